@@ -0,0 +1,224 @@
+﻿/************************************************************************************/
+/*
+* File name: BeltReference.cpp
+*
+* Synopsis:  This file contains the implementation of the CBeltReference class that
+*            captures the profile of the empty conveyor belt and subtracts it from
+*            the converted profiles.
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+#include <mil.h>
+#include <string.h>
+#include <math.h>
+#include "BeltReference.h"
+
+//*****************************************************************************
+// Constants.
+//*****************************************************************************
+
+// Minimum weighted number of tracked points to update the model of the belt.
+static const MIL_DOUBLE MIN_TRACKING_WEIGHT = 100.0;
+
+//*****************************************************************************
+// Solve. Solves the least squares fit of the line. If the points do not
+//        span enough X to fit a slope, only the offset is fitted. Returns
+//        false if there are not enough points.
+//*****************************************************************************
+bool SPLineSums::Solve(SPBeltModel& Model) const
+   {
+   if(S1 < MIN_TRACKING_WEIGHT)
+      return false;
+
+   MIL_DOUBLE Det = S1 * SXX - SX * SX;
+   if(Det > 1e-9 * S1 * SXX)
+      {
+      Model.SlopeX = (S1 * SXZ - SX * SZ) / Det;
+      Model.Offset = (SZ - Model.SlopeX * SX) / S1;
+      }
+   else
+      {
+      Model.SlopeX = 0.0;
+      Model.Offset = SZ / S1;
+      }
+   Model.Weight = S1;
+   return true;
+   }
+
+//*****************************************************************************
+// Constructor.
+//*****************************************************************************
+CBeltReference::CBeltReference(MIL_INT ProfileSize, const SPBeltSettings& Settings)
+   : m_NbReferenceBlocks(Settings.NbReferenceBlocks > 0 ? Settings.NbReferenceBlocks : 1),
+     m_Tolerance((MIL_FLOAT)Settings.Tolerance),
+     m_TrackingBand((MIL_FLOAT)Settings.TrackingBand),
+     m_TrackingFade(pow(0.5, 1.0 / (Settings.TrackingHalfLife > 0 ? Settings.TrackingHalfLife : 1))),
+     m_NbCapturedBlocks(0),
+     m_IsReady(false),
+     m_Reference(ProfileSize, 0.0f),
+     m_SumZ(ProfileSize, 0.0),
+     m_Count(ProfileSize, 0)
+   {
+   }
+
+//*****************************************************************************
+// Destructor.
+//*****************************************************************************
+CBeltReference::~CBeltReference()
+   {
+   }
+
+//*****************************************************************************
+// ProcessRow. Processes a converted row. While the reference is captured,
+//             accumulates the Z of the valid points per column and
+//             invalidates the row. Then, subtracts the reference from the
+//             Z of the points with the model of the belt, accumulates the
+//             sums of the tracked points and invalidates the points of the
+//             belt. pMask can be M_NULL if all points are valid, in which
+//             case the points are not invalidated.
+//*****************************************************************************
+void CBeltReference::ProcessRow(const MIL_FLOAT* pX, MIL_FLOAT* pZ, MIL_UINT8* pMask, MIL_INT Size)
+   {
+   if(!m_IsReady)
+      {
+      for(MIL_INT x = 0; x < Size; x++)
+         {
+         MIL_INT Valid = pMask ? (pMask[x] != 0) : 1;
+         m_SumZ[x] += Valid ? pZ[x] : 0.0;
+         m_Count[x] += Valid;
+         }
+      if(pMask)
+         memset(pMask, 0, (size_t)Size);
+      return;
+      }
+
+   const MIL_FLOAT* pReference = &m_Reference[0];
+   const MIL_FLOAT Tolerance = m_Tolerance;
+   const MIL_FLOAT Offset = (MIL_FLOAT)m_Model.Offset;
+   const MIL_FLOAT SlopeX = (MIL_FLOAT)m_Model.SlopeX;
+   if(m_TrackingBand <= 0)
+      {
+      for(MIL_INT x = 0; x < Size; x++)
+         {
+         MIL_FLOAT Height = pZ[x] - pReference[x] - (Offset + SlopeX * pX[x]);
+         pZ[x] = Height;
+         if(pMask)
+            pMask[x] = (Height > Tolerance || Height < -Tolerance) ? pMask[x] : (MIL_UINT8)0;
+         }
+      return;
+      }
+
+   const MIL_FLOAT Band = m_TrackingBand;
+   SPLineSums RowSums;
+   for(MIL_INT x = 0; x < Size; x++)
+      {
+      MIL_FLOAT Drift = pZ[x] - pReference[x];
+      MIL_FLOAT Height = Drift - (Offset + SlopeX * pX[x]);
+      pZ[x] = Height;
+      bool Valid = pMask ? pMask[x] != 0 : true;
+      if(Valid && Height <= Band && Height >= -Band)
+         {
+         RowSums.S1 += 1.0;
+         RowSums.SX += pX[x];
+         RowSums.SXX += (MIL_DOUBLE)pX[x] * pX[x];
+         RowSums.SZ += Drift;
+         RowSums.SXZ += (MIL_DOUBLE)pX[x] * Drift;
+         }
+      if(pMask)
+         pMask[x] = (Height > Tolerance || Height < -Tolerance) ? pMask[x] : (MIL_UINT8)0;
+      }
+   m_BlockSums.Add(RowSums);
+   }
+
+//*****************************************************************************
+// TrackPoints. Adds the sampled points of a block that is not converted to
+//              the sums of the tracked points. Each point is weighted as
+//              Weight points of the block and is given with the column of
+//              its profile.
+//*****************************************************************************
+void CBeltReference::TrackPoints(const MIL_FLOAT* pX, const MIL_FLOAT* pZ, const MIL_INT* pColumns,
+                                 MIL_INT NbPoints, MIL_DOUBLE Weight)
+   {
+   if(!m_IsReady || m_TrackingBand <= 0)
+      return;
+
+   const MIL_FLOAT Offset = (MIL_FLOAT)m_Model.Offset;
+   const MIL_FLOAT SlopeX = (MIL_FLOAT)m_Model.SlopeX;
+   const MIL_FLOAT Band = m_TrackingBand;
+   SPLineSums PointSums;
+   for(MIL_INT i = 0; i < NbPoints; i++)
+      {
+      MIL_FLOAT Drift = pZ[i] - m_Reference[pColumns[i]];
+      MIL_FLOAT Height = Drift - (Offset + SlopeX * pX[i]);
+      if(Height <= Band && Height >= -Band)
+         {
+         PointSums.S1 += 1.0;
+         PointSums.SX += pX[i];
+         PointSums.SXX += (MIL_DOUBLE)pX[i] * pX[i];
+         PointSums.SZ += Drift;
+         PointSums.SXZ += (MIL_DOUBLE)pX[i] * Drift;
+         }
+      }
+   PointSums.Scale(Weight);
+   m_BlockSums.Add(PointSums);
+   }
+
+//*****************************************************************************
+// EndBlock. Ends the processing of a block. Builds the reference once the
+//           reference blocks are captured. Then, fades the sums of the
+//           previously tracked points, adds the ones of the block and
+//           updates the model of the belt.
+//*****************************************************************************
+void CBeltReference::EndBlock()
+   {
+   if(!m_IsReady)
+      {
+      if(++m_NbCapturedBlocks >= m_NbReferenceBlocks)
+         BuildReference();
+      return;
+      }
+
+   if(m_TrackingBand > 0)
+      {
+      m_TrackedSums.Scale(m_TrackingFade);
+      m_TrackedSums.Add(m_BlockSums);
+      m_BlockSums = SPLineSums();
+      m_TrackedSums.Solve(m_Model);
+      }
+   }
+
+//*****************************************************************************
+// BuildReference. Builds the reference from the accumulated Z. The columns
+//                 without any valid point take the value interpolated
+//                 between the nearest valid columns, or the value of the
+//                 nearest one at the ends. If no column is valid, the
+//                 capture continues.
+//*****************************************************************************
+void CBeltReference::BuildReference()
+   {
+   MIL_INT Size = (MIL_INT)m_Reference.size();
+   MIL_INT PrevValid = -1;
+   for(MIL_INT x = 0; x < Size; x++)
+      {
+      if(!m_Count[x])
+         continue;
+
+      m_Reference[x] = (MIL_FLOAT)(m_SumZ[x] / m_Count[x]);
+      MIL_INT GapStart = PrevValid >= 0 ? PrevValid + 1 : 0;
+      for(MIL_INT g = GapStart; g < x; g++)
+         {
+         m_Reference[g] = PrevValid >= 0 ?
+            m_Reference[PrevValid] + (m_Reference[x] - m_Reference[PrevValid]) * (g - PrevValid) / (x - PrevValid) :
+            m_Reference[x];
+         }
+      PrevValid = x;
+      }
+
+   if(PrevValid < 0)
+      return;
+
+   for(MIL_INT g = PrevValid + 1; g < Size; g++)
+      m_Reference[g] = m_Reference[PrevValid];
+   m_IsReady = true;
+   }
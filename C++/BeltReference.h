@@ -0,0 +1,122 @@
+﻿/************************************************************************************/
+/*
+* File name: BeltReference.h
+*
+* Synopsis:  This file contains the declaration of the CBeltReference class that
+*            captures the profile of the empty conveyor belt and subtracts it from
+*            the converted profiles, so that the profile processes get the height
+*            of the points above the belt.
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+
+#ifndef BELT_REFERENCE_H
+#define BELT_REFERENCE_H
+
+#include <vector>
+
+//*****************************************************************************
+// Structure defining the reference profile of the belt.
+//*****************************************************************************
+struct SPBeltSettings
+   {
+   SPBeltSettings(): NbReferenceBlocks(0), Tolerance(0.0), TrackingBand(0.0), TrackingHalfLife(0) {};
+
+   MIL_INT    NbReferenceBlocks; // Empty blocks averaged at startup. 0 to keep the absolute Z.
+   MIL_DOUBLE Tolerance;         // Points closer to the belt are invalid, in mm.
+   MIL_DOUBLE TrackingBand;      // Points closer to the belt track its drift, in mm. 0 for a static belt.
+   MIL_INT    TrackingHalfLife;  // Number of blocks after which a tracked point weighs half.
+   };
+
+//*****************************************************************************
+// Structure defining the drift of the belt from the reference profile. The
+// belt is at the height Offset + SlopeX * X above the reference.
+//*****************************************************************************
+struct SPBeltModel
+   {
+   SPBeltModel(): Offset(0.0), SlopeX(0.0), Weight(0.0) {};
+
+   MIL_DOUBLE Offset;   // in mm
+   MIL_DOUBLE SlopeX;   // in mm/mm
+   MIL_DOUBLE Weight;   // Weighted number of the tracked points of the model.
+   };
+
+//*****************************************************************************
+// Structure holding the running sums of the least squares fit of a line
+// Z = Offset + SlopeX * X.
+//*****************************************************************************
+struct SPLineSums
+   {
+   SPLineSums(): S1(0.0), SX(0.0), SXX(0.0), SZ(0.0), SXZ(0.0) {};
+   void Scale(MIL_DOUBLE Factor)
+      {
+      S1 *= Factor; SX *= Factor; SXX *= Factor; SZ *= Factor; SXZ *= Factor;
+      }
+   void Add(const SPLineSums& Sums)
+      {
+      S1 += Sums.S1; SX += Sums.SX; SXX += Sums.SXX; SZ += Sums.SZ; SXZ += Sums.SXZ;
+      }
+   bool Solve(SPBeltModel& Model) const;
+
+   MIL_DOUBLE S1;
+   MIL_DOUBLE SX;
+   MIL_DOUBLE SXX;
+   MIL_DOUBLE SZ;
+   MIL_DOUBLE SXZ;
+   };
+
+//*****************************************************************************
+// Class holding the reference profile of the belt.
+//
+// The reference is a table of the mean Z of each column of the profiles. It
+// is captured on the first NbReferenceBlocks blocks, which must only contain
+// belt, and the points of these blocks are invalid. The columns without any
+// valid point are interpolated from their neighbors. Then the reference is
+// subtracted from the Z of the points of each converted row, while the row
+// is still in the cache, and the points within the tolerance of the belt
+// are invalid.
+//
+// The belt drifts with the temperature and the wear. If tracked, the points
+// within the tracking band of the belt feed the running sums of a line fit
+// of their heights above the reference. The sums fade by block, so the
+// memory and the cost of the fit are constant. The model of the belt is
+// updated at the end of each block and subtracted with the reference. The
+// blocks that are not converted, such as the empty blocks, feed the sums
+// with a weighted sample of their points.
+//*****************************************************************************
+class CBeltReference
+   {
+   public:
+      CBeltReference(MIL_INT ProfileSize, const SPBeltSettings& Settings);
+      virtual ~CBeltReference();
+
+      void ProcessRow(const MIL_FLOAT* pX, MIL_FLOAT* pZ, MIL_UINT8* pMask, MIL_INT Size);
+      void TrackPoints(const MIL_FLOAT* pX, const MIL_FLOAT* pZ, const MIL_INT* pColumns,
+                       MIL_INT NbPoints, MIL_DOUBLE Weight);
+      void EndBlock();
+
+      bool IsReady() const { return m_IsReady; }
+      MIL_INT GetNbCapturedBlocks() const { return m_NbCapturedBlocks; }
+      const MIL_FLOAT* GetReference() const { return &m_Reference[0]; }
+      MIL_DOUBLE GetTolerance() const { return m_Tolerance; }
+      const SPBeltModel& GetModel() const { return m_Model; }
+
+   private:
+      void BuildReference();
+
+      MIL_INT                 m_NbReferenceBlocks;
+      MIL_FLOAT               m_Tolerance;
+      MIL_FLOAT               m_TrackingBand;
+      MIL_DOUBLE              m_TrackingFade;
+      MIL_INT                 m_NbCapturedBlocks;
+      bool                    m_IsReady;
+      std::vector<MIL_FLOAT>  m_Reference;
+      std::vector<MIL_DOUBLE> m_SumZ;
+      std::vector<MIL_INT>    m_Count;
+      SPLineSums              m_BlockSums;
+      SPLineSums              m_TrackedSums;
+      SPBeltModel             m_Model;
+   };
+
+#endif // BELT_REFERENCE_H
@@ -0,0 +1,288 @@
+﻿/************************************************************************************/
+/*
+* File name: BufferPlanner.cpp
+*
+* Synopsis:  This file contains the implementation of the CBufferPlanner class that
+*            computes the lifetime of the intermediate buffers of a chain of
+*            CDataConversion and allocates them so that buffers that are never
+*            alive at the same time share memory, and so that conversions that
+*            only change the buffer format are done in place.
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+#include <mil.h>
+#include "BufferPlanner.h"
+
+//*****************************************************************************
+// Constructor.
+//*****************************************************************************
+CBufferPlanner::CBufferPlanner(MIL_ID MilSystem, const SPAllocPolicy& Policy)
+   : m_MilSystem(MilSystem), m_Policy(Policy), m_CurStage(0)
+   {
+   }
+
+//*****************************************************************************
+// Destructor. Frees the buffers and the slabs.
+//*****************************************************************************
+CBufferPlanner::~CBufferPlanner()
+   {
+   for(size_t b = 0; b < m_Buffers.size(); b++)
+      {
+      if(m_Buffers[b].MilBuffer)
+         MbufFree(m_Buffers[b].MilBuffer);
+      }
+   for(size_t s = 0; s < m_SlabMemory.size(); s++)
+      FreeHostMemory(m_SlabMemory[s]);
+   }
+
+//*****************************************************************************
+// BeginStage. Starts the planning of the next stage of the chain. The buffers
+//             requested and used afterward are associated to that stage.
+//*****************************************************************************
+void CBufferPlanner::BeginStage()
+   {
+   m_CurStage++;
+   }
+
+//*****************************************************************************
+// AddExternal. Declares a buffer that is allocated outside of the planner,
+//              such as the grab buffer. It is never allocated nor aliased.
+//*****************************************************************************
+MIL_INT CBufferPlanner::AddExternal(MIL_INT SizeX, MIL_INT SizeY, MIL_INT Type, MIL_INT Pitch)
+   {
+   return AddBuffer(SizeX, SizeY, Type, Pitch, true);
+   }
+
+//*****************************************************************************
+// Request. Declares a new buffer produced by the current stage.
+//*****************************************************************************
+MIL_INT CBufferPlanner::Request(MIL_INT SizeX, MIL_INT SizeY, MIL_INT Type)
+   {
+   return AddBuffer(SizeX, SizeY, Type, SizeX, false);
+   }
+
+//*****************************************************************************
+// RequestView. Declares a buffer produced by the current stage that holds the
+//              same data as the source buffer in a different format. If the
+//              source is contiguous and of the same type, the new buffer is
+//              an alias of the source and the conversion becomes in place.
+//*****************************************************************************
+MIL_INT CBufferPlanner::RequestView(MIL_INT SizeX, MIL_INT SizeY, MIL_INT Type, MIL_INT Source)
+   {
+   MIL_INT View = AddBuffer(SizeX, SizeY, Type, SizeX, false);
+   if(Source != NO_PLANNED_BUFFER)
+      {
+      const SPBuffer& Src = m_Buffers[Source];
+      if(!Src.External &&
+         Src.Type == Type &&
+         Src.Pitch == Src.SizeX &&
+         Src.SizeX * Src.SizeY == SizeX * SizeY)
+         {
+         m_Buffers[View].AliasOf = GetRoot(Source);
+         m_Buffers[GetRoot(Source)].Viewed = true;
+         }
+      }
+   return View;
+   }
+
+//*****************************************************************************
+// Use. Declares that the current stage uses the buffer.
+//*****************************************************************************
+void CBufferPlanner::Use(MIL_INT Buffer)
+   {
+   if(Buffer != NO_PLANNED_BUFFER)
+      m_Buffers[Buffer].LastStage = m_CurStage;
+   }
+
+void CBufferPlanner::Use(const SPPlanData& Data)
+   {
+   Use(Data.X);
+   Use(Data.Z);
+   Use(Data.ValidMask);
+   }
+
+//*****************************************************************************
+// Allocate. Computes the live range of each buffer, assigns the buffers to
+//           memory slabs and allocates them. Two buffers share a slab only
+//           if their live ranges do not overlap.
+//*****************************************************************************
+void CBufferPlanner::Allocate()
+   {
+   // Align the rows of the buffers. The viewed buffers stay contiguous.
+   for(size_t b = 0; b < m_Buffers.size(); b++)
+      {
+      SPBuffer& Buffer = m_Buffers[b];
+      if(Buffer.External || Buffer.Viewed || Buffer.AliasOf != NO_PLANNED_BUFFER)
+         continue;
+      Buffer.Pitch = GetAlignedPitch(Buffer.SizeX, Buffer.Type, m_Policy);
+      Buffer.Bytes = Buffer.Pitch * Buffer.SizeY * GetBytesPerPixel(Buffer.Type);
+      }
+
+   // Extend the live range of the aliased buffers to cover their aliases.
+   for(size_t b = 0; b < m_Buffers.size(); b++)
+      {
+      if(m_Buffers[b].AliasOf != NO_PLANNED_BUFFER)
+         {
+         SPBuffer& Root = m_Buffers[m_Buffers[b].AliasOf];
+         if(m_Buffers[b].LastStage > Root.LastStage)
+            Root.LastStage = m_Buffers[b].LastStage;
+         }
+      }
+
+   // Assign the root buffers to the slabs. The buffers are declared in stage
+   // order so they are visited by increasing first stage.
+   std::vector<MIL_INT> SlabLastStage;
+   for(size_t b = 0; b < m_Buffers.size(); b++)
+      {
+      SPBuffer& Buffer = m_Buffers[b];
+      if(Buffer.External || Buffer.AliasOf != NO_PLANNED_BUFFER)
+         continue;
+
+      // Find the free slab whose size is the closest to the buffer size.
+      MIL_INT BestSlab = -1;
+      MIL_INT BestCost = 0;
+      for(size_t s = 0; s < m_SlabBytes.size(); s++)
+         {
+         if(SlabLastStage[s] >= Buffer.FirstStage)
+            continue;
+         MIL_INT Cost = m_SlabBytes[s] >= Buffer.Bytes ? m_SlabBytes[s] - Buffer.Bytes : 2 * (Buffer.Bytes - m_SlabBytes[s]);
+         if(BestSlab < 0 || Cost < BestCost)
+            {
+            BestSlab = (MIL_INT)s;
+            BestCost = Cost;
+            }
+         }
+
+      // Create a new slab if no slab is free.
+      if(BestSlab < 0)
+         {
+         BestSlab = (MIL_INT)m_SlabBytes.size();
+         m_SlabBytes.push_back(0);
+         SlabLastStage.push_back(0);
+         }
+      if(m_SlabBytes[BestSlab] < Buffer.Bytes)
+         m_SlabBytes[BestSlab] = Buffer.Bytes;
+      SlabLastStage[BestSlab] = Buffer.LastStage;
+      Buffer.Slab = BestSlab;
+      }
+
+   // Allocate the slabs. All the buffers start at the beginning of their slab
+   // so they are aligned like the slab.
+   m_SlabMemory.resize(m_SlabBytes.size());
+   for(size_t s = 0; s < m_SlabBytes.size(); s++)
+      m_SlabMemory[s] = AllocHostMemory(m_SlabBytes[s], m_Policy);
+
+   // Create the buffers on the memory of their slab.
+   for(size_t b = 0; b < m_Buffers.size(); b++)
+      {
+      SPBuffer& Buffer = m_Buffers[b];
+      if(Buffer.External)
+         continue;
+      MIL_INT Slab = m_Buffers[GetRoot((MIL_INT)b)].Slab;
+      void* pSlabData = m_SlabMemory[Slab].pData;
+      MbufCreate2d(m_MilSystem, Buffer.SizeX, Buffer.SizeY, Buffer.Type, M_IMAGE + M_PROC,
+                   M_HOST_ADDRESS + M_PITCH, Buffer.Pitch, pSlabData, &Buffer.MilBuffer);
+      }
+   }
+
+//*****************************************************************************
+// GetBuffer. Gets the MIL buffer allocated for a planned buffer.
+//*****************************************************************************
+MIL_ID CBufferPlanner::GetBuffer(MIL_INT Buffer) const
+   {
+   return Buffer != NO_PLANNED_BUFFER ? m_Buffers[Buffer].MilBuffer : M_NULL;
+   }
+
+//*****************************************************************************
+// GetType. Gets the type of a planned buffer, external ones included.
+//*****************************************************************************
+MIL_INT CBufferPlanner::GetType(MIL_INT Buffer) const
+   {
+   return Buffer != NO_PLANNED_BUFFER ? m_Buffers[Buffer].Type : 0;
+   }
+
+//*****************************************************************************
+// GetUnplannedWorkingSet. Gets the memory that the buffers would use if
+//                         each of them was allocated separately.
+//*****************************************************************************
+MIL_INT CBufferPlanner::GetUnplannedWorkingSet() const
+   {
+   MIL_INT WorkingSet = 0;
+   for(size_t b = 0; b < m_Buffers.size(); b++)
+      {
+      if(!m_Buffers[b].External)
+         WorkingSet += m_Buffers[b].Bytes;
+      }
+   return WorkingSet;
+   }
+
+//*****************************************************************************
+// GetPlannedWorkingSet. Gets the memory used by the allocated slabs.
+//*****************************************************************************
+MIL_INT CBufferPlanner::GetPlannedWorkingSet() const
+   {
+   MIL_INT WorkingSet = 0;
+   for(size_t s = 0; s < m_SlabBytes.size(); s++)
+      WorkingSet += m_SlabBytes[s];
+   return WorkingSet;
+   }
+
+//*****************************************************************************
+// PrintReport. Prints the peak working set before and after the planning.
+//*****************************************************************************
+void CBufferPlanner::PrintReport() const
+   {
+   MIL_INT NbBuffers = 0;
+   MIL_INT NbAliases = 0;
+   MIL_INT NbLargePageSlabs = 0;
+   for(size_t b = 0; b < m_Buffers.size(); b++)
+      {
+      if(!m_Buffers[b].External)
+         NbBuffers++;
+      if(m_Buffers[b].AliasOf != NO_PLANNED_BUFFER)
+         NbAliases++;
+      }
+   for(size_t s = 0; s < m_SlabMemory.size(); s++)
+      {
+      if(m_SlabMemory[s].Kind == HOST_MEMORY_LARGE_PAGES)
+         NbLargePageSlabs++;
+      }
+
+   MosPrintf(MIL_TEXT("Data conversion buffers: %d planned, %d converted in place, %d memory slab(s).\n")
+             MIL_TEXT("Rows aligned on %d bytes, %d slab(s) on large pages.\n")
+             MIL_TEXT("Peak working set: %.1f KB before planning, %.1f KB after planning.\n\n"),
+             (int)NbBuffers, (int)NbAliases, (int)m_SlabBytes.size(),
+             (int)m_Policy.RowAlignment, (int)NbLargePageSlabs,
+             GetUnplannedWorkingSet() / 1024.0, GetPlannedWorkingSet() / 1024.0);
+   }
+
+//*****************************************************************************
+// AddBuffer. Adds a buffer produced by the current stage.
+//*****************************************************************************
+MIL_INT CBufferPlanner::AddBuffer(MIL_INT SizeX, MIL_INT SizeY, MIL_INT Type, MIL_INT Pitch, bool External)
+   {
+   SPBuffer Buffer;
+   Buffer.SizeX = SizeX;
+   Buffer.SizeY = SizeY;
+   Buffer.Type = Type;
+   Buffer.Pitch = Pitch;
+   Buffer.Bytes = Pitch * SizeY * GetBytesPerPixel(Type);
+   Buffer.External = External;
+   Buffer.AliasOf = NO_PLANNED_BUFFER;
+   Buffer.Viewed = false;
+   Buffer.FirstStage = m_CurStage;
+   Buffer.LastStage = m_CurStage;
+   Buffer.Slab = -1;
+   Buffer.MilBuffer = M_NULL;
+   m_Buffers.push_back(Buffer);
+   return (MIL_INT)m_Buffers.size() - 1;
+   }
+
+//*****************************************************************************
+// GetRoot. Gets the buffer that owns the memory of a buffer.
+//*****************************************************************************
+MIL_INT CBufferPlanner::GetRoot(MIL_INT Buffer) const
+   {
+   return m_Buffers[Buffer].AliasOf != NO_PLANNED_BUFFER ? m_Buffers[Buffer].AliasOf : Buffer;
+   }
@@ -0,0 +1,102 @@
+﻿/************************************************************************************/
+/*
+* File name: BufferPlanner.h
+*
+* Synopsis:  This file contains the declaration of the CBufferPlanner class that
+*            computes the lifetime of the intermediate buffers of a chain of
+*            CDataConversion and allocates them so that buffers that are never
+*            alive at the same time share memory, and so that conversions that
+*            only change the buffer format are done in place.
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+
+#ifndef BUFFER_PLANNER_H
+#define BUFFER_PLANNER_H
+
+#include <vector>
+#include "HostMemory.h"
+
+//*****************************************************************************
+// Constants.
+//*****************************************************************************
+static const MIL_INT NO_PLANNED_BUFFER = -1;
+
+//*****************************************************************************
+// Structure defining the planned buffers of some profile data. It is the
+// planning counterpart of SPData.
+//*****************************************************************************
+struct SPPlanData
+   {
+   SPPlanData(): X(NO_PLANNED_BUFFER), Z(NO_PLANNED_BUFFER), ValidMask(NO_PLANNED_BUFFER){};
+
+   MIL_INT X;
+   MIL_INT Z;
+   MIL_INT ValidMask;
+   };
+
+//*****************************************************************************
+// Class that plans and allocates the intermediate buffers of a data
+// conversion chain.
+//
+// The planning is done in two steps. First, each stage of the chain declares,
+// in processing order, the buffers it produces and the buffers it uses. Then,
+// Allocate() computes the live range of the buffers and assigns them to memory
+// slabs. The stages finally retrieve their MIL buffers with GetBuffer().
+//
+// The slabs are allocated according to the allocation policy. The rows of
+// the buffers that are not viewed in another format are padded to the row
+// alignment of the policy.
+//*****************************************************************************
+class CBufferPlanner
+   {
+   public:
+      CBufferPlanner(MIL_ID MilSystem, const SPAllocPolicy& Policy);
+      virtual ~CBufferPlanner();
+
+      // Planning functions.
+      void BeginStage();
+      MIL_INT AddExternal(MIL_INT SizeX, MIL_INT SizeY, MIL_INT Type, MIL_INT Pitch);
+      MIL_INT Request(MIL_INT SizeX, MIL_INT SizeY, MIL_INT Type);
+      MIL_INT RequestView(MIL_INT SizeX, MIL_INT SizeY, MIL_INT Type, MIL_INT Source);
+      void Use(MIL_INT Buffer);
+      void Use(const SPPlanData& Data);
+
+      // Allocation functions.
+      void Allocate();
+      MIL_ID GetBuffer(MIL_INT Buffer) const;
+      MIL_INT GetType(MIL_INT Buffer) const;
+      MIL_INT GetUnplannedWorkingSet() const;
+      MIL_INT GetPlannedWorkingSet() const;
+      void PrintReport() const;
+
+   private:
+      struct SPBuffer
+         {
+         MIL_INT SizeX;
+         MIL_INT SizeY;
+         MIL_INT Type;
+         MIL_INT Pitch;
+         MIL_INT Bytes;
+         bool    External;
+         MIL_INT AliasOf;
+         bool    Viewed;
+         MIL_INT FirstStage;
+         MIL_INT LastStage;
+         MIL_INT Slab;
+         MIL_ID  MilBuffer;
+         };
+
+      MIL_INT AddBuffer(MIL_INT SizeX, MIL_INT SizeY, MIL_INT Type, MIL_INT Pitch, bool External);
+      MIL_INT GetRoot(MIL_INT Buffer) const;
+
+      MIL_ID m_MilSystem;
+      SPAllocPolicy m_Policy;
+      MIL_INT m_CurStage;
+      std::vector<SPBuffer> m_Buffers;
+      std::vector<MIL_INT>  m_SlabBytes;
+      std::vector<SPHostMemory> m_SlabMemory;
+   };
+
+#endif // BUFFER_PLANNER_H
@@ -0,0 +1,198 @@
+﻿/************************************************************************************/
+/*
+* File name: CpuFeatures.cpp
+*
+* Synopsis:  This file contains the implementation of the functions that detect the
+*            instruction sets supported by the CPU and select the instruction
+*            set used by the host kernels.
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+#include <mil.h>
+#include <stdlib.h>
+#include <string.h>
+#include "CpuFeatures.h"
+
+#if M_MIL_USE_WINDOWS
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#if KERNELS_USE_SSE41
+   #if defined(_MSC_VER)
+      #include <intrin.h>
+   #else
+      #include <cpuid.h>
+   #endif
+#endif
+
+//*****************************************************************************
+// Constants.
+//*****************************************************************************
+static const char* KERNEL_ISA_ENV_VALUES[NB_KERNEL_ISA] =
+   {
+   "scalar",
+   "sse4.1",
+   "avx2",
+   "avx512"
+   };
+
+static MIL_CONST_TEXT_PTR KERNEL_ISA_NAMES[NB_KERNEL_ISA] =
+   {
+   MIL_TEXT("scalar"),
+   MIL_TEXT("SSE4.1"),
+   MIL_TEXT("AVX2"),
+   MIL_TEXT("AVX-512")
+   };
+
+//*****************************************************************************
+// Override of the instruction set. -1 when not overridden.
+//*****************************************************************************
+static MIL_INT g_KernelIsaOverride = -1;
+
+#if KERNELS_USE_SSE41
+//*****************************************************************************
+// Cpuid. Executes the cpuid instruction for a leaf and a sub-leaf.
+//*****************************************************************************
+static void Cpuid(unsigned int Leaf, unsigned int SubLeaf, unsigned int Regs[4])
+   {
+#if defined(_MSC_VER)
+   int IntRegs[4];
+   __cpuidex(IntRegs, (int)Leaf, (int)SubLeaf);
+   for(int r = 0; r < 4; r++)
+      Regs[r] = (unsigned int)IntRegs[r];
+#else
+   __cpuid_count(Leaf, SubLeaf, Regs[0], Regs[1], Regs[2], Regs[3]);
+#endif
+   }
+
+//*****************************************************************************
+// GetEnabledXStates. Gets the register states enabled by the OS.
+//*****************************************************************************
+static unsigned long long GetEnabledXStates()
+   {
+#if defined(_MSC_VER)
+   return _xgetbv(0);
+#else
+   unsigned int Eax, Edx;
+   __asm__ __volatile__("xgetbv" : "=a"(Eax), "=d"(Edx) : "c"(0));
+   return ((unsigned long long)Edx << 32) | Eax;
+#endif
+   }
+#endif
+
+//*****************************************************************************
+// GetSupportedKernelIsa. Gets the highest instruction set supported by the
+//                        CPU and the OS for which the kernels are compiled.
+//*****************************************************************************
+EKernelIsa GetSupportedKernelIsa()
+   {
+   static MIL_INT SupportedIsa = -1;
+   if(SupportedIsa >= 0)
+      return (EKernelIsa)SupportedIsa;
+
+   EKernelIsa Isa = KERNEL_ISA_SCALAR;
+#if KERNELS_USE_SSE41
+   unsigned int Regs[4];
+   Cpuid(0, 0, Regs);
+   unsigned int MaxLeaf = Regs[0];
+   Cpuid(1, 0, Regs);
+   bool HasSse41 = (Regs[2] & (1u << 19)) != 0;
+   bool HasOsXSave = (Regs[2] & (1u << 27)) != 0;
+   bool HasAvx = (Regs[2] & (1u << 28)) != 0;
+
+   // The OS must save the AVX (YMM) and AVX-512 (opmask, ZMM) registers.
+   unsigned long long XStates = HasOsXSave ? GetEnabledXStates() : 0;
+   bool OsSavesYmm = (XStates & 0x6) == 0x6;
+   bool OsSavesZmm = (XStates & 0xE6) == 0xE6;
+
+   bool HasAvx2 = false;
+   bool HasAvx512 = false;
+   if(MaxLeaf >= 7)
+      {
+      Cpuid(7, 0, Regs);
+      HasAvx2 = (Regs[1] & (1u << 5)) != 0;
+      HasAvx512 = (Regs[1] & (1u << 16)) != 0 && (Regs[1] & (1u << 30)) != 0;
+      }
+
+   if(HasSse41)
+      Isa = KERNEL_ISA_SSE41;
+#if KERNELS_USE_AVX2
+   if(HasAvx && HasAvx2 && OsSavesYmm)
+      Isa = KERNEL_ISA_AVX2;
+#endif
+#if KERNELS_USE_AVX512
+   if(HasAvx512 && OsSavesZmm)
+      Isa = KERNEL_ISA_AVX512;
+#endif
+#endif
+
+   SupportedIsa = Isa;
+   return Isa;
+   }
+
+//*****************************************************************************
+// SetKernelIsaOverride. Forces the instruction set of the kernels, for
+//                       example to test the lower instruction sets on a
+//                       recent CPU. Must be called before the kernels are
+//                       selected.
+//*****************************************************************************
+void SetKernelIsaOverride(EKernelIsa Isa)
+   {
+   g_KernelIsaOverride = Isa;
+   }
+
+void ClearKernelIsaOverride()
+   {
+   g_KernelIsaOverride = -1;
+   }
+
+//*****************************************************************************
+// GetKernelIsa. Gets the instruction set of the kernels to use. It is the
+//               overridden instruction set, set by SetKernelIsaOverride() or
+//               by the environment variable, if any, or the best supported
+//               one. The override is capped to the supported instruction set.
+//*****************************************************************************
+EKernelIsa GetKernelIsa()
+   {
+   MIL_INT Isa = g_KernelIsaOverride;
+   if(Isa < 0)
+      {
+      const char* pEnvValue = getenv(KERNEL_ISA_ENV_VARIABLE);
+      for(MIL_INT i = 0; pEnvValue && i < NB_KERNEL_ISA; i++)
+         {
+         if(strcmp(pEnvValue, KERNEL_ISA_ENV_VALUES[i]) == 0)
+            Isa = i;
+         }
+      }
+
+   EKernelIsa SupportedIsa = GetSupportedKernelIsa();
+   if(Isa < 0 || Isa > SupportedIsa)
+      Isa = SupportedIsa;
+   return (EKernelIsa)Isa;
+   }
+
+//*****************************************************************************
+// GetKernelIsaName. Gets the display name of an instruction set.
+//*****************************************************************************
+MIL_CONST_TEXT_PTR GetKernelIsaName(EKernelIsa Isa)
+   {
+   return (Isa >= 0 && Isa < NB_KERNEL_ISA) ? KERNEL_ISA_NAMES[Isa] : MIL_TEXT("unknown");
+   }
+
+//*****************************************************************************
+// GetNbLogicalCores. Gets the number of logical cores of the CPU.
+//*****************************************************************************
+MIL_INT GetNbLogicalCores()
+   {
+#if M_MIL_USE_WINDOWS
+   SYSTEM_INFO SystemInfo;
+   GetSystemInfo(&SystemInfo);
+   MIL_INT NbCores = (MIL_INT)SystemInfo.dwNumberOfProcessors;
+#else
+   MIL_INT NbCores = (MIL_INT)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+   return NbCores > 0 ? NbCores : 1;
+   }
@@ -0,0 +1,76 @@
+﻿/************************************************************************************/
+/*
+* File name: CpuFeatures.h
+*
+* Synopsis:  This file contains the declaration of the functions that detect the
+*            instruction sets supported by the CPU and select the instruction
+*            set used by the host kernels.
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+// The vectorized kernels are only compiled for x86 processors. AVX2 and
+// AVX-512 intrinsics require Visual Studio 2013 and 2017 respectively.
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+   #define KERNELS_USE_SSE41 1
+   #if defined(_MSC_VER)
+      #define KERNELS_USE_AVX2   (_MSC_VER >= 1800)
+      #define KERNELS_USE_AVX512 (_MSC_VER >= 1911)
+   #else
+      #define KERNELS_USE_AVX2   1
+      #define KERNELS_USE_AVX512 1
+   #endif
+#else
+   #define KERNELS_USE_SSE41  0
+   #define KERNELS_USE_AVX2   0
+   #define KERNELS_USE_AVX512 0
+#endif
+
+// Function attributes that enable an instruction set on a single function.
+// Visual Studio does not need them to compile the intrinsics. Code shared
+// with the scalar kernels is kept out of line so that the compiler does not
+// fuse its multiply and add operations when it inlines it in a kernel
+// compiled for a FMA capable instruction set.
+#if defined(__GNUC__)
+   #define KERNEL_TARGET_SSE41  __attribute__((target("sse4.1")))
+   #define KERNEL_TARGET_AVX2   __attribute__((target("avx2")))
+   #define KERNEL_TARGET_AVX512 __attribute__((target("avx512f,avx512bw,popcnt")))
+   #define KERNEL_NOINLINE      __attribute__((noinline))
+#else
+   #define KERNEL_TARGET_SSE41
+   #define KERNEL_TARGET_AVX2
+   #define KERNEL_TARGET_AVX512
+   #define KERNEL_NOINLINE      __declspec(noinline)
+#endif
+
+//*****************************************************************************
+// Instruction sets for which the kernels are compiled, in increasing order.
+//*****************************************************************************
+enum EKernelIsa
+   {
+   KERNEL_ISA_SCALAR = 0,
+   KERNEL_ISA_SSE41,
+   KERNEL_ISA_AVX2,
+   KERNEL_ISA_AVX512,
+   NB_KERNEL_ISA
+   };
+
+// Name of the environment variable that overrides the instruction set.
+// The accepted values are "scalar", "sse4.1", "avx2" and "avx512".
+#define KERNEL_ISA_ENV_VARIABLE "PROFILE_KERNEL_ISA"
+
+//*****************************************************************************
+// Functions.
+//*****************************************************************************
+EKernelIsa GetSupportedKernelIsa();
+void SetKernelIsaOverride(EKernelIsa Isa);
+void ClearKernelIsaOverride();
+EKernelIsa GetKernelIsa();
+MIL_CONST_TEXT_PTR GetKernelIsaName(EKernelIsa Isa);
+MIL_INT GetNbLogicalCores();
+
+#endif // CPU_FEATURES_H
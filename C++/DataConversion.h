@@ -1,228 +1,510 @@
-﻿/************************************************************************************/
-/*
-* File name: DataConversion.h
-*
-* Synopsis:  This file contains the declaration of everything related to the input data
-*            and its conversion to a given format. The CDataConversion derived class
-*            can include a chain of other CDataConversion each preformed one after the other.
-*
-* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
-* All Rights Reserved
-*/
-
-#ifndef DATA_CONVERSION_H
-#define DATA_CONVERSION_H
-
-//*****************************************************************************
-// Structure defining the profile data in the form of 3 images.
-//*****************************************************************************
-struct SPData
-   {
-   SPData(): MilX(M_NULL), MilZ(M_NULL), MilValidMask(M_NULL){};
-   void ReleaseData()
-      {
-      if(MilX) MbufFree(MilX);
-      if(MilZ) MbufFree(MilZ);
-      }
-
-   void ReleaseMask()
-      {
-      if(MilValidMask) MbufFree(MilValidMask);
-      }
-
-   MIL_ID MilX;
-   MIL_ID MilZ;
-   MIL_ID MilValidMask;
-   };
-
-//*****************************************************************************
-// Structure defining a calibration that could be associated to some
-// profile data.
-//*****************************************************************************
-struct SPCal
-   {
-   MIL_DOUBLE WorldX;
-   MIL_DOUBLE WorldZ;   
-   MIL_DOUBLE GrayLevelSX;
-   MIL_DOUBLE GrayLevelSZ;
-   };
-
-//*****************************************************************************
-// Base class defining the data conversion interface. 
-//*****************************************************************************
-class CDataConversion
-   {
-   public:
-      CDataConversion(CDataConversion* pPrevConv): m_pPrevConv(pPrevConv) {};
-      virtual ~CDataConversion() { if(m_pPrevConv) delete m_pPrevConv; }
-      virtual SPData Convert(const SPData& Data) = 0;
-
-   protected:
-      virtual SPData ConvertPrev(const SPData& Data) { return m_pPrevConv ? m_pPrevConv->Convert(Data) : Data; }
-      CDataConversion* m_pPrevConv;
-   };
-
-//*****************************************************************************
-// Data conversion that creates a valid mask from the input Z data.
-//*****************************************************************************
-class CDataConversionAddMask : public CDataConversion
-   {
-   public:
-      CDataConversionAddMask(CDataConversion* pPrevConv, MIL_ID MilSystem,
-                             MIL_INT ProfileSize, MIL_INT NbProfiles, MIL_DOUBLE InvalidValue)
-         : CDataConversion(pPrevConv),
-           m_InvalidValue(InvalidValue)
-         {
-         MbufAlloc2d(MilSystem, ProfileSize, NbProfiles, 8 + M_UNSIGNED, M_IMAGE + M_PROC, &m_MilValidMask);
-         }
-      virtual ~CDataConversionAddMask()
-         {
-         MbufFree(m_MilValidMask);
-         }
-
-      virtual SPData Convert(const SPData& Data)
-         {
-         SPData ConvertedData = ConvertPrev(Data);
-         MimArith(ConvertedData.MilZ, m_InvalidValue, m_MilValidMask, M_NOT_EQUAL_CONST);
-         ConvertedData.MilValidMask = m_MilValidMask;
-         return ConvertedData;
-         };
-   private:
-      MIL_ID m_MilValidMask;
-      MIL_DOUBLE m_InvalidValue;
-   };
-
-//*****************************************************************************
-// Base class defining a data conversion that modifies 
-// the data type or data structure which requires the allocation
-// of a new SPData structure.
-//*****************************************************************************
-class CDataConversionData: public CDataConversion
-   {
-   public:
-      CDataConversionData(CDataConversion* pPrevConv): CDataConversion(pPrevConv) {};
-      virtual ~CDataConversionData() { m_ConvertedData.ReleaseData(); }
-   protected:
-      SPData m_ConvertedData;
-   };
-
-//*****************************************************************************
-// Data conversion from data whose calibration is
-// described by an external calibration to actual calibrated
-// data of float type.
-//*****************************************************************************
-class CDataConversionToWorld: public CDataConversionData
-   {
-   public:
-      CDataConversionToWorld(CDataConversion* pPrevConv, MIL_ID MilSystem,
-                             MIL_INT ProfileSize, MIL_INT NbProfiles, SPCal PCal) :
-         CDataConversionData(pPrevConv),
-         m_PCal(PCal)
-         {
-         MbufAlloc2d(MilSystem, ProfileSize, NbProfiles, 32 + M_FLOAT, M_IMAGE + M_PROC, &m_ConvertedData.MilX);
-         MbufAlloc2d(MilSystem, ProfileSize, NbProfiles, 32 + M_FLOAT, M_IMAGE + M_PROC, &m_ConvertedData.MilZ);
-         };
-
-      virtual SPData Convert(const SPData& Data)
-         {         
-         SPData ConvertedData = ConvertPrev(Data);
-         MimArith(ConvertedData.MilX, m_PCal.GrayLevelSX, m_ConvertedData.MilX, M_MULT_CONST + M_FLOAT_PROC);
-         MimArith(m_ConvertedData.MilX, m_PCal.WorldX, m_ConvertedData.MilX, M_ADD_CONST + M_FLOAT_PROC);
-         MimArith(ConvertedData.MilZ, m_PCal.GrayLevelSZ, m_ConvertedData.MilZ, M_MULT_CONST + M_FLOAT_PROC);
-         MimArith(m_ConvertedData.MilZ, m_PCal.WorldZ, m_ConvertedData.MilZ, M_ADD_CONST + M_FLOAT_PROC);
-         m_ConvertedData.MilValidMask = ConvertedData.MilValidMask;
-         return m_ConvertedData;
-         }
-
-   private:
-      SPCal m_PCal;
-   };
-
-//*****************************************************************************
-// Data conversion that takes data that is in an image
-// format (with a pitch) and flattens it into a 1d buffer.
-//*****************************************************************************
-class CDataConversionToFlat: public CDataConversionData
-   {
-   public:
-      CDataConversionToFlat(CDataConversion* pPrevConv, MIL_ID MilSystem,
-                            MIL_INT ProfileSize, MIL_INT NbProfiles, MIL_INT Type) :
-         CDataConversionData(pPrevConv)
-         {         
-         MbufAlloc1d(MilSystem, ProfileSize*NbProfiles, Type, M_IMAGE + M_PROC, &m_ConvertedData.MilX);
-         MbufAlloc1d(MilSystem, ProfileSize*NbProfiles, Type, M_IMAGE + M_PROC, &m_ConvertedData.MilZ);
-         MbufAlloc1d(MilSystem, ProfileSize*NbProfiles,
-                     8+M_UNSIGNED, M_IMAGE + M_PROC, &m_ConvertedData.MilValidMask);
-         }
-
-      virtual ~CDataConversionToFlat() { m_ConvertedData.ReleaseMask(); }
-
-      virtual SPData Convert(const SPData& Data)
-         {
-         SPData ConvertedData = ConvertPrev(Data);
-         MbufGet(ConvertedData.MilX, (void*)MbufInquire(m_ConvertedData.MilX, M_HOST_ADDRESS, M_NULL));
-         MbufGet(ConvertedData.MilZ, (void*)MbufInquire(m_ConvertedData.MilZ, M_HOST_ADDRESS, M_NULL));
-         MbufGet(ConvertedData.MilValidMask, (void*)MbufInquire(m_ConvertedData.MilValidMask, M_HOST_ADDRESS, M_NULL));
-         return m_ConvertedData;
-         }
-   };
-
-//*****************************************************************************
-// Base class defining a data conversion that simply 
-// performs an operation on the input data without actually
-// needing to change the type or buffer format.
-//*****************************************************************************
-struct CDataConversionOp: public CDataConversion
-   {
-   CDataConversionOp(CDataConversion* pPrevConv) : CDataConversion(pPrevConv) {};
-   
-   virtual SPData Convert(const SPData& Data) 
-      { 
-      SPData ConvertedData = ConvertPrev(Data);
-      ConvertOp(ConvertedData);
-      return ConvertedData;
-      }
-
-   virtual void ConvertOp(const SPData& pData) = 0;
-   };
-
-//*****************************************************************************
-// Flips the values of the X data.
-//*****************************************************************************
-struct CDataConversionFlipXVal : public CDataConversionOp
-   {
-   CDataConversionFlipXVal(CDataConversion* pOtherConversion): CDataConversionOp(pOtherConversion) {};
-   virtual void ConvertOp(const SPData& Data) { MimArith(65535, Data.MilX, Data.MilX, M_CONST_SUB); };
-   };
-
-//*****************************************************************************
-// Flips the values of the Z data.
-//*****************************************************************************
-struct CDataConversionFlipZVal : public CDataConversionOp
-   {
-   CDataConversionFlipZVal(CDataConversion* pOtherConversion): CDataConversionOp(pOtherConversion) {};
-   virtual void ConvertOp(const SPData& Data) { MimArith(65535, Data.MilZ, Data.MilZ, M_CONST_SUB); }
-   };
-
-//*****************************************************************************
-// Applies the invalid mask into the X and Y data.
-//*****************************************************************************
-struct CDataConversionApplyInvalid : public CDataConversionOp
-   {
-   CDataConversionApplyInvalid(CDataConversion* pOtherConversion): CDataConversionOp(pOtherConversion) {};
-   virtual void ConvertOp(const SPData& Data)
-      {
-      ApplyInvalidMask(Data.MilX, Data.MilValidMask);
-      ApplyInvalidMask(Data.MilZ, Data.MilValidMask);
-      }
-
-   void ApplyInvalidMask(MIL_ID MilImage, MIL_ID MilMask)
-      {
-      MIL_INT Type = MbufInquire(MilImage, M_TYPE, M_NULL);
-      MIL_DOUBLE InvalidValue;
-      MbufInquire(MilImage, M_MAX, &InvalidValue);
-      MbufClearCond(MilImage, InvalidValue, 0, 0, MilMask, M_EQUAL, 0);
-      }
-   };
-
-#endif // DATA_CONVERSION_H
+﻿/************************************************************************************/
+/*
+* File name: DataConversion.h
+*
+* Synopsis:  This file contains the declaration of everything related to the input data
+*            and its conversion to a given format. The CDataConversion derived class
+*            can include a chain of other CDataConversion each preformed one after the other.
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+
+#ifndef DATA_CONVERSION_H
+#define DATA_CONVERSION_H
+
+#include <math.h>
+#include "BufferPlanner.h"
+#include "ProfileKernels.h"
+#include "BeltReference.h"
+
+//*****************************************************************************
+// Structure defining the statistics of a block of profile data. The
+// statistics are accumulated while the block is converted.
+//*****************************************************************************
+struct SPStats
+   {
+   SPStats() { Reset(); }
+   void Reset()
+      {
+      NbPoints = 0;
+      NbValidPoints = 0;
+      ValidRatio = 0.0;
+      MinZ = 0.0;
+      MaxZ = 0.0;
+      MeanZ = 0.0;
+      HistogramMinZ = 0.0;
+      HistogramBinSizeZ = 0.0;
+      for(MIL_INT i = 0; i < NB_STATS_HISTOGRAM_BINS; i++)
+         Histogram[i] = 0;
+      }
+
+   MIL_INT    NbPoints;
+   MIL_INT    NbValidPoints;
+   MIL_DOUBLE ValidRatio;
+   MIL_DOUBLE MinZ;
+   MIL_DOUBLE MaxZ;
+   MIL_DOUBLE MeanZ;
+
+   // Coarse histogram of the valid Z values. Bin i covers the world Z values
+   // starting at HistogramMinZ + i * HistogramBinSizeZ.
+   MIL_DOUBLE HistogramMinZ;
+   MIL_DOUBLE HistogramBinSizeZ;
+   MIL_INT    Histogram[NB_STATS_HISTOGRAM_BINS];
+   };
+
+//*****************************************************************************
+// Structure defining the profile data in the form of 3 images.
+//*****************************************************************************
+struct SPData
+   {
+   SPData(): MilX(M_NULL), MilZ(M_NULL), MilValidMask(M_NULL), pStats(M_NULL){};
+   void ReleaseData()
+      {
+      if(MilX) MbufFree(MilX);
+      if(MilZ) MbufFree(MilZ);
+      }
+
+   void ReleaseMask()
+      {
+      if(MilValidMask) MbufFree(MilValidMask);
+      }
+
+   MIL_ID MilX;
+   MIL_ID MilZ;
+   MIL_ID MilValidMask;
+   const SPStats* pStats;
+   };
+
+//*****************************************************************************
+// Structure defining a calibration that could be associated to some
+// profile data.
+//*****************************************************************************
+struct SPCal
+   {
+   MIL_DOUBLE WorldX;
+   MIL_DOUBLE WorldZ;   
+   MIL_DOUBLE GrayLevelSX;
+   MIL_DOUBLE GrayLevelSZ;
+   };
+
+//*****************************************************************************
+// Structure defining the pose of a sensor in the world of several sensors.
+// The profile plane of the sensor is rotated by AngleY around the Y axis,
+// then offset. Two opposite sensors are 180 degrees apart.
+//*****************************************************************************
+struct SPSensorPose
+   {
+   SPSensorPose(): AngleY(0.0), OffsetX(0.0), OffsetY(0.0), OffsetZ(0.0) {};
+
+   MIL_DOUBLE AngleY;   // in degrees
+   MIL_DOUBLE OffsetX;  // in mm
+   MIL_DOUBLE OffsetY;  // in mm, along the conveyor
+   MIL_DOUBLE OffsetZ;  // in mm
+   };
+
+//*****************************************************************************
+// Base class defining the data conversion interface. The intermediate buffers
+// of the conversions are not allocated by the conversions themselves. They
+// are declared to a CBufferPlanner in Plan() and retrieved in Bind() once
+// the planner has allocated the whole chain. Bind() also gives the host
+// kernels selected for the profile size.
+//*****************************************************************************
+class CDataConversion
+   {
+   public:
+      CDataConversion(CDataConversion* pPrevConv): m_pPrevConv(pPrevConv) {};
+      virtual ~CDataConversion() { if(m_pPrevConv) delete m_pPrevConv; }
+      virtual SPData Convert(const SPData& Data) = 0;
+      virtual SPPlanData Plan(CBufferPlanner& Planner, const SPPlanData& Data) { return PlanPrev(Planner, Data); }
+      virtual void Bind(const CBufferPlanner& Planner, const SPProfileKernels& Kernels) { BindPrev(Planner, Kernels); }
+
+   protected:
+      virtual SPData ConvertPrev(const SPData& Data) { return m_pPrevConv ? m_pPrevConv->Convert(Data) : Data; }
+      SPPlanData PlanPrev(CBufferPlanner& Planner, const SPPlanData& Data)
+         {
+         SPPlanData PlannedData = m_pPrevConv ? m_pPrevConv->Plan(Planner, Data) : Data;
+         Planner.BeginStage();
+         return PlannedData;
+         }
+      void BindPrev(const CBufferPlanner& Planner, const SPProfileKernels& Kernels)
+         {
+         if(m_pPrevConv)
+            m_pPrevConv->Bind(Planner, Kernels);
+         }
+      CDataConversion* m_pPrevConv;
+   };
+
+//*****************************************************************************
+// Data conversion that creates a valid mask from the input Z data.
+//*****************************************************************************
+class CDataConversionAddMask : public CDataConversion
+   {
+   public:
+      CDataConversionAddMask(CDataConversion* pPrevConv, MIL_INT ProfileSize,
+                             MIL_INT NbProfiles, MIL_DOUBLE InvalidValue)
+         : CDataConversion(pPrevConv),
+           m_ProfileSize(ProfileSize),
+           m_NbProfiles(NbProfiles),
+           m_InvalidValue(InvalidValue),
+           m_MaskBuffer(NO_PLANNED_BUFFER),
+           m_MilValidMask(M_NULL),
+           m_MaskRow(M_NULL)
+         {
+         }
+
+      virtual SPPlanData Plan(CBufferPlanner& Planner, const SPPlanData& Data)
+         {
+         SPPlanData PlannedData = PlanPrev(Planner, Data);
+         Planner.Use(PlannedData.Z);
+         m_MaskBuffer = Planner.Request(m_ProfileSize, m_NbProfiles, 8 + M_UNSIGNED);
+         PlannedData.ValidMask = m_MaskBuffer;
+         return PlannedData;
+         }
+
+      virtual void Bind(const CBufferPlanner& Planner, const SPProfileKernels& Kernels)
+         {
+         BindPrev(Planner, Kernels);
+         m_MilValidMask = Planner.GetBuffer(m_MaskBuffer);
+         m_MaskRow = Kernels.MaskRow;
+         }
+
+      virtual SPData Convert(const SPData& Data)
+         {
+         SPData ConvertedData = ConvertPrev(Data);
+         MIL_INT SrcPitch = MbufInquire(ConvertedData.MilZ, M_PITCH, M_NULL);
+         MIL_INT MaskPitch = MbufInquire(m_MilValidMask, M_PITCH, M_NULL);
+         const MIL_UINT16* pSrcZ = (const MIL_UINT16*)MbufInquire(ConvertedData.MilZ, M_HOST_ADDRESS, M_NULL);
+         MIL_UINT8* pMask = (MIL_UINT8*)MbufInquire(m_MilValidMask, M_HOST_ADDRESS, M_NULL);
+         for(MIL_INT y = 0; y < m_NbProfiles; y++)
+            m_MaskRow(pSrcZ + y * SrcPitch, pMask + y * MaskPitch, m_ProfileSize, (MIL_UINT16)m_InvalidValue);
+         ConvertedData.MilValidMask = m_MilValidMask;
+         return ConvertedData;
+         };
+   private:
+      MIL_INT m_ProfileSize;
+      MIL_INT m_NbProfiles;
+      MIL_DOUBLE m_InvalidValue;
+      MIL_INT m_MaskBuffer;
+      MIL_ID m_MilValidMask;
+      PMaskRow m_MaskRow;
+   };
+
+//*****************************************************************************
+// Base class defining a data conversion that modifies 
+// the data type or data structure which requires the allocation
+// of a new SPData structure.
+//*****************************************************************************
+class CDataConversionData: public CDataConversion
+   {
+   public:
+      CDataConversionData(CDataConversion* pPrevConv): CDataConversion(pPrevConv) {};
+
+      virtual void Bind(const CBufferPlanner& Planner, const SPProfileKernels& Kernels)
+         {
+         BindPrev(Planner, Kernels);
+         m_ConvertedData.MilX = Planner.GetBuffer(m_PlannedData.X);
+         m_ConvertedData.MilZ = Planner.GetBuffer(m_PlannedData.Z);
+         m_ConvertedData.MilValidMask = Planner.GetBuffer(m_PlannedData.ValidMask);
+         }
+
+   protected:
+      SPData m_ConvertedData;
+      SPPlanData m_PlannedData;
+   };
+
+//*****************************************************************************
+// Data conversion from data whose calibration is
+// described by an external calibration to actual calibrated
+// data of float type. The conversion is done in a single pass over
+// the 16 bits input data by the ConvertToWorldRow kernel that also
+// accumulates the block statistics. If a belt reference is given, it is
+// subtracted from each row right after its conversion. The statistics are
+// the ones of the absolute Z. Input data that are not 16 bits unsigned
+// codes are converted by MIL instead, without statistics.
+//*****************************************************************************
+class CDataConversionToWorld: public CDataConversionData
+   {
+   public:
+      CDataConversionToWorld(CDataConversion* pPrevConv, MIL_INT ProfileSize,
+                             MIL_INT NbProfiles, SPCal PCal, CBeltReference* pBeltReference) :
+         CDataConversionData(pPrevConv),
+         m_ProfileSize(ProfileSize),
+         m_NbProfiles(NbProfiles),
+         m_PCal(PCal),
+         m_pBeltReference(pBeltReference),
+         m_ConvertToWorldRow(M_NULL),
+         m_IsSourceCodes(true)
+         {
+         };
+
+      virtual SPPlanData Plan(CBufferPlanner& Planner, const SPPlanData& Data)
+         {
+         SPPlanData PlannedData = PlanPrev(Planner, Data);
+         m_SourceData = PlannedData;
+         Planner.Use(PlannedData);
+         m_PlannedData.X = Planner.Request(m_ProfileSize, m_NbProfiles, 32 + M_FLOAT);
+         m_PlannedData.Z = Planner.Request(m_ProfileSize, m_NbProfiles, 32 + M_FLOAT);
+         m_PlannedData.ValidMask = PlannedData.ValidMask;
+         return m_PlannedData;
+         }
+
+      virtual void Bind(const CBufferPlanner& Planner, const SPProfileKernels& Kernels)
+         {
+         CDataConversionData::Bind(Planner, Kernels);
+         m_ConvertToWorldRow = Kernels.ConvertToWorldRow;
+
+         // The kernel reads the data as 16 bits unsigned codes.
+         m_IsSourceCodes = Planner.GetType(m_SourceData.X) == 16 + M_UNSIGNED &&
+                           Planner.GetType(m_SourceData.Z) == 16 + M_UNSIGNED;
+         if(!m_IsSourceCodes)
+            MosPrintf(MIL_TEXT("The profile data are not 16 bits unsigned codes. ")
+                      MIL_TEXT("They are converted without statistics.\n"));
+         }
+
+      virtual SPData Convert(const SPData& Data)
+         {         
+         SPData ConvertedData = ConvertPrev(Data);
+         MIL_INT SizeX = MbufInquire(ConvertedData.MilZ, M_SIZE_X, M_NULL);
+         MIL_INT SizeY = MbufInquire(ConvertedData.MilZ, M_SIZE_Y, M_NULL);
+         MIL_INT SrcPitch = MbufInquire(ConvertedData.MilZ, M_PITCH, M_NULL);
+         MIL_INT DstPitch = MbufInquire(m_ConvertedData.MilZ, M_PITCH, M_NULL);
+         MIL_INT MaskPitch = ConvertedData.MilValidMask ? MbufInquire(ConvertedData.MilValidMask, M_PITCH, M_NULL) : 0;
+         const MIL_UINT16* pSrcX = (const MIL_UINT16*)MbufInquire(ConvertedData.MilX, M_HOST_ADDRESS, M_NULL);
+         const MIL_UINT16* pSrcZ = (const MIL_UINT16*)MbufInquire(ConvertedData.MilZ, M_HOST_ADDRESS, M_NULL);
+         MIL_UINT8* pMask = ConvertedData.MilValidMask ?
+            (MIL_UINT8*)MbufInquire(ConvertedData.MilValidMask, M_HOST_ADDRESS, M_NULL) : M_NULL;
+         MIL_FLOAT* pDstX = (MIL_FLOAT*)MbufInquire(m_ConvertedData.MilX, M_HOST_ADDRESS, M_NULL);
+         MIL_FLOAT* pDstZ = (MIL_FLOAT*)MbufInquire(m_ConvertedData.MilZ, M_HOST_ADDRESS, M_NULL);
+
+         // Convert the rows and accumulate the statistics on the Z codes.
+         SPConvertParams Params;
+         Params.ScaleX = (MIL_FLOAT)m_PCal.GrayLevelSX;
+         Params.OffsetX = (MIL_FLOAT)m_PCal.WorldX;
+         Params.ScaleZ = (MIL_FLOAT)m_PCal.GrayLevelSZ;
+         Params.OffsetZ = (MIL_FLOAT)m_PCal.WorldZ;
+         SPStatsAccumulator Stats;
+         if(m_IsSourceCodes)
+            {
+            for(MIL_INT y = 0; y < SizeY; y++)
+               {
+               m_ConvertToWorldRow(pSrcX + y * SrcPitch, pSrcZ + y * SrcPitch,
+                                   pMask ? pMask + y * MaskPitch : M_NULL,
+                                   pDstX + y * DstPitch, pDstZ + y * DstPitch,
+                                   SizeX, Params, Stats);
+               if(m_pBeltReference)
+                  m_pBeltReference->ProcessRow(pDstX + y * DstPitch, pDstZ + y * DstPitch, pMask ? pMask + y * MaskPitch : M_NULL, SizeX);
+               }
+            }
+         else
+            {
+            MimArith(ConvertedData.MilX, m_PCal.GrayLevelSX, m_ConvertedData.MilX, M_MULT_CONST + M_FLOAT_PROC);
+            MimArith(m_ConvertedData.MilX, m_PCal.WorldX, m_ConvertedData.MilX, M_ADD_CONST + M_FLOAT_PROC);
+            MimArith(ConvertedData.MilZ, m_PCal.GrayLevelSZ, m_ConvertedData.MilZ, M_MULT_CONST + M_FLOAT_PROC);
+            MimArith(m_ConvertedData.MilZ, m_PCal.WorldZ, m_ConvertedData.MilZ, M_ADD_CONST + M_FLOAT_PROC);
+            for(MIL_INT y = 0; m_pBeltReference && y < SizeY; y++)
+               m_pBeltReference->ProcessRow(pDstX + y * DstPitch, pDstZ + y * DstPitch, pMask ? pMask + y * MaskPitch : M_NULL, SizeX);
+            }
+         if(m_pBeltReference)
+            m_pBeltReference->EndBlock();
+
+         // Express the statistics in world units.
+         m_Stats.NbPoints = SizeX * SizeY;
+         m_Stats.NbValidPoints = (MIL_INT)Stats.NbValid;
+         m_Stats.ValidRatio = m_Stats.NbPoints ? (MIL_DOUBLE)Stats.NbValid / m_Stats.NbPoints : 0.0;
+         m_Stats.HistogramMinZ = m_PCal.WorldZ;
+         m_Stats.HistogramBinSizeZ = m_PCal.GrayLevelSZ * (1 << STATS_HISTOGRAM_SHIFT);
+         for(MIL_INT i = 0; i < NB_STATS_HISTOGRAM_BINS; i++)
+            m_Stats.Histogram[i] = (MIL_INT)Stats.Histogram[i];
+         if(Stats.NbValid)
+            {
+            MIL_DOUBLE MinZ = Stats.MinCodeZ * m_PCal.GrayLevelSZ + m_PCal.WorldZ;
+            MIL_DOUBLE MaxZ = Stats.MaxCodeZ * m_PCal.GrayLevelSZ + m_PCal.WorldZ;
+            m_Stats.MinZ = MinZ < MaxZ ? MinZ : MaxZ;
+            m_Stats.MaxZ = MinZ < MaxZ ? MaxZ : MinZ;
+            m_Stats.MeanZ = ((MIL_DOUBLE)Stats.SumCodeZ / Stats.NbValid) * m_PCal.GrayLevelSZ + m_PCal.WorldZ;
+            }
+         else
+            m_Stats.MinZ = m_Stats.MaxZ = m_Stats.MeanZ = 0.0;
+
+         m_ConvertedData.MilValidMask = ConvertedData.MilValidMask;
+         m_ConvertedData.pStats = &m_Stats;
+         return m_ConvertedData;
+         }
+
+   private:
+      MIL_INT m_ProfileSize;
+      MIL_INT m_NbProfiles;
+      SPCal m_PCal;
+      SPStats m_Stats;
+      CBeltReference* m_pBeltReference;
+      PConvertToWorldRow m_ConvertToWorldRow;
+      SPPlanData m_SourceData;
+      bool m_IsSourceCodes;
+   };
+
+//*****************************************************************************
+// Data conversion that takes data that is in an image
+// format (with a pitch) and flattens it into a 1d buffer.
+// When the planner aliases the 1d buffer on the memory of
+// an input image without pitch, the copy is skipped.
+//*****************************************************************************
+class CDataConversionToFlat: public CDataConversionData
+   {
+   public:
+      CDataConversionToFlat(CDataConversion* pPrevConv, MIL_INT ProfileSize,
+                            MIL_INT NbProfiles, MIL_INT Type) :
+         CDataConversionData(pPrevConv),
+         m_NbPoints(ProfileSize * NbProfiles),
+         m_Type(Type)
+         {         
+         }
+
+      virtual SPPlanData Plan(CBufferPlanner& Planner, const SPPlanData& Data)
+         {
+         SPPlanData PlannedData = PlanPrev(Planner, Data);
+         Planner.Use(PlannedData);
+         m_PlannedData.X = Planner.RequestView(m_NbPoints, 1, m_Type, PlannedData.X);
+         m_PlannedData.Z = Planner.RequestView(m_NbPoints, 1, m_Type, PlannedData.Z);
+         m_PlannedData.ValidMask = Planner.RequestView(m_NbPoints, 1, 8 + M_UNSIGNED, PlannedData.ValidMask);
+         return m_PlannedData;
+         }
+
+      virtual SPData Convert(const SPData& Data)
+         {
+         SPData ConvertedData = ConvertPrev(Data);
+         Flatten(ConvertedData.MilX, m_ConvertedData.MilX);
+         Flatten(ConvertedData.MilZ, m_ConvertedData.MilZ);
+         Flatten(ConvertedData.MilValidMask, m_ConvertedData.MilValidMask);
+         m_ConvertedData.pStats = ConvertedData.pStats;
+         return m_ConvertedData;
+         }
+
+   private:
+      void Flatten(MIL_ID MilImage, MIL_ID MilFlat)
+         {
+         void* pFlat = (void*)MbufInquire(MilFlat, M_HOST_ADDRESS, M_NULL);
+         if(pFlat != (void*)MbufInquire(MilImage, M_HOST_ADDRESS, M_NULL))
+            MbufGet(MilImage, pFlat);
+         }
+
+      MIL_INT m_NbPoints;
+      MIL_INT m_Type;
+   };
+
+//*****************************************************************************
+// Base class defining a data conversion that simply 
+// performs an operation on the input data without actually
+// needing to change the type or buffer format.
+//*****************************************************************************
+struct CDataConversionOp: public CDataConversion
+   {
+   CDataConversionOp(CDataConversion* pPrevConv) : CDataConversion(pPrevConv) {};
+
+   virtual SPPlanData Plan(CBufferPlanner& Planner, const SPPlanData& Data)
+      {
+      SPPlanData PlannedData = PlanPrev(Planner, Data);
+      Planner.Use(PlannedData);
+      return PlannedData;
+      }
+   
+   virtual SPData Convert(const SPData& Data) 
+      { 
+      SPData ConvertedData = ConvertPrev(Data);
+      ConvertOp(ConvertedData);
+      return ConvertedData;
+      }
+
+   virtual void ConvertOp(const SPData& pData) = 0;
+   };
+
+//*****************************************************************************
+// Flips the values of the X data.
+//*****************************************************************************
+struct CDataConversionFlipXVal : public CDataConversionOp
+   {
+   CDataConversionFlipXVal(CDataConversion* pOtherConversion): CDataConversionOp(pOtherConversion) {};
+   virtual void ConvertOp(const SPData& Data) { MimArith(65535, Data.MilX, Data.MilX, M_CONST_SUB); };
+   };
+
+//*****************************************************************************
+// Flips the values of the Z data.
+//*****************************************************************************
+struct CDataConversionFlipZVal : public CDataConversionOp
+   {
+   CDataConversionFlipZVal(CDataConversion* pOtherConversion): CDataConversionOp(pOtherConversion) {};
+   virtual void ConvertOp(const SPData& Data) { MimArith(65535, Data.MilZ, Data.MilZ, M_CONST_SUB); }
+   };
+
+//*****************************************************************************
+// Applies the invalid mask into the X and Y data.
+//*****************************************************************************
+struct CDataConversionApplyInvalid : public CDataConversionOp
+   {
+   CDataConversionApplyInvalid(CDataConversion* pOtherConversion): CDataConversionOp(pOtherConversion) {};
+   virtual void ConvertOp(const SPData& Data)
+      {
+      ApplyInvalidMask(Data.MilX, Data.MilValidMask);
+      ApplyInvalidMask(Data.MilZ, Data.MilValidMask);
+      }
+
+   void ApplyInvalidMask(MIL_ID MilImage, MIL_ID MilMask)
+      {
+      MIL_INT Type = MbufInquire(MilImage, M_TYPE, M_NULL);
+      MIL_DOUBLE InvalidValue;
+      MbufInquire(MilImage, M_MAX, &InvalidValue);
+      MbufClearCond(MilImage, InvalidValue, 0, 0, MilMask, M_EQUAL, 0);
+      }
+   };
+
+//*****************************************************************************
+// Applies the pose of the sensor to the valid world X and Z data. The
+// offset in Y is applied by the rasterization.
+//*****************************************************************************
+struct CDataConversionApplyPose : public CDataConversionOp
+   {
+   CDataConversionApplyPose(CDataConversion* pOtherConversion, const SPSensorPose& Pose)
+      : CDataConversionOp(pOtherConversion),
+        m_Cos((MIL_FLOAT)cos(Pose.AngleY * 3.14159265358979323846 / 180.0)),
+        m_Sin((MIL_FLOAT)sin(Pose.AngleY * 3.14159265358979323846 / 180.0)),
+        m_OffsetX((MIL_FLOAT)Pose.OffsetX),
+        m_OffsetZ((MIL_FLOAT)Pose.OffsetZ)
+      {
+      }
+
+   virtual void ConvertOp(const SPData& Data)
+      {
+      MIL_INT SizeX = MbufInquire(Data.MilX, M_SIZE_X, M_NULL);
+      MIL_INT SizeY = MbufInquire(Data.MilX, M_SIZE_Y, M_NULL);
+      MIL_INT Pitch = MbufInquire(Data.MilX, M_PITCH, M_NULL);
+      MIL_INT MaskPitch = Data.MilValidMask ? MbufInquire(Data.MilValidMask, M_PITCH, M_NULL) : 0;
+      MIL_FLOAT* pX = (MIL_FLOAT*)MbufInquire(Data.MilX, M_HOST_ADDRESS, M_NULL);
+      MIL_FLOAT* pZ = (MIL_FLOAT*)MbufInquire(Data.MilZ, M_HOST_ADDRESS, M_NULL);
+      const MIL_UINT8* pMask = Data.MilValidMask ?
+         (const MIL_UINT8*)MbufInquire(Data.MilValidMask, M_HOST_ADDRESS, M_NULL) : M_NULL;
+      for(MIL_INT y = 0; y < SizeY; y++)
+         {
+         MIL_FLOAT* pRowX = pX + y * Pitch;
+         MIL_FLOAT* pRowZ = pZ + y * Pitch;
+         const MIL_UINT8* pRowMask = pMask ? pMask + y * MaskPitch : M_NULL;
+         for(MIL_INT x = 0; x < SizeX; x++)
+            {
+            // The invalid points keep their invalid value.
+            if(pRowMask && !pRowMask[x])
+               continue;
+            MIL_FLOAT X = pRowX[x];
+            MIL_FLOAT Z = pRowZ[x];
+            pRowX[x] = m_Cos * X - m_Sin * Z + m_OffsetX;
+            pRowZ[x] = m_Sin * X + m_Cos * Z + m_OffsetZ;
+            }
+         }
+      }
+
+   private:
+      MIL_FLOAT m_Cos;
+      MIL_FLOAT m_Sin;
+      MIL_FLOAT m_OffsetX;
+      MIL_FLOAT m_OffsetZ;
+   };
+
+#endif // DATA_CONVERSION_H
@@ -0,0 +1,234 @@
+﻿/************************************************************************************/
+/*
+* File name: DepthMapColorizer.cpp
+*
+* Synopsis:  This file contains the implementation of the CDepthMapColorizer class
+*            that colorizes previews of the continuous depth map.
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+#include <mil.h>
+#include <algorithm>
+#include "DepthMapColorizer.h"
+
+//*****************************************************************************
+// Constants.
+//*****************************************************************************
+
+// Fractions of the valid cells below and above the range of the depths, so
+// the outliers do not squeeze the colors.
+static const MIL_DOUBLE RANGE_OUTLIER_RATIO = 0.01;
+
+// Weight of a preview in the smoothed range of the depths.
+static const MIL_DOUBLE RANGE_SMOOTHING = 0.2;
+
+//*****************************************************************************
+// Constructor. Reads the JET LUT of the display and starts the colorizer
+//              thread.
+//*****************************************************************************
+CDepthMapColorizer::CDepthMapColorizer(MIL_ID MilSystem, const CDepthMapRing& Ring, MIL_INT NbRows,
+                                       MIL_DOUBLE MaxFrameRate)
+   : m_Ring(Ring),
+     m_ColorizeRow(M_NULL),
+     m_HasRange(false),
+     m_MinDepth(0.0),
+     m_MaxDepth(0.0),
+     m_MinPreviewPeriod(MaxFrameRate > 0.0 ? 1.0 / MaxFrameRate : 0.0),
+     m_LastPreviewTime(0.0),
+     m_Busy(false),
+     m_Exit(false),
+     m_NbPreviews(0)
+   {
+   // The previews are the last rows of the depth map.
+   m_MilWindow = Ring.AllocWindow(NbRows);
+   m_SizeX = MbufInquire(m_MilWindow, M_SIZE_X, M_NULL);
+   m_SizeY = MbufInquire(m_MilWindow, M_SIZE_Y, M_NULL);
+   MbufAlloc2d(MilSystem, m_SizeX, m_SizeY, 16 + M_UNSIGNED, M_IMAGE + M_PROC, &m_MilSource);
+   m_BackPixels.resize(m_SizeX * m_SizeY);
+   m_FrontPixels.resize(m_SizeX * m_SizeY);
+   m_Histogram.resize(INVALID_DEPTH);
+
+   // Pack the LUT of the display in BGR32 colors.
+   MIL_ID MilLut;
+   MbufAllocColor(MilSystem, 3, 65536, 1, 8 + M_UNSIGNED, M_LUT, &MilLut);
+   MgenLutFunction(MilLut, M_COLORMAP_JET, M_DEFAULT, M_DEFAULT, M_DEFAULT, M_DEFAULT, M_DEFAULT, M_DEFAULT);
+   MIL_UINT8 ColorForInvalidDepth[3] = {128, 128, 128};
+   MbufPutColor2d(MilLut, M_PLANAR, M_ALL_BANDS, 65535, 0, 1, 1, ColorForInvalidDepth);
+   std::vector<MIL_UINT8> PlanarLut(3 * 65536);
+   MbufGetColor(MilLut, M_PLANAR, M_ALL_BANDS, &PlanarLut[0]);
+   MbufFree(MilLut);
+   m_Lut.resize(65536);
+   for(MIL_INT i = 0; i < 65536; i++)
+      m_Lut[i] = (MIL_UINT32)PlanarLut[2 * 65536 + i] | ((MIL_UINT32)PlanarLut[65536 + i] << 8) |
+                 ((MIL_UINT32)PlanarLut[i] << 16);
+
+   // Start the colorizer thread at the lowest priority.
+   MthrAlloc(MilSystem, M_MUTEX, M_DEFAULT, M_NULL, M_NULL, &m_MilMutex);
+   MthrAlloc(MilSystem, M_EVENT, M_NOT_SIGNALED + M_AUTO_RESET, M_NULL, M_NULL, &m_MilStartEvent);
+   MthrAlloc(MilSystem, M_THREAD, M_DEFAULT, &ColorizerThread, this, &m_MilThread);
+   MthrControl(m_MilThread, M_THREAD_PRIORITY, M_LOWEST);
+   }
+
+//*****************************************************************************
+// Destructor. Stops the colorizer thread.
+//*****************************************************************************
+CDepthMapColorizer::~CDepthMapColorizer()
+   {
+   m_Exit = true;
+   MthrControl(m_MilStartEvent, M_EVENT_SET, M_SIGNALED);
+   MthrWait(m_MilThread, M_THREAD_END_WAIT, M_NULL);
+   MthrFree(m_MilThread);
+   MthrFree(m_MilStartEvent);
+   MthrFree(m_MilMutex);
+   MbufFree(m_MilSource);
+   MbufFree(m_MilWindow);
+   }
+
+//*****************************************************************************
+// Update. Starts a preview of the last rows if one is due and the
+//         colorizer thread is idle.
+//*****************************************************************************
+void CDepthMapColorizer::Update()
+   {
+   if(!m_ColorizeRow)
+      return;
+
+   MIL_DOUBLE Time;
+   MappTimer(M_DEFAULT, M_TIMER_READ, &Time);
+   Lock();
+   bool Start = !m_Busy && (m_NbPreviews == 0 || Time - m_LastPreviewTime >= m_MinPreviewPeriod);
+   if(Start && m_Ring.MoveWindowToLast(m_MilWindow, m_SizeY))
+      {
+      MbufCopy(m_MilWindow, m_MilSource);
+      m_Busy = true;
+      m_LastPreviewTime = Time;
+      MthrControl(m_MilStartEvent, M_EVENT_SET, M_SIGNALED);
+      }
+   Unlock();
+   }
+
+//*****************************************************************************
+// UpdateRange. Smooths the range of the depths with the range of the copied
+//              rows and stretches it to the LUT. The range of the rows
+//              drops the outliers, from the histogram of their depths. Rows
+//              without valid cells keep the range.
+//*****************************************************************************
+void CDepthMapColorizer::UpdateRange(const MIL_UINT16* pSource, MIL_INT Pitch)
+   {
+   std::fill(m_Histogram.begin(), m_Histogram.end(), 0);
+   MIL_INT NbValidCells = 0;
+   for(MIL_INT y = 0; y < m_SizeY; y++)
+      {
+      const MIL_UINT16* pRow = pSource + y * Pitch;
+      for(MIL_INT x = 0; x < m_SizeX; x++)
+         {
+         if(pRow[x] != INVALID_DEPTH)
+            {
+            m_Histogram[pRow[x]]++;
+            NbValidCells++;
+            }
+         }
+      }
+   if(NbValidCells == 0)
+      return;
+
+   MIL_INT NbOutliers = (MIL_INT)(RANGE_OUTLIER_RATIO * NbValidCells);
+   MIL_INT Low = 0;
+   MIL_INT Count = m_Histogram[0];
+   while(Count <= NbOutliers)
+      Count += m_Histogram[++Low];
+   MIL_INT High = MAX_DEPTH;
+   Count = m_Histogram[High];
+   while(High > Low && Count <= NbOutliers)
+      Count += m_Histogram[--High];
+
+   if(!m_HasRange)
+      {
+      m_MinDepth = (MIL_DOUBLE)Low;
+      m_MaxDepth = (MIL_DOUBLE)High;
+      m_HasRange = true;
+      }
+   else
+      {
+      m_MinDepth += RANGE_SMOOTHING * (Low - m_MinDepth);
+      m_MaxDepth += RANGE_SMOOTHING * (High - m_MaxDepth);
+      }
+
+   // Stretch the range to the LUT.
+   MIL_DOUBLE MinDepth = m_MinDepth > MAX_DEPTH - 1 ? MAX_DEPTH - 1 : m_MinDepth;
+   MIL_DOUBLE MaxDepth = m_MaxDepth < MinDepth + 1 ? MinDepth + 1 : m_MaxDepth;
+   m_Params.MinDepth = (MIL_UINT16)MinDepth;
+   m_Params.RangeDepth = (MIL_UINT16)(MaxDepth - m_Params.MinDepth);
+   m_Params.Scale = ((MIL_UINT32)MAX_DEPTH << COLORIZE_SCALE_BITS) / m_Params.RangeDepth;
+   }
+
+//*****************************************************************************
+// GetPreview. Copies the last preview.
+//*****************************************************************************
+MIL_INT64 CDepthMapColorizer::GetPreview(std::vector<MIL_UINT32>& Pixels) const
+   {
+   Lock();
+   MIL_INT64 Preview = m_NbPreviews;
+   if(Preview)
+      Pixels = m_FrontPixels;
+   Unlock();
+   return Preview;
+   }
+
+//*****************************************************************************
+// ColorizerThread. Function of the colorizer thread. Waits for the rows of
+//                  a preview, colorizes them and publishes the preview.
+//*****************************************************************************
+MIL_UINT32 MFTYPE CDepthMapColorizer::ColorizerThread(void* pUserData)
+   {
+   CDepthMapColorizer& Colorizer = *(CDepthMapColorizer*)pUserData;
+   while(true)
+      {
+      MthrWait(Colorizer.m_MilStartEvent, M_EVENT_WAIT, M_NULL);
+      if(Colorizer.m_Exit)
+         break;
+      Colorizer.Colorize();
+      }
+   return 0;
+   }
+
+//*****************************************************************************
+// Colorize. Colorizes the copied rows in the back pixels and swaps them with
+//           the published ones. The previews wait for a first range.
+//*****************************************************************************
+void CDepthMapColorizer::Colorize()
+   {
+   const MIL_UINT16* pSource = (const MIL_UINT16*)MbufInquire(m_MilSource, M_HOST_ADDRESS, M_NULL);
+   MIL_INT Pitch = MbufInquire(m_MilSource, M_PITCH, M_NULL);
+   UpdateRange(pSource, Pitch);
+   if(!m_HasRange)
+      {
+      Lock();
+      m_Busy = false;
+      Unlock();
+      return;
+      }
+
+   for(MIL_INT y = 0; y < m_SizeY; y++)
+      m_ColorizeRow(pSource + y * Pitch, &m_BackPixels[y * m_SizeX], m_SizeX, &m_Lut[0], m_Params);
+
+   Lock();
+   m_FrontPixels.swap(m_BackPixels);
+   m_NbPreviews++;
+   m_Busy = false;
+   Unlock();
+   }
+
+//*****************************************************************************
+// Lock/Unlock. Protect the published preview and the state of the thread.
+//*****************************************************************************
+void CDepthMapColorizer::Lock() const
+   {
+   MthrControl(m_MilMutex, M_LOCK, M_DEFAULT);
+   }
+
+void CDepthMapColorizer::Unlock() const
+   {
+   MthrControl(m_MilMutex, M_UNLOCK, M_DEFAULT);
+   }
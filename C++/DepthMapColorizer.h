@@ -0,0 +1,90 @@
+﻿/************************************************************************************/
+/*
+* File name: DepthMapColorizer.h
+*
+* Synopsis:  This file contains the declaration of the CDepthMapColorizer class that
+*            colorizes the last rows of the continuous depth map, with the LUT of the
+*            display, in a low priority thread, to give previews to the viewers
+*            that do not use the MIL display.
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+
+#ifndef DEPTH_MAP_COLORIZER_H
+#define DEPTH_MAP_COLORIZER_H
+
+#include <vector>
+#include "DepthMapRing.h"
+
+//*****************************************************************************
+// Class colorizing previews of the continuous depth map.
+//
+// After each block, the processing thread calls Update(), which copies the
+// last rows of the depth map for the colorizer thread when a preview is due
+// and the previous one is done. The previews are thus capped at MaxFrameRate
+// and the processing thread never waits for the colorization.
+//
+// The colorizer thread runs at the lowest priority. It follows the range of
+// the depths of the copied rows, so the range is in the Z of the depth map,
+// stretches it to the JET LUT of the display and publishes the preview,
+// which GetPreview() copies from any thread.
+//*****************************************************************************
+class CDepthMapColorizer
+   {
+   public:
+      CDepthMapColorizer(MIL_ID MilSystem, const CDepthMapRing& Ring, MIL_INT NbRows, MIL_DOUBLE MaxFrameRate);
+      ~CDepthMapColorizer();
+
+      void SetKernel(PColorizeRow ColorizeRow) { m_ColorizeRow = ColorizeRow; }
+      void Update();
+
+      // Copies the last preview, as packed BGR32 pixels (blue in the low
+      // byte) of GetSizeX() by GetSizeY(). Returns the number of the preview,
+      // or 0 if there is none yet.
+      MIL_INT64 GetPreview(std::vector<MIL_UINT32>& Pixels) const;
+
+      MIL_INT GetSizeX() const { return m_SizeX; }
+      MIL_INT GetSizeY() const { return m_SizeY; }
+      MIL_INT64 GetNbPreviews() const { return m_NbPreviews; }
+
+   private:
+      static MIL_UINT32 MFTYPE ColorizerThread(void* pUserData);
+      void UpdateRange(const MIL_UINT16* pSource, MIL_INT Pitch);
+      void Colorize();
+      void Lock() const;
+      void Unlock() const;
+
+      const CDepthMapRing& m_Ring;
+      MIL_INT    m_SizeX;
+      MIL_INT    m_SizeY;
+      MIL_ID     m_MilWindow;
+      MIL_ID     m_MilSource;
+      PColorizeRow m_ColorizeRow;
+
+      // Range of the depths, in gray levels, smoothed over the previews,
+      // and the histogram of the depths of a preview.
+      bool       m_HasRange;
+      MIL_DOUBLE m_MinDepth;
+      MIL_DOUBLE m_MaxDepth;
+      std::vector<MIL_UINT32> m_Histogram;
+
+      // Pacing of the previews.
+      MIL_DOUBLE m_MinPreviewPeriod;
+      MIL_DOUBLE m_LastPreviewTime;
+      bool       m_Busy;
+
+      // Colorizer thread.
+      MIL_ID     m_MilThread;
+      MIL_ID     m_MilStartEvent;
+      MIL_ID     m_MilMutex;
+      bool       m_Exit;
+
+      SPColorizeParams        m_Params;
+      std::vector<MIL_UINT32> m_Lut;
+      std::vector<MIL_UINT32> m_BackPixels;
+      std::vector<MIL_UINT32> m_FrontPixels;
+      MIL_INT64               m_NbPreviews;
+   };
+
+#endif // DEPTH_MAP_COLORIZER_H
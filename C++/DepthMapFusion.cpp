@@ -0,0 +1,190 @@
+﻿/************************************************************************************/
+/*
+* File name: DepthMapFusion.cpp
+*
+* Synopsis:  This file contains the implementation of the CDepthMapFusion class that
+*            fuses the depth maps rasterized from several sensors.
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+#include <mil.h>
+#include "DepthMapFusion.h"
+
+//*****************************************************************************
+// Constants.
+//*****************************************************************************
+static MIL_CONST_TEXT_PTR FUSION_POLICY_NAMES[NB_FUSION_POLICIES] =
+   {
+   MIL_TEXT("max Z"),
+   MIL_TEXT("min Z"),
+   MIL_TEXT("mean Z"),
+   MIL_TEXT("priority")
+   };
+
+//*****************************************************************************
+// GetFusionPolicyName. Gets the display name of a fusion policy.
+//*****************************************************************************
+MIL_CONST_TEXT_PTR GetFusionPolicyName(EFusionPolicy Policy)
+   {
+   return (Policy >= 0 && Policy < NB_FUSION_POLICIES) ? FUSION_POLICY_NAMES[Policy] : MIL_TEXT("unknown");
+   }
+
+//*****************************************************************************
+// Constructor. Allocates the fused depth map and its display.
+//*****************************************************************************
+CDepthMapFusion::CDepthMapFusion(MIL_ID MilSystem, const SPDepthMapGrid& Grid, MIL_INT NbSensors,
+                                 EFusionPolicy Policy, MIL_INT MapLength, MIL_INT DisplayLength)
+   : m_Policy(Policy),
+     m_NbFusedRows(0),
+     m_NbOverlapCells(0),
+     m_DisplayLength(DisplayLength < MapLength ? DisplayLength : MapLength),
+     m_SensorRows(NbSensors)
+   {
+   SPSensor NoSensor = {M_NULL, 0, 0, 0};
+   m_Sensors.resize(NbSensors, NoSensor);
+   m_pRing = new CDepthMapRing(MilSystem, Grid, MapLength, m_DisplayLength);
+   MthrAlloc(MilSystem, M_MUTEX, M_DEFAULT, M_NULL, M_NULL, &m_MilMutex);
+
+   // Allocate the display of the last fused rows, with the LUT of the depth
+   // map process.
+   m_MilDepthMap = m_pRing->AllocWindow(m_DisplayLength);
+   MdispAlloc(MilSystem, M_DEFAULT, MIL_TEXT("M_DEFAULT"), M_DEFAULT, &m_MilDisplay);
+   MbufAllocColor(MilSystem, 3, 65536, 1, 8 + M_UNSIGNED, M_LUT, &m_MilDisplayLut);
+   MgenLutFunction(m_MilDisplayLut, M_COLORMAP_JET, M_DEFAULT,
+                   M_DEFAULT, M_DEFAULT, M_DEFAULT, M_DEFAULT, M_DEFAULT);
+   MIL_UINT8 ColorForInvalidDepth[3] = {128, 128, 128};
+   MbufPutColor2d(m_MilDisplayLut, M_PLANAR, M_ALL_BANDS, 65535, 0, 1, 1, ColorForInvalidDepth);
+   MdispLut(m_MilDisplay, m_MilDisplayLut);
+   MdispSelect(m_MilDisplay, m_MilDepthMap);
+   }
+
+//*****************************************************************************
+// Destructor.
+//*****************************************************************************
+CDepthMapFusion::~CDepthMapFusion()
+   {
+   MbufFree(m_MilDisplayLut);
+   MdispFree(m_MilDisplay);
+   MbufFree(m_MilDepthMap);
+   MthrFree(m_MilMutex);
+   delete m_pRing;
+   }
+
+//*****************************************************************************
+// SetSensor. Declares the ring of a sensor.
+//*****************************************************************************
+void CDepthMapFusion::SetSensor(MIL_INT Sensor, const CDepthMapRing* pRing, MIL_INT64 RowOffset,
+                                MIL_INT MaxBlockRows)
+   {
+   Lock();
+   m_Sensors[Sensor].pRing = pRing;
+   m_Sensors[Sensor].RowOffset = RowOffset;
+   m_Sensors[Sensor].MaxBlockRows = MaxBlockRows;
+   m_Sensors[Sensor].NbCompletedRows = 0;
+   Unlock();
+   }
+
+//*****************************************************************************
+// Update. Fuses the rows completed by all the sensors and displays them.
+//*****************************************************************************
+void CDepthMapFusion::Update(MIL_INT Sensor, MIL_INT64 NbCompletedRows)
+   {
+   Lock();
+   m_Sensors[Sensor].NbCompletedRows = NbCompletedRows;
+
+   // The fused rows end at the last row completed by the slowest sensor.
+   MIL_INT64 EndRow = -1;
+   for(size_t s = 0; s < m_Sensors.size(); s++)
+      {
+      if(!m_Sensors[s].pRing)
+         {
+         EndRow = -1;
+         break;
+         }
+      MIL_INT64 SensorEndRow = m_Sensors[s].NbCompletedRows + m_Sensors[s].RowOffset;
+      if(EndRow < 0 || SensorEndRow < EndRow)
+         EndRow = SensorEndRow;
+      }
+
+   if(EndRow > m_NbFusedRows)
+      {
+      // The rows that the fused ring cannot hold are skipped.
+      MIL_INT64 FirstRow = m_NbFusedRows;
+      if(EndRow - FirstRow > m_pRing->GetLength())
+         FirstRow = EndRow - m_pRing->GetLength();
+      for(MIL_INT64 Row = FirstRow; Row < EndRow; Row++)
+         FuseRow(Row);
+      m_pRing->CommitRows(SPRowRange(FirstRow, EndRow));
+      m_NbFusedRows = EndRow;
+
+      m_pRing->MoveWindowToLast(m_MilDepthMap, m_DisplayLength);
+      MbufControl(m_MilDepthMap, M_MODIFIED, M_DEFAULT);
+      }
+   Unlock();
+   }
+
+//*****************************************************************************
+// FuseRow. Combines the row of the sensors that still have it. The rows
+//          that a sensor can be writing, one block after the rows it
+//          reported, are not read.
+//*****************************************************************************
+void CDepthMapFusion::FuseRow(MIL_INT64 Row)
+   {
+   MIL_INT NbRows = 0;
+   for(size_t s = 0; s < m_Sensors.size(); s++)
+      {
+      const SPSensor& SensorInfo = m_Sensors[s];
+      MIL_INT64 SensorRow = Row - SensorInfo.RowOffset;
+      MIL_INT64 FirstSafeRow = SensorInfo.NbCompletedRows + SensorInfo.MaxBlockRows - SensorInfo.pRing->GetLength();
+      if(SensorRow >= 0 && SensorRow >= FirstSafeRow)
+         m_SensorRows[NbRows++] = SensorInfo.pRing->GetRow(SensorRow);
+      }
+
+   MIL_UINT16* pDstRow = m_pRing->GetRow(Row);
+   MIL_INT SizeX = m_pRing->GetGrid().SizeX;
+   if(NbRows == 0)
+      {
+      ClearDepthRow(pDstRow, SizeX);
+      return;
+      }
+
+   for(MIL_INT x = 0; x < SizeX; x++)
+      {
+      MIL_UINT32 Fused = INVALID_DEPTH;
+      MIL_UINT32 Sum = 0;
+      MIL_UINT32 Count = 0;
+      for(MIL_INT r = 0; r < NbRows; r++)
+         {
+         MIL_UINT32 Depth = m_SensorRows[r][x];
+         if(Depth == INVALID_DEPTH)
+            continue;
+         switch(m_Policy)
+            {
+            case FUSION_MAX_Z:    if(Count == 0 || Depth > Fused) Fused = Depth; break;
+            case FUSION_MIN_Z:    if(Count == 0 || Depth < Fused) Fused = Depth; break;
+            case FUSION_MEAN_Z:   Sum += Depth; break;
+            default:              if(Count == 0) Fused = Depth; break;
+            }
+         Count++;
+         }
+      if(m_Policy == FUSION_MEAN_Z && Count > 0)
+         Fused = (Sum + Count / 2) / Count;
+      if(Count > 1)
+         m_NbOverlapCells++;
+      pDstRow[x] = (MIL_UINT16)Fused;
+      }
+   }
+
+//*****************************************************************************
+// Lock/Unlock. Protect the fused depth map.
+//*****************************************************************************
+void CDepthMapFusion::Lock() const
+   {
+   MthrControl(m_MilMutex, M_LOCK, M_DEFAULT);
+   }
+
+void CDepthMapFusion::Unlock() const
+   {
+   MthrControl(m_MilMutex, M_UNLOCK, M_DEFAULT);
+   }
@@ -0,0 +1,96 @@
+﻿/************************************************************************************/
+/*
+* File name: DepthMapFusion.h
+*
+* Synopsis:  This file contains the declaration of the CDepthMapFusion class that
+*            fuses the depth maps rasterized from several sensors, each with its
+*            own calibration and pose, in a shared calibrated depth map.
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+
+#ifndef DEPTH_MAP_FUSION_H
+#define DEPTH_MAP_FUSION_H
+
+#include <vector>
+#include "DepthMapRing.h"
+
+//*****************************************************************************
+// Policies combining the cells seen by several sensors.
+//*****************************************************************************
+enum EFusionPolicy
+   {
+   FUSION_MAX_Z = 0,    // Highest cell. For the tops of the parts.
+   FUSION_MIN_Z,        // Lowest cell.
+   FUSION_MEAN_Z,       // Mean of the cells. Reduces the noise in the overlaps.
+   FUSION_PRIORITY,     // Cell of the first sensor that sees it, in the sensor order.
+   NB_FUSION_POLICIES
+   };
+
+MIL_CONST_TEXT_PTR GetFusionPolicyName(EFusionPolicy Policy);
+
+//*****************************************************************************
+// Class fusing the depth maps of several sensors.
+//
+// Each sensor rasterizes its blocks, in its own thread, in its own ring on
+// the shared grid, and reports the rows it completed with Update(). A fused
+// row is combined once all the sensors completed it, so the fused depth map
+// advances at the rate of the slowest sensor. The offset of a sensor along
+// the conveyor is a whole number of rows.
+//
+// The rings of the sensors must hold the lag between the sensors: the rows
+// of a sensor that are no longer in its ring are missing from the fused rows.
+//*****************************************************************************
+class CDepthMapFusion
+   {
+   public:
+      CDepthMapFusion(MIL_ID MilSystem, const SPDepthMapGrid& Grid, MIL_INT NbSensors,
+                      EFusionPolicy Policy, MIL_INT MapLength, MIL_INT DisplayLength);
+      ~CDepthMapFusion();
+
+      // Declares the ring of a sensor and the row of the fused depth map of
+      // its first row. MaxBlockRows is the most rows written by a block.
+      void SetSensor(MIL_INT Sensor, const CDepthMapRing* pRing, MIL_INT64 RowOffset, MIL_INT MaxBlockRows);
+
+      // Reports the rows completed by a sensor and fuses the rows completed
+      // by all the sensors. Called from the thread of the sensor.
+      void Update(MIL_INT Sensor, MIL_INT64 NbCompletedRows);
+
+      // Fused depth map. Lock the fusion to read it while the sensors run.
+      const CDepthMapRing& GetRing() const { return *m_pRing; }
+      MIL_INT64 GetNbFusedRows() const { return m_NbFusedRows; }
+      MIL_INT64 GetNbOverlapCells() const { return m_NbOverlapCells; }
+      const SPDepthMapGrid& GetGrid() const { return m_pRing->GetGrid(); }
+      EFusionPolicy GetPolicy() const { return m_Policy; }
+      void Lock() const;
+      void Unlock() const;
+
+   private:
+      struct SPSensor
+         {
+         const CDepthMapRing* pRing;
+         MIL_INT64            RowOffset;
+         MIL_INT              MaxBlockRows;
+         MIL_INT64            NbCompletedRows;
+         };
+
+      void FuseRow(MIL_INT64 Row);
+
+      EFusionPolicy  m_Policy;
+      CDepthMapRing* m_pRing;
+      MIL_INT64      m_NbFusedRows;
+      MIL_INT64      m_NbOverlapCells;
+      MIL_ID         m_MilMutex;
+
+      // Display of the last fused rows.
+      MIL_ID  m_MilDisplay;
+      MIL_ID  m_MilDisplayLut;
+      MIL_ID  m_MilDepthMap;
+      MIL_INT m_DisplayLength;
+
+      std::vector<SPSensor>          m_Sensors;
+      std::vector<const MIL_UINT16*> m_SensorRows;
+   };
+
+#endif // DEPTH_MAP_FUSION_H
@@ -0,0 +1,258 @@
+﻿/************************************************************************************/
+/*
+* File name: DepthMapHoleFiller.cpp
+*
+* Synopsis:  This file contains the implementation of the CDepthMapHoleFiller class
+*            that fills the holes of bounded size of the continuous depth map.
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+#include <mil.h>
+#include <string.h>
+#include "DepthMapHoleFiller.h"
+
+//*****************************************************************************
+// Constants.
+//*****************************************************************************
+
+// Minimum number of rows of a tile.
+static const MIL_INT64 MIN_TILE_ROWS = 8;
+
+// Minimum number of valid cells in the 3x3 neighborhood of a missing cell
+// for the 2d pass to fill it. Fewer would grow the borders of large holes.
+static const MIL_INT MIN_VALID_NEIGHBORS = 3;
+
+//*****************************************************************************
+// Constructor.
+//*****************************************************************************
+CDepthMapHoleFiller::CDepthMapHoleFiller(MIL_INT SizeX, MIL_INT MaxHoleSize, CWorkerPool* pWorkerPool)
+   : m_SizeX(SizeX),
+     m_MaxHoleSize(MaxHoleSize),
+     m_pWorkerPool(pWorkerPool),
+     m_NextRow(0),
+     m_TilePass(LINE_PASS),
+     m_pRing(M_NULL),
+     m_TileRows(0),
+     m_NbCompletedRows(0)
+   {
+   m_Scratch.resize(pWorkerPool ? pWorkerPool->GetNbWorkers() : 1);
+   for(size_t w = 0; w < m_Scratch.size(); w++)
+      {
+      m_Scratch[w].PrevValid.resize(SizeX);
+      m_Scratch[w].NextValid.resize(SizeX);
+      }
+   }
+
+//*****************************************************************************
+// Destructor.
+//*****************************************************************************
+CDepthMapHoleFiller::~CDepthMapHoleFiller()
+   {
+   }
+
+//*****************************************************************************
+// Fill. Fills the holes of the rows that have enough completed rows after
+//       them. Returns the rows that were filled.
+//*****************************************************************************
+SPRowRange CDepthMapHoleFiller::Fill(CDepthMapRing& Ring, MIL_INT64 NbCompletedRows)
+   {
+   return FillRows(Ring, NbCompletedRows - GetLagRows(), NbCompletedRows);
+   }
+
+//*****************************************************************************
+// Finish. Fills the holes of all the completed rows at the end of the scan,
+//         when no row follows the completed ones. Returns the rows that
+//         were filled.
+//*****************************************************************************
+SPRowRange CDepthMapHoleFiller::Finish(CDepthMapRing& Ring, MIL_INT64 NbCompletedRows)
+   {
+   return FillRows(Ring, NbCompletedRows, NbCompletedRows);
+   }
+
+//*****************************************************************************
+// FillRows. Fills the holes of the rows up to EndRow, from the rows up to
+//           NbCompletedRows.
+//*****************************************************************************
+SPRowRange CDepthMapHoleFiller::FillRows(CDepthMapRing& Ring, MIL_INT64 EndRow, MIL_INT64 NbCompletedRows)
+   {
+   if(EndRow <= m_NextRow)
+      return SPRowRange();
+
+   m_pRing = &Ring;
+   m_Rows = SPRowRange(m_NextRow, EndRow);
+   m_NbCompletedRows = NbCompletedRows;
+   MIL_INT64 NbRows = EndRow - m_NextRow;
+   m_LineFilled.resize((size_t)(NbRows * m_SizeX));
+
+   MIL_INT64 NbWorkers = (MIL_INT64)m_Scratch.size();
+   m_TileRows = (NbRows + NbWorkers - 1) / NbWorkers;
+   if(m_TileRows < MIN_TILE_ROWS)
+      m_TileRows = MIN_TILE_ROWS;
+   MIL_INT NbTiles = (MIL_INT)((NbRows + m_TileRows - 1) / m_TileRows);
+
+   RunTiles(LINE_PASS, NbTiles);
+   RunTiles(NEIGHBORHOOD_PASS, NbTiles);
+
+   m_NextRow = EndRow;
+   return m_Rows;
+   }
+
+//*****************************************************************************
+// RunTiles. Runs a pass over the tiles on the worker pool, or in the calling
+//           thread if there is no pool.
+//*****************************************************************************
+void CDepthMapHoleFiller::RunTiles(ETilePass Pass, MIL_INT NbTiles)
+   {
+   m_TilePass = Pass;
+   if(m_pWorkerPool)
+      m_pWorkerPool->Run(*this, NbTiles);
+   else
+      {
+      for(MIL_INT Tile = 0; Tile < NbTiles; Tile++)
+         RunItem(Tile, 0);
+      }
+   }
+
+//*****************************************************************************
+// RunItem. Runs the current pass on a tile of rows.
+//*****************************************************************************
+void CDepthMapHoleFiller::RunItem(MIL_INT Tile, MIL_INT Worker)
+   {
+   MIL_INT64 TileFirstRow = m_Rows.First + Tile * m_TileRows;
+   MIL_INT64 TileEndRow = TileFirstRow + m_TileRows;
+   if(TileEndRow > m_Rows.End)
+      TileEndRow = m_Rows.End;
+
+   for(MIL_INT64 Row = TileFirstRow; Row < TileEndRow; Row++)
+      {
+      if(m_TilePass == LINE_PASS)
+         FillLines(Row, m_Scratch[Worker]);
+      else
+         FillNeighborhoods(Row);
+      }
+   }
+
+//*****************************************************************************
+// FillLines. Interpolates the missing cells of a row along the row and along
+//            the columns, in the scratch copy of the row.
+//*****************************************************************************
+void CDepthMapHoleFiller::FillLines(MIL_INT64 Row, SPWorkerScratch& Scratch)
+   {
+   const MIL_UINT16* pSrcRow = m_pRing->GetRow(Row);
+   MIL_UINT16* pDstRow = &m_LineFilled[(size_t)((Row - m_Rows.First) * m_SizeX)];
+   memcpy(pDstRow, pSrcRow, m_SizeX * sizeof(MIL_UINT16));
+
+   // Find the nearest valid cells on each side of the cells of the row.
+   MIL_INT32 Prev = -1;
+   for(MIL_INT x = 0; x < m_SizeX; x++)
+      {
+      Scratch.PrevValid[x] = Prev;
+      if(pSrcRow[x] != INVALID_DEPTH)
+         Prev = (MIL_INT32)x;
+      }
+   MIL_INT32 Next = -1;
+   for(MIL_INT x = m_SizeX - 1; x >= 0; x--)
+      {
+      Scratch.NextValid[x] = Next;
+      if(pSrcRow[x] != INVALID_DEPTH)
+         Next = (MIL_INT32)x;
+      }
+
+   // The rows above the first row of the scan or past the completed rows
+   // do not exist.
+   MIL_INT64 FirstRow = Row - m_MaxHoleSize - 1;
+   if(FirstRow < m_pRing->GetFirstAvailableRow())
+      FirstRow = m_pRing->GetFirstAvailableRow();
+   MIL_INT64 LastRow = Row + m_MaxHoleSize + 1;
+   if(LastRow >= m_NbCompletedRows)
+      LastRow = m_NbCompletedRows - 1;
+
+   for(MIL_INT x = 0; x < m_SizeX; x++)
+      {
+      if(pSrcRow[x] != INVALID_DEPTH)
+         continue;
+
+      MIL_FLOAT Sum = 0.0f;
+      MIL_INT NbInterpolations = 0;
+
+      // Along the row.
+      MIL_INT32 Left = Scratch.PrevValid[x];
+      MIL_INT32 Right = Scratch.NextValid[x];
+      if(Left >= 0 && Right >= 0 && Right - Left - 1 <= m_MaxHoleSize)
+         {
+         MIL_FLOAT Weight = (MIL_FLOAT)(x - Left) / (Right - Left);
+         Sum += pSrcRow[Left] + (pSrcRow[Right] - (MIL_FLOAT)pSrcRow[Left]) * Weight;
+         NbInterpolations++;
+         }
+
+      // Along the column.
+      MIL_INT64 Up = Row - 1;
+      while(Up >= FirstRow && m_pRing->GetRow(Up)[x] == INVALID_DEPTH)
+         Up--;
+      MIL_INT64 Down = Row + 1;
+      while(Down <= LastRow && m_pRing->GetRow(Down)[x] == INVALID_DEPTH)
+         Down++;
+      if(Up >= FirstRow && Down <= LastRow && Down - Up - 1 <= m_MaxHoleSize)
+         {
+         MIL_FLOAT UpDepth = m_pRing->GetRow(Up)[x];
+         MIL_FLOAT Weight = (MIL_FLOAT)(Row - Up) / (MIL_FLOAT)(Down - Up);
+         Sum += UpDepth + (m_pRing->GetRow(Down)[x] - UpDepth) * Weight;
+         NbInterpolations++;
+         }
+
+      if(NbInterpolations)
+         pDstRow[x] = (MIL_UINT16)(Sum / NbInterpolations + 0.5f);
+      }
+   }
+
+//*****************************************************************************
+// GetLineFilledRow. Gets a row after the line pass: the scratch copy for the
+//                   rows being filled, the ring for the others.
+//*****************************************************************************
+const MIL_UINT16* CDepthMapHoleFiller::GetLineFilledRow(MIL_INT64 Row) const
+   {
+   if(Row >= m_Rows.First && Row < m_Rows.End)
+      return &m_LineFilled[(size_t)((Row - m_Rows.First) * m_SizeX)];
+   return m_pRing->GetRow(Row);
+   }
+
+//*****************************************************************************
+// FillNeighborhoods. Sets the cells still missing after the line pass to
+//                    the mean of their valid 3x3 neighbors, and writes the
+//                    row back to the ring.
+//*****************************************************************************
+void CDepthMapHoleFiller::FillNeighborhoods(MIL_INT64 Row)
+   {
+   const MIL_UINT16* pRows[3];
+   pRows[1] = GetLineFilledRow(Row);
+   pRows[0] = Row > m_pRing->GetFirstAvailableRow() ? GetLineFilledRow(Row - 1) : M_NULL;
+   pRows[2] = Row + 1 < m_NbCompletedRows ? GetLineFilledRow(Row + 1) : M_NULL;
+
+   MIL_UINT16* pDstRow = m_pRing->GetRow(Row);
+   for(MIL_INT x = 0; x < m_SizeX; x++)
+      {
+      MIL_UINT16 Depth = pRows[1][x];
+      if(Depth == INVALID_DEPTH)
+         {
+         MIL_UINT32 Sum = 0;
+         MIL_INT NbValid = 0;
+         for(MIL_INT r = 0; r < 3; r++)
+            {
+            if(!pRows[r])
+               continue;
+            for(MIL_INT n = (x > 0 ? x - 1 : 0); n <= x + 1 && n < m_SizeX; n++)
+               {
+               if(pRows[r][n] != INVALID_DEPTH)
+                  {
+                  Sum += pRows[r][n];
+                  NbValid++;
+                  }
+               }
+            }
+         if(NbValid >= MIN_VALID_NEIGHBORS)
+            Depth = (MIL_UINT16)((Sum + NbValid / 2) / NbValid);
+         }
+      pDstRow[x] = Depth;
+      }
+   }
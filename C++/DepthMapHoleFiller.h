@@ -0,0 +1,85 @@
+﻿/************************************************************************************/
+/*
+* File name: DepthMapHoleFiller.h
+*
+* Synopsis:  This file contains the declaration of the CDepthMapHoleFiller class that
+*            fills the holes of bounded size of the continuous depth map, in place,
+*            as the rows are completed.
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+
+#ifndef DEPTH_MAP_HOLE_FILLER_H
+#define DEPTH_MAP_HOLE_FILLER_H
+
+#include "DepthMapRing.h"
+
+//*****************************************************************************
+// Class that fills the holes of the continuous depth map.
+//
+// A missing cell is first interpolated linearly between the nearest valid
+// cells of its row and of its column, if they are at most MaxHoleSize cells
+// apart; with both, the two interpolations are averaged. A single 2d pass
+// then sets each remaining missing cell that has enough valid neighbors to
+// the mean of its 3x3 neighborhood. Larger holes stay invalid.
+//
+// A row is filled once the MaxHoleSize + 1 rows after it are completed, so
+// the filling lags the rasterization by that number of rows. At the end of
+// the scan, Finish() fills the last rows without waiting for more rows. The
+// rows to fill are split in tiles processed by the workers of a pool: the
+// line pass writes to a scratch copy of the rows and the 2d pass writes back
+// to the ring, so no tile reads a row that another tile writes.
+//*****************************************************************************
+class CDepthMapHoleFiller : private CParallelTask
+   {
+   public:
+      CDepthMapHoleFiller(MIL_INT SizeX, MIL_INT MaxHoleSize, CWorkerPool* pWorkerPool);
+      virtual ~CDepthMapHoleFiller();
+
+      SPRowRange Fill(CDepthMapRing& Ring, MIL_INT64 NbCompletedRows);
+      SPRowRange Finish(CDepthMapRing& Ring, MIL_INT64 NbCompletedRows);
+
+      MIL_INT GetMaxHoleSize() const { return m_MaxHoleSize; }
+      MIL_INT GetLagRows() const { return m_MaxHoleSize + 1; }
+      MIL_INT64 GetNbFilledRows() const { return m_NextRow; }
+
+   private:
+      // Scratch memory of a worker: the nearest valid cells of a row.
+      struct SPWorkerScratch
+         {
+         std::vector<MIL_INT32> PrevValid;
+         std::vector<MIL_INT32> NextValid;
+         };
+
+      // Passes over the tiles.
+      enum ETilePass
+         {
+         LINE_PASS,
+         NEIGHBORHOOD_PASS
+         };
+
+      SPRowRange FillRows(CDepthMapRing& Ring, MIL_INT64 EndRow, MIL_INT64 NbCompletedRows);
+      virtual void RunItem(MIL_INT Tile, MIL_INT Worker);
+      void RunTiles(ETilePass Pass, MIL_INT NbTiles);
+      void FillLines(MIL_INT64 Row, SPWorkerScratch& Scratch);
+      void FillNeighborhoods(MIL_INT64 Row);
+      const MIL_UINT16* GetLineFilledRow(MIL_INT64 Row) const;
+
+      MIL_INT      m_SizeX;
+      MIL_INT      m_MaxHoleSize;
+      CWorkerPool* m_pWorkerPool;
+      MIL_INT64    m_NextRow;
+      ETilePass    m_TilePass;
+
+      // Rows being filled.
+      CDepthMapRing*          m_pRing;
+      SPRowRange              m_Rows;
+      MIL_INT64               m_TileRows;
+      MIL_INT64               m_NbCompletedRows;
+      std::vector<MIL_UINT16> m_LineFilled;
+
+      std::vector<SPWorkerScratch> m_Scratch;
+   };
+
+#endif // DEPTH_MAP_HOLE_FILLER_H
@@ -0,0 +1,167 @@
+﻿/************************************************************************************/
+/*
+* File name: DepthMapPyramid.cpp
+*
+* Synopsis:  This file contains the implementation of the CDepthMapPyramid class that
+*            maintains min, max and mean reductions of the continuous depth map.
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+#include <mil.h>
+#include "DepthMapPyramid.h"
+
+//*****************************************************************************
+// Reduction of two rows of a level in a row of the next level. The loops
+// are written without branches so that the compiler can vectorize them.
+// A missing second cell of the last column is given as invalid.
+//*****************************************************************************
+static inline MIL_UINT16 Min4(MIL_UINT16 A, MIL_UINT16 B, MIL_UINT16 C, MIL_UINT16 D)
+   {
+   // The invalid gray level is higher than all the valid ones.
+   MIL_UINT16 AB = A < B ? A : B;
+   MIL_UINT16 CD = C < D ? C : D;
+   return AB < CD ? AB : CD;
+   }
+
+static inline MIL_UINT16 Max4(MIL_UINT16 A, MIL_UINT16 B, MIL_UINT16 C, MIL_UINT16 D)
+   {
+   // Shift the gray levels so that the invalid one becomes the lowest.
+   MIL_UINT16 AB = (MIL_UINT16)(A + 1) > (MIL_UINT16)(B + 1) ? A : B;
+   MIL_UINT16 CD = (MIL_UINT16)(C + 1) > (MIL_UINT16)(D + 1) ? C : D;
+   return (MIL_UINT16)(AB + 1) > (MIL_UINT16)(CD + 1) ? AB : CD;
+   }
+
+static inline MIL_UINT16 Mean4(MIL_UINT16 A, MIL_UINT16 B, MIL_UINT16 C, MIL_UINT16 D)
+   {
+   MIL_UINT32 ValidA = A != INVALID_DEPTH, ValidB = B != INVALID_DEPTH;
+   MIL_UINT32 ValidC = C != INVALID_DEPTH, ValidD = D != INVALID_DEPTH;
+   MIL_UINT32 Count = ValidA + ValidB + ValidC + ValidD;
+   MIL_UINT32 Sum = A * ValidA + B * ValidB + C * ValidC + D * ValidD;
+   return Count ? (MIL_UINT16)((Sum + Count / 2) / Count) : INVALID_DEPTH;
+   }
+
+static void ReduceRows(const MIL_UINT16* pSrcRow0, const MIL_UINT16* pSrcRow1, MIL_INT SrcSizeX,
+                       MIL_UINT16* pDstRow, EPyramidStat Stat)
+   {
+   MIL_INT NbPairs = SrcSizeX / 2;
+   switch(Stat)
+      {
+      case PYRAMID_MIN:
+         for(MIL_INT x = 0; x < NbPairs; x++)
+            pDstRow[x] = Min4(pSrcRow0[2 * x], pSrcRow0[2 * x + 1], pSrcRow1[2 * x], pSrcRow1[2 * x + 1]);
+         break;
+      case PYRAMID_MAX:
+         for(MIL_INT x = 0; x < NbPairs; x++)
+            pDstRow[x] = Max4(pSrcRow0[2 * x], pSrcRow0[2 * x + 1], pSrcRow1[2 * x], pSrcRow1[2 * x + 1]);
+         break;
+      default:
+         for(MIL_INT x = 0; x < NbPairs; x++)
+            pDstRow[x] = Mean4(pSrcRow0[2 * x], pSrcRow0[2 * x + 1], pSrcRow1[2 * x], pSrcRow1[2 * x + 1]);
+         break;
+      }
+
+   if(SrcSizeX % 2)
+      {
+      MIL_UINT16 A = pSrcRow0[SrcSizeX - 1];
+      MIL_UINT16 C = pSrcRow1[SrcSizeX - 1];
+      pDstRow[NbPairs] = Stat == PYRAMID_MIN ? Min4(A, INVALID_DEPTH, C, INVALID_DEPTH) :
+                         Stat == PYRAMID_MAX ? Max4(A, INVALID_DEPTH, C, INVALID_DEPTH) :
+                                               Mean4(A, INVALID_DEPTH, C, INVALID_DEPTH);
+      }
+   }
+
+//*****************************************************************************
+// Constructor. Allocates the rings of the levels. The grid of a level is
+// centered on the 2x2 cells of the level below.
+//*****************************************************************************
+CDepthMapPyramid::CDepthMapPyramid(MIL_ID MilSystem, const CDepthMapRing& DepthMapRing, MIL_INT NbLevels,
+                                   MIL_INT Length, MIL_INT MaxWindowLength)
+   : m_DepthMapRing(DepthMapRing),
+     m_InvalidRow(DepthMapRing.GetGrid().SizeX, INVALID_DEPTH)
+   {
+   SPDepthMapGrid Grid = DepthMapRing.GetGrid();
+   m_Levels.resize(NbLevels);
+   for(MIL_INT l = 0; l < NbLevels; l++)
+      {
+      Grid.WorldPosX += Grid.PixelSizeX / 2;
+      Grid.WorldPosY += Grid.PixelSizeY / 2;
+      Grid.PixelSizeX *= 2;
+      Grid.PixelSizeY *= 2;
+      Grid.SizeX = (Grid.SizeX + 1) / 2;
+      for(MIL_INT s = 0; s < NB_PYRAMID_STATS; s++)
+         m_Levels[l].pRings[s] = new CDepthMapRing(MilSystem, Grid, Length, MaxWindowLength);
+      }
+   }
+
+//*****************************************************************************
+// Destructor.
+//*****************************************************************************
+CDepthMapPyramid::~CDepthMapPyramid()
+   {
+   for(size_t l = 0; l < m_Levels.size(); l++)
+      {
+      for(MIL_INT s = 0; s < NB_PYRAMID_STATS; s++)
+         delete m_Levels[l].pRings[s];
+      }
+   }
+
+//*****************************************************************************
+// GetLevel. Gets the ring of a statistic of a level. Level 0 is the depth
+//           map itself, the same for all the statistics.
+//*****************************************************************************
+const CDepthMapRing& CDepthMapPyramid::GetLevel(MIL_INT Level, EPyramidStat Stat) const
+   {
+   return Level == 0 ? m_DepthMapRing : *m_Levels[Level - 1].pRings[Stat];
+   }
+
+//*****************************************************************************
+// GetLastUpdatedRows. Gets the rows of a level updated by the last update.
+//*****************************************************************************
+const SPRowRange& CDepthMapPyramid::GetLastUpdatedRows(MIL_INT Level) const
+   {
+   return Level == 0 ? m_BaseUpdatedRows : m_Levels[Level - 1].LastUpdatedRows;
+   }
+
+//*****************************************************************************
+// GetSourceRow. Gets a row of a level to reduce. The rows not written yet
+//               are invalid.
+//*****************************************************************************
+const MIL_UINT16* CDepthMapPyramid::GetSourceRow(MIL_INT Level, EPyramidStat Stat, MIL_INT64 Row) const
+   {
+   const CDepthMapRing& Ring = GetLevel(Level, Stat);
+   return Row < Ring.GetNbRowsWritten() ? Ring.GetRow(Row) : &m_InvalidRow[0];
+   }
+
+//*****************************************************************************
+// Update. Updates the cells of the levels above the rows of the depth map
+//         that changed. Each level only recomputes the rows above the rows
+//         that changed in the level below.
+//*****************************************************************************
+void CDepthMapPyramid::Update(const SPRowRange& Rows)
+   {
+   m_BaseUpdatedRows = Rows;
+   SPRowRange SrcRows = Rows;
+   for(MIL_INT l = 1; l <= GetNbLevels(); l++)
+      {
+      SPLevel& Level = m_Levels[l - 1];
+      SPRowRange DstRows(SrcRows.First / 2, (SrcRows.End + 1) / 2);
+      if(SrcRows.IsEmpty())
+         DstRows = SPRowRange();
+
+      MIL_INT SrcSizeX = GetLevel(l - 1, PYRAMID_MIN).GetGrid().SizeX;
+      for(MIL_INT s = 0; s < NB_PYRAMID_STATS; s++)
+         {
+         EPyramidStat Stat = (EPyramidStat)s;
+         CDepthMapRing& Ring = *Level.pRings[s];
+         for(MIL_INT64 Row = DstRows.First; Row < DstRows.End; Row++)
+            {
+            ReduceRows(GetSourceRow(l - 1, Stat, 2 * Row), GetSourceRow(l - 1, Stat, 2 * Row + 1),
+                       SrcSizeX, Ring.GetRow(Row), Stat);
+            }
+         Ring.CommitRows(DstRows);
+         }
+      Level.LastUpdatedRows = DstRows;
+      SrcRows = DstRows;
+      }
+   }
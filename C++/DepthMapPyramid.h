@@ -0,0 +1,70 @@
+﻿/************************************************************************************/
+/*
+* File name: DepthMapPyramid.h
+*
+* Synopsis:  This file contains the declaration of the CDepthMapPyramid class that
+*            maintains min, max and mean reductions of the continuous depth map at
+*            several resolutions, updating only the cells of the rows that change.
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+
+#ifndef DEPTH_MAP_PYRAMID_H
+#define DEPTH_MAP_PYRAMID_H
+
+#include <vector>
+#include "DepthMapRing.h"
+
+//*****************************************************************************
+// Statistics kept by the levels of the pyramid.
+//*****************************************************************************
+enum EPyramidStat
+   {
+   PYRAMID_MIN = 0,
+   PYRAMID_MAX,
+   PYRAMID_MEAN,
+   NB_PYRAMID_STATS
+   };
+
+//*****************************************************************************
+// Class maintaining a pyramid of the continuous depth map.
+//
+// Each level halves the resolution of the previous one in X and in Y. A cell
+// of a level reduces the 2x2 cells below it: the min, the max and the mean
+// of their valid cells, or invalid if they are all invalid. The mean of a
+// level is the mean of the valid means of the level below.
+//
+// Each level of each statistic is a ring of Length rows, calibrated at its
+// resolution, so a coarse level covers a longer part of the scan than the
+// depth map and can be read through windows like the depth map.
+//*****************************************************************************
+class CDepthMapPyramid
+   {
+   public:
+      CDepthMapPyramid(MIL_ID MilSystem, const CDepthMapRing& DepthMapRing, MIL_INT NbLevels,
+                       MIL_INT Length, MIL_INT MaxWindowLength);
+      virtual ~CDepthMapPyramid();
+
+      void Update(const SPRowRange& Rows);
+
+      MIL_INT GetNbLevels() const { return (MIL_INT)m_Levels.size(); }
+      const CDepthMapRing& GetLevel(MIL_INT Level, EPyramidStat Stat) const;
+      const SPRowRange& GetLastUpdatedRows(MIL_INT Level) const;
+
+   private:
+      struct SPLevel
+         {
+         CDepthMapRing* pRings[NB_PYRAMID_STATS];
+         SPRowRange     LastUpdatedRows;
+         };
+
+      const MIL_UINT16* GetSourceRow(MIL_INT Level, EPyramidStat Stat, MIL_INT64 Row) const;
+
+      const CDepthMapRing&    m_DepthMapRing;
+      std::vector<SPLevel>    m_Levels;
+      std::vector<MIL_UINT16> m_InvalidRow;
+      SPRowRange              m_BaseUpdatedRows;
+   };
+
+#endif // DEPTH_MAP_PYRAMID_H
@@ -0,0 +1,374 @@
+﻿/************************************************************************************/
+/*
+* File name: DepthMapRasterizer.cpp
+*
+* Synopsis:  This file contains the implementation of the CDepthMapRasterizer class
+*            that writes the 3d points of the profiles directly in a calibrated
+*            16 bits depth map.
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+#include <mil.h>
+#include <math.h>
+#include <algorithm>
+#include "DepthMapRing.h"
+
+//*****************************************************************************
+// CalibrateDepthMap. Associates the calibration of the grid to a depth map.
+//*****************************************************************************
+void CalibrateDepthMap(MIL_ID MilDepthMap, const SPDepthMapGrid& Grid)
+   {
+   McalUniform(MilDepthMap, Grid.WorldPosX, Grid.WorldPosY, Grid.PixelSizeX, Grid.PixelSizeY, 0.0, M_DEFAULT);
+   McalControl(MilDepthMap, M_WORLD_POS_Z, Grid.WorldPosZ);
+   McalControl(MilDepthMap, M_GRAY_LEVEL_SIZE_Z, Grid.GrayLevelSizeZ);
+   }
+
+//*****************************************************************************
+// Constants.
+//*****************************************************************************
+
+// Minimum number of rows of a tile. Smaller tiles cost more in dispatch
+// than they save in parallelism.
+static const MIL_INT64 MIN_TILE_ROWS = 8;
+
+static MIL_CONST_TEXT_PTR CELL_POLICY_NAMES[NB_CELL_POLICIES] =
+   {
+   MIL_TEXT("max Z"),
+   MIL_TEXT("min Z"),
+   MIL_TEXT("mean Z"),
+   MIL_TEXT("last written")
+   };
+
+//*****************************************************************************
+// GetCellPolicyName. Gets the display name of a cell policy.
+//*****************************************************************************
+MIL_CONST_TEXT_PTR GetCellPolicyName(ECellPolicy CellPolicy)
+   {
+   return (CellPolicy >= 0 && CellPolicy < NB_CELL_POLICIES) ? CELL_POLICY_NAMES[CellPolicy] : MIL_TEXT("unknown");
+   }
+
+//*****************************************************************************
+// Scatter functions. Combine the quantized points of a profile in the cells
+// of a depth map row according to the cell policy.
+//*****************************************************************************
+static void ScatterMaxZ(const MIL_INT32* pCells, const MIL_INT32* pDepths, MIL_INT Size, MIL_UINT16* pRow)
+   {
+   for(MIL_INT i = 0; i < Size; i++)
+      {
+      if(pCells[i] < 0)
+         continue;
+      MIL_UINT16 Cur = pRow[pCells[i]];
+      if(Cur == INVALID_DEPTH || (MIL_UINT16)pDepths[i] > Cur)
+         pRow[pCells[i]] = (MIL_UINT16)pDepths[i];
+      }
+   }
+
+// The invalid gray level is higher than all the valid ones.
+static void ScatterMinZ(const MIL_INT32* pCells, const MIL_INT32* pDepths, MIL_INT Size, MIL_UINT16* pRow)
+   {
+   for(MIL_INT i = 0; i < Size; i++)
+      {
+      if(pCells[i] >= 0 && (MIL_UINT16)pDepths[i] < pRow[pCells[i]])
+         pRow[pCells[i]] = (MIL_UINT16)pDepths[i];
+      }
+   }
+
+static void ScatterLastWritten(const MIL_INT32* pCells, const MIL_INT32* pDepths, MIL_INT Size, MIL_UINT16* pRow)
+   {
+   for(MIL_INT i = 0; i < Size; i++)
+      {
+      if(pCells[i] >= 0)
+         pRow[pCells[i]] = (MIL_UINT16)pDepths[i];
+      }
+   }
+
+static void AccumulateMeanZ(const MIL_INT32* pCells, const MIL_INT32* pDepths, MIL_INT Size,
+                            MIL_UINT32* pSums, MIL_UINT32* pCounts)
+   {
+   for(MIL_INT i = 0; i < Size; i++)
+      {
+      if(pCells[i] < 0)
+         continue;
+      pSums[pCells[i]] += (MIL_UINT32)pDepths[i];
+      pCounts[pCells[i]]++;
+      }
+   }
+
+// Writes the rounded means of the accumulated cells in a row.
+static void ResolveMeanZ(const MIL_UINT32* pSums, const MIL_UINT32* pCounts, MIL_INT SizeX, MIL_UINT16* pRow)
+   {
+   for(MIL_INT x = 0; x < SizeX; x++)
+      pRow[x] = pCounts[x] ? (MIL_UINT16)((pSums[x] + pCounts[x] / 2) / pCounts[x]) : INVALID_DEPTH;
+   }
+
+//*****************************************************************************
+// Constructor. Computes the mapping of the world coordinates to the cells and
+//              gray levels of the grid. A point of world X maps to the cell
+//              whose center is the closest, as in the McalUniform calibration.
+//              The worker pool can be M_NULL to rasterize in the calling
+//              thread.
+//*****************************************************************************
+CDepthMapRasterizer::CDepthMapRasterizer(const SPDepthMapGrid& Grid, MIL_DOUBLE ProfileStepY, ECellPolicy CellPolicy,
+                                         MIL_INT MaxFillGap, CWorkerPool* pWorkerPool)
+   : m_Grid(Grid),
+     m_QuantizeRow(M_NULL),
+     m_InterpolateRow(M_NULL),
+     m_CellPolicy(CellPolicy),
+     m_RowsPerProfile(ProfileStepY / Grid.PixelSizeY),
+     m_MaxFillGap(MaxFillGap),
+     m_pWorkerPool(pWorkerPool),
+     m_NbProfilesRasterized(0),
+     m_OpenRow(-1),
+     m_NextRow(0),
+     m_TilePass(RASTERIZE_PASS),
+     m_OpenAccumulator(0)
+   {
+   m_Params.ScaleX = (MIL_FLOAT)(1.0 / Grid.PixelSizeX);
+   m_Params.OffsetX = (MIL_FLOAT)(-Grid.WorldPosX / Grid.PixelSizeX);
+   m_Params.ScaleZ = (MIL_FLOAT)(1.0 / Grid.GrayLevelSizeZ);
+   m_Params.OffsetZ = (MIL_FLOAT)(-Grid.WorldPosZ / Grid.GrayLevelSizeZ);
+   m_Params.SizeX = Grid.SizeX;
+
+   m_Scratch.resize(pWorkerPool ? pWorkerPool->GetNbWorkers() : 1);
+   if(CellPolicy == CELL_MEAN_Z)
+      {
+      for(size_t w = 0; w < m_Scratch.size(); w++)
+         {
+         m_Scratch[w].Sums.resize(Grid.SizeX);
+         m_Scratch[w].Counts.resize(Grid.SizeX);
+         }
+      for(MIL_INT a = 0; a < 2; a++)
+         {
+         m_OpenSums[a].resize(Grid.SizeX, 0);
+         m_OpenCounts[a].resize(Grid.SizeX, 0);
+         }
+      }
+   }
+
+//*****************************************************************************
+// Destructor.
+//*****************************************************************************
+CDepthMapRasterizer::~CDepthMapRasterizer()
+   {
+   }
+
+//*****************************************************************************
+// SetKernels. Sets the kernels of the instruction set and profile size.
+//*****************************************************************************
+void CDepthMapRasterizer::SetKernels(PQuantizeRow QuantizeRow, PInterpolateRow InterpolateRow)
+   {
+   m_QuantizeRow = QuantizeRow;
+   m_InterpolateRow = InterpolateRow;
+   }
+
+//*****************************************************************************
+// GetProfileRow. Gets the row of a profile, indexed from the beginning of
+//                the scan. The first profile is at Grid.WorldPosY.
+//*****************************************************************************
+MIL_INT64 CDepthMapRasterizer::GetProfileRow(MIL_INT64 Profile) const
+   {
+   return (MIL_INT64)floor(Profile * m_RowsPerProfile + 0.5);
+   }
+
+//*****************************************************************************
+// GetMaxRowsPerBlock. Gets the maximum number of rows updated by a block,
+//                     including the seam row.
+//*****************************************************************************
+MIL_INT CDepthMapRasterizer::GetMaxRowsPerBlock(MIL_INT NbProfiles) const
+   {
+   return (MIL_INT)ceil(NbProfiles * m_RowsPerProfile) + 2;
+   }
+
+//*****************************************************************************
+// Rasterize. Rasterizes a block of profiles, given as flat X and Z arrays of
+//            NbProfiles rows of ProfileSize points, in the continuous depth
+//            map. Returns the rows that were updated: the open row of the
+//            previous block, if any, the rows interpolated up to the first
+//            profile of the block, and the rows of the block. pX, pZ and
+//            pMask are M_NULL for a block without any point, such as an
+//            empty belt block, whose rows are only cleared.
+//*****************************************************************************
+SPRowRange CDepthMapRasterizer::Rasterize(const MIL_FLOAT* pX, const MIL_FLOAT* pZ, const MIL_UINT8* pMask,
+                                          MIL_INT ProfileSize, MIL_INT NbProfiles, CDepthMapRing& Ring)
+   {
+   if(NbProfiles <= 0)
+      return SPRowRange();
+
+   // Get the rows of the profiles.
+   m_ProfileRows.resize(NbProfiles);
+   for(MIL_INT y = 0; y < NbProfiles; y++)
+      m_ProfileRows[y] = GetProfileRow(m_NbProfilesRasterized + y);
+   for(size_t w = 0; w < m_Scratch.size(); w++)
+      {
+      m_Scratch[w].Cells.resize(ProfileSize);
+      m_Scratch[w].Depths.resize(ProfileSize);
+      }
+
+   // The last row stays open if the next profile goes to it.
+   m_Block.pX = pX;
+   m_Block.pZ = pZ;
+   m_Block.pMask = pMask;
+   m_Block.ProfileSize = ProfileSize;
+   m_Block.NbProfiles = NbProfiles;
+   m_Block.FirstRow = m_NextRow;
+   m_Block.LastRow = m_ProfileRows[NbProfiles - 1];
+   m_Block.OpenRow = GetProfileRow(m_NbProfilesRasterized + NbProfiles) == m_Block.LastRow ? m_Block.LastRow : -1;
+   m_Block.pRing = &Ring;
+
+   // Split the rows in tiles.
+   MIL_INT64 NbRows = m_Block.LastRow - m_Block.FirstRow + 1;
+   MIL_INT64 NbWorkers = (MIL_INT64)m_Scratch.size();
+   m_Block.TileRows = (NbRows + NbWorkers - 1) / NbWorkers;
+   if(m_Block.TileRows < MIN_TILE_ROWS)
+      m_Block.TileRows = MIN_TILE_ROWS;
+   MIL_INT NbTiles = (MIL_INT)((NbRows + m_Block.TileRows - 1) / m_Block.TileRows);
+
+   // Rasterize the rows of the profiles, then interpolate the rows between
+   // them, which need the completed rows of the neighbor tiles.
+   RunTiles(RASTERIZE_PASS, NbTiles);
+   if(m_RowsPerProfile > 1.0)
+      RunTiles(INTERPOLATE_PASS, NbTiles);
+
+   m_NbProfilesRasterized += NbProfiles;
+   m_OpenRow = m_Block.OpenRow;
+   m_NextRow = m_OpenRow >= 0 ? m_OpenRow : m_Block.LastRow + 1;
+   m_OpenAccumulator = 1 - m_OpenAccumulator;
+   return SPRowRange(m_Block.FirstRow, m_Block.LastRow + 1);
+   }
+
+//*****************************************************************************
+// RunTiles. Runs a pass over the tiles of the current block on the worker
+//           pool, or in the calling thread if there is no pool.
+//*****************************************************************************
+void CDepthMapRasterizer::RunTiles(ETilePass Pass, MIL_INT NbTiles)
+   {
+   m_TilePass = Pass;
+   if(m_pWorkerPool)
+      m_pWorkerPool->Run(*this, NbTiles);
+   else
+      {
+      for(MIL_INT Tile = 0; Tile < NbTiles; Tile++)
+         RunItem(Tile, 0);
+      }
+   }
+
+//*****************************************************************************
+// RunItem. Runs the current pass on a tile of rows of the current block.
+//*****************************************************************************
+void CDepthMapRasterizer::RunItem(MIL_INT Tile, MIL_INT Worker)
+   {
+   MIL_INT64 TileFirstRow = m_Block.FirstRow + Tile * m_Block.TileRows;
+   MIL_INT64 TileEndRow = TileFirstRow + m_Block.TileRows;
+   if(TileEndRow > m_Block.LastRow + 1)
+      TileEndRow = m_Block.LastRow + 1;
+
+   if(m_TilePass == RASTERIZE_PASS)
+      RasterizeTile(TileFirstRow, TileEndRow, m_Scratch[Worker]);
+   else
+      InterpolateTile(TileFirstRow, TileEndRow);
+   }
+
+//*****************************************************************************
+// RasterizeTile. Rasterizes the profiles of a tile of rows. The open row of
+//                the previous block keeps its content; the other rows are
+//                cleared before their profiles are combined. The rows
+//                without profile are left to the interpolation. All the
+//                rows but the open row of the block are completed.
+//*****************************************************************************
+void CDepthMapRasterizer::RasterizeTile(MIL_INT64 TileFirstRow, MIL_INT64 TileEndRow, SPWorkerScratch& Scratch)
+   {
+   // Find the first profile of the tile.
+   MIL_INT Profile = (MIL_INT)(std::lower_bound(m_ProfileRows.begin(), m_ProfileRows.end(), TileFirstRow) -
+                               m_ProfileRows.begin());
+
+   bool IsMean = (m_CellPolicy == CELL_MEAN_Z);
+   for(MIL_INT64 Row = TileFirstRow; Row < TileEndRow; Row++)
+      {
+      bool HasProfiles = Profile < m_Block.NbProfiles && m_ProfileRows[Profile] == Row;
+      if(!HasProfiles && Row != m_OpenRow)
+         continue;
+
+      MIL_UINT16* pRow = m_Block.pRing->GetRow(Row);
+      if(Row == m_OpenRow)
+         {
+         if(IsMean)
+            {
+            Scratch.Sums = m_OpenSums[m_OpenAccumulator];
+            Scratch.Counts = m_OpenCounts[m_OpenAccumulator];
+            }
+         }
+      else
+         {
+         ClearDepthRow(pRow, m_Grid.SizeX);
+         if(IsMean)
+            {
+            std::fill(Scratch.Sums.begin(), Scratch.Sums.end(), 0);
+            std::fill(Scratch.Counts.begin(), Scratch.Counts.end(), 0);
+            }
+         }
+
+      for(; Profile < m_Block.NbProfiles && m_ProfileRows[Profile] == Row; Profile++)
+         ScatterProfile(Profile, pRow, Scratch);
+
+      if(IsMean)
+         ResolveMeanZ(&Scratch.Sums[0], &Scratch.Counts[0], m_Grid.SizeX, pRow);
+      if(Row != m_Block.OpenRow)
+         FillDepthRowGaps(pRow, m_Grid.SizeX, m_MaxFillGap);
+      else if(IsMean)
+         {
+         m_OpenSums[1 - m_OpenAccumulator] = Scratch.Sums;
+         m_OpenCounts[1 - m_OpenAccumulator] = Scratch.Counts;
+         }
+      }
+   }
+
+//*****************************************************************************
+// InterpolateTile. Interpolates the rows of a tile that have no profile
+//                  between the rows of the previous and the next profiles.
+//                  The previous profile can be in the previous block.
+//*****************************************************************************
+void CDepthMapRasterizer::InterpolateTile(MIL_INT64 TileFirstRow, MIL_INT64 TileEndRow)
+   {
+   MIL_INT Profile = (MIL_INT)(std::lower_bound(m_ProfileRows.begin(), m_ProfileRows.end(), TileFirstRow) -
+                               m_ProfileRows.begin());
+   for(MIL_INT64 Row = TileFirstRow; Row < TileEndRow; Row++)
+      {
+      if(m_ProfileRows[Profile] == Row)
+         {
+         Profile++;
+         continue;
+         }
+      MIL_INT64 NextRow = m_ProfileRows[Profile];
+      MIL_INT64 PrevRow = Profile > 0 ? m_ProfileRows[Profile - 1] : GetProfileRow(m_NbProfilesRasterized - 1);
+      MIL_UINT32 Weight = (MIL_UINT32)(((Row - PrevRow) * INTERPOLATION_WEIGHT_ONE + (NextRow - PrevRow) / 2) /
+                                       (NextRow - PrevRow));
+      m_InterpolateRow(m_Block.pRing->GetRow(PrevRow), m_Block.pRing->GetRow(NextRow),
+                       m_Block.pRing->GetRow(Row), m_Grid.SizeX, Weight);
+      }
+   }
+
+//*****************************************************************************
+// ScatterProfile. Quantizes a profile of the block and combines its points
+//                 in a row according to the cell policy.
+//*****************************************************************************
+void CDepthMapRasterizer::ScatterProfile(MIL_INT Profile, MIL_UINT16* pRow, SPWorkerScratch& Scratch)
+   {
+   if(!m_Block.pX)
+      return;
+
+   MIL_INT Size = m_Block.ProfileSize;
+   MIL_INT Offset = Profile * Size;
+   MIL_INT32* pCells = &Scratch.Cells[0];
+   MIL_INT32* pDepths = &Scratch.Depths[0];
+   m_QuantizeRow(m_Block.pX + Offset, m_Block.pZ + Offset, m_Block.pMask ? m_Block.pMask + Offset : M_NULL,
+                 pCells, pDepths, Size, m_Params);
+
+   switch(m_CellPolicy)
+      {
+      case CELL_MIN_Z:        ScatterMinZ(pCells, pDepths, Size, pRow); break;
+      case CELL_MEAN_Z:       AccumulateMeanZ(pCells, pDepths, Size, &Scratch.Sums[0], &Scratch.Counts[0]); break;
+      case CELL_LAST_WRITTEN: ScatterLastWritten(pCells, pDepths, Size, pRow); break;
+      default:                ScatterMaxZ(pCells, pDepths, Size, pRow); break;
+      }
+   }
@@ -0,0 +1,163 @@
+﻿/************************************************************************************/
+/*
+* File name: DepthMapRasterizer.h
+*
+* Synopsis:  This file contains the declaration of the CDepthMapRasterizer class that
+*            writes the 3d points of the profiles directly in a calibrated 16 bits
+*            depth map. The profiles form an organized grid, ordered along Y, so
+*            the points do not need to go through a point cloud container and
+*            only the rows touched by a block of profiles are updated.
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+
+#ifndef DEPTH_MAP_RASTERIZER_H
+#define DEPTH_MAP_RASTERIZER_H
+
+#include <vector>
+#include "ProfileKernels.h"
+#include "WorkerPool.h"
+
+//*****************************************************************************
+// Structure defining the grid and the calibration of a depth map.
+//*****************************************************************************
+struct SPDepthMapGrid
+   {
+   MIL_INT    SizeX;
+   MIL_INT    SizeY;
+   MIL_DOUBLE WorldPosX;
+   MIL_DOUBLE WorldPosY;
+   MIL_DOUBLE PixelSizeX;
+   MIL_DOUBLE PixelSizeY;
+   MIL_DOUBLE WorldPosZ;
+   MIL_DOUBLE GrayLevelSizeZ;
+   };
+
+//*****************************************************************************
+// Structure defining a range of depth map rows, from First to End
+// (excluded). The rows are indexed from the beginning of the scan.
+//*****************************************************************************
+struct SPRowRange
+   {
+   SPRowRange(): First(0), End(0) {};
+   SPRowRange(MIL_INT64 FirstRow, MIL_INT64 EndRow): First(FirstRow), End(EndRow) {};
+   bool IsEmpty() const { return End <= First; }
+
+   MIL_INT64 First;
+   MIL_INT64 End;
+   };
+
+//*****************************************************************************
+// Policies combining the points that fall in the same depth map cell.
+//*****************************************************************************
+enum ECellPolicy
+   {
+   CELL_MAX_Z = 0,      // Highest point, like M3dmapExtract. For the tops of the parts.
+   CELL_MIN_Z,          // Lowest point.
+   CELL_MEAN_Z,         // Mean of the points. Reduces the noise.
+   CELL_LAST_WRITTEN,   // Last point, in the scan order.
+   NB_CELL_POLICIES
+   };
+
+void CalibrateDepthMap(MIL_ID MilDepthMap, const SPDepthMapGrid& Grid);
+MIL_CONST_TEXT_PTR GetCellPolicyName(ECellPolicy CellPolicy);
+
+class CDepthMapRing;
+
+//*****************************************************************************
+// Class that rasterizes the blocks of profiles in a continuous depth map.
+//
+// The profiles are spaced by ProfileStepY in world Y and the grid can be
+// coarser or finer than the profiles in X and in Y. Each profile goes to the
+// row whose center is the closest. When the rows are coarser than the
+// profiles, several profiles share a row; a row is completed, its small
+// gaps filled, only when no later profile can go to it, so the last row of
+// a block can stay open and become the seam row of the next block. When the
+// rows are finer than the profiles, the rows between two profiles are
+// interpolated between them.
+//
+// The rows touched by a block are split in tiles of consecutive rows that
+// are rasterized in parallel by the workers of a pool. Each cell belongs to
+// a single tile, so the tiles do not need any lock.
+//*****************************************************************************
+class CDepthMapRasterizer : private CParallelTask
+   {
+   public:
+      CDepthMapRasterizer(const SPDepthMapGrid& Grid, MIL_DOUBLE ProfileStepY, ECellPolicy CellPolicy,
+                          MIL_INT MaxFillGap, CWorkerPool* pWorkerPool);
+      virtual ~CDepthMapRasterizer();
+
+      void SetKernels(PQuantizeRow QuantizeRow, PInterpolateRow InterpolateRow);
+      SPRowRange Rasterize(const MIL_FLOAT* pX, const MIL_FLOAT* pZ, const MIL_UINT8* pMask,
+                           MIL_INT ProfileSize, MIL_INT NbProfiles, CDepthMapRing& Ring);
+
+      MIL_INT64 GetProfileRow(MIL_INT64 Profile) const;
+      MIL_INT GetMaxRowsPerBlock(MIL_INT NbProfiles) const;
+      MIL_INT64 GetNbCompletedRows() const { return m_NextRow; }
+      ECellPolicy GetCellPolicy() const { return m_CellPolicy; }
+      const SPDepthMapGrid& GetGrid() const { return m_Grid; }
+
+   private:
+      // Scratch memory of a worker.
+      struct SPWorkerScratch
+         {
+         std::vector<MIL_INT32>  Cells;
+         std::vector<MIL_INT32>  Depths;
+         std::vector<MIL_UINT32> Sums;
+         std::vector<MIL_UINT32> Counts;
+         };
+
+      // Block being rasterized.
+      struct SPBlock
+         {
+         const MIL_FLOAT* pX;
+         const MIL_FLOAT* pZ;
+         const MIL_UINT8* pMask;
+         MIL_INT          ProfileSize;
+         MIL_INT          NbProfiles;
+         MIL_INT64        FirstRow;
+         MIL_INT64        LastRow;
+         MIL_INT64        OpenRow;       // Last row if it stays open, otherwise -1.
+         MIL_INT64        TileRows;
+         CDepthMapRing*   pRing;
+         };
+
+      // Passes over the tiles.
+      enum ETilePass
+         {
+         RASTERIZE_PASS,
+         INTERPOLATE_PASS
+         };
+
+      virtual void RunItem(MIL_INT Tile, MIL_INT Worker);
+      void RunTiles(ETilePass Pass, MIL_INT NbTiles);
+      void RasterizeTile(MIL_INT64 TileFirstRow, MIL_INT64 TileEndRow, SPWorkerScratch& Scratch);
+      void InterpolateTile(MIL_INT64 TileFirstRow, MIL_INT64 TileEndRow);
+      void ScatterProfile(MIL_INT Profile, MIL_UINT16* pRow, SPWorkerScratch& Scratch);
+
+      SPDepthMapGrid  m_Grid;
+      SPRasterParams  m_Params;
+      PQuantizeRow    m_QuantizeRow;
+      PInterpolateRow m_InterpolateRow;
+      ECellPolicy     m_CellPolicy;
+      MIL_DOUBLE      m_RowsPerProfile;
+      MIL_INT         m_MaxFillGap;
+      CWorkerPool*    m_pWorkerPool;
+      MIL_INT64       m_NbProfilesRasterized;
+      MIL_INT64       m_OpenRow;
+      MIL_INT64       m_NextRow;
+      ETilePass       m_TilePass;
+
+      SPBlock                      m_Block;
+      std::vector<MIL_INT64>       m_ProfileRows;
+      std::vector<SPWorkerScratch> m_Scratch;
+
+      // Sums and counts of the open row for the mean policy. They are double
+      // buffered because the tiles that read and write them run in parallel.
+      std::vector<MIL_UINT32> m_OpenSums[2];
+      std::vector<MIL_UINT32> m_OpenCounts[2];
+      MIL_INT                 m_OpenAccumulator;
+   };
+
+#endif // DEPTH_MAP_RASTERIZER_H
@@ -0,0 +1,122 @@
+﻿/************************************************************************************/
+/*
+* File name: DepthMapRing.cpp
+*
+* Synopsis:  This file contains the implementation of the CDepthMapRing class that
+*            holds a continuous depth map of the last rows scanned in a ring
+*            buffer.
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+#include <mil.h>
+#include <string.h>
+#include "DepthMapRing.h"
+
+//*****************************************************************************
+// Constructor. Allocates the ring buffer and its mirrored rows.
+//*****************************************************************************
+CDepthMapRing::CDepthMapRing(MIL_ID MilSystem, const SPDepthMapGrid& Grid, MIL_INT Length, MIL_INT MaxWindowLength)
+   : m_Grid(Grid),
+     m_Length(Length),
+     m_MaxWindowLength(MaxWindowLength < Length ? MaxWindowLength : Length),
+     m_NbRowsWritten(0)
+   {
+   m_Grid.SizeY = Length;
+   MbufAlloc2d(MilSystem, Grid.SizeX, m_Length + m_MaxWindowLength, 16 + M_UNSIGNED,
+               M_IMAGE + M_PROC + M_DISP, &m_MilRingBuffer);
+   MbufClear(m_MilRingBuffer, INVALID_DEPTH);
+   m_pData = (MIL_UINT16*)MbufInquire(m_MilRingBuffer, M_HOST_ADDRESS, M_NULL);
+   m_Pitch = MbufInquire(m_MilRingBuffer, M_PITCH, M_NULL);
+   }
+
+//*****************************************************************************
+// Destructor.
+//*****************************************************************************
+CDepthMapRing::~CDepthMapRing()
+   {
+   MbufFree(m_MilRingBuffer);
+   }
+
+//*****************************************************************************
+// GetRow. Gets the address of a row in the ring buffer. The row must not be
+//         older than the first available row.
+//*****************************************************************************
+MIL_UINT16* CDepthMapRing::GetRow(MIL_INT64 Row) const
+   {
+   return m_pData + (MIL_INT)(Row % m_Length) * m_Pitch;
+   }
+
+//*****************************************************************************
+// CommitRows. Completes the writing of a range of rows. The first rows of
+//             the ring are copied to the mirrored rows so that the windows
+//             that wrap around see them.
+//*****************************************************************************
+void CDepthMapRing::CommitRows(const SPRowRange& Rows)
+   {
+   for(MIL_INT64 Row = Rows.First; Row < Rows.End; Row++)
+      {
+      MIL_INT r = (MIL_INT)(Row % m_Length);
+      if(r < m_MaxWindowLength)
+         CopyRow(r, r + m_Length);
+      }
+   if(Rows.End > m_NbRowsWritten)
+      m_NbRowsWritten = Rows.End;
+   }
+
+//*****************************************************************************
+// GetFirstAvailableRow. Gets the oldest row still in the ring.
+//*****************************************************************************
+MIL_INT64 CDepthMapRing::GetFirstAvailableRow() const
+   {
+   return m_NbRowsWritten > m_Length ? m_NbRowsWritten - m_Length : 0;
+   }
+
+//*****************************************************************************
+// AllocWindow. Allocates a window of NbRows rows on the ring buffer. The
+//              window is a child buffer moved with MoveWindow().
+//*****************************************************************************
+MIL_ID CDepthMapRing::AllocWindow(MIL_INT NbRows) const
+   {
+   MIL_INT WindowLength = NbRows < m_MaxWindowLength ? NbRows : m_MaxWindowLength;
+   MIL_ID MilWindow = MbufChild2d(m_MilRingBuffer, 0, 0, m_Grid.SizeX, WindowLength, M_NULL);
+   CalibrateDepthMap(MilWindow, m_Grid);
+   return MilWindow;
+   }
+
+//*****************************************************************************
+// MoveWindow. Moves a window on the rows starting at FirstRow and calibrates
+//             it at their world position. Returns false if the rows are not
+//             available. Before the ring is full, the rows not yet written
+//             are available and invalid.
+//*****************************************************************************
+bool CDepthMapRing::MoveWindow(MIL_ID MilWindow, MIL_INT64 FirstRow, MIL_INT NbRows) const
+   {
+   MIL_INT64 EndRow = m_NbRowsWritten > m_Length ? m_NbRowsWritten : m_Length;
+   if(NbRows > m_MaxWindowLength || FirstRow < GetFirstAvailableRow() || FirstRow + NbRows > EndRow)
+      return false;
+
+   MbufChildMove(MilWindow, 0, (MIL_INT)(FirstRow % m_Length), m_Grid.SizeX, NbRows, M_DEFAULT);
+   SPDepthMapGrid WindowGrid = m_Grid;
+   WindowGrid.SizeY = NbRows;
+   WindowGrid.WorldPosY = m_Grid.WorldPosY + FirstRow * m_Grid.PixelSizeY;
+   CalibrateDepthMap(MilWindow, WindowGrid);
+   return true;
+   }
+
+//*****************************************************************************
+// MoveWindowToLast. Moves a window on the last rows written.
+//*****************************************************************************
+bool CDepthMapRing::MoveWindowToLast(MIL_ID MilWindow, MIL_INT NbRows) const
+   {
+   MIL_INT64 FirstRow = m_NbRowsWritten - NbRows;
+   return MoveWindow(MilWindow, FirstRow > 0 ? FirstRow : 0, NbRows);
+   }
+
+//*****************************************************************************
+// CopyRow. Copies a row of the ring buffer.
+//*****************************************************************************
+void CDepthMapRing::CopyRow(MIL_INT SrcRow, MIL_INT DstRow)
+   {
+   memcpy(m_pData + DstRow * m_Pitch, m_pData + SrcRow * m_Pitch, m_Grid.SizeX * sizeof(MIL_UINT16));
+   }
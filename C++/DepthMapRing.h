@@ -0,0 +1,67 @@
+﻿/************************************************************************************/
+/*
+* File name: DepthMapRing.h
+*
+* Synopsis:  This file contains the declaration of the CDepthMapRing class that holds
+*            a continuous depth map of the last rows scanned in a ring buffer. The
+*            rows touched by the blocks of profiles are written in place and any
+*            window of recent rows can be read as a contiguous child buffer.
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+
+#ifndef DEPTH_MAP_RING_H
+#define DEPTH_MAP_RING_H
+
+#include "DepthMapRasterizer.h"
+
+//*****************************************************************************
+// Class holding a continuous depth map in a ring buffer.
+//
+// The ring keeps the last Length rows. The buffer has MaxWindowLength extra
+// rows after the ring that mirror its first rows, so that any window of at
+// most MaxWindowLength rows is contiguous in memory even when it wraps
+// around the end of the ring.
+//
+// The rows are identified by their index since the beginning of the scan.
+// The world Y position of a row is Grid.WorldPosY + Row * Grid.PixelSizeY.
+// The rows are written with GetRow() and committed with CommitRows(), which
+// updates their mirrored copies. A committed row can be written again, for
+// example the seam row shared by two blocks, as long as it is in the ring.
+//*****************************************************************************
+class CDepthMapRing
+   {
+   public:
+      CDepthMapRing(MIL_ID MilSystem, const SPDepthMapGrid& Grid, MIL_INT Length, MIL_INT MaxWindowLength);
+      virtual ~CDepthMapRing();
+
+      // Writing of the rows.
+      MIL_UINT16* GetRow(MIL_INT64 Row) const;
+      void CommitRows(const SPRowRange& Rows);
+      MIL_ID GetBuffer() const { return m_MilRingBuffer; }
+
+      // Reading of the windows.
+      MIL_INT64 GetNbRowsWritten() const { return m_NbRowsWritten; }
+      MIL_INT64 GetFirstAvailableRow() const;
+      MIL_ID AllocWindow(MIL_INT NbRows) const;
+      bool MoveWindow(MIL_ID MilWindow, MIL_INT64 FirstRow, MIL_INT NbRows) const;
+      bool MoveWindowToLast(MIL_ID MilWindow, MIL_INT NbRows) const;
+
+      MIL_INT GetLength() const { return m_Length; }
+      MIL_INT GetMaxWindowLength() const { return m_MaxWindowLength; }
+      const SPDepthMapGrid& GetGrid() const { return m_Grid; }
+
+   private:
+      void CopyRow(MIL_INT SrcRow, MIL_INT DstRow);
+
+      MIL_ID         m_MilRingBuffer;
+      SPDepthMapGrid m_Grid;
+      MIL_INT        m_Length;
+      MIL_INT        m_MaxWindowLength;
+      MIL_INT64      m_NbRowsWritten;
+      MIL_UINT16*    m_pData;
+      MIL_INT        m_Pitch;
+   };
+
+#endif // DEPTH_MAP_RING_H
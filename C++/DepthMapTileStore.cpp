@@ -0,0 +1,455 @@
+﻿/************************************************************************************/
+/*
+* File name: DepthMapTileStore.cpp
+*
+* Synopsis:  This file contains the implementation of the CDepthMapTileStore class
+*            that keeps the tiles of a long scan compressed in a memory mapped
+*            spill file.
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+#include <mil.h>
+#include <string.h>
+#include "DepthMapTileStore.h"
+
+#if M_MIL_USE_WINDOWS
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+//*****************************************************************************
+// Constants.
+//*****************************************************************************
+
+// Size of the segments in which the spill file is mapped.
+static const MIL_INT64 SPILL_SEGMENT_SIZE = 64 * 1024 * 1024; // in bytes
+
+// Number of segments mapped at the same time: the segment being written and
+// the last segments read.
+static const size_t MAX_MAPPED_SEGMENTS = 4;
+
+// Largest code of a cell: a difference of 17 bits and a flag bit.
+static const MIL_INT MAX_CELL_CODE_BYTES = 3;
+
+//*****************************************************************************
+// Spill file functions.
+//*****************************************************************************
+#if M_MIL_USE_WINDOWS
+static MIL_INT64 OpenSpillFile(MIL_CONST_TEXT_PTR FileName)
+   {
+   HANDLE File = CreateFile(FileName, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                            FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+   return File != INVALID_HANDLE_VALUE ? (MIL_INT64)File : -1;
+   }
+
+static bool ResizeSpillFile(MIL_INT64 File, MIL_INT64 Bytes)
+   {
+   LARGE_INTEGER Size;
+   Size.QuadPart = Bytes;
+   return SetFilePointerEx((HANDLE)File, Size, NULL, FILE_BEGIN) && SetEndOfFile((HANDLE)File);
+   }
+
+static MIL_UINT8* MapSpillFile(MIL_INT64 File, MIL_INT64 Offset, MIL_INT64 Bytes)
+   {
+   // The view keeps the mapping object alive.
+   HANDLE Mapping = CreateFileMapping((HANDLE)File, NULL, PAGE_READWRITE, 0, 0, NULL);
+   if(!Mapping)
+      return M_NULL;
+   void* pData = MapViewOfFile(Mapping, FILE_MAP_ALL_ACCESS, (DWORD)(Offset >> 32), (DWORD)Offset, (SIZE_T)Bytes);
+   CloseHandle(Mapping);
+   return (MIL_UINT8*)pData;
+   }
+
+static void UnmapSpillFile(MIL_UINT8* pData, MIL_INT64 Bytes)
+   {
+   UnmapViewOfFile(pData);
+   }
+
+static void CloseSpillFile(MIL_INT64 File)
+   {
+   CloseHandle((HANDLE)File);
+   }
+#else
+static MIL_INT64 OpenSpillFile(MIL_CONST_TEXT_PTR FileName)
+   {
+   // The file is unlinked at once so that it is deleted when it is closed.
+   int File = open(FileName, O_RDWR | O_CREAT | O_TRUNC, 0600);
+   if(File >= 0)
+      unlink(FileName);
+   return File;
+   }
+
+static bool ResizeSpillFile(MIL_INT64 File, MIL_INT64 Bytes)
+   {
+   // Allocate the blocks of the file, so that a full disk fails here instead
+   // of on the first write to the mapped pages.
+   return posix_fallocate((int)File, 0, (off_t)Bytes) == 0;
+   }
+
+static MIL_UINT8* MapSpillFile(MIL_INT64 File, MIL_INT64 Offset, MIL_INT64 Bytes)
+   {
+   void* pData = mmap(NULL, (size_t)Bytes, PROT_READ | PROT_WRITE, MAP_SHARED, (int)File, (off_t)Offset);
+   return pData != MAP_FAILED ? (MIL_UINT8*)pData : M_NULL;
+   }
+
+static void UnmapSpillFile(MIL_UINT8* pData, MIL_INT64 Bytes)
+   {
+   munmap(pData, (size_t)Bytes);
+   }
+
+static void CloseSpillFile(MIL_INT64 File)
+   {
+   close((int)File);
+   }
+#endif
+
+//*****************************************************************************
+// Row codec. A code is a variable length integer, 7 bits per byte. Its low
+// bit is 0 for the zigzag coded difference with the previous cell and 1 for
+// a run of cells equal to the previous cell.
+//*****************************************************************************
+static MIL_UINT8* PutCode(MIL_UINT8* pDst, MIL_UINT32 Code)
+   {
+   while(Code >= 0x80)
+      {
+      *pDst++ = (MIL_UINT8)(Code | 0x80);
+      Code >>= 7;
+      }
+   *pDst++ = (MIL_UINT8)Code;
+   return pDst;
+   }
+
+static const MIL_UINT8* GetCode(const MIL_UINT8* pSrc, MIL_UINT32& Code)
+   {
+   Code = 0;
+   for(MIL_UINT32 Shift = 0; ; Shift += 7)
+      {
+      MIL_UINT8 Byte = *pSrc++;
+      Code |= (MIL_UINT32)(Byte & 0x7F) << Shift;
+      if(!(Byte & 0x80))
+         return pSrc;
+      }
+   }
+
+static MIL_UINT8* EncodeDepthRow(const MIL_UINT16* pRow, MIL_INT SizeX, MIL_UINT8* pDst)
+   {
+   MIL_INT32 Prev = 0;
+   MIL_INT x = 0;
+   while(x < SizeX)
+      {
+      if(pRow[x] == Prev)
+         {
+         MIL_INT Run = 1;
+         while(x + Run < SizeX && pRow[x + Run] == Prev)
+            Run++;
+         pDst = PutCode(pDst, ((MIL_UINT32)Run << 1) | 1);
+         x += Run;
+         }
+      else
+         {
+         MIL_INT32 Diff = (MIL_INT32)pRow[x] - Prev;
+         MIL_UINT32 ZigZag = ((MIL_UINT32)Diff << 1) ^ (MIL_UINT32)(Diff >> 31);
+         pDst = PutCode(pDst, ZigZag << 1);
+         Prev = pRow[x];
+         x++;
+         }
+      }
+   return pDst;
+   }
+
+static const MIL_UINT8* DecodeDepthRow(const MIL_UINT8* pSrc, MIL_INT SizeX, MIL_UINT16* pRow)
+   {
+   MIL_INT32 Prev = 0;
+   MIL_INT x = 0;
+   while(x < SizeX)
+      {
+      MIL_UINT32 Code;
+      pSrc = GetCode(pSrc, Code);
+      if(Code & 1)
+         {
+         for(MIL_UINT32 r = 0; r < (Code >> 1) && x < SizeX; r++)
+            pRow[x++] = (MIL_UINT16)Prev;
+         }
+      else
+         {
+         MIL_UINT32 ZigZag = Code >> 1;
+         Prev += (MIL_INT32)(ZigZag >> 1) ^ -(MIL_INT32)(ZigZag & 1);
+         pRow[x++] = (MIL_UINT16)Prev;
+         }
+      }
+   return pSrc;
+   }
+
+//*****************************************************************************
+// Constructor. Creates the spill file. Grid.SizeY is the number of rows of
+//              the ring of the depth map, which must hold a whole tile.
+//              IsOpen() is false if the tiles do not fit in the ring or if
+//              the file could not be created.
+//*****************************************************************************
+CDepthMapTileStore::CDepthMapTileStore(MIL_ID MilSystem, const SPDepthMapGrid& Grid, MIL_INT TileRows,
+                                       MIL_CONST_TEXT_PTR SpillFileName)
+   : m_Grid(Grid),
+     m_TileRows(TileRows),
+     m_FileSize(0),
+     m_WriteOffset(0),
+     m_NbRowsStored(0),
+     m_IsFull(false),
+     m_IsFlushed(false),
+     m_NbSegmentUses(0)
+   {
+   m_Grid.SizeY = TileRows;
+
+   // A segment must hold the largest compressed tile.
+   MIL_INT MaxTileBytes = TileRows * Grid.SizeX * MAX_CELL_CODE_BYTES;
+   m_SegmentSize = SPILL_SEGMENT_SIZE;
+   while(m_SegmentSize < MaxTileBytes)
+      m_SegmentSize *= 2;
+   m_Encoded.resize(MaxTileBytes);
+
+   m_FileHandle = (TileRows > 0 && TileRows <= Grid.SizeY) ? OpenSpillFile(SpillFileName) : INVALID_SPILL_FILE;
+   MthrAlloc(MilSystem, M_MUTEX, M_DEFAULT, M_NULL, M_NULL, &m_MilMutex);
+   }
+
+//*****************************************************************************
+// Destructor. Unmaps and deletes the spill file.
+//*****************************************************************************
+CDepthMapTileStore::~CDepthMapTileStore()
+   {
+   for(size_t s = 0; s < m_Segments.size(); s++)
+      UnmapSpillFile(m_Segments[s].pData, m_SegmentSize);
+   if(IsOpen())
+      CloseSpillFile(m_FileHandle);
+   MthrFree(m_MilMutex);
+   }
+
+//*****************************************************************************
+// Append. Stores the tiles whose rows are all final. The rows of the tiles
+//         must still be in the ring. Once the spill file cannot grow, the
+//         next tiles are not stored.
+//*****************************************************************************
+void CDepthMapTileStore::Append(const CDepthMapRing& Ring, MIL_INT64 NbFinalRows)
+   {
+   if(!IsOpen() || m_IsFlushed)
+      return;
+   while(!m_IsFull && m_NbRowsStored + m_TileRows <= NbFinalRows)
+      {
+      StoreTile(Ring, m_NbRowsStored, m_TileRows);
+      m_NbRowsStored += m_TileRows;
+      }
+   }
+
+//*****************************************************************************
+// Flush. Stores the tiles of the final rows at the end of the scan. The last
+//        rows that do not fill a tile are stored in a shorter tile. No rows
+//        are stored afterwards.
+//*****************************************************************************
+void CDepthMapTileStore::Flush(const CDepthMapRing& Ring, MIL_INT64 NbFinalRows)
+   {
+   Append(Ring, NbFinalRows);
+   if(!IsOpen() || m_IsFlushed)
+      return;
+   if(!m_IsFull && m_NbRowsStored < NbFinalRows)
+      {
+      MIL_INT NbRows = (MIL_INT)(NbFinalRows - m_NbRowsStored);
+      StoreTile(Ring, m_NbRowsStored, NbRows);
+      m_NbRowsStored += NbRows;
+      }
+   m_IsFlushed = true;
+   }
+
+//*****************************************************************************
+// StoreTile. Compresses the NbRows rows of a tile and appends them to the
+//            spill file. A tile does not cross the end of a segment.
+//*****************************************************************************
+void CDepthMapTileStore::StoreTile(const CDepthMapRing& Ring, MIL_INT64 FirstRow, MIL_INT NbRows)
+   {
+   // Compress the tile outside of the lock.
+   MIL_UINT8* pEnd = &m_Encoded[0];
+   for(MIL_INT r = 0; r < NbRows; r++)
+      pEnd = EncodeDepthRow(Ring.GetRow(FirstRow + r), m_Grid.SizeX, pEnd);
+   MIL_INT Bytes = (MIL_INT)(pEnd - &m_Encoded[0]);
+
+   Lock();
+   MIL_INT64 Segment = m_WriteOffset / m_SegmentSize;
+   if(m_WriteOffset + Bytes > (Segment + 1) * m_SegmentSize)
+      {
+      Segment++;
+      m_WriteOffset = Segment * m_SegmentSize;
+      }
+   if(m_FileSize < (Segment + 1) * m_SegmentSize)
+      {
+      if(ResizeSpillFile(m_FileHandle, (Segment + 1) * m_SegmentSize))
+         m_FileSize = (Segment + 1) * m_SegmentSize;
+      else
+         m_IsFull = true;
+      }
+
+   // The tiles are numbered in order, so a tile that cannot be written
+   // stops the store.
+   MIL_UINT8* pSegment = m_IsFull ? M_NULL : GetSegment(Segment);
+   if(!pSegment)
+      {
+      m_IsFull = true;
+      MosPrintf(MIL_TEXT("The spill file of the depth map tiles is full. The next tiles are not stored.\n"));
+      }
+   else
+      {
+      memcpy(pSegment + (m_WriteOffset - Segment * m_SegmentSize), &m_Encoded[0], Bytes);
+      SPTileEntry Entry;
+      Entry.Offset = m_WriteOffset;
+      Entry.Bytes = Bytes;
+      Entry.NbRows = NbRows;
+      m_Tiles.push_back(Entry);
+      m_WriteOffset += Bytes;
+      }
+   Unlock();
+   }
+
+//*****************************************************************************
+// GetSegment. Gets the address of a segment of the spill file, mapping it
+//             if needed in place of the least recently used one.
+//*****************************************************************************
+MIL_UINT8* CDepthMapTileStore::GetSegment(MIL_INT64 Index) const
+   {
+   m_NbSegmentUses++;
+   size_t Oldest = 0;
+   for(size_t s = 0; s < m_Segments.size(); s++)
+      {
+      if(m_Segments[s].Index == Index)
+         {
+         m_Segments[s].LastUse = m_NbSegmentUses;
+         return m_Segments[s].pData;
+         }
+      if(m_Segments[s].LastUse < m_Segments[Oldest].LastUse)
+         Oldest = s;
+      }
+
+   MIL_UINT8* pData = MapSpillFile(m_FileHandle, Index * m_SegmentSize, m_SegmentSize);
+   if(!pData)
+      return M_NULL;
+
+   SPMappedSegment Segment;
+   Segment.Index = Index;
+   Segment.pData = pData;
+   Segment.LastUse = m_NbSegmentUses;
+   if(m_Segments.size() < MAX_MAPPED_SEGMENTS)
+      m_Segments.push_back(Segment);
+   else
+      {
+      UnmapSpillFile(m_Segments[Oldest].pData, m_SegmentSize);
+      m_Segments[Oldest] = Segment;
+      }
+   return pData;
+   }
+
+//*****************************************************************************
+// GetNbTiles. Gets the number of tiles stored.
+//*****************************************************************************
+MIL_INT64 CDepthMapTileStore::GetNbTiles() const
+   {
+   Lock();
+   MIL_INT64 NbTiles = (MIL_INT64)m_Tiles.size();
+   Unlock();
+   return NbTiles;
+   }
+
+//*****************************************************************************
+// AllocTile. Allocates a buffer that can receive a tile.
+//*****************************************************************************
+MIL_ID CDepthMapTileStore::AllocTile(MIL_ID MilSystem) const
+   {
+   MIL_ID MilTile = MbufAlloc2d(MilSystem, m_Grid.SizeX, m_TileRows, 16 + M_UNSIGNED, M_IMAGE + M_PROC, M_NULL);
+   CalibrateDepthMap(MilTile, m_Grid);
+   return MilTile;
+   }
+
+//*****************************************************************************
+// GetTile. Decompresses a tile in a buffer allocated by AllocTile() and
+//          calibrates the buffer at the world position of the tile. The
+//          rows past the end of the last, shorter tile are invalid.
+//          Returns false if the tile is not stored yet.
+//*****************************************************************************
+bool CDepthMapTileStore::GetTile(MIL_INT64 Tile, MIL_ID MilTile) const
+   {
+   MIL_UINT16* pData = (MIL_UINT16*)MbufInquire(MilTile, M_HOST_ADDRESS, M_NULL);
+   MIL_INT Pitch = MbufInquire(MilTile, M_PITCH, M_NULL);
+
+   Lock();
+   bool Stored = Tile >= 0 && Tile < (MIL_INT64)m_Tiles.size();
+   if(Stored)
+      {
+      const SPTileEntry& Entry = m_Tiles[(size_t)Tile];
+      MIL_INT64 Segment = Entry.Offset / m_SegmentSize;
+      const MIL_UINT8* pSrc = GetSegment(Segment);
+      Stored = pSrc != M_NULL;
+      if(Stored)
+         {
+         pSrc += Entry.Offset - Segment * m_SegmentSize;
+         for(MIL_INT r = 0; r < Entry.NbRows; r++)
+            pSrc = DecodeDepthRow(pSrc, m_Grid.SizeX, pData + r * Pitch);
+         for(MIL_INT r = Entry.NbRows; r < m_TileRows; r++)
+            for(MIL_INT x = 0; x < m_Grid.SizeX; x++)
+               pData[r * Pitch + x] = INVALID_DEPTH;
+         }
+      }
+   Unlock();
+   if(!Stored)
+      return false;
+
+   SPDepthMapGrid TileGrid = m_Grid;
+   TileGrid.WorldPosY = m_Grid.WorldPosY + Tile * m_TileRows * m_Grid.PixelSizeY;
+   CalibrateDepthMap(MilTile, TileGrid);
+   MbufControl(MilTile, M_MODIFIED, M_DEFAULT);
+   return true;
+   }
+
+//*****************************************************************************
+// GetStoredBytes. Gets the size of the compressed tiles.
+//*****************************************************************************
+MIL_INT64 CDepthMapTileStore::GetStoredBytes() const
+   {
+   Lock();
+   MIL_INT64 Bytes = 0;
+   for(size_t t = 0; t < m_Tiles.size(); t++)
+      Bytes += m_Tiles[t].Bytes;
+   Unlock();
+   return Bytes;
+   }
+
+//*****************************************************************************
+// GetNbRowsStored. Gets the number of rows of the stored tiles.
+//*****************************************************************************
+MIL_INT64 CDepthMapTileStore::GetNbRowsStored() const
+   {
+   Lock();
+   MIL_INT64 NbRows = 0;
+   for(size_t t = 0; t < m_Tiles.size(); t++)
+      NbRows += m_Tiles[t].NbRows;
+   Unlock();
+   return NbRows;
+   }
+
+//*****************************************************************************
+// GetRawBytes. Gets the size of the stored tiles before compression.
+//*****************************************************************************
+MIL_INT64 CDepthMapTileStore::GetRawBytes() const
+   {
+   return GetNbRowsStored() * m_Grid.SizeX * (MIL_INT64)sizeof(MIL_UINT16);
+   }
+
+//*****************************************************************************
+// Lock/Unlock. Protect the index and the mapped segments.
+//*****************************************************************************
+void CDepthMapTileStore::Lock() const
+   {
+   MthrControl(m_MilMutex, M_LOCK, M_DEFAULT);
+   }
+
+void CDepthMapTileStore::Unlock() const
+   {
+   MthrControl(m_MilMutex, M_UNLOCK, M_DEFAULT);
+   }
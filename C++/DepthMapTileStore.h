@@ -0,0 +1,103 @@
+﻿/************************************************************************************/
+/*
+* File name: DepthMapTileStore.h
+*
+* Synopsis:  This file contains the declaration of the CDepthMapTileStore class that
+*            keeps all the rows of a long scan out of core. The completed tiles of
+*            the continuous depth map are compressed and spilled to a memory
+*            mapped file, and any tile can be read back, calibrated, while the
+*            scan continues.
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+
+#ifndef DEPTH_MAP_TILE_STORE_H
+#define DEPTH_MAP_TILE_STORE_H
+
+#include <vector>
+#include "DepthMapRing.h"
+
+//*****************************************************************************
+// Class storing the tiles of a continuous depth map in a spill file.
+//
+// A tile is TileRows consecutive rows of the whole width of the depth map.
+// When the last row of a tile is final, the tile is compressed and appended
+// to the spill file. At the end of the scan, Flush() stores the final rows
+// that do not fill a whole tile as a last, shorter tile. The file is mapped in segments and only a few segments
+// are mapped at a time, so the memory used does not grow with the length of
+// the scan. The spill file is deleted when the store is freed.
+//
+// The tiles are compressed without loss: each row is coded as the
+// differences between consecutive cells, with variable length codes, and
+// the runs of equal cells, such as the invalid cells, as run lengths.
+//
+// The tiles can be read from another thread than the one that appends
+// them; the index and the mapped segments are protected by a MIL mutex.
+//*****************************************************************************
+class CDepthMapTileStore
+   {
+   public:
+      CDepthMapTileStore(MIL_ID MilSystem, const SPDepthMapGrid& Grid, MIL_INT TileRows,
+                         MIL_CONST_TEXT_PTR SpillFileName);
+      virtual ~CDepthMapTileStore();
+
+      bool IsOpen() const { return m_FileHandle != INVALID_SPILL_FILE; }
+      bool IsFull() const { return m_IsFull; }
+
+      // Writing of the final rows.
+      void Append(const CDepthMapRing& Ring, MIL_INT64 NbFinalRows);
+      void Flush(const CDepthMapRing& Ring, MIL_INT64 NbFinalRows);
+
+      // Reading of the tiles.
+      MIL_INT64 GetNbTiles() const;
+      MIL_ID AllocTile(MIL_ID MilSystem) const;
+      bool GetTile(MIL_INT64 Tile, MIL_ID MilTile) const;
+
+      MIL_INT GetTileRows() const { return m_TileRows; }
+      MIL_INT64 GetNbRowsStored() const;
+      MIL_INT64 GetStoredBytes() const;
+      MIL_INT64 GetRawBytes() const;
+
+   private:
+      static const MIL_INT64 INVALID_SPILL_FILE = -1;
+
+      // Compressed tile in the spill file.
+      struct SPTileEntry
+         {
+         MIL_INT64 Offset;
+         MIL_INT   Bytes;
+         MIL_INT   NbRows;
+         };
+
+      // Mapped segment of the spill file.
+      struct SPMappedSegment
+         {
+         MIL_INT64  Index;
+         MIL_UINT8* pData;
+         MIL_INT64  LastUse;
+         };
+
+      void StoreTile(const CDepthMapRing& Ring, MIL_INT64 FirstRow, MIL_INT NbRows);
+      MIL_UINT8* GetSegment(MIL_INT64 Index) const;
+      void Lock() const;
+      void Unlock() const;
+
+      SPDepthMapGrid m_Grid;
+      MIL_INT        m_TileRows;
+      MIL_INT64      m_SegmentSize;
+      MIL_INT64      m_FileHandle;
+      MIL_INT64      m_FileSize;
+      MIL_INT64      m_WriteOffset;
+      MIL_INT64      m_NbRowsStored;
+      bool           m_IsFull;
+      bool           m_IsFlushed;
+      MIL_ID         m_MilMutex;
+
+      std::vector<SPTileEntry>             m_Tiles;
+      std::vector<MIL_UINT8>               m_Encoded;
+      mutable std::vector<SPMappedSegment> m_Segments;
+      mutable MIL_INT64                    m_NbSegmentUses;
+   };
+
+#endif // DEPTH_MAP_TILE_STORE_H
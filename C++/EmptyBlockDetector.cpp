@@ -0,0 +1,118 @@
+﻿/************************************************************************************/
+/*
+* File name: EmptyBlockDetector.cpp
+*
+* Synopsis:  This file contains the implementation of the CEmptyBlockDetector class
+*            that classifies the blocks of raw profiles that only contain the empty
+*            belt.
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+#include <mil.h>
+#include "DataConversion.h"
+#include "EmptyBlockDetector.h"
+
+//*****************************************************************************
+// Constants.
+//*****************************************************************************
+
+// Largest code of the flipped X and Z codes.
+static const MIL_INT32 MAX_CODE = 65535;
+
+//*****************************************************************************
+// Constructor.
+//*****************************************************************************
+CEmptyBlockDetector::CEmptyBlockDetector(MIL_INT ProfileSize, MIL_INT NbProfiles, MIL_UINT16 InvalidCode,
+                                         const SPCal& PCal, bool FlipX, bool FlipZ,
+                                         const SPEmptyBlockSettings& Settings, CBeltReference* pBeltReference)
+   : m_ProfileSize(ProfileSize),
+     m_NbProfiles(NbProfiles),
+     m_InvalidCode(InvalidCode),
+     m_ScaleX((MIL_FLOAT)PCal.GrayLevelSX),
+     m_OffsetX((MIL_FLOAT)PCal.WorldX),
+     m_ScaleZ((MIL_FLOAT)PCal.GrayLevelSZ),
+     m_OffsetZ((MIL_FLOAT)PCal.WorldZ),
+     m_FlipX(FlipX),
+     m_FlipZ(FlipZ),
+     m_HeightThreshold((MIL_FLOAT)Settings.HeightThreshold),
+     m_ColumnStep(Settings.ColumnStep > 0 ? Settings.ColumnStep : 1),
+     m_RowStep(Settings.RowStep > 0 ? Settings.RowStep : 1),
+     m_MaxOutliers(Settings.MaxOutliers),
+     m_pBeltReference(pBeltReference),
+     m_NbBlocks(0),
+     m_NbEmptyBlocks(0)
+   {
+   MIL_INT NbSamples = ((ProfileSize + m_ColumnStep - 1) / m_ColumnStep) *
+                       ((NbProfiles + m_RowStep - 1) / m_RowStep);
+   m_SampleX.reserve(NbSamples);
+   m_SampleZ.reserve(NbSamples);
+   m_SampleColumns.reserve(NbSamples);
+   }
+
+//*****************************************************************************
+// Destructor.
+//*****************************************************************************
+CEmptyBlockDetector::~CEmptyBlockDetector()
+   {
+   }
+
+//*****************************************************************************
+// IsEmpty. Classifies a block of raw X and Z codes. The sampling stops at
+//          the first outlier above the maximum. The sampled points of an
+//          empty block track the belt and end the block of the reference.
+//*****************************************************************************
+bool CEmptyBlockDetector::IsEmpty(MIL_ID MilX, MIL_ID MilZ)
+   {
+   m_NbBlocks++;
+   if(!m_pBeltReference->IsReady())
+      return false;
+
+   const MIL_UINT16* pX = (const MIL_UINT16*)MbufInquire(MilX, M_HOST_ADDRESS, M_NULL);
+   const MIL_UINT16* pZ = (const MIL_UINT16*)MbufInquire(MilZ, M_HOST_ADDRESS, M_NULL);
+   MIL_INT PitchX = MbufInquire(MilX, M_PITCH, M_NULL);
+   MIL_INT PitchZ = MbufInquire(MilZ, M_PITCH, M_NULL);
+   const MIL_FLOAT* pReference = m_pBeltReference->GetReference();
+   const SPBeltModel& Model = m_pBeltReference->GetModel();
+   const MIL_FLOAT Offset = (MIL_FLOAT)Model.Offset;
+   const MIL_FLOAT SlopeX = (MIL_FLOAT)Model.SlopeX;
+
+   m_SampleX.clear();
+   m_SampleZ.clear();
+   m_SampleColumns.clear();
+   MIL_INT NbOutliers = 0;
+   for(MIL_INT y = 0; y < m_NbProfiles; y += m_RowStep)
+      {
+      const MIL_UINT16* pRowX = pX + y * PitchX;
+      const MIL_UINT16* pRowZ = pZ + y * PitchZ;
+      for(MIL_INT x = 0; x < m_ProfileSize; x += m_ColumnStep)
+         {
+         if(pRowZ[x] == m_InvalidCode)
+            continue;
+         MIL_INT32 CodeX = m_FlipX ? MAX_CODE - pRowX[x] : pRowX[x];
+         MIL_INT32 CodeZ = m_FlipZ ? MAX_CODE - pRowZ[x] : pRowZ[x];
+         MIL_FLOAT WorldX = CodeX * m_ScaleX + m_OffsetX;
+         MIL_FLOAT WorldZ = CodeZ * m_ScaleZ + m_OffsetZ;
+         MIL_FLOAT Height = WorldZ - pReference[x] - (Offset + SlopeX * WorldX);
+         if(Height > m_HeightThreshold || Height < -m_HeightThreshold)
+            {
+            if(++NbOutliers > m_MaxOutliers)
+               return false;
+            continue;
+            }
+         m_SampleX.push_back(WorldX);
+         m_SampleZ.push_back(WorldZ);
+         m_SampleColumns.push_back(x);
+         }
+      }
+
+   // Track the belt with the sampled points.
+   if(!m_SampleX.empty())
+      {
+      m_pBeltReference->TrackPoints(&m_SampleX[0], &m_SampleZ[0], &m_SampleColumns[0],
+                                    (MIL_INT)m_SampleX.size(), (MIL_DOUBLE)(m_ColumnStep * m_RowStep));
+      }
+   m_pBeltReference->EndBlock();
+   m_NbEmptyBlocks++;
+   return true;
+   }
@@ -0,0 +1,87 @@
+﻿/************************************************************************************/
+/*
+* File name: EmptyBlockDetector.h
+*
+* Synopsis:  This file contains the declaration of the CEmptyBlockDetector class that
+*            classifies the blocks of raw profiles that only contain the empty belt,
+*            so that their conversion and processing can be skipped.
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+
+#ifndef EMPTY_BLOCK_DETECTOR_H
+#define EMPTY_BLOCK_DETECTOR_H
+
+#include <vector>
+
+// Forward declares.
+class CBeltReference;
+struct SPCal;
+
+//*****************************************************************************
+// Structure defining the detection of the empty blocks.
+//*****************************************************************************
+struct SPEmptyBlockSettings
+   {
+   SPEmptyBlockSettings()
+      : Enable(false), HeightThreshold(0.0), ColumnStep(1), RowStep(1), MaxOutliers(0) {};
+
+   bool       Enable;            // Detect the empty blocks. Needs the reference of the belt.
+   MIL_DOUBLE HeightThreshold;   // Points farther from the belt are not belt, in mm.
+   MIL_INT    ColumnStep;        // Step between the sampled columns.
+   MIL_INT    RowStep;           // Step between the sampled profiles.
+   MIL_INT    MaxOutliers;       // Sampled points off the belt still considered noise.
+   };
+
+//*****************************************************************************
+// Class classifying the empty blocks on a sample of their raw codes.
+//
+// The belt is the one of the belt reference of the profile process, so the
+// detector and the converted blocks see the same belt. The sampled points
+// are converted to world units like the data conversion does, flips
+// included, and a block is empty if at most MaxOutliers of them are
+// farther than the threshold from the belt. The blocks are never empty
+// while the reference is captured. The other sampled points of an empty
+// block track the drift of the belt in the reference, weighted as the
+// points of the block that they stand for.
+//*****************************************************************************
+class CEmptyBlockDetector
+   {
+   public:
+      CEmptyBlockDetector(MIL_INT ProfileSize, MIL_INT NbProfiles, MIL_UINT16 InvalidCode,
+                          const SPCal& PCal, bool FlipX, bool FlipZ,
+                          const SPEmptyBlockSettings& Settings, CBeltReference* pBeltReference);
+      virtual ~CEmptyBlockDetector();
+
+      bool IsEmpty(MIL_ID MilX, MIL_ID MilZ);
+
+      MIL_INT64 GetNbBlocks() const { return m_NbBlocks; }
+      MIL_INT64 GetNbEmptyBlocks() const { return m_NbEmptyBlocks; }
+      MIL_INT64 GetNbSkippedPoints() const { return m_NbEmptyBlocks * m_ProfileSize * m_NbProfiles; }
+
+   private:
+      MIL_INT         m_ProfileSize;
+      MIL_INT         m_NbProfiles;
+      MIL_UINT16      m_InvalidCode;
+      MIL_FLOAT       m_ScaleX;
+      MIL_FLOAT       m_OffsetX;
+      MIL_FLOAT       m_ScaleZ;
+      MIL_FLOAT       m_OffsetZ;
+      bool            m_FlipX;
+      bool            m_FlipZ;
+      MIL_FLOAT       m_HeightThreshold;
+      MIL_INT         m_ColumnStep;
+      MIL_INT         m_RowStep;
+      MIL_INT         m_MaxOutliers;
+      CBeltReference* m_pBeltReference;
+      MIL_INT64       m_NbBlocks;
+      MIL_INT64       m_NbEmptyBlocks;
+
+      // Sampled points of the belt of the current block.
+      std::vector<MIL_FLOAT> m_SampleX;
+      std::vector<MIL_FLOAT> m_SampleZ;
+      std::vector<MIL_INT>   m_SampleColumns;
+   };
+
+#endif // EMPTY_BLOCK_DETECTOR_H
@@ -0,0 +1,278 @@
+﻿/************************************************************************************/
+/*
+* File name: HostMemory.cpp
+*
+* Synopsis:  This file contains the implementation of the functions that allocate
+*            the host memory of the grab buffers and of the data conversion
+*            buffers according to an allocation policy.
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+#include <mil.h>
+#include <stdlib.h>
+#include "HostMemory.h"
+
+#if M_MIL_USE_WINDOWS
+#include <windows.h>
+#include <malloc.h>
+#else
+#include <stdio.h>
+#include <sys/mman.h>
+#endif
+
+//*****************************************************************************
+// RoundUp. Rounds a size up to a multiple of a power of 2.
+//*****************************************************************************
+static MIL_INT RoundUp(MIL_INT Size, MIL_INT Multiple)
+   {
+   return (Size + Multiple - 1) & ~(Multiple - 1);
+   }
+
+#if M_MIL_USE_WINDOWS
+//*****************************************************************************
+// GetLargePageSize. Gets the size of the large pages, or 0 if the process
+//                   cannot allocate large pages. Allocating large pages
+//                   requires the "Lock pages in memory" privilege, which is
+//                   enabled the first time.
+//*****************************************************************************
+static MIL_INT GetLargePageSize()
+   {
+   static MIL_INT LargePageSize = -1;
+   if(LargePageSize >= 0)
+      return LargePageSize;
+
+   LargePageSize = 0;
+   HANDLE Token;
+   if(OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &Token))
+      {
+      TOKEN_PRIVILEGES Privileges;
+      Privileges.PrivilegeCount = 1;
+      Privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+      if(LookupPrivilegeValue(NULL, SE_LOCK_MEMORY_NAME, &Privileges.Privileges[0].Luid) &&
+         AdjustTokenPrivileges(Token, FALSE, &Privileges, 0, NULL, NULL) &&
+         GetLastError() == ERROR_SUCCESS)
+         LargePageSize = (MIL_INT)GetLargePageMinimum();
+      CloseHandle(Token);
+      }
+   return LargePageSize;
+   }
+
+static void* AllocLargePages(MIL_INT Bytes)
+   {
+   return VirtualAlloc(NULL, (SIZE_T)Bytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+   }
+
+static void FreeLargePages(void* pData, MIL_INT Bytes)
+   {
+   VirtualFree(pData, 0, MEM_RELEASE);
+   }
+
+static void* AllocAligned(MIL_INT Bytes, MIL_INT Alignment)
+   {
+   return _aligned_malloc((size_t)Bytes, (size_t)Alignment);
+   }
+
+static void FreeAligned(void* pData)
+   {
+   _aligned_free(pData);
+   }
+
+static void AdviseLargePages(void* pData, MIL_INT Bytes)
+   {
+   }
+#else
+//*****************************************************************************
+// GetLargePageSize. Gets the default size of the huge pages from
+//                   /proc/meminfo, or 0 if the kernel has no huge pages.
+//*****************************************************************************
+static MIL_INT GetLargePageSize()
+   {
+   static MIL_INT LargePageSize = -1;
+   if(LargePageSize >= 0)
+      return LargePageSize;
+
+   LargePageSize = 0;
+   FILE* pFile = fopen("/proc/meminfo", "r");
+   if(pFile)
+      {
+      char Line[256];
+      long SizeKb;
+      while(fgets(Line, sizeof(Line), pFile))
+         {
+         if(sscanf(Line, "Hugepagesize: %ld kB", &SizeKb) == 1)
+            {
+            LargePageSize = (MIL_INT)SizeKb * 1024;
+            break;
+            }
+         }
+      fclose(pFile);
+      }
+   return LargePageSize;
+   }
+
+static void* AllocLargePages(MIL_INT Bytes)
+   {
+#ifdef MAP_HUGETLB
+   void* pData = mmap(NULL, (size_t)Bytes, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+   return pData != MAP_FAILED ? pData : M_NULL;
+#else
+   return M_NULL;
+#endif
+   }
+
+static void FreeLargePages(void* pData, MIL_INT Bytes)
+   {
+   munmap(pData, (size_t)Bytes);
+   }
+
+static void* AllocAligned(MIL_INT Bytes, MIL_INT Alignment)
+   {
+   void* pData = M_NULL;
+   if(posix_memalign(&pData, (size_t)Alignment, (size_t)Bytes) != 0)
+      return M_NULL;
+   return pData;
+   }
+
+static void FreeAligned(void* pData)
+   {
+   free(pData);
+   }
+
+//*****************************************************************************
+// AdviseLargePages. Asks for transparent huge pages on the whole huge pages
+//                   of a block of regular pages.
+//*****************************************************************************
+static void AdviseLargePages(void* pData, MIL_INT Bytes)
+   {
+#ifdef MADV_HUGEPAGE
+   MIL_INT LargePageSize = GetLargePageSize();
+   if(LargePageSize <= 0)
+      return;
+   MIL_UINT First = ((MIL_UINT)pData + LargePageSize - 1) & ~(MIL_UINT)(LargePageSize - 1);
+   MIL_UINT End = ((MIL_UINT)pData + Bytes) & ~(MIL_UINT)(LargePageSize - 1);
+   if(First < End)
+      madvise((void*)First, (size_t)(End - First), MADV_HUGEPAGE);
+#endif
+   }
+#endif
+
+//*****************************************************************************
+// GetBytesPerPixel. Gets the number of bytes of a pixel of a MIL buffer type.
+//*****************************************************************************
+MIL_INT GetBytesPerPixel(MIL_INT Type)
+   {
+   return ((Type & 0xFF) + 7) / 8;
+   }
+
+//*****************************************************************************
+// GetAlignedPitch. Gets the pitch, in pixels, of the rows of a buffer
+//                  aligned according to the policy.
+//*****************************************************************************
+MIL_INT GetAlignedPitch(MIL_INT SizeX, MIL_INT Type, const SPAllocPolicy& Policy)
+   {
+   MIL_INT BytesPerPixel = GetBytesPerPixel(Type);
+   if(Policy.RowAlignment <= 1 || Policy.RowAlignment % BytesPerPixel)
+      return SizeX;
+   return RoundUp(SizeX * BytesPerPixel, Policy.RowAlignment) / BytesPerPixel;
+   }
+
+//*****************************************************************************
+// AllocHostMemory. Allocates a block of host memory aligned on the row
+//                  alignment of the policy. Blocks of at least the minimum
+//                  large page size are backed by large pages if requested
+//                  and possible, otherwise they fall back on regular pages
+//                  with the regular alignment. On Linux, the whole huge
+//                  pages of the fallback block can still be backed by
+//                  transparent huge pages.
+//*****************************************************************************
+SPHostMemory AllocHostMemory(MIL_INT Bytes, const SPAllocPolicy& Policy)
+   {
+   SPHostMemory Memory;
+   MIL_INT Alignment = Policy.RowAlignment > 1 ? Policy.RowAlignment : (MIL_INT)sizeof(void*);
+
+   bool AdviseLarge = false;
+   if(Policy.UseLargePages && Bytes >= Policy.LargePageMinSize)
+      {
+      MIL_INT LargePageSize = GetLargePageSize();
+      if(LargePageSize > 0)
+         {
+         MIL_INT LargeBytes = RoundUp(Bytes, LargePageSize);
+         Memory.pData = AllocLargePages(LargeBytes);
+         if(Memory.pData)
+            {
+            Memory.Bytes = LargeBytes;
+            Memory.Kind = HOST_MEMORY_LARGE_PAGES;
+            return Memory;
+            }
+         AdviseLarge = true;
+         }
+      }
+
+   Memory.Bytes = RoundUp(Bytes, Alignment);
+   Memory.pData = AllocAligned(Memory.Bytes, Alignment);
+   if(Memory.pData && AdviseLarge)
+      AdviseLargePages(Memory.pData, Memory.Bytes);
+   Memory.Kind = Memory.pData ? HOST_MEMORY_ALIGNED : HOST_MEMORY_NONE;
+   return Memory;
+   }
+
+//*****************************************************************************
+// FreeHostMemory. Frees a block of host memory.
+//*****************************************************************************
+void FreeHostMemory(SPHostMemory& Memory)
+   {
+   if(Memory.Kind == HOST_MEMORY_LARGE_PAGES)
+      FreeLargePages(Memory.pData, Memory.Bytes);
+   else if(Memory.Kind == HOST_MEMORY_ALIGNED)
+      FreeAligned(Memory.pData);
+   Memory = SPHostMemory();
+   }
+
+//*****************************************************************************
+// AllocHostBuffer2d. Allocates a 2d buffer on host memory allocated according
+//                    to the policy. If MIL cannot create the buffer on that
+//                    memory, for example because the system does not support
+//                    grabbing in host memory, the buffer is allocated by MIL.
+//*****************************************************************************
+MIL_ID AllocHostBuffer2d(MIL_ID MilSystem, MIL_INT SizeX, MIL_INT SizeY, MIL_INT Type,
+                         MIL_INT64 Attribute, const SPAllocPolicy& Policy, SPHostMemory& Memory)
+   {
+   MIL_ID MilBuffer = M_NULL;
+   MIL_INT Pitch = GetAlignedPitch(SizeX, Type, Policy);
+   Memory = AllocHostMemory(Pitch * SizeY * GetBytesPerPixel(Type), Policy);
+   if(Memory.pData)
+      {
+      MbufCreate2d(MilSystem, SizeX, SizeY, Type, Attribute,
+                   M_HOST_ADDRESS + M_PITCH, Pitch, Memory.pData, &MilBuffer);
+      if(!MilBuffer)
+         FreeHostMemory(Memory);
+      }
+   if(!MilBuffer)
+      MbufAlloc2d(MilSystem, SizeX, SizeY, Type, Attribute, &MilBuffer);
+   return MilBuffer;
+   }
+
+//*****************************************************************************
+// FreeHostBuffer. Frees a buffer allocated by AllocHostBuffer2d.
+//*****************************************************************************
+void FreeHostBuffer(MIL_ID MilBuffer, SPHostMemory& Memory)
+   {
+   if(MilBuffer)
+      MbufFree(MilBuffer);
+   FreeHostMemory(Memory);
+   }
+
+//*****************************************************************************
+// GetHostMemoryKindName. Gets the display name of a kind of host memory.
+//*****************************************************************************
+MIL_CONST_TEXT_PTR GetHostMemoryKindName(EHostMemoryKind Kind)
+   {
+   switch(Kind)
+      {
+      case HOST_MEMORY_ALIGNED:     return MIL_TEXT("aligned");
+      case HOST_MEMORY_LARGE_PAGES: return MIL_TEXT("large pages");
+      default:                      return MIL_TEXT("MIL allocated");
+      }
+   }
@@ -0,0 +1,71 @@
+﻿/************************************************************************************/
+/*
+* File name: HostMemory.h
+*
+* Synopsis:  This file contains the declaration of the allocation policy of the
+*            host buffers (grab buffers and data conversion buffers) and of the
+*            functions that allocate host memory according to that policy.
+*            The rows of the buffers are aligned on cache lines and large blocks
+*            can be backed by large pages to reduce the TLB misses.
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+
+#ifndef HOST_MEMORY_H
+#define HOST_MEMORY_H
+
+//*****************************************************************************
+// Constants.
+//*****************************************************************************
+static const MIL_INT DEFAULT_ROW_ALIGNMENT = 64;                 // in bytes
+static const MIL_INT DEFAULT_LARGE_PAGE_MIN_SIZE = 2 * 1024 * 1024; // in bytes
+
+// Kinds of host memory.
+enum EHostMemoryKind
+   {
+   HOST_MEMORY_NONE = 0,         // Not allocated, or allocated by MIL.
+   HOST_MEMORY_ALIGNED,          // Aligned memory on regular pages.
+   HOST_MEMORY_LARGE_PAGES       // Memory on large pages.
+   };
+
+//*****************************************************************************
+// Structure defining the allocation policy of the host buffers.
+//*****************************************************************************
+struct SPAllocPolicy
+   {
+   SPAllocPolicy()
+      : RowAlignment(DEFAULT_ROW_ALIGNMENT),
+        UseLargePages(false),
+        LargePageMinSize(DEFAULT_LARGE_PAGE_MIN_SIZE) {};
+
+   MIL_INT RowAlignment;      // Alignment of the rows, in bytes. Power of 2.
+   bool    UseLargePages;     // Back the large blocks with large pages if possible.
+   MIL_INT LargePageMinSize;  // Minimum size of a block backed by large pages, in bytes.
+   };
+
+//*****************************************************************************
+// Structure defining a block of host memory.
+//*****************************************************************************
+struct SPHostMemory
+   {
+   SPHostMemory(): pData(M_NULL), Bytes(0), Kind(HOST_MEMORY_NONE) {};
+
+   void*           pData;
+   MIL_INT         Bytes;
+   EHostMemoryKind Kind;
+   };
+
+//*****************************************************************************
+// Functions.
+//*****************************************************************************
+MIL_INT GetBytesPerPixel(MIL_INT Type);
+MIL_INT GetAlignedPitch(MIL_INT SizeX, MIL_INT Type, const SPAllocPolicy& Policy);
+SPHostMemory AllocHostMemory(MIL_INT Bytes, const SPAllocPolicy& Policy);
+void FreeHostMemory(SPHostMemory& Memory);
+MIL_ID AllocHostBuffer2d(MIL_ID MilSystem, MIL_INT SizeX, MIL_INT SizeY, MIL_INT Type,
+                         MIL_INT64 Attribute, const SPAllocPolicy& Policy, SPHostMemory& Memory);
+void FreeHostBuffer(MIL_ID MilBuffer, SPHostMemory& Memory);
+MIL_CONST_TEXT_PTR GetHostMemoryKindName(EHostMemoryKind Kind);
+
+#endif // HOST_MEMORY_H
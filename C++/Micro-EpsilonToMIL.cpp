@@ -1,114 +1,196 @@
-﻿/************************************************************************************/
-/*
-* File name: Micro-EpsilonToMIL.cpp
-*
-* Synopsis:  This file contains the implementation of the CMicroEpsilonToMIL class that
-*            interfaces the grab of the MicroEpsilon profile container buffer to
-*            MIL. It makes the necessary band extraction and data conversion before
-*            calling the profile processing on the data.
-*
-* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
-* All Rights Reserved
-*/
-
-#include <mil.h>
-#include "ProfileProcess.h"
-#include "Micro-EpsilonToMIL.h"
-
-//*****************************************************************************
-// Constants.
-//*****************************************************************************
-static MIL_DOUBLE INVALID_VALUE = 0;
-
-//*****************************************************************************
-// Constructor.
-//*****************************************************************************
-CMicroEpsilonToMIL::CMicroEpsilonToMIL(MIL_INT SizeX, MIL_INT SizeY)
-   : m_SizeX(SizeX), m_SizeY(SizeY), m_pDataConversion(0)
-   {
-   }
-
-//*****************************************************************************
-// Destructor.
-//*****************************************************************************
-CMicroEpsilonToMIL::~CMicroEpsilonToMIL()
-   {
-   if(m_pDataConversion)
-      delete m_pDataConversion;
-   }
-
-//*****************************************************************************
-// BuildInterface. Builds the interface between the MicroEpsilon data and 
-//                 MIL. Gets the profile processing to perform and build the
-//                 data conversion.
-//*****************************************************************************
-void CMicroEpsilonToMIL::BuildInterface(MIL_ID MilDigitizer, CProfileProcess* pProfileProcess)
-   {
-   // Set the Profile process to apply to the acquired data.
-   m_pProfileProcess = pProfileProcess;
-
-   // Build the data conversion due to the digitizer.
-   BuildDigitizerDataConversion(MilDigitizer);
-   }
-
-//*****************************************************************************
-// BuildDigitizerDataConversion. Creates the CDataConversion objects that
-//                               will put the data provided by the digitizer
-//                               in a format that can be processed by the profile
-//                               process.
-//*****************************************************************************
-void CMicroEpsilonToMIL::BuildDigitizerDataConversion(MIL_ID MilDigitizer)
-   {
-   // Convert the data to have a valid mask.
-   MIL_ID MilSystem = MdigInquire(MilDigitizer, M_OWNER_SYSTEM, M_NULL);
-   m_pDataConversion = new CDataConversionAddMask(m_pDataConversion, MilSystem,
-                                                  m_SizeX, m_SizeY, INVALID_VALUE);
-
-   // Flip the X position values if necessary.
-   MIL_BOOL FlipPosition = M_FALSE;
-   MdigInquireFeature(MilDigitizer, M_FEATURE_VALUE, MIL_TEXT("FlipPos"), M_TYPE_BOOLEAN, &FlipPosition);
-   if(FlipPosition)
-      m_pDataConversion = new CDataConversionFlipXVal(m_pDataConversion);
-
-   // Flip the Z position values if necessary.
-   MIL_BOOL FlipDistance = M_FALSE;
-   MdigInquireFeature(MilDigitizer, M_FEATURE_VALUE, MIL_TEXT("FlipDist"), M_TYPE_BOOLEAN, &FlipDistance);
-   if(FlipDistance)
-      m_pDataConversion = new CDataConversionFlipZVal(m_pDataConversion);
-   }
-
-//*****************************************************************************
-// MilInterfaceHook. Hook function called by the MdigProcess function.
-//*****************************************************************************
-MIL_INT MFTYPE CMicroEpsilonToMIL::MilInterfaceHook(MIL_INT HookType, MIL_ID MilEvent, void *pUserData)
-   {
-   CMicroEpsilonToMIL* pInterface = (CMicroEpsilonToMIL*)pUserData;
-   return pInterface->MilInterface(HookType, MilEvent);
-   }
-
-//*****************************************************************************
-// MilInterface. Actual interface function that is being called at each MdigProcess
-//               hook. Separates, converts and processes the data.
-//*****************************************************************************
-MIL_INT CMicroEpsilonToMIL::MilInterface(MIL_INT HookType, MIL_ID MilEvent)
-   {
-   // Get the grab buffer.
-   MIL_ID MilGrabBuffer;
-   MdigGetHookInfo(MilEvent, M_MODIFIED_BUFFER + M_BUFFER_ID, &MilGrabBuffer);
-
-   // Separate the Z and X data buffers into child buffers.
-   SPData Data;
-   Data.MilZ = MbufChild2d(MilGrabBuffer, 0, 0, m_SizeX, m_SizeY, M_NULL);
-   Data.MilX = MbufChild2d(MilGrabBuffer, m_SizeX, 0, m_SizeX, m_SizeY, M_NULL);
-
-   // Convert the data.
-   SPData ConvertedData = m_pDataConversion ? m_pDataConversion->Convert(Data) : Data;
-
-   // Process the data.
-   m_pProfileProcess->Process(ConvertedData);
-
-   // Free the child buffers.
-   Data.ReleaseData();
-
-   return 0;
-   }
+﻿/************************************************************************************/
+/*
+* File name: Micro-EpsilonToMIL.cpp
+*
+* Synopsis:  This file contains the implementation of the CMicroEpsilonToMIL class that
+*            interfaces the grab of the MicroEpsilon profile container buffer to
+*            MIL. It makes the necessary band extraction and data conversion before
+*            calling the profile processing on the data.
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+
+#include <mil.h>
+#include "ProfileProcess.h"
+#include "EmptyBlockDetector.h"
+#include "Micro-EpsilonToMIL.h"
+
+//*****************************************************************************
+// Constants.
+//*****************************************************************************
+static MIL_DOUBLE INVALID_VALUE = 0;
+
+//*****************************************************************************
+// Constructor.
+//*****************************************************************************
+CMicroEpsilonToMIL::CMicroEpsilonToMIL(MIL_INT SizeX, MIL_INT SizeY)
+   : m_SizeX(SizeX), m_SizeY(SizeY), m_pDataConversion(0), m_pBufferPlanner(0), m_pEmptyBlockDetector(0),
+     m_FlipX(false), m_FlipZ(false)
+   {
+   }
+
+//*****************************************************************************
+// Destructor.
+//*****************************************************************************
+CMicroEpsilonToMIL::~CMicroEpsilonToMIL()
+   {
+   if(m_pDataConversion)
+      delete m_pDataConversion;
+   if(m_pBufferPlanner)
+      delete m_pBufferPlanner;
+   if(m_pEmptyBlockDetector)
+      delete m_pEmptyBlockDetector;
+   }
+
+//*****************************************************************************
+// BuildInterface. Builds the interface between the MicroEpsilon data and 
+//                 MIL. Gets the profile processing to perform and build the
+//                 data conversion. The layout of the input data is inquired
+//                 on MilGrabBuffer, one of the grab buffers.
+//*****************************************************************************
+void CMicroEpsilonToMIL::BuildInterface(MIL_ID MilDigitizer, MIL_ID MilGrabBuffer, CProfileProcess* pProfileProcess,
+                                        const SPAllocPolicy& Policy)
+   {
+   // Set the Profile process to apply to the acquired data.
+   m_pProfileProcess = pProfileProcess;
+
+   // Build the data conversion due to the digitizer.
+   BuildDigitizerDataConversion(MilDigitizer);
+
+   // Select the kernels for the profile size and the CPU once.
+   const SPProfileKernels& Kernels = SelectProfileKernels(m_SizeX);
+   PrintProfileKernels(Kernels);
+
+   // Allocate the buffers of the whole data conversion chain.
+   PlanDataConversion(MilDigitizer, MilGrabBuffer, Kernels, Policy);
+   }
+
+//*****************************************************************************
+// EnableEmptyBlockDetection. Enables the detection of the blocks that only
+//                            contain the empty belt on their raw codes.
+//                            Their conversion and processing are skipped.
+//                            The belt is the belt reference of the profile
+//                            process, so the interface must be built.
+//*****************************************************************************
+void CMicroEpsilonToMIL::EnableEmptyBlockDetection(const SPEmptyBlockSettings& Settings, const SPCal& PCal)
+   {
+   if(m_pEmptyBlockDetector)
+      delete m_pEmptyBlockDetector;
+   m_pEmptyBlockDetector = M_NULL;
+   if(!Settings.Enable)
+      return;
+
+   CBeltReference* pBeltReference = m_pProfileProcess->GetBeltReference();
+   if(!pBeltReference)
+      {
+      MosPrintf(MIL_TEXT("The detection of the empty blocks needs the reference of the belt. ")
+                MIL_TEXT("It is disabled.\n\n"));
+      return;
+      }
+   m_pEmptyBlockDetector = new CEmptyBlockDetector(m_SizeX, m_SizeY, (MIL_UINT16)INVALID_VALUE, PCal,
+                                                   m_FlipX, m_FlipZ, Settings, pBeltReference);
+   }
+
+//*****************************************************************************
+// BuildDigitizerDataConversion. Creates the CDataConversion objects that
+//                               will put the data provided by the digitizer
+//                               in a format that can be processed by the profile
+//                               process.
+//*****************************************************************************
+void CMicroEpsilonToMIL::BuildDigitizerDataConversion(MIL_ID MilDigitizer)
+   {
+   // Convert the data to have a valid mask.
+   m_pDataConversion = new CDataConversionAddMask(m_pDataConversion, m_SizeX, m_SizeY, INVALID_VALUE);
+
+   // Flip the X position values if necessary.
+   MIL_BOOL FlipPosition = M_FALSE;
+   MdigInquireFeature(MilDigitizer, M_FEATURE_VALUE, MIL_TEXT("FlipPos"), M_TYPE_BOOLEAN, &FlipPosition);
+   m_FlipX = (FlipPosition != M_FALSE);
+   if(FlipPosition)
+      m_pDataConversion = new CDataConversionFlipXVal(m_pDataConversion);
+
+   // Flip the Z position values if necessary.
+   MIL_BOOL FlipDistance = M_FALSE;
+   MdigInquireFeature(MilDigitizer, M_FEATURE_VALUE, MIL_TEXT("FlipDist"), M_TYPE_BOOLEAN, &FlipDistance);
+   m_FlipZ = (FlipDistance != M_FALSE);
+   if(FlipDistance)
+      m_pDataConversion = new CDataConversionFlipZVal(m_pDataConversion);
+   }
+
+//*****************************************************************************
+// PlanDataConversion. Plans the intermediate buffers of the digitizer data
+//                     conversion followed by the profile process data
+//                     conversion. Buffers whose lifetimes do not overlap
+//                     share memory and format only conversions are done in
+//                     place.
+//*****************************************************************************
+void CMicroEpsilonToMIL::PlanDataConversion(MIL_ID MilDigitizer, MIL_ID MilGrabBuffer,
+                                            const SPProfileKernels& Kernels, const SPAllocPolicy& Policy)
+   {
+   MIL_ID MilSystem = MdigInquire(MilDigitizer, M_OWNER_SYSTEM, M_NULL);
+   m_pBufferPlanner = new CBufferPlanner(MilSystem, Policy);
+
+   // The input data are the Z and X child buffers of the grab buffer. Its
+   // pitch is inquired since MIL allocates it when the aligned host memory
+   // cannot be used.
+   MIL_INT GrabPitch = MbufInquire(MilGrabBuffer, M_PITCH, M_NULL);
+   SPPlanData PlannedData;
+   PlannedData.Z = m_pBufferPlanner->AddExternal(m_SizeX, m_SizeY, 16 + M_UNSIGNED, GrabPitch);
+   PlannedData.X = m_pBufferPlanner->AddExternal(m_SizeX, m_SizeY, 16 + M_UNSIGNED, GrabPitch);
+
+   // Plan the whole chain.
+   if(m_pDataConversion)
+      PlannedData = m_pDataConversion->Plan(*m_pBufferPlanner, PlannedData);
+   m_pProfileProcess->Plan(*m_pBufferPlanner, PlannedData);
+
+   // Allocate the buffers and give them, with the kernels, to the conversions.
+   m_pBufferPlanner->Allocate();
+   if(m_pDataConversion)
+      m_pDataConversion->Bind(*m_pBufferPlanner, Kernels);
+   m_pProfileProcess->Bind(*m_pBufferPlanner, Kernels);
+
+   m_pBufferPlanner->PrintReport();
+   }
+
+//*****************************************************************************
+// MilInterfaceHook. Hook function called by the MdigProcess function.
+//*****************************************************************************
+MIL_INT MFTYPE CMicroEpsilonToMIL::MilInterfaceHook(MIL_INT HookType, MIL_ID MilEvent, void *pUserData)
+   {
+   CMicroEpsilonToMIL* pInterface = (CMicroEpsilonToMIL*)pUserData;
+   return pInterface->MilInterface(HookType, MilEvent);
+   }
+
+//*****************************************************************************
+// MilInterface. Actual interface function that is being called at each MdigProcess
+//               hook. Separates, converts and processes the data. The empty
+//               blocks are only accounted for by the profile process.
+//*****************************************************************************
+MIL_INT CMicroEpsilonToMIL::MilInterface(MIL_INT HookType, MIL_ID MilEvent)
+   {
+   // Get the grab buffer.
+   MIL_ID MilGrabBuffer;
+   MdigGetHookInfo(MilEvent, M_MODIFIED_BUFFER + M_BUFFER_ID, &MilGrabBuffer);
+
+   // Separate the Z and X data buffers into child buffers.
+   SPData Data;
+   Data.MilZ = MbufChild2d(MilGrabBuffer, 0, 0, m_SizeX, m_SizeY, M_NULL);
+   Data.MilX = MbufChild2d(MilGrabBuffer, m_SizeX, 0, m_SizeX, m_SizeY, M_NULL);
+
+   if(m_pEmptyBlockDetector && m_pEmptyBlockDetector->IsEmpty(Data.MilX, Data.MilZ))
+      m_pProfileProcess->ProcessEmptyBlock();
+   else
+      {
+      // Convert the data.
+      SPData ConvertedData = m_pDataConversion ? m_pDataConversion->Convert(Data) : Data;
+
+      // Process the data.
+      m_pProfileProcess->Process(ConvertedData);
+      }
+
+   // Free the child buffers.
+   Data.ReleaseData();
+
+   return 0;
+   }
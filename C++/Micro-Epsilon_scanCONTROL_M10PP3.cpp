@@ -1,377 +1,679 @@
-﻿//***************************************************************************************/
-// 
-// File name: Micro-Epsilon_scanCONTROL_M10PP3.cpp  
-//
-// Synopsis:  This program contains an example of 3d reconstruction by interfacing with
-//            a MicroEpsilon ScanControl scanner.
-//            See the PrintHeader() function below for detailed description.
-//
-// Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
-// All Rights Reserved
-//***************************************************************************************/
-#include <mil.h>
-#include "DataConversion.h"
-#include "ProfileProcess.h"
-#include "Micro-EpsilonToMIL.h"
-
-//****************************************************************************
-// Example description.
-//****************************************************************************
-void PrintHeader()
-{
-	MosPrintf(MIL_TEXT("[EXAMPLE NAME]\n")
-	          MIL_TEXT("Micro-Epsilon_scanCONTROL_M10PP3\n\n")
-
-	          MIL_TEXT("[SYNOPSIS]\n")
-	          MIL_TEXT("This program acquires 3d data using a MicroEpsilon scanControl.\n")
-	          MIL_TEXT("The 3d data from the scanner is grabbed using the GigeVision\n")
-	          MIL_TEXT("interface provided by MicroEpsilon.\n\n")
-             
-	          MIL_TEXT("[MODULES USED]\n")
-	          MIL_TEXT("Modules used: application, system, display, buffer, calibration,\n")
-	          MIL_TEXT("              image processing, 3dMap.\n\n")
-             MIL_TEXT("Press <Enter> to start.\n\n"));
-   MosGetch();
-}
-
-//*****************************************************************************
-// Acquisition parameter.
-//*****************************************************************************
-static const MIL_INT MIN_GRAB_TIMEOUT = 5000; // in ms
-static const MIL_INT NB_PROFILES_PER_GRAB = 100;
-
-static const MIL_DOUBLE CONVEYOR_SPEED = 0.05; // in mm/frame
-static MIL_CONST_TEXT_PTR EXPECTED_DEVICE_VENDOR = MIL_TEXT("MICRO-EPSILON Optronic GmbH");
-static const MIL_INT NB_MODELS = 2;
-static MIL_STRING EXPECTED_DEVICE_MODEL[NB_MODELS] =
-   {
-   MIL_TEXT("scanCONTROL 26"),
-   MIL_TEXT("scanCONTROL 29"),
-   };
-
-
-// Definition of the valid ranges in decreasing order.
-static const MIL_INT NB_RANGE = 4;
-static MIL_STRING EXPECTED_RANGE[NB_RANGE] =
-   {
-   MIL_TEXT("100"),
-   MIL_TEXT("50"),
-   MIL_TEXT("25"),
-   MIL_TEXT("10")
-   };
-
-static const MIL_DOUBLE CONV_S[NB_RANGE] = {0.005, 0.002, 0.001, 0.0005};
-static const MIL_DOUBLE CONV_OFF[NB_RANGE] = {250.0, 95.0, 65.0, 55.0};
-static const SPCal CONVPCAL[NB_RANGE] =
-   {
-      {-32768 * CONV_S[0], -32768 * CONV_S[0] + CONV_OFF[0], CONV_S[0], CONV_S[0]},
-      {-32768 * CONV_S[1], -32768 * CONV_S[1] + CONV_OFF[1], CONV_S[1], CONV_S[1]},
-      {-32768 * CONV_S[2], -32768 * CONV_S[2] + CONV_OFF[2], CONV_S[2], CONV_S[2]},
-      {-32768 * CONV_S[3], -32768 * CONV_S[3] + CONV_OFF[3], CONV_S[3], CONV_S[3]}
-   };
-
-static const SPRange PRANGE[NB_RANGE] =
-   {
-      {-143.5 / 2, 125.0, 143.5 / 2, 390.0},
-      {-60.0  / 2, 65.0 , 60.0  / 2, 125.0},
-      {-29.3  / 2, 53.0 , 29.3  / 2, 79.0},
-      {-10.7  / 2, 52.5 , 10.7  / 2, 60.5}
-   };
-
-//*****************************************************************************
-// Prototypes.
-//*****************************************************************************
-MIL_INT ChooseProfileMode();
-bool VerifyDeviceCompatibility(MIL_ID MilDigitizer, MIL_INT* pCameraModeIndex);
-MIL_INT SetupCamera(MIL_ID MilDigitizer, MIL_INT NbProfiles);
-MIL_INT GetContainerResolution(MIL_ID MilDigitizer);
-
-//*****************************************************************************
-int MosMain(void)
-   {
-   PrintHeader();
-
-   // Allocate the application.
-   MIL_ID MilApplication = MappAlloc(M_DEFAULT, M_NULL);
-
-   // Try to allocate the GigE Vision(R) system and digitizer.
-   MappControl(M_ERROR, M_PRINT_DISABLE);
-   MIL_ID MilSystem = MsysAlloc(M_SYSTEM_GIGE_VISION, M_DEFAULT, M_DEFAULT, M_NULL);
-   MIL_ID MilDigitizer = MdigAlloc(MilSystem, M_DEFAULT, MIL_TEXT("M_DEFAULT"), M_DEFAULT, M_NULL);
-   
-   // Verify the compatibility of the camera and get the model index.
-   MIL_INT CameraModelIndex;
-   if(MappGetError(M_CURRENT, M_NULL) == M_NULL_ERROR && VerifyDeviceCompatibility(MilDigitizer, &CameraModelIndex))
-      {
-      // Choose the profile process.
-      MIL_INT NbProfiles = ChooseProfileMode();
-
-      // Set up the camera mode for the example.
-      MIL_INT ProfileSize = SetupCamera(MilDigitizer, NbProfiles);
-      
-      // Allocate the grab buffers.
-      MIL_ID MilGrabBuffers[2];
-      MIL_INT ImageSizeX = MdigInquire(MilDigitizer, M_SIZE_X, M_NULL);
-      MIL_INT ImageSizeY = MdigInquire(MilDigitizer, M_SIZE_Y, M_NULL);
-      MIL_INT ImageSizeBit = MdigInquire(MilDigitizer, M_SIZE_BIT, M_NULL);
-      MbufAlloc2d(MilSystem, ImageSizeX, ImageSizeY, ImageSizeBit + M_UNSIGNED,
-                  M_IMAGE + M_PROC + M_GRAB + M_DISP, &MilGrabBuffers[0]);
-      MbufAlloc2d(MilSystem, ImageSizeX, ImageSizeY, ImageSizeBit + M_UNSIGNED,
-                  M_IMAGE + M_PROC + M_GRAB + M_DISP, &MilGrabBuffers[1]);
-
-      // Try grabbing an image.
-      MdigGrab(MilDigitizer, MilGrabBuffers[0]);
-
-      if(MappGetError(M_CURRENT, M_NULL) == M_NULL_ERROR)
-         {
-         MappControl(M_ERROR, M_PRINT_ENABLE);
-
-         // Allocate the profile processing object.
-         CProfileProcess* pProfileProcess;
-         if(NbProfiles == 1)
-            pProfileProcess = new CProfileSingleProcess(MilSystem, CONVPCAL[CameraModelIndex],
-                                                        PRANGE[CameraModelIndex], ProfileSize);
-         else
-            pProfileProcess = new CProfileDepthMapProcess(MilSystem, CONVPCAL[CameraModelIndex],
-                                                          PRANGE[CameraModelIndex], 0.0,
-                                                          CONVEYOR_SPEED, ProfileSize, NB_PROFILES_PER_GRAB);
-
-         // Allocate the interface between MicroEpsilon and MIL.
-         CMicroEpsilonToMIL MicroEpsilonToMILInterface(ProfileSize, NbProfiles);
-         MicroEpsilonToMILInterface.BuildInterface(MilDigitizer, pProfileProcess);
-
-         // Process 3d data.
-         MdigProcess(MilDigitizer, MilGrabBuffers, 2, M_START, M_DEFAULT,
-                     CMicroEpsilonToMIL::MilInterfaceHook, &MicroEpsilonToMILInterface);
-
-         // Wait for the user to stop the grab and terminate the application.
-         MosPrintf(MIL_TEXT("Press <Enter> to end.\n\n"));
-         MosGetch();
-         MdigProcess(MilDigitizer, MilGrabBuffers, 2, M_STOP, M_DEFAULT,
-                     CMicroEpsilonToMIL::MilInterfaceHook, &MicroEpsilonToMILInterface);
-
-         // Free the profile process.
-         delete pProfileProcess;
-         }
-      else
-         {
-         MosPrintf(MIL_TEXT("Unable to grab from the MicroEpsilon scanControl camera!\n")
-                   MIL_TEXT("Verify the configuration of the camera:\n")
-                   MIL_TEXT("   - Profile frequency vs measuring field.\n")
-                   MIL_TEXT("   - ...\n")
-                   MIL_TEXT("The default configuration of the camera upon powerup should work.\n\n")
-                   MIL_TEXT("Press <Enter> to end.\n"));
-         MosGetch();
-         }      
-
-      // Free the grab buffers
-      MbufFree(MilGrabBuffers[1]);
-      MbufFree(MilGrabBuffers[0]);
-      }
-   else
-      {
-      MosPrintf(MIL_TEXT("The example requires the following conditions to run:\n")
-                MIL_TEXT("   - MIL GigE Vision(R) driver must be installed.\n")
-                MIL_TEXT("   - An actual MicroEpsilon scanControl must be\n")
-                MIL_TEXT("     connected to your computer or network.\n\n")
-                MIL_TEXT("Press <Enter> to end.\n"));
-      MosGetch();
-      }
-
-   // Free the MIL objects.
-   MdigFree(MilDigitizer);
-   MsysFree(MilSystem);
-   MappFree(MilApplication);
-
-	return 0;
-   }
-
-//*****************************************************************************
-// Ask the user to choose a profile mode. Allocate the profile process.
-//*****************************************************************************
-MIL_INT ChooseProfileMode()
-   {
-   while(1)
-      {
-      MosPrintf(MIL_TEXT("Please choose the profile mode of the example.\n")
-                MIL_TEXT("   a. Single profile mode.\n")
-                MIL_TEXT("   b. Multiple profiles mode.\n\n"));
-      switch(MosGetch())
-         {
-         case MIL_TEXT('a'):
-         case MIL_TEXT('A'):
-            MosPrintf(MIL_TEXT("Single profile mode\n")
-                      MIL_TEXT("--------------------\n")
-                      MIL_TEXT("The camera is configured to transmit one profile per frame.\n")
-                      MIL_TEXT("The profile is first converted to 3d points. The points are then displayed in\n")
-                      MIL_TEXT("the camera world system. The displayed gray region represents the bounding\n")
-                      MIL_TEXT("area of meaurement specified by the scanControl camera.\n\n"));
-            return 1;
-            break;
-           
-         case MIL_TEXT('b'):
-         case MIL_TEXT('B'):            
-            MosPrintf(MIL_TEXT("Multiple profiles mode\n")
-                      MIL_TEXT("-----------------------\n")
-                      MIL_TEXT("The camera is configured to transmit multiple profiles per frame.\n")
-                      MIL_TEXT("The profiles are first converted to a MIL 3d point cloud. The point cloud\n")
-                      MIL_TEXT("is then extracted into a calibrated depth map that is displayed.\n\n"));
-            return NB_PROFILES_PER_GRAB;
-         default:
-            break;
-         }
-      } 
-   }
-
-//*****************************************************************************
-// Checks whether the GigE Vision(R) camera used is expected.
-//*****************************************************************************
-bool VerifyDeviceCompatibility(MIL_ID MilDigitizer, MIL_INT* pCameraRangeIndex)
-   {
-   *pCameraRangeIndex = -1;
-
-   // Get the device vendor.
-   MIL_INT64 DeviceVendorNameStringSize = 0;
-   MdigInquireFeature(MilDigitizer, M_FEATURE_VALUE + M_STRING_SIZE, MIL_TEXT("DeviceVendorName"),
-                      M_TYPE_INT64, &DeviceVendorNameStringSize);
-   MIL_TEXT_PTR DeviceVendorNamePtr = new MIL_TEXT_CHAR[(MIL_INT)DeviceVendorNameStringSize];
-   MdigInquireFeature(MilDigitizer, M_FEATURE_VALUE, MIL_TEXT("DeviceVendorName"),
-                      M_TYPE_STRING, DeviceVendorNamePtr);
-
-   if(MosStrcmp(DeviceVendorNamePtr, EXPECTED_DEVICE_VENDOR) == 0)
-      {
-      // Get the device model.
-      MIL_INT64 DeviceModelNameStringSize = 0;
-      MdigInquireFeature(MilDigitizer, M_FEATURE_VALUE + M_STRING_SIZE, MIL_TEXT("DeviceModelName"),
-                         M_TYPE_INT64, &DeviceModelNameStringSize);
-      MIL_TEXT_PTR DeviceModelNamePtr = new MIL_TEXT_CHAR[(MIL_INT)DeviceModelNameStringSize];
-      MdigInquireFeature(MilDigitizer, M_FEATURE_VALUE, MIL_TEXT("DeviceModelName"),
-                         M_TYPE_STRING, &DeviceModelNamePtr[0]);
-
-      // Check the model.
-      MIL_STRING DeviceModelName(DeviceModelNamePtr);
-      for(MIL_INT m = 0; m < NB_MODELS; m++)
-         {
-         size_t pos = DeviceModelName.find(EXPECTED_DEVICE_MODEL[m]);
-         if(pos != MIL_STRING::npos)
-            {
-            // Verify that the model name is long enough.
-            MIL_INT MaxRangeName = EXPECTED_RANGE[0].length();
-            if(DeviceModelName.length() >= (pos + EXPECTED_DEVICE_MODEL[m].length() + MaxRangeName))
-               {
-               // Check the range.
-               MIL_STRING RangeName = DeviceModelName.substr(pos + EXPECTED_DEVICE_MODEL[m].length() + MaxRangeName);
-               for(MIL_INT m = 0; m < NB_RANGE; m++)
-                  {
-               if(RangeName.find(EXPECTED_RANGE[m]) != MIL_STRING::npos)
-                     {
-                     *pCameraRangeIndex = m;
-                     break;
-                     }
-                  }
-               }
-            break;
-            }
-         }
-      
-      delete[] DeviceModelNamePtr;
-      }
-
-   delete[] DeviceVendorNamePtr;
-
-   return *pCameraRangeIndex >= 0;
-   }
-
-//*****************************************************************************
-// SetupCamera. Minimal setup of the camera to be in a mode that is easy to
-//              interface with MIL.
-//*****************************************************************************
-MIL_INT SetupCamera(MIL_ID MilDigitizer, MIL_INT NbProfiles)
-   {
-   // Set the camera in container mode.
-   MdigControlFeature(MilDigitizer, M_FEATURE_VALUE, MIL_TEXT("TransmissionType"),
-                      M_TYPE_STRING, MIL_TEXT("TypeContainer"));
-   MdigControlFeature(MilDigitizer, M_FEATURE_VALUE, MIL_TEXT("PixelFormat"),
-                      M_TYPE_STRING, MIL_TEXT("Mono16"));
-
-   // Enable the Z and the X content and disable the others.
-   MIL_BOOL Enable = M_TRUE;
-   MdigControlFeature(MilDigitizer, M_FEATURE_VALUE, MIL_TEXT("ContainerZ"), M_TYPE_BOOLEAN, &Enable);
-   MdigControlFeature(MilDigitizer, M_FEATURE_VALUE, MIL_TEXT("ContainerX"), M_TYPE_BOOLEAN, &Enable);
-   Enable = M_FALSE;
-   MdigControlFeature(MilDigitizer, M_FEATURE_VALUE, MIL_TEXT("ContainerH"), M_TYPE_BOOLEAN, &Enable);
-   MdigControlFeature(MilDigitizer, M_FEATURE_VALUE, MIL_TEXT("ContainerW"), M_TYPE_BOOLEAN, &Enable);
-   MdigControlFeature(MilDigitizer, M_FEATURE_VALUE, MIL_TEXT("ContainerM01"), M_TYPE_BOOLEAN, &Enable);
-   MdigControlFeature(MilDigitizer, M_FEATURE_VALUE, MIL_TEXT("ContainerM02"), M_TYPE_BOOLEAN, &Enable);
-   MdigControlFeature(MilDigitizer, M_FEATURE_VALUE, MIL_TEXT("ContainerTS"), M_TYPE_BOOLEAN, &Enable);
-
-   // Set the packet size to the value recommended by MicroEpsilon.
-   MIL_INT64 GevSCPSPacketSize = 356;
-   MdigControlFeature(MilDigitizer, M_FEATURE_VALUE, MIL_TEXT("GevSCPSPacketSize"),
-                      M_TYPE_INT64, &GevSCPSPacketSize);
-
-   // Always enable the calibration of the data.
-   Enable = M_TRUE;
-   MdigControlFeature(MilDigitizer, M_FEATURE_VALUE, MIL_TEXT("Calibration"), M_TYPE_BOOLEAN, &Enable);
-
-   // Get the size of the profile.
-   MIL_INT ProfileSize = GetContainerResolution(MilDigitizer);
-
-   // Set the grab image accordingly.
-   MIL_INT64 Width = ProfileSize * 2;
-   MdigControlFeature(MilDigitizer, M_FEATURE_VALUE, MIL_TEXT("Width"), M_TYPE_INT64, &Width);
-   MIL_INT64 Height = NbProfiles;
-   MdigControlFeature(MilDigitizer, M_FEATURE_VALUE, MIL_TEXT("Height"), M_TYPE_INT64, &Height);
-
-   // Get the profile rate of the camera.
-   MIL_DOUBLE ProfileFrequencyInHz = 0;
-   MdigInquireFeature(MilDigitizer, M_FEATURE_VALUE, MIL_TEXT("AcquisitionFrameRate"),
-                      M_TYPE_DOUBLE, &ProfileFrequencyInHz);
-
-   // Set the grab timeout.
-   MIL_DOUBLE GrabTimeout = 2 * Height * 1000.0 / ProfileFrequencyInHz;
-   GrabTimeout = GrabTimeout < MIN_GRAB_TIMEOUT ? MIN_GRAB_TIMEOUT : GrabTimeout;
-   MdigControl(MilDigitizer, M_GRAB_TIMEOUT, GrabTimeout);
-   
-   return ProfileSize;
-   }
-
-//*****************************************************************************
-// GetContainerResolution. Gets the resolution of the container.
-//*****************************************************************************
-MIL_INT GetContainerResolution(MIL_ID MilDigitizer)
-   {  
-   MIL_INT ContainerResolution = 0;
-   MIL_INT64 EntryToRead = 0; 
-   MdigInquireFeature(MilDigitizer, M_FEATURE_VALUE, MIL_TEXT("ContainerResolution"),
-                      M_TYPE_INT64, &EntryToRead);
-
-   MIL_INT Count = 0;
-   MdigInquireFeature(MilDigitizer, M_FEATURE_ENUM_ENTRY_COUNT, MIL_TEXT("ContainerResolution"),
-                      M_TYPE_MIL_INT, &Count);
-   if(Count)
-      {
-      for(MIL_INT i = 0; i < Count; i++)
-         {
-         MIL_INT64 CurEntry;
-         MdigInquireFeature(MilDigitizer, M_FEATURE_ENUM_ENTRY_VALUE + i, MIL_TEXT("ContainerResolution"),
-                            M_TYPE_INT64, &CurEntry);
-
-         if(EntryToRead == CurEntry)
-            {
-            MIL_INT64 StringSize;
-            MdigInquireFeature(MilDigitizer, M_FEATURE_ENUM_ENTRY_DISPLAY_NAME + i + M_STRING_SIZE,
-                               MIL_TEXT("ContainerResolution"), M_TYPE_INT64, &StringSize);
-            MIL_TEXT_PTR ContainerResolutionString = new MIL_TEXT_CHAR[(MIL_INT)StringSize];
-            MdigInquireFeature(MilDigitizer, M_FEATURE_ENUM_ENTRY_DISPLAY_NAME + i,
-                               MIL_TEXT("ContainerResolution"), M_TYPE_STRING, ContainerResolutionString);
-            MIL_STRING_STREAM Stream(ContainerResolutionString);
-            Stream >> ContainerResolution;
-            delete [] ContainerResolutionString;
-            break;
-            }
-         }
-      }
-
-   return ContainerResolution;
-   }
+﻿//***************************************************************************************/
+// 
+// File name: Micro-Epsilon_scanCONTROL_M10PP3.cpp  
+//
+// Synopsis:  This program contains an example of 3d reconstruction by interfacing with
+//            a MicroEpsilon ScanControl scanner.
+//            See the PrintHeader() function below for detailed description.
+//
+// Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+// All Rights Reserved
+//***************************************************************************************/
+#include <mil.h>
+#include <float.h>
+#include "DataConversion.h"
+#include "HostMemory.h"
+#include "ProfileProcess.h"
+#include "EmptyBlockDetector.h"
+#include "Micro-EpsilonToMIL.h"
+
+//****************************************************************************
+// Example description.
+//****************************************************************************
+void PrintHeader()
+{
+	MosPrintf(MIL_TEXT("[EXAMPLE NAME]\n")
+	          MIL_TEXT("Micro-Epsilon_scanCONTROL_M10PP3\n\n")
+
+	          MIL_TEXT("[SYNOPSIS]\n")
+	          MIL_TEXT("This program acquires 3d data using a MicroEpsilon scanControl.\n")
+	          MIL_TEXT("The 3d data from the scanner is grabbed using the GigeVision\n")
+	          MIL_TEXT("interface provided by MicroEpsilon.\n\n")
+             
+	          MIL_TEXT("[MODULES USED]\n")
+	          MIL_TEXT("Modules used: application, system, display, buffer, calibration,\n")
+	          MIL_TEXT("              image processing.\n\n")
+             MIL_TEXT("Press <Enter> to start.\n\n"));
+   MosGetch();
+}
+
+//*****************************************************************************
+// Acquisition parameter.
+//*****************************************************************************
+static const MIL_INT MIN_GRAB_TIMEOUT = 5000; // in ms
+static const MIL_INT NB_PROFILES_PER_GRAB = 100;
+
+static const MIL_DOUBLE CONVEYOR_SPEED = 0.05; // in mm/frame
+
+// Reference profile of the belt, averaged over the first blocks, which must
+// be empty. The processes then get the heights above the belt and the points
+// within the tolerance of the belt are invalid. 0 blocks keeps the absolute Z;
+// 10 blocks is a typical capture. The points within the tracking band follow
+// the drift of the belt, with a half-life in blocks. A band of 0 keeps the
+// belt static.
+static const MIL_INT    BELT_NB_REFERENCE_BLOCKS = 0;
+static const MIL_DOUBLE BELT_TOLERANCE = 0.2;     // in mm
+static const MIL_DOUBLE BELT_TRACKING_BAND = 1.0; // in mm
+static const MIL_INT    BELT_TRACKING_HALF_LIFE = 50;
+
+// Detection of the blocks that only contain the empty belt, on a sample of
+// their raw codes. Their conversion and processing are skipped, their rows
+// are cleared like the points of the belt within its tolerance, and their
+// samples track the drift of the belt. The belt is the belt reference, so
+// the detection needs BELT_NB_REFERENCE_BLOCKS > 0.
+static const bool       EMPTY_BLOCK_DETECTION = false;
+static const MIL_DOUBLE EMPTY_BLOCK_HEIGHT_THRESHOLD = 1.0; // in mm
+static const MIL_INT    EMPTY_BLOCK_COLUMN_STEP = 8;
+static const MIL_INT    EMPTY_BLOCK_ROW_STEP = 4;
+static const MIL_INT    EMPTY_BLOCK_MAX_OUTLIERS = 4;
+
+// Continuous depth map parameters.
+static const MIL_INT DEPTH_MAP_LENGTH = 20000;        // in rows
+static const MIL_INT DEPTH_MAP_DISPLAY_LENGTH = 1000; // in rows
+
+// Rasterization of the depth map. The highest point of a cell keeps the tops
+// of the parts; CELL_MEAN_Z reduces the noise. 0 workers uses all the cores.
+static const ECellPolicy DEPTH_MAP_CELL_POLICY = CELL_MAX_Z;
+static const MIL_INT     DEPTH_MAP_NB_WORKERS = 0;
+
+// Resolution of the depth map, independent of the sensor settings. A coarse
+// grid gives small maps for presence checks; a fine grid keeps all the
+// details for gauging. 0 uses the resolution of the profiles.
+static const MIL_DOUBLE DEPTH_MAP_PIXEL_SIZE_X = 0.0; // in mm
+static const MIL_DOUBLE DEPTH_MAP_PIXEL_SIZE_Y = 0.0; // in mm
+
+// Largest hole of the depth map filled by interpolation, such as the
+// occlusion shadows behind the parts. 0 does not fill the holes.
+static const MIL_INT DEPTH_MAP_MAX_HOLE_SIZE = 16; // in cells
+
+// Out-of-core storage of the whole scan. The completed tiles are compressed
+// in a spill file, deleted at the end. M_NULL does not keep the tiles; set a
+// file name such as MIL_TEXT("DepthMapTiles.tmp") to keep them.
+static MIL_CONST_TEXT_PTR DEPTH_MAP_SPILL_FILE = M_NULL;
+static const MIL_INT DEPTH_MAP_TILE_ROWS = 1000; // in rows
+
+// Number of reduced levels of the min, max and mean pyramid of the depth map,
+// for the overviews and the coarse to fine searches. 0 for no pyramid; 4
+// levels reduce a row of 1280 cells to 80.
+static const MIL_INT DEPTH_MAP_NB_PYRAMID_LEVELS = 0;
+
+// Segmentation of the parts in the depth map. The parts are the connected
+// cells higher than PART_MIN_Z, above the belt if its reference is captured.
+static const bool       SEGMENT_PARTS = false;
+static const MIL_DOUBLE PART_MIN_Z = 0.5;   // in mm
+static const MIL_INT    PART_MIN_CELLS = 50;
+
+// Inspection of the parts against a golden part, saved as a depth map of
+// the same grid. M_NULL learns the first part as the golden part. The parts
+// with fewer than PART_MIN_CELLS cells are noise and are not inspected.
+static const bool         INSPECT_PARTS = false;
+static MIL_CONST_TEXT_PTR GOLDEN_PART_FILE = M_NULL;
+static const MIL_DOUBLE   INSPECTION_TOLERANCE = 0.3; // in mm
+static const MIL_INT      INSPECTION_MAX_OUT_OF_TOLERANCE = 100;
+
+// Organized point cloud of the profiles, with the normals and the curvatures
+// of the points computed from their neighbors in the grid.
+static const bool COMPUTE_NORMALS = false;
+
+// Streaming triangle mesh of the profiles. The triangles that span a Z gap
+// larger than the one of the D3D display are skipped.
+static const bool GENERATE_MESH = false;
+
+// Decimated point set of the whole scan, with one point per occupied voxel.
+// A VOXEL_SIZE of 0 does not accumulate the points; 0.5 mm is a typical size.
+static const MIL_DOUBLE   VOXEL_SIZE = 0.0;   // in mm
+static const EVoxelPolicy VOXEL_POLICY = VOXEL_CENTROID;
+
+// Spatial index of the points of the last part of the scan, for the range,
+// nearest point and height queries. A cell size of 0 does not index the
+// points; 2 mm is a typical size. A length of 0 keeps the whole scan, whose
+// memory then grows without bound.
+static const MIL_DOUBLE POINT_INDEX_CELL_SIZE = 0.0; // in mm
+static const MIL_DOUBLE POINT_INDEX_LENGTH = 100.0;  // in mm
+
+// Highest rate of the colorized previews of the depth map, for the viewers
+// that do not use the MIL display. A rate of 0 does not colorize previews;
+// 5 Hz is a typical rate.
+static const MIL_DOUBLE PREVIEW_RATE = 0.0; // in Hz
+
+// Fusion of the depth maps of several sensors on a shared grid, instead of
+// the depth map of the sensor. The example drives a single head, which is
+// fused at its pose, rotated around Y and offset, in the fused display.
+static const bool          FUSE_DEPTH_MAPS = false;
+static const EFusionPolicy FUSION_POLICY = FUSION_MAX_Z;
+static const MIL_DOUBLE    SENSOR_ANGLE_Y = 0.0;  // in degrees
+static const MIL_DOUBLE    SENSOR_OFFSET_X = 0.0; // in mm
+static const MIL_DOUBLE    SENSOR_OFFSET_Y = 0.0; // in mm, along the conveyor
+static const MIL_DOUBLE    SENSOR_OFFSET_Z = 0.0; // in mm
+
+// Allocation of the grab and data conversion buffers. Blocks of at least
+// LARGE_PAGE_MIN_SIZE are backed by large pages when the process is allowed
+// to allocate them.
+static const MIL_INT HOST_ROW_ALIGNMENT = 64;               // in bytes
+static const bool    USE_LARGE_PAGES = true;
+static const MIL_INT LARGE_PAGE_MIN_SIZE = 2 * 1024 * 1024; // in bytes
+
+static MIL_CONST_TEXT_PTR EXPECTED_DEVICE_VENDOR = MIL_TEXT("MICRO-EPSILON Optronic GmbH");
+static const MIL_INT NB_MODELS = 2;
+static MIL_STRING EXPECTED_DEVICE_MODEL[NB_MODELS] =
+   {
+   MIL_TEXT("scanCONTROL 26"),
+   MIL_TEXT("scanCONTROL 29"),
+   };
+
+
+// Definition of the valid ranges in decreasing order.
+static const MIL_INT NB_RANGE = 4;
+static MIL_STRING EXPECTED_RANGE[NB_RANGE] =
+   {
+   MIL_TEXT("100"),
+   MIL_TEXT("50"),
+   MIL_TEXT("25"),
+   MIL_TEXT("10")
+   };
+
+static const MIL_DOUBLE CONV_S[NB_RANGE] = {0.005, 0.002, 0.001, 0.0005};
+static const MIL_DOUBLE CONV_OFF[NB_RANGE] = {250.0, 95.0, 65.0, 55.0};
+static const SPCal CONVPCAL[NB_RANGE] =
+   {
+      {-32768 * CONV_S[0], -32768 * CONV_S[0] + CONV_OFF[0], CONV_S[0], CONV_S[0]},
+      {-32768 * CONV_S[1], -32768 * CONV_S[1] + CONV_OFF[1], CONV_S[1], CONV_S[1]},
+      {-32768 * CONV_S[2], -32768 * CONV_S[2] + CONV_OFF[2], CONV_S[2], CONV_S[2]},
+      {-32768 * CONV_S[3], -32768 * CONV_S[3] + CONV_OFF[3], CONV_S[3], CONV_S[3]}
+   };
+
+static const SPRange PRANGE[NB_RANGE] =
+   {
+      {-143.5 / 2, 125.0, 143.5 / 2, 390.0},
+      {-60.0  / 2, 65.0 , 60.0  / 2, 125.0},
+      {-29.3  / 2, 53.0 , 29.3  / 2, 79.0},
+      {-10.7  / 2, 52.5 , 10.7  / 2, 60.5}
+   };
+
+//*****************************************************************************
+// Prototypes.
+//*****************************************************************************
+MIL_INT ChooseProfileMode();
+bool VerifyDeviceCompatibility(MIL_ID MilDigitizer, MIL_INT* pCameraModeIndex);
+MIL_INT SetupCamera(MIL_ID MilDigitizer, MIL_INT NbProfiles);
+MIL_INT GetContainerResolution(MIL_ID MilDigitizer);
+SPDepthMapGrid GetFusionGrid(const SPRange& DataRange, const SPSensorPose& Pose, MIL_INT ProfileSize);
+
+//*****************************************************************************
+int MosMain(void)
+   {
+   PrintHeader();
+
+   // Allocate the application.
+   MIL_ID MilApplication = MappAlloc(M_DEFAULT, M_NULL);
+
+   // Try to allocate the GigE Vision(R) system and digitizer.
+   MappControl(M_ERROR, M_PRINT_DISABLE);
+   MIL_ID MilSystem = MsysAlloc(M_SYSTEM_GIGE_VISION, M_DEFAULT, M_DEFAULT, M_NULL);
+   MIL_ID MilDigitizer = MdigAlloc(MilSystem, M_DEFAULT, MIL_TEXT("M_DEFAULT"), M_DEFAULT, M_NULL);
+   
+   // Verify the compatibility of the camera and get the model index.
+   MIL_INT CameraModelIndex;
+   if(MappGetError(M_CURRENT, M_NULL) == M_NULL_ERROR && VerifyDeviceCompatibility(MilDigitizer, &CameraModelIndex))
+      {
+      // Choose the profile process.
+      MIL_INT NbProfiles = ChooseProfileMode();
+
+      // Set up the camera mode for the example.
+      MIL_INT ProfileSize = SetupCamera(MilDigitizer, NbProfiles);
+      
+      // Set the allocation policy of the host buffers.
+      SPAllocPolicy AllocPolicy;
+      AllocPolicy.RowAlignment = HOST_ROW_ALIGNMENT;
+      AllocPolicy.UseLargePages = USE_LARGE_PAGES;
+      AllocPolicy.LargePageMinSize = LARGE_PAGE_MIN_SIZE;
+
+      // Allocate the grab buffers with aligned rows.
+      MIL_ID MilGrabBuffers[2];
+      SPHostMemory GrabMemory[2];
+      MIL_INT ImageSizeX = MdigInquire(MilDigitizer, M_SIZE_X, M_NULL);
+      MIL_INT ImageSizeY = MdigInquire(MilDigitizer, M_SIZE_Y, M_NULL);
+      MIL_INT ImageSizeBit = MdigInquire(MilDigitizer, M_SIZE_BIT, M_NULL);
+      for(MIL_INT b = 0; b < 2; b++)
+         {
+         MilGrabBuffers[b] = AllocHostBuffer2d(MilSystem, ImageSizeX, ImageSizeY, ImageSizeBit + M_UNSIGNED,
+                                               M_IMAGE + M_PROC + M_GRAB + M_DISP, AllocPolicy, GrabMemory[b]);
+         }
+      MosPrintf(MIL_TEXT("Grab buffers: %s, pitch of %d bytes.\n"), GetHostMemoryKindName(GrabMemory[0].Kind),
+                (int)MbufInquire(MilGrabBuffers[0], M_PITCH_BYTE, M_NULL));
+
+      // Try grabbing an image.
+      MdigGrab(MilDigitizer, MilGrabBuffers[0]);
+
+      if(MappGetError(M_CURRENT, M_NULL) == M_NULL_ERROR)
+         {
+         MappControl(M_ERROR, M_PRINT_ENABLE);
+
+         // Set the reference profile of the belt. The heights above the belt
+         // range from 0 to the depth of the measuring field.
+         SPBeltSettings BeltSettings;
+         BeltSettings.NbReferenceBlocks = BELT_NB_REFERENCE_BLOCKS;
+         BeltSettings.Tolerance = BELT_TOLERANCE;
+         BeltSettings.TrackingBand = BELT_TRACKING_BAND;
+         BeltSettings.TrackingHalfLife = BELT_TRACKING_HALF_LIFE;
+         SPRange DataRange = PRANGE[CameraModelIndex];
+         if(BeltSettings.NbReferenceBlocks > 0)
+            {
+            DataRange.MaxZ -= DataRange.MinZ;
+            DataRange.MinZ = 0.0;
+            MosPrintf(MIL_TEXT("The belt reference is captured on the first %d blocks.\n")
+                      MIL_TEXT("Keep the belt empty until then.\n\n"), (int)BeltSettings.NbReferenceBlocks);
+            }
+
+         // Allocate the profile processing object.
+         CProfileProcess* pProfileProcess;
+         CProfileDepthMapProcess* pDepthMapProcess = M_NULL;
+         CDepthMapFusion* pFusion = M_NULL;
+         if(NbProfiles == 1)
+            pProfileProcess = new CProfileSingleProcess(MilSystem, CONVPCAL[CameraModelIndex],
+                                                        DataRange, ProfileSize, BeltSettings);
+         else if(FUSE_DEPTH_MAPS)
+            {
+            SPSensorPose Pose;
+            Pose.AngleY = SENSOR_ANGLE_Y;
+            Pose.OffsetX = SENSOR_OFFSET_X;
+            Pose.OffsetY = SENSOR_OFFSET_Y;
+            Pose.OffsetZ = SENSOR_OFFSET_Z;
+            pFusion = new CDepthMapFusion(MilSystem, GetFusionGrid(DataRange, Pose, ProfileSize), 1,
+                                          FUSION_POLICY, DEPTH_MAP_LENGTH, DEPTH_MAP_DISPLAY_LENGTH);
+            pProfileProcess = new CProfileFusionProcess(MilSystem, CONVPCAL[CameraModelIndex], DataRange,
+                                                        Pose, CONVEYOR_SPEED, ProfileSize, NB_PROFILES_PER_GRAB,
+                                                        BeltSettings, DEPTH_MAP_CELL_POLICY,
+                                                        DEPTH_MAP_NB_WORKERS, *pFusion, 0);
+            }
+         else
+            {
+            SPDepthMapSettings DepthMapSettings;
+            DepthMapSettings.MapLength = DEPTH_MAP_LENGTH;
+            DepthMapSettings.DisplayLength = DEPTH_MAP_DISPLAY_LENGTH;
+            DepthMapSettings.CellPolicy = DEPTH_MAP_CELL_POLICY;
+            DepthMapSettings.NbWorkers = DEPTH_MAP_NB_WORKERS;
+            DepthMapSettings.PixelSizeX = DEPTH_MAP_PIXEL_SIZE_X;
+            DepthMapSettings.PixelSizeY = DEPTH_MAP_PIXEL_SIZE_Y;
+            DepthMapSettings.MaxHoleSize = DEPTH_MAP_MAX_HOLE_SIZE;
+            DepthMapSettings.SpillFileName = DEPTH_MAP_SPILL_FILE;
+            DepthMapSettings.TileRows = DEPTH_MAP_TILE_ROWS;
+            DepthMapSettings.NbPyramidLevels = DEPTH_MAP_NB_PYRAMID_LEVELS;
+            DepthMapSettings.SegmentParts = SEGMENT_PARTS;
+            DepthMapSettings.PartMinZ = PART_MIN_Z;
+            DepthMapSettings.PartMinCells = PART_MIN_CELLS;
+            DepthMapSettings.InspectParts = INSPECT_PARTS;
+            DepthMapSettings.GoldenFileName = GOLDEN_PART_FILE;
+            DepthMapSettings.InspectionTolerance = INSPECTION_TOLERANCE;
+            DepthMapSettings.MaxOutOfTolerance = INSPECTION_MAX_OUT_OF_TOLERANCE;
+            DepthMapSettings.ComputeNormals = COMPUTE_NORMALS;
+            DepthMapSettings.GenerateMesh = GENERATE_MESH;
+            DepthMapSettings.VoxelSize = VOXEL_SIZE;
+            DepthMapSettings.VoxelPolicy = VOXEL_POLICY;
+            DepthMapSettings.IndexCellSize = POINT_INDEX_CELL_SIZE;
+            DepthMapSettings.IndexLength = POINT_INDEX_LENGTH;
+            DepthMapSettings.PreviewRate = PREVIEW_RATE;
+            pDepthMapProcess = new CProfileDepthMapProcess(MilSystem, CONVPCAL[CameraModelIndex],
+                                                           DataRange, 0.0,
+                                                           CONVEYOR_SPEED, ProfileSize, NB_PROFILES_PER_GRAB,
+                                                           BeltSettings, DepthMapSettings);
+            pProfileProcess = pDepthMapProcess;
+            }
+
+         // Allocate the interface between MicroEpsilon and MIL.
+         CMicroEpsilonToMIL MicroEpsilonToMILInterface(ProfileSize, NbProfiles);
+         MicroEpsilonToMILInterface.BuildInterface(MilDigitizer, MilGrabBuffers[0], pProfileProcess, AllocPolicy);
+
+         // Enable the detection of the empty blocks.
+         SPEmptyBlockSettings EmptyBlockSettings;
+         EmptyBlockSettings.Enable = EMPTY_BLOCK_DETECTION;
+         EmptyBlockSettings.HeightThreshold = EMPTY_BLOCK_HEIGHT_THRESHOLD;
+         EmptyBlockSettings.ColumnStep = EMPTY_BLOCK_COLUMN_STEP;
+         EmptyBlockSettings.RowStep = EMPTY_BLOCK_ROW_STEP;
+         EmptyBlockSettings.MaxOutliers = EMPTY_BLOCK_MAX_OUTLIERS;
+         MicroEpsilonToMILInterface.EnableEmptyBlockDetection(EmptyBlockSettings, CONVPCAL[CameraModelIndex]);
+
+         // Process 3d data.
+         MdigProcess(MilDigitizer, MilGrabBuffers, 2, M_START, M_DEFAULT,
+                     CMicroEpsilonToMIL::MilInterfaceHook, &MicroEpsilonToMILInterface);
+
+         // Wait for the user to stop the grab and terminate the application.
+         MosPrintf(MIL_TEXT("Press <Enter> to end.\n\n"));
+         MosGetch();
+         MdigProcess(MilDigitizer, MilGrabBuffers, 2, M_STOP, M_DEFAULT,
+                     CMicroEpsilonToMIL::MilInterfaceHook, &MicroEpsilonToMILInterface);
+
+         // Complete the depth map with its last rows.
+         if(pDepthMapProcess)
+            pDepthMapProcess->EndScan();
+
+         // Report the work avoided on the empty blocks.
+         const CEmptyBlockDetector* pDetector = MicroEpsilonToMILInterface.GetEmptyBlockDetector();
+         if(pDetector && pDetector->GetNbBlocks())
+            {
+            MosPrintf(MIL_TEXT("Empty blocks skipped: %d of %d (%.1f%%), %.0f points not converted.\n\n"),
+                      (int)pDetector->GetNbEmptyBlocks(), (int)pDetector->GetNbBlocks(),
+                      100.0 * pDetector->GetNbEmptyBlocks() / pDetector->GetNbBlocks(),
+                      (MIL_DOUBLE)pDetector->GetNbSkippedPoints());
+            }
+
+         // Report the out-of-core tiles of the scan.
+         const CDepthMapTileStore* pTileStore = pDepthMapProcess ? pDepthMapProcess->GetTileStore() : M_NULL;
+         if(pTileStore && pTileStore->GetNbTiles())
+            {
+            MosPrintf(MIL_TEXT("Tiles: %d tiles of up to %d rows, %.0f rows, %.1f MB compressed from %.1f MB.\n\n"),
+                      (int)pTileStore->GetNbTiles(), (int)pTileStore->GetTileRows(),
+                      (MIL_DOUBLE)pTileStore->GetNbRowsStored(),
+                      pTileStore->GetStoredBytes() / (1024.0 * 1024.0),
+                      pTileStore->GetRawBytes() / (1024.0 * 1024.0));
+            }
+
+         // Report the decimation of the scan in voxels.
+         const CVoxelAccumulator* pVoxels = pDepthMapProcess ? pDepthMapProcess->GetVoxelAccumulator() : M_NULL;
+         if(pVoxels && pVoxels->GetNbPointsAdded())
+            {
+            MosPrintf(MIL_TEXT("Voxels (%s): %.0f points decimated to %.0f voxels of %.2f mm, %.1f MB.\n\n"),
+                      GetVoxelPolicyName(VOXEL_POLICY), (MIL_DOUBLE)pVoxels->GetNbPointsAdded(),
+                      (MIL_DOUBLE)pVoxels->GetNbVoxels(), VOXEL_SIZE,
+                      pVoxels->GetMemorySize() / (1024.0 * 1024.0));
+            }
+
+         // Report the size of the mesh of the scan.
+         const CProfileMesher* pMesher = pDepthMapProcess ? pDepthMapProcess->GetMesher() : M_NULL;
+         if(pMesher && pMesher->GetNbTriangles())
+            {
+            MosPrintf(MIL_TEXT("Mesh: %.0f vertices, %.0f triangles.\n\n"),
+                      (MIL_DOUBLE)pMesher->GetNbVertices(), (MIL_DOUBLE)pMesher->GetNbTriangles());
+            }
+
+         // Query the highest indexed point.
+         const CPointIndex* pPointIndex = pDepthMapProcess ? pDepthMapProcess->GetPointIndex() : M_NULL;
+         SPIndexPoint HighestPoint;
+         if(pPointIndex && pPointIndex->FindHighestPoint(-DBL_MAX, -DBL_MAX, DBL_MAX, DBL_MAX,
+                                                         HighestPoint))
+            {
+            MosPrintf(MIL_TEXT("Point index: %.0f points, %.0f dropped, ")
+                      MIL_TEXT("highest point at (%.2f, %.2f, %.2f) mm.\n\n"),
+                      (MIL_DOUBLE)pPointIndex->GetNbPoints(), (MIL_DOUBLE)pPointIndex->GetNbPointsDropped(),
+                      HighestPoint.X, HighestPoint.Y, HighestPoint.Z);
+            }
+
+         // Report the colorized previews.
+         const CDepthMapColorizer* pColorizer = pDepthMapProcess ? pDepthMapProcess->GetColorizer() : M_NULL;
+         if(pColorizer)
+            {
+            MosPrintf(MIL_TEXT("Previews: %d of %d x %d pixels colorized at up to %.1f Hz.\n\n"),
+                      (int)pColorizer->GetNbPreviews(), (int)pColorizer->GetSizeX(),
+                      (int)pColorizer->GetSizeY(), PREVIEW_RATE);
+            }
+
+         // Report the fused depth map.
+         if(pFusion)
+            {
+            MosPrintf(MIL_TEXT("Fusion (%s): %.0f rows fused, %.0f overlap cells.\n\n"),
+                      GetFusionPolicyName(pFusion->GetPolicy()), (MIL_DOUBLE)pFusion->GetNbFusedRows(),
+                      (MIL_DOUBLE)pFusion->GetNbOverlapCells());
+            }
+
+         // Free the profile process, then the fusion of its depth map.
+         delete pProfileProcess;
+         delete pFusion;
+         }
+      else
+         {
+         MosPrintf(MIL_TEXT("Unable to grab from the MicroEpsilon scanControl camera!\n")
+                   MIL_TEXT("Verify the configuration of the camera:\n")
+                   MIL_TEXT("   - Profile frequency vs measuring field.\n")
+                   MIL_TEXT("   - ...\n")
+                   MIL_TEXT("The default configuration of the camera upon powerup should work.\n\n")
+                   MIL_TEXT("Press <Enter> to end.\n"));
+         MosGetch();
+         }      
+
+      // Free the grab buffers
+      FreeHostBuffer(MilGrabBuffers[1], GrabMemory[1]);
+      FreeHostBuffer(MilGrabBuffers[0], GrabMemory[0]);
+      }
+   else
+      {
+      MosPrintf(MIL_TEXT("The example requires the following conditions to run:\n")
+                MIL_TEXT("   - MIL GigE Vision(R) driver must be installed.\n")
+                MIL_TEXT("   - An actual MicroEpsilon scanControl must be\n")
+                MIL_TEXT("     connected to your computer or network.\n\n")
+                MIL_TEXT("Press <Enter> to end.\n"));
+      MosGetch();
+      }
+
+   // Free the MIL objects.
+   MdigFree(MilDigitizer);
+   MsysFree(MilSystem);
+   MappFree(MilApplication);
+
+	return 0;
+   }
+
+//*****************************************************************************
+// Ask the user to choose a profile mode. Allocate the profile process.
+//*****************************************************************************
+MIL_INT ChooseProfileMode()
+   {
+   while(1)
+      {
+      MosPrintf(MIL_TEXT("Please choose the profile mode of the example.\n")
+                MIL_TEXT("   a. Single profile mode.\n")
+                MIL_TEXT("   b. Multiple profiles mode.\n\n"));
+      switch(MosGetch())
+         {
+         case MIL_TEXT('a'):
+         case MIL_TEXT('A'):
+            MosPrintf(MIL_TEXT("Single profile mode\n")
+                      MIL_TEXT("--------------------\n")
+                      MIL_TEXT("The camera is configured to transmit one profile per frame.\n")
+                      MIL_TEXT("The profile is first converted to 3d points. The points are then displayed in\n")
+                      MIL_TEXT("the camera world system. The displayed gray region represents the bounding\n")
+                      MIL_TEXT("area of meaurement specified by the scanControl camera.\n\n"));
+            return 1;
+            break;
+           
+         case MIL_TEXT('b'):
+         case MIL_TEXT('B'):            
+            MosPrintf(MIL_TEXT("Multiple profiles mode\n")
+                      MIL_TEXT("-----------------------\n")
+                      MIL_TEXT("The camera is configured to transmit multiple profiles per frame.\n")
+                      MIL_TEXT("The profiles are first converted to a MIL 3d point cloud. The point cloud\n")
+                      MIL_TEXT("is then extracted into a calibrated depth map that is displayed.\n\n"));
+            return NB_PROFILES_PER_GRAB;
+         default:
+            break;
+         }
+      } 
+   }
+
+//*****************************************************************************
+// Checks whether the GigE Vision(R) camera used is expected.
+//*****************************************************************************
+bool VerifyDeviceCompatibility(MIL_ID MilDigitizer, MIL_INT* pCameraRangeIndex)
+   {
+   *pCameraRangeIndex = -1;
+
+   // Get the device vendor.
+   MIL_INT64 DeviceVendorNameStringSize = 0;
+   MdigInquireFeature(MilDigitizer, M_FEATURE_VALUE + M_STRING_SIZE, MIL_TEXT("DeviceVendorName"),
+                      M_TYPE_INT64, &DeviceVendorNameStringSize);
+   MIL_TEXT_PTR DeviceVendorNamePtr = new MIL_TEXT_CHAR[(MIL_INT)DeviceVendorNameStringSize];
+   MdigInquireFeature(MilDigitizer, M_FEATURE_VALUE, MIL_TEXT("DeviceVendorName"),
+                      M_TYPE_STRING, DeviceVendorNamePtr);
+
+   if(MosStrcmp(DeviceVendorNamePtr, EXPECTED_DEVICE_VENDOR) == 0)
+      {
+      // Get the device model.
+      MIL_INT64 DeviceModelNameStringSize = 0;
+      MdigInquireFeature(MilDigitizer, M_FEATURE_VALUE + M_STRING_SIZE, MIL_TEXT("DeviceModelName"),
+                         M_TYPE_INT64, &DeviceModelNameStringSize);
+      MIL_TEXT_PTR DeviceModelNamePtr = new MIL_TEXT_CHAR[(MIL_INT)DeviceModelNameStringSize];
+      MdigInquireFeature(MilDigitizer, M_FEATURE_VALUE, MIL_TEXT("DeviceModelName"),
+                         M_TYPE_STRING, &DeviceModelNamePtr[0]);
+
+      // Check the model.
+      MIL_STRING DeviceModelName(DeviceModelNamePtr);
+      for(MIL_INT m = 0; m < NB_MODELS; m++)
+         {
+         size_t pos = DeviceModelName.find(EXPECTED_DEVICE_MODEL[m]);
+         if(pos != MIL_STRING::npos)
+            {
+            // Verify that the model name is long enough.
+            MIL_INT MaxRangeName = EXPECTED_RANGE[0].length();
+            if(DeviceModelName.length() >= (pos + EXPECTED_DEVICE_MODEL[m].length() + MaxRangeName))
+               {
+               // Check the range.
+               MIL_STRING RangeName = DeviceModelName.substr(pos + EXPECTED_DEVICE_MODEL[m].length() + MaxRangeName);
+               for(MIL_INT m = 0; m < NB_RANGE; m++)
+                  {
+               if(RangeName.find(EXPECTED_RANGE[m]) != MIL_STRING::npos)
+                     {
+                     *pCameraRangeIndex = m;
+                     break;
+                     }
+                  }
+               }
+            break;
+            }
+         }
+      
+      delete[] DeviceModelNamePtr;
+      }
+
+   delete[] DeviceVendorNamePtr;
+
+   return *pCameraRangeIndex >= 0;
+   }
+
+//*****************************************************************************
+// SetupCamera. Minimal setup of the camera to be in a mode that is easy to
+//              interface with MIL.
+//*****************************************************************************
+MIL_INT SetupCamera(MIL_ID MilDigitizer, MIL_INT NbProfiles)
+   {
+   // Set the camera in container mode.
+   MdigControlFeature(MilDigitizer, M_FEATURE_VALUE, MIL_TEXT("TransmissionType"),
+                      M_TYPE_STRING, MIL_TEXT("TypeContainer"));
+   MdigControlFeature(MilDigitizer, M_FEATURE_VALUE, MIL_TEXT("PixelFormat"),
+                      M_TYPE_STRING, MIL_TEXT("Mono16"));
+
+   // Enable the Z and the X content and disable the others.
+   MIL_BOOL Enable = M_TRUE;
+   MdigControlFeature(MilDigitizer, M_FEATURE_VALUE, MIL_TEXT("ContainerZ"), M_TYPE_BOOLEAN, &Enable);
+   MdigControlFeature(MilDigitizer, M_FEATURE_VALUE, MIL_TEXT("ContainerX"), M_TYPE_BOOLEAN, &Enable);
+   Enable = M_FALSE;
+   MdigControlFeature(MilDigitizer, M_FEATURE_VALUE, MIL_TEXT("ContainerH"), M_TYPE_BOOLEAN, &Enable);
+   MdigControlFeature(MilDigitizer, M_FEATURE_VALUE, MIL_TEXT("ContainerW"), M_TYPE_BOOLEAN, &Enable);
+   MdigControlFeature(MilDigitizer, M_FEATURE_VALUE, MIL_TEXT("ContainerM01"), M_TYPE_BOOLEAN, &Enable);
+   MdigControlFeature(MilDigitizer, M_FEATURE_VALUE, MIL_TEXT("ContainerM02"), M_TYPE_BOOLEAN, &Enable);
+   MdigControlFeature(MilDigitizer, M_FEATURE_VALUE, MIL_TEXT("ContainerTS"), M_TYPE_BOOLEAN, &Enable);
+
+   // Set the packet size to the value recommended by MicroEpsilon.
+   MIL_INT64 GevSCPSPacketSize = 356;
+   MdigControlFeature(MilDigitizer, M_FEATURE_VALUE, MIL_TEXT("GevSCPSPacketSize"),
+                      M_TYPE_INT64, &GevSCPSPacketSize);
+
+   // Always enable the calibration of the data.
+   Enable = M_TRUE;
+   MdigControlFeature(MilDigitizer, M_FEATURE_VALUE, MIL_TEXT("Calibration"), M_TYPE_BOOLEAN, &Enable);
+
+   // Get the size of the profile.
+   MIL_INT ProfileSize = GetContainerResolution(MilDigitizer);
+
+   // Set the grab image accordingly.
+   MIL_INT64 Width = ProfileSize * 2;
+   MdigControlFeature(MilDigitizer, M_FEATURE_VALUE, MIL_TEXT("Width"), M_TYPE_INT64, &Width);
+   MIL_INT64 Height = NbProfiles;
+   MdigControlFeature(MilDigitizer, M_FEATURE_VALUE, MIL_TEXT("Height"), M_TYPE_INT64, &Height);
+
+   // Get the profile rate of the camera.
+   MIL_DOUBLE ProfileFrequencyInHz = 0;
+   MdigInquireFeature(MilDigitizer, M_FEATURE_VALUE, MIL_TEXT("AcquisitionFrameRate"),
+                      M_TYPE_DOUBLE, &ProfileFrequencyInHz);
+
+   // Set the grab timeout.
+   MIL_DOUBLE GrabTimeout = 2 * Height * 1000.0 / ProfileFrequencyInHz;
+   GrabTimeout = GrabTimeout < MIN_GRAB_TIMEOUT ? MIN_GRAB_TIMEOUT : GrabTimeout;
+   MdigControl(MilDigitizer, M_GRAB_TIMEOUT, GrabTimeout);
+   
+   return ProfileSize;
+   }
+
+//*****************************************************************************
+// GetContainerResolution. Gets the resolution of the container.
+//*****************************************************************************
+MIL_INT GetContainerResolution(MIL_ID MilDigitizer)
+   {  
+   MIL_INT ContainerResolution = 0;
+   MIL_INT64 EntryToRead = 0; 
+   MdigInquireFeature(MilDigitizer, M_FEATURE_VALUE, MIL_TEXT("ContainerResolution"),
+                      M_TYPE_INT64, &EntryToRead);
+
+   MIL_INT Count = 0;
+   MdigInquireFeature(MilDigitizer, M_FEATURE_ENUM_ENTRY_COUNT, MIL_TEXT("ContainerResolution"),
+                      M_TYPE_MIL_INT, &Count);
+   if(Count)
+      {
+      for(MIL_INT i = 0; i < Count; i++)
+         {
+         MIL_INT64 CurEntry;
+         MdigInquireFeature(MilDigitizer, M_FEATURE_ENUM_ENTRY_VALUE + i, MIL_TEXT("ContainerResolution"),
+                            M_TYPE_INT64, &CurEntry);
+
+         if(EntryToRead == CurEntry)
+            {
+            MIL_INT64 StringSize;
+            MdigInquireFeature(MilDigitizer, M_FEATURE_ENUM_ENTRY_DISPLAY_NAME + i + M_STRING_SIZE,
+                               MIL_TEXT("ContainerResolution"), M_TYPE_INT64, &StringSize);
+            MIL_TEXT_PTR ContainerResolutionString = new MIL_TEXT_CHAR[(MIL_INT)StringSize];
+            MdigInquireFeature(MilDigitizer, M_FEATURE_ENUM_ENTRY_DISPLAY_NAME + i,
+                               MIL_TEXT("ContainerResolution"), M_TYPE_STRING, ContainerResolutionString);
+            MIL_STRING_STREAM Stream(ContainerResolutionString);
+            Stream >> ContainerResolution;
+            delete [] ContainerResolutionString;
+            break;
+            }
+         }
+      }
+
+   return ContainerResolution;
+   }
+
+//*****************************************************************************
+// GetFusionGrid. Gets the grid of the fused depth map, which holds the
+//                measuring field of the sensor at its pose.
+//*****************************************************************************
+SPDepthMapGrid GetFusionGrid(const SPRange& DataRange, const SPSensorPose& Pose, MIL_INT ProfileSize)
+   {
+   // Bounding box of the corners of the measuring field at the pose.
+   MIL_DOUBLE Cos = cos(Pose.AngleY * 3.14159265358979323846 / 180.0);
+   MIL_DOUBLE Sin = sin(Pose.AngleY * 3.14159265358979323846 / 180.0);
+   MIL_DOUBLE CornersX[4] = {DataRange.MinX, DataRange.MaxX, DataRange.MinX, DataRange.MaxX};
+   MIL_DOUBLE CornersZ[4] = {DataRange.MinZ, DataRange.MinZ, DataRange.MaxZ, DataRange.MaxZ};
+   SPRange PoseRange = {DBL_MAX, DBL_MAX, -DBL_MAX, -DBL_MAX};
+   for(MIL_INT c = 0; c < 4; c++)
+      {
+      MIL_DOUBLE X = Cos * CornersX[c] - Sin * CornersZ[c] + Pose.OffsetX;
+      MIL_DOUBLE Z = Sin * CornersX[c] + Cos * CornersZ[c] + Pose.OffsetZ;
+      PoseRange.MinX = X < PoseRange.MinX ? X : PoseRange.MinX;
+      PoseRange.MaxX = X > PoseRange.MaxX ? X : PoseRange.MaxX;
+      PoseRange.MinZ = Z < PoseRange.MinZ ? Z : PoseRange.MinZ;
+      PoseRange.MaxZ = Z > PoseRange.MaxZ ? Z : PoseRange.MaxZ;
+      }
+
+   // The grid has the resolution of the depth map process.
+   MIL_DOUBLE ProfilePixelSizeX = (DataRange.MaxX - DataRange.MinX) / ProfileSize;
+   SPDepthMapGrid Grid;
+   Grid.PixelSizeX = DEPTH_MAP_PIXEL_SIZE_X > 0 ? DEPTH_MAP_PIXEL_SIZE_X : ProfilePixelSizeX;
+   Grid.PixelSizeY = DEPTH_MAP_PIXEL_SIZE_Y > 0 ? DEPTH_MAP_PIXEL_SIZE_Y : CONVEYOR_SPEED;
+   Grid.SizeX = (MIL_INT)ceil((PoseRange.MaxX - PoseRange.MinX) / Grid.PixelSizeX);
+   Grid.SizeY = DEPTH_MAP_LENGTH;
+   Grid.WorldPosX = PoseRange.MinX;
+   Grid.WorldPosY = 0.0;
+   Grid.WorldPosZ = PoseRange.MinZ;
+   Grid.GrayLevelSizeZ = (PoseRange.MaxZ - PoseRange.MinZ) / 65535;
+   return Grid;
+   }
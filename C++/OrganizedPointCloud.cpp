@@ -0,0 +1,118 @@
+﻿/************************************************************************************/
+/*
+* File name: OrganizedPointCloud.cpp
+*
+* Synopsis:  This file contains the implementation of the COrganizedPointCloud class
+*            that keeps the converted points organized and computes their normals.
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+#include <mil.h>
+#include <string.h>
+#include "OrganizedPointCloud.h"
+
+//*****************************************************************************
+// Constants.
+//*****************************************************************************
+
+// Minimum number of rows of a band.
+static const MIL_INT MIN_BAND_ROWS = 8;
+
+//*****************************************************************************
+// Constructor. The previous profiles are invalid before the first block.
+//*****************************************************************************
+COrganizedPointCloud::COrganizedPointCloud(MIL_INT ProfileSize, MIL_INT NbProfiles, MIL_DOUBLE WorldPosY,
+                                           MIL_DOUBLE StepY, CWorkerPool* pWorkerPool)
+   : m_ProfileSize(ProfileSize),
+     m_NbProfiles(NbProfiles),
+     m_WorldPosY(WorldPosY),
+     m_StepY(StepY),
+     m_pWorkerPool(pWorkerPool),
+     m_NormalRow(M_NULL),
+     m_NbProfilesProcessed(0)
+   {
+   MIL_INT NbPoints = ProfileSize * (NbProfiles + 2);
+   m_X.resize(NbPoints, 0);
+   m_Z.resize(NbPoints, 0);
+   m_Mask.resize(NbPoints, 0);
+
+   NbPoints = ProfileSize * NbProfiles;
+   m_NormalX.resize(NbPoints);
+   m_NormalY.resize(NbPoints);
+   m_NormalZ.resize(NbPoints);
+   m_Curvature.resize(NbPoints);
+   m_NormalMask.resize(NbPoints);
+
+   MIL_INT NbWorkers = pWorkerPool ? pWorkerPool->GetNbWorkers() : 1;
+   m_BandRows = (NbProfiles + NbWorkers - 1) / NbWorkers;
+   if(m_BandRows < MIN_BAND_ROWS)
+      m_BandRows = MIN_BAND_ROWS;
+   }
+
+//*****************************************************************************
+// Destructor.
+//*****************************************************************************
+COrganizedPointCloud::~COrganizedPointCloud()
+   {
+   }
+
+//*****************************************************************************
+// Process. Keeps the two last profiles of the previous block, copies the
+//          block after them and computes the normals of the rows that have
+//          their two neighbor rows, by bands.
+//*****************************************************************************
+void COrganizedPointCloud::Process(const MIL_FLOAT* pX, const MIL_FLOAT* pZ, const MIL_UINT8* pMask)
+   {
+   MIL_INT BlockSize = m_ProfileSize * m_NbProfiles;
+   MIL_INT KeptSize = 2 * m_ProfileSize;
+   memmove(&m_X[0], &m_X[BlockSize], KeptSize * sizeof(MIL_FLOAT));
+   memmove(&m_Z[0], &m_Z[BlockSize], KeptSize * sizeof(MIL_FLOAT));
+   memmove(&m_Mask[0], &m_Mask[BlockSize], KeptSize);
+
+   if(pX)
+      {
+      memcpy(&m_X[KeptSize], pX, BlockSize * sizeof(MIL_FLOAT));
+      memcpy(&m_Z[KeptSize], pZ, BlockSize * sizeof(MIL_FLOAT));
+      memset(&m_Mask[KeptSize], 255, BlockSize);
+      if(pMask)
+         memcpy(&m_Mask[KeptSize], pMask, BlockSize);
+      }
+   else
+      memset(&m_Mask[KeptSize], 0, BlockSize);
+   m_NbProfilesProcessed += m_NbProfiles;
+
+   MIL_INT NbBands = (m_NbProfiles + m_BandRows - 1) / m_BandRows;
+   if(m_pWorkerPool)
+      m_pWorkerPool->Run(*this, NbBands);
+   else
+      {
+      for(MIL_INT Band = 0; Band < NbBands; Band++)
+         RunItem(Band, 0);
+      }
+   }
+
+//*****************************************************************************
+// RunItem. Computes the normals of a band of rows. The bands only read the
+//          points, so they can share their border rows.
+//*****************************************************************************
+void COrganizedPointCloud::RunItem(MIL_INT Band, MIL_INT /*Worker*/)
+   {
+   MIL_INT FirstRow = Band * m_BandRows;
+   MIL_INT EndRow = FirstRow + m_BandRows < m_NbProfiles ? FirstRow + m_BandRows : m_NbProfiles;
+   MIL_FLOAT StepY = (MIL_FLOAT)m_StepY;
+   for(MIL_INT Row = FirstRow; Row < EndRow; Row++)
+      {
+      // Row r of the block is row r + 1 of the points.
+      const MIL_FLOAT* pZ[3];
+      const MIL_UINT8* pMask[3];
+      for(MIL_INT r = 0; r < 3; r++)
+         {
+         pZ[r] = &m_Z[(Row + r) * m_ProfileSize];
+         pMask[r] = &m_Mask[(Row + r) * m_ProfileSize];
+         }
+      MIL_INT Offset = Row * m_ProfileSize;
+      m_NormalRow(GetX(Row), pZ, pMask, &m_NormalX[Offset], &m_NormalY[Offset], &m_NormalZ[Offset],
+                  &m_Curvature[Offset], &m_NormalMask[Offset], m_ProfileSize, StepY);
+      }
+   }
@@ -0,0 +1,93 @@
+﻿/************************************************************************************/
+/*
+* File name: OrganizedPointCloud.h
+*
+* Synopsis:  This file contains the declaration of the COrganizedPointCloud class that
+*            keeps the converted points organized by profile and by point, as the
+*            sensor measures them, and computes their normals and curvatures from
+*            their neighbors in the grid.
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+
+#ifndef ORGANIZED_POINT_CLOUD_H
+#define ORGANIZED_POINT_CLOUD_H
+
+#include <vector>
+#include "ProfileKernels.h"
+#include "WorkerPool.h"
+
+//*****************************************************************************
+// Organized point cloud of the converted blocks.
+//
+// A row of the cloud is a profile and a column is a point of the profiles;
+// the Y of a row is the position of its profile on the conveyor. The
+// normals and the curvatures of a row need the rows before and after it, so
+// the cloud lags the conversion by one profile: the rows of a block are the
+// last profile of the previous block and all the profiles of the block but
+// the last. Before the first block, the previous profile is invalid.
+//
+// The neighbors are found in the grid, without a spatial search, and the
+// rows are split in bands processed by the workers of a pool. The rows of
+// the last block stay available until the next block.
+//*****************************************************************************
+class COrganizedPointCloud : private CParallelTask
+   {
+   public:
+      COrganizedPointCloud(MIL_INT ProfileSize, MIL_INT NbProfiles, MIL_DOUBLE WorldPosY,
+                           MIL_DOUBLE StepY, CWorkerPool* pWorkerPool);
+      virtual ~COrganizedPointCloud();
+
+      void SetKernel(PNormalRow NormalRow) { m_NormalRow = NormalRow; }
+
+      // Adds a block of converted points. pMask can be M_NULL if all the
+      // points are valid; without points, the profiles of the block are
+      // invalid.
+      void Process(const MIL_FLOAT* pX, const MIL_FLOAT* pZ, const MIL_UINT8* pMask);
+
+      // Rows of the last block.
+      MIL_INT64 GetFirstProfile() const { return m_NbProfilesProcessed - m_NbProfiles - 1; }
+      MIL_INT GetNbProfiles() const { return m_NbProfiles; }
+      MIL_INT GetProfileSize() const { return m_ProfileSize; }
+      MIL_DOUBLE GetY(MIL_INT Row) const { return m_WorldPosY + (GetFirstProfile() + Row) * m_StepY; }
+
+      // Points of a row of the last block, and their normals and mean
+      // curvatures, in 1/mm. The masks are 255 for the valid points and
+      // normals.
+      const MIL_FLOAT* GetX(MIL_INT Row) const { return &m_X[(Row + 1) * m_ProfileSize]; }
+      const MIL_FLOAT* GetZ(MIL_INT Row) const { return &m_Z[(Row + 1) * m_ProfileSize]; }
+      const MIL_UINT8* GetMask(MIL_INT Row) const { return &m_Mask[(Row + 1) * m_ProfileSize]; }
+      const MIL_FLOAT* GetNormalX(MIL_INT Row) const { return &m_NormalX[Row * m_ProfileSize]; }
+      const MIL_FLOAT* GetNormalY(MIL_INT Row) const { return &m_NormalY[Row * m_ProfileSize]; }
+      const MIL_FLOAT* GetNormalZ(MIL_INT Row) const { return &m_NormalZ[Row * m_ProfileSize]; }
+      const MIL_FLOAT* GetCurvature(MIL_INT Row) const { return &m_Curvature[Row * m_ProfileSize]; }
+      const MIL_UINT8* GetNormalMask(MIL_INT Row) const { return &m_NormalMask[Row * m_ProfileSize]; }
+
+   private:
+      virtual void RunItem(MIL_INT Band, MIL_INT Worker);
+
+      MIL_INT      m_ProfileSize;
+      MIL_INT      m_NbProfiles;
+      MIL_DOUBLE   m_WorldPosY;
+      MIL_DOUBLE   m_StepY;
+      CWorkerPool* m_pWorkerPool;
+      PNormalRow   m_NormalRow;
+      MIL_INT64    m_NbProfilesProcessed;
+      MIL_INT      m_BandRows;
+
+      // Points of the two last profiles of the previous block followed by
+      // the profiles of the block.
+      std::vector<MIL_FLOAT> m_X;
+      std::vector<MIL_FLOAT> m_Z;
+      std::vector<MIL_UINT8> m_Mask;
+
+      // Normals of the rows of the block.
+      std::vector<MIL_FLOAT> m_NormalX;
+      std::vector<MIL_FLOAT> m_NormalY;
+      std::vector<MIL_FLOAT> m_NormalZ;
+      std::vector<MIL_FLOAT> m_Curvature;
+      std::vector<MIL_UINT8> m_NormalMask;
+   };
+
+#endif // ORGANIZED_POINT_CLOUD_H
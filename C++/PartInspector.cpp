@@ -0,0 +1,186 @@
+﻿/************************************************************************************/
+/*
+* File name: PartInspector.cpp
+*
+* Synopsis:  This file contains the implementation of the CPartInspector class that
+*            compares the parts of the continuous depth map with a golden part.
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+#include <mil.h>
+#include <math.h>
+#include <string.h>
+#include "PartInspector.h"
+
+//*****************************************************************************
+// Constructor. Converts the minimum height and the tolerance to gray levels
+//              and keeps the rows of the golden depth map that have part
+//              cells, if any.
+//*****************************************************************************
+CPartInspector::CPartInspector(const SPDepthMapGrid& Grid, MIL_ID MilGoldenDepthMap, MIL_DOUBLE MinZ,
+                               MIL_INT64 MinCells, MIL_DOUBLE Tolerance, MIL_INT64 MaxOutOfTolerance)
+   : m_Grid(Grid),
+     m_DeviationRow(M_NULL),
+     m_MinCells(MinCells),
+     m_MaxOutOfTolerance(MaxOutOfTolerance),
+     m_NextRow(0),
+     m_NbParts(0),
+     m_GoldenSizeY(0),
+     m_IsInPart(false),
+     m_NbPartCells(0),
+     m_MaxDeviation(0)
+   {
+   MIL_DOUBLE MinDepth = ceil((MinZ - Grid.WorldPosZ) / Grid.GrayLevelSizeZ);
+   m_MinDepth = (MIL_UINT16)(MinDepth < 0 ? 0 : (MinDepth > MAX_DEPTH ? MAX_DEPTH : MinDepth));
+   MIL_DOUBLE ToleranceDepth = floor(Tolerance / Grid.GrayLevelSizeZ);
+   m_Tolerance = (MIL_UINT16)(ToleranceDepth < 0 ? 0 :
+                              (ToleranceDepth > MAX_DEVIATION ? MAX_DEVIATION : ToleranceDepth));
+
+   if(MilGoldenDepthMap == M_NULL)
+      return;
+
+   // Get the golden depth map and trim it to its part rows.
+   MIL_INT SizeX = Grid.SizeX;
+   MIL_INT SizeY = MbufInquire(MilGoldenDepthMap, M_SIZE_Y, M_NULL);
+   m_Golden.resize(SizeX * SizeY);
+   MbufGet2d(MilGoldenDepthMap, 0, 0, SizeX, SizeY, &m_Golden[0]);
+
+   MIL_INT FirstRow = 0;
+   while(FirstRow < SizeY && CountPartCells(&m_Golden[FirstRow * SizeX]) == 0)
+      FirstRow++;
+   MIL_INT EndRow = SizeY;
+   while(EndRow > FirstRow && CountPartCells(&m_Golden[(EndRow - 1) * SizeX]) == 0)
+      EndRow--;
+   m_Golden.erase(m_Golden.begin() + EndRow * SizeX, m_Golden.end());
+   m_Golden.erase(m_Golden.begin(), m_Golden.begin() + FirstRow * SizeX);
+   SetGoldenSizeY(EndRow - FirstRow);
+   }
+
+//*****************************************************************************
+// Destructor.
+//*****************************************************************************
+CPartInspector::~CPartInspector()
+   {
+   }
+
+//*****************************************************************************
+// Update. Inspects the final rows that were not inspected yet and keeps the
+//         inspections of the parts they completed.
+//*****************************************************************************
+void CPartInspector::Update(const CDepthMapRing& Ring, MIL_INT64 NbFinalRows)
+   {
+   m_NewInspections.clear();
+   for(; m_NextRow < NbFinalRows; m_NextRow++)
+      InspectRow(Ring.GetRow(m_NextRow), m_NextRow);
+   }
+
+//*****************************************************************************
+// InspectRow. Compares a row of a part with the golden row at the same
+//             offset, or ends the part on a row without part cells.
+//*****************************************************************************
+void CPartInspector::InspectRow(const MIL_UINT16* pRow, MIL_INT64 Row)
+   {
+   MIL_INT NbPartCells = CountPartCells(pRow);
+   if(!m_IsInPart)
+      {
+      if(NbPartCells == 0)
+         return;
+      m_IsInPart = true;
+      m_Part.Id = m_NbParts;
+      m_Part.FirstRow = Row;
+      m_Part.NbOutOfTolerance = 0;
+      m_Part.IsGolden = !HasGolden();
+      m_NbPartCells = 0;
+      m_MaxDeviation = 0;
+      }
+   else if(NbPartCells == 0)
+      {
+      EndPart(Row);
+      return;
+      }
+
+   m_NbPartCells += NbPartCells;
+   MIL_INT SizeX = m_Grid.SizeX;
+   MIL_INT Offset = (MIL_INT)(Row - m_Part.FirstRow);
+   if(m_Part.IsGolden)
+      {
+      // Learn the row.
+      m_Golden.insert(m_Golden.end(), pRow, pRow + SizeX);
+      }
+   else if(Offset < m_GoldenSizeY)
+      {
+      m_Part.NbOutOfTolerance += m_DeviationRow(pRow, &m_Golden[Offset * SizeX],
+                                                &m_PartDeviation[Offset * SizeX], &m_PartFlags[Offset * SizeX],
+                                                SizeX, m_Tolerance, m_MaxDeviation);
+      }
+   else
+      {
+      // The row is in excess.
+      m_Part.NbOutOfTolerance += NbPartCells;
+      }
+   }
+
+//*****************************************************************************
+// EndPart. Ends the part before a row and decides if it passes. The rows of
+//          the golden part that were not reached are missing. A part that
+//          is noise is dropped, with its learned rows and its deviation;
+//          otherwise, the deviation of its rows is published.
+//*****************************************************************************
+void CPartInspector::EndPart(MIL_INT64 Row)
+   {
+   m_IsInPart = false;
+   if(m_NbPartCells < m_MinCells)
+      {
+      if(m_Part.IsGolden)
+         m_Golden.clear();
+      return;
+      }
+
+   m_Part.EndRow = Row;
+   MIL_INT NbRows = (MIL_INT)(Row - m_Part.FirstRow);
+   if(m_Part.IsGolden)
+      SetGoldenSizeY(NbRows);
+   else
+      {
+      MIL_INT NbComparedRows = NbRows < m_GoldenSizeY ? NbRows : m_GoldenSizeY;
+      memcpy(&m_Deviation[0], &m_PartDeviation[0], NbComparedRows * m_Grid.SizeX * sizeof(MIL_INT16));
+      memcpy(&m_Flags[0], &m_PartFlags[0], NbComparedRows * m_Grid.SizeX * sizeof(MIL_UINT8));
+      if(NbRows < m_GoldenSizeY)
+         m_Part.NbOutOfTolerance += m_GoldenCellsToEnd[NbRows];
+      }
+
+   m_Part.MaxDeviation = m_MaxDeviation * m_Grid.GrayLevelSizeZ;
+   m_Part.Pass = m_Part.NbOutOfTolerance <= m_MaxOutOfTolerance;
+   m_NewInspections.push_back(m_Part);
+   m_NbParts++;
+   }
+
+//*****************************************************************************
+// CountPartCells. Counts the cells of a row that are higher than the
+//                 minimum height.
+//*****************************************************************************
+MIL_INT CPartInspector::CountPartCells(const MIL_UINT16* pRow) const
+   {
+   MIL_INT NbPartCells = 0;
+   for(MIL_INT x = 0; x < m_Grid.SizeX; x++)
+      NbPartCells += (pRow[x] != INVALID_DEPTH && pRow[x] >= m_MinDepth) ? 1 : 0;
+   return NbPartCells;
+   }
+
+//*****************************************************************************
+// SetGoldenSizeY. Sets the number of rows of the golden part, counts its
+//                 part cells and allocates the deviations and the flags.
+//*****************************************************************************
+void CPartInspector::SetGoldenSizeY(MIL_INT GoldenSizeY)
+   {
+   MIL_INT SizeX = m_Grid.SizeX;
+   m_GoldenSizeY = GoldenSizeY;
+   m_GoldenCellsToEnd.assign(GoldenSizeY + 1, 0);
+   for(MIL_INT y = GoldenSizeY - 1; y >= 0; y--)
+      m_GoldenCellsToEnd[y] = m_GoldenCellsToEnd[y + 1] + CountPartCells(&m_Golden[y * SizeX]);
+   m_PartDeviation.assign(GoldenSizeY * SizeX, DEVIATION_INVALID);
+   m_PartFlags.assign(GoldenSizeY * SizeX, 0);
+   m_Deviation.assign(GoldenSizeY * SizeX, DEVIATION_INVALID);
+   m_Flags.assign(GoldenSizeY * SizeX, 0);
+   }
@@ -0,0 +1,111 @@
+﻿/************************************************************************************/
+/*
+* File name: PartInspector.h
+*
+* Synopsis:  This file contains the declaration of the CPartInspector class that
+*            compares the parts of the continuous depth map with a golden part,
+*            row by row as the rows are completed, and decides if each part
+*            passes as soon as its last row has passed.
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+
+#ifndef PART_INSPECTOR_H
+#define PART_INSPECTOR_H
+
+#include <vector>
+#include "DepthMapRing.h"
+
+//*****************************************************************************
+// Structure defining the inspection of a part.
+//*****************************************************************************
+struct SPInspection
+   {
+   MIL_INT64  Id;                // Index of the part, from 0.
+   MIL_INT64  FirstRow;
+   MIL_INT64  EndRow;            // Row after the last row of the part.
+   MIL_INT64  NbOutOfTolerance;  // Cells out of tolerance, missing or in excess.
+   MIL_DOUBLE MaxDeviation;      // Largest deviation of the cells of both parts, in mm.
+   bool       Pass;
+   bool       IsGolden;          // The part was learned as the golden part.
+   };
+
+//*****************************************************************************
+// Inspection of the parts against a golden part. The rows of a part are
+// the consecutive rows that have cells higher than the minimum height; the
+// parts are inspected one at a time and must be placed at the X of the
+// golden part. Each row of a part is compared, as soon as it is final,
+// with the row of the golden part at the same offset from the first row.
+// The rows of the part past the end of the golden part are in excess, the
+// rows of the golden part past the end of the part are missing. The parts
+// with fewer part cells than the minimum, like those of the segmenter, are
+// noise: they are neither learned nor reported.
+//
+// The golden part is the depth map given to the constructor, trimmed to
+// its rows that have part cells. Without one, the first part is learned.
+//*****************************************************************************
+class CPartInspector
+   {
+   public:
+      CPartInspector(const SPDepthMapGrid& Grid, MIL_ID MilGoldenDepthMap, MIL_DOUBLE MinZ,
+                     MIL_INT64 MinCells, MIL_DOUBLE Tolerance, MIL_INT64 MaxOutOfTolerance);
+      ~CPartInspector();
+
+      void SetKernel(PDeviationRow DeviationRow) { m_DeviationRow = DeviationRow; }
+
+      // Inspects the final rows that were not inspected yet.
+      void Update(const CDepthMapRing& Ring, MIL_INT64 NbFinalRows);
+
+      // Inspections of the parts completed by the last update.
+      MIL_INT GetNbNewInspections() const { return (MIL_INT)m_NewInspections.size(); }
+      const SPInspection& GetNewInspection(MIL_INT Index) const { return m_NewInspections[Index]; }
+
+      // Golden part.
+      bool HasGolden() const { return m_GoldenSizeY > 0; }
+      MIL_INT GetGoldenSizeY() const { return m_GoldenSizeY; }
+
+      // Deviation, in gray levels, and flags of the rows of the last part
+      // compared with the golden part. The rows are the rows of the golden
+      // part; the rows past the end of the last part are not updated. The
+      // part being inspected and the noise parts do not change them.
+      const MIL_INT16* GetDeviationRow(MIL_INT Row) const { return &m_Deviation[Row * m_Grid.SizeX]; }
+      const MIL_UINT8* GetFlagRow(MIL_INT Row) const { return &m_Flags[Row * m_Grid.SizeX]; }
+
+   private:
+      void InspectRow(const MIL_UINT16* pRow, MIL_INT64 Row);
+      void EndPart(MIL_INT64 Row);
+      MIL_INT CountPartCells(const MIL_UINT16* pRow) const;
+      void SetGoldenSizeY(MIL_INT GoldenSizeY);
+
+      SPDepthMapGrid m_Grid;
+      PDeviationRow  m_DeviationRow;
+      MIL_UINT16     m_MinDepth;
+      MIL_INT64      m_MinCells;
+      MIL_UINT16     m_Tolerance;
+      MIL_INT64      m_MaxOutOfTolerance;
+      MIL_INT64      m_NextRow;
+      MIL_INT64      m_NbParts;
+
+      // Golden part, and number of part cells of its rows from each row to
+      // its end.
+      MIL_INT                 m_GoldenSizeY;
+      std::vector<MIL_UINT16> m_Golden;
+      std::vector<MIL_INT64>  m_GoldenCellsToEnd;
+
+      // Part being inspected.
+      bool         m_IsInPart;
+      SPInspection m_Part;
+      MIL_INT64    m_NbPartCells;
+      MIL_UINT16   m_MaxDeviation;
+
+      // Deviation and flags of the part being inspected, and of the last
+      // part that was not noise.
+      std::vector<MIL_INT16>    m_PartDeviation;
+      std::vector<MIL_UINT8>    m_PartFlags;
+      std::vector<MIL_INT16>    m_Deviation;
+      std::vector<MIL_UINT8>    m_Flags;
+      std::vector<SPInspection> m_NewInspections;
+   };
+
+#endif // PART_INSPECTOR_H
@@ -0,0 +1,332 @@
+﻿/************************************************************************************/
+/*
+* File name: PartSegmenter.cpp
+*
+* Synopsis:  This file contains the implementation of the CPartSegmenter class that
+*            segments the parts of the continuous depth map in connected components.
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+#include <mil.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include "PartSegmenter.h"
+
+//*****************************************************************************
+// Constructor. Converts the minimum height of the parts to a gray level.
+//*****************************************************************************
+CPartSegmenter::CPartSegmenter(const SPDepthMapGrid& Grid, MIL_DOUBLE MinZ, MIL_INT64 MinCells)
+   : m_Grid(Grid),
+     m_MinCells(MinCells),
+     m_NextRow(0),
+     m_NbParts(0)
+   {
+   MIL_DOUBLE MinDepth = ceil((MinZ - Grid.WorldPosZ) / Grid.GrayLevelSizeZ);
+   m_MinDepth = (MIL_UINT16)(MinDepth < 0 ? 0 : (MinDepth > MAX_DEPTH ? MAX_DEPTH : MinDepth));
+   }
+
+//*****************************************************************************
+// Destructor.
+//*****************************************************************************
+CPartSegmenter::~CPartSegmenter()
+   {
+   }
+
+//*****************************************************************************
+// Update. Segments the final rows that were not segmented yet and keeps the
+//         parts they completed.
+//*****************************************************************************
+void CPartSegmenter::Update(const CDepthMapRing& Ring, MIL_INT64 NbFinalRows)
+   {
+   m_NewParts.clear();
+   for(; m_NextRow < NbFinalRows; m_NextRow++)
+      SegmentRow(Ring.GetRow(m_NextRow), m_NextRow);
+   }
+
+//*****************************************************************************
+// SegmentRow. Labels the runs of a row with the runs of the frontier that
+//             touch them, including diagonally, then emits the parts that
+//             did not reach the row.
+//*****************************************************************************
+void CPartSegmenter::SegmentRow(const MIL_UINT16* pRow, MIL_INT64 Row)
+   {
+   m_CurRuns.clear();
+   MIL_INT SizeX = m_Grid.SizeX;
+   MIL_UINT16 MinDepth = m_MinDepth;
+   size_t PrevRun = 0;
+   for(MIL_INT x = 0; x < SizeX; )
+      {
+      // Find the next run of part cells.
+      while(x < SizeX && (pRow[x] == INVALID_DEPTH || pRow[x] < MinDepth))
+         x++;
+      if(x == SizeX)
+         break;
+      MIL_INT StartX = x;
+      MIL_UINT64 SumDepth = 0;
+      MIL_UINT16 MaxDepth = 0;
+      for(; x < SizeX && pRow[x] != INVALID_DEPTH && pRow[x] >= MinDepth; x++)
+         {
+         SumDepth += pRow[x];
+         MaxDepth = pRow[x] > MaxDepth ? pRow[x] : MaxDepth;
+         }
+      MIL_INT EndX = x;
+
+      // Skip the runs of the frontier that end before the run. They cannot
+      // touch the next runs either.
+      while(PrevRun < m_PrevRuns.size() && m_PrevRuns[PrevRun].EndX < StartX)
+         PrevRun++;
+
+      // Label the run with the first run of the frontier that touches it and
+      // merge the parts of the others.
+      MIL_INT Slot = -1;
+      for(size_t r = PrevRun; r < m_PrevRuns.size() && m_PrevRuns[r].StartX <= EndX; r++)
+         {
+         if(Slot < 0)
+            Slot = m_PrevRuns[r].Slot;
+         else if(m_PrevRuns[r].Slot != Slot)
+            MergeSlots(Slot, m_PrevRuns[r].Slot);
+         }
+      if(Slot < 0)
+         Slot = NewSlot(Row);
+
+      SPFrontierRun Run = {StartX, EndX, Slot};
+      m_CurRuns.push_back(Run);
+      AddRun(Slot, Row, StartX, EndX, SumDepth, MaxDepth);
+      }
+
+   // Emit the parts that did not reach the row.
+   for(size_t a = 0; a < m_ActiveSlots.size(); )
+      {
+      MIL_INT Slot = m_ActiveSlots[a];
+      SPPart& Part = m_Slots[Slot].Part;
+      if(Part.EndRow > Row)
+         {
+         a++;
+         continue;
+         }
+
+      if(Part.NbCells >= m_MinCells)
+         {
+         Part.Id = m_NbParts++;
+         Measure(m_Slots[Slot].Sums, Part);
+         m_NewParts.push_back(SPPart());
+         std::swap(m_NewParts.back(), Part);
+         }
+      m_ActiveSlots[a] = m_ActiveSlots.back();
+      m_ActiveSlots.pop_back();
+      FreeSlot(Slot);
+      }
+
+   m_PrevRuns.swap(m_CurRuns);
+   }
+
+//*****************************************************************************
+// NewSlot. Gets a slot for a new part starting at a row.
+//*****************************************************************************
+MIL_INT CPartSegmenter::NewSlot(MIL_INT64 Row)
+   {
+   MIL_INT Slot;
+   if(!m_FreeSlots.empty())
+      {
+      Slot = m_FreeSlots.back();
+      m_FreeSlots.pop_back();
+      }
+   else
+      {
+      Slot = (MIL_INT)m_Slots.size();
+      m_Slots.push_back(SPSlot());
+      }
+
+   SPPart& Part = m_Slots[Slot].Part;
+   Part.FirstRow = Row;
+   Part.EndRow = Row;
+   Part.StartX = m_Grid.SizeX;
+   Part.EndX = 0;
+   Part.NbCells = 0;
+   Part.Runs.clear();
+
+   SPPartSums& Sums = m_Slots[Slot].Sums;
+   Sums.OriginRow = Row;
+   Sums.SumDepth = 0;
+   Sums.MaxDepth = 0;
+   Sums.SX = Sums.SY = Sums.SXX = Sums.SYY = Sums.SXY = 0.0;
+
+   m_ActiveSlots.push_back(Slot);
+   return Slot;
+   }
+
+//*****************************************************************************
+// AddRun. Adds a run, with the sum and the max of its depths, to a part.
+//*****************************************************************************
+void CPartSegmenter::AddRun(MIL_INT Slot, MIL_INT64 Row, MIL_INT StartX, MIL_INT EndX,
+                            MIL_UINT64 SumDepth, MIL_UINT16 MaxDepth)
+   {
+   SPPart& Part = m_Slots[Slot].Part;
+   SPRun Run = {Row, StartX, EndX};
+   Part.Runs.push_back(Run);
+   Part.EndRow = Row + 1;
+   Part.StartX = std::min(Part.StartX, StartX);
+   Part.EndX = std::max(Part.EndX, EndX);
+   Part.NbCells += EndX - StartX;
+
+   // The sums of X and X2 over the run are closed forms.
+   SPPartSums& Sums = m_Slots[Slot].Sums;
+   MIL_DOUBLE N = (MIL_DOUBLE)(EndX - StartX);
+   MIL_DOUBLE Y = (MIL_DOUBLE)(Row - Sums.OriginRow);
+   MIL_DOUBLE SumX = N * (StartX + EndX - 1) / 2.0;
+   MIL_DOUBLE SumXX = ((MIL_DOUBLE)(EndX - 1) * EndX * (2 * EndX - 1) -
+                       (MIL_DOUBLE)(StartX - 1) * StartX * (2 * StartX - 1)) / 6.0;
+   Sums.SumDepth += SumDepth;
+   Sums.MaxDepth = std::max(Sums.MaxDepth, MaxDepth);
+   Sums.SX += SumX;
+   Sums.SY += N * Y;
+   Sums.SXX += SumXX;
+   Sums.SYY += N * Y * Y;
+   Sums.SXY += Y * SumX;
+   }
+
+//*****************************************************************************
+// MergeSlots. Merges a part in another one and relabels its runs of the
+//             frontier and of the current row.
+//*****************************************************************************
+void CPartSegmenter::MergeSlots(MIL_INT IntoSlot, MIL_INT FromSlot)
+   {
+   // Move the moments of the merged part to the origin row of the other.
+   SPPartSums& IntoSums = m_Slots[IntoSlot].Sums;
+   const SPPartSums& FromSums = m_Slots[FromSlot].Sums;
+   MIL_DOUBLE N = (MIL_DOUBLE)m_Slots[FromSlot].Part.NbCells;
+   MIL_DOUBLE D = (MIL_DOUBLE)(FromSums.OriginRow - IntoSums.OriginRow);
+   IntoSums.SumDepth += FromSums.SumDepth;
+   IntoSums.MaxDepth = std::max(IntoSums.MaxDepth, FromSums.MaxDepth);
+   IntoSums.SX += FromSums.SX;
+   IntoSums.SY += FromSums.SY + N * D;
+   IntoSums.SXX += FromSums.SXX;
+   IntoSums.SYY += FromSums.SYY + 2.0 * D * FromSums.SY + N * D * D;
+   IntoSums.SXY += FromSums.SXY + D * FromSums.SX;
+
+   SPPart& Into = m_Slots[IntoSlot].Part;
+   SPPart& From = m_Slots[FromSlot].Part;
+   Into.FirstRow = std::min(Into.FirstRow, From.FirstRow);
+   Into.EndRow = std::max(Into.EndRow, From.EndRow);
+   Into.StartX = std::min(Into.StartX, From.StartX);
+   Into.EndX = std::max(Into.EndX, From.EndX);
+   Into.NbCells += From.NbCells;
+   Into.Runs.insert(Into.Runs.end(), From.Runs.begin(), From.Runs.end());
+
+   for(size_t r = 0; r < m_PrevRuns.size(); r++)
+      {
+      if(m_PrevRuns[r].Slot == FromSlot)
+         m_PrevRuns[r].Slot = IntoSlot;
+      }
+   for(size_t r = 0; r < m_CurRuns.size(); r++)
+      {
+      if(m_CurRuns[r].Slot == FromSlot)
+         m_CurRuns[r].Slot = IntoSlot;
+      }
+
+   m_ActiveSlots.erase(std::find(m_ActiveSlots.begin(), m_ActiveSlots.end(), FromSlot));
+   FreeSlot(FromSlot);
+   }
+
+//*****************************************************************************
+// FreeSlot. Frees the slot of a part.
+//*****************************************************************************
+void CPartSegmenter::FreeSlot(MIL_INT Slot)
+   {
+   std::vector<SPRun>().swap(m_Slots[Slot].Part.Runs);
+   m_FreeSlots.push_back(Slot);
+   }
+
+//*****************************************************************************
+// Measure. Computes the measures of a complete part from its sums. The box
+//          is aligned on the principal axes of the covariance of the cells
+//          and bounds the corners of the ends of the runs.
+//*****************************************************************************
+void CPartSegmenter::Measure(const SPPartSums& Sums, SPPart& Part) const
+   {
+   SPPartMeasures& Measures = Part.Measures;
+   MIL_DOUBLE PixelSizeX = m_Grid.PixelSizeX;
+   MIL_DOUBLE PixelSizeY = m_Grid.PixelSizeY;
+   MIL_DOUBLE N = (MIL_DOUBLE)Part.NbCells;
+   MIL_DOUBLE CellArea = PixelSizeX * PixelSizeY;
+   Measures.Area = N * CellArea;
+   Measures.Volume = (N * m_Grid.WorldPosZ + Sums.SumDepth * m_Grid.GrayLevelSizeZ) * CellArea;
+   Measures.MaxZ = m_Grid.WorldPosZ + Sums.MaxDepth * m_Grid.GrayLevelSizeZ;
+   Measures.MeanZ = m_Grid.WorldPosZ + (Sums.SumDepth / N) * m_Grid.GrayLevelSizeZ;
+
+   // Principal axes, in world units relative to the origin row.
+   MIL_DOUBLE MeanX = Sums.SX / N;
+   MIL_DOUBLE MeanY = Sums.SY / N;
+   MIL_DOUBLE Cxx = (Sums.SXX / N - MeanX * MeanX) * PixelSizeX * PixelSizeX;
+   MIL_DOUBLE Cyy = (Sums.SYY / N - MeanY * MeanY) * PixelSizeY * PixelSizeY;
+   MIL_DOUBLE Cxy = (Sums.SXY / N - MeanX * MeanY) * PixelSizeX * PixelSizeY;
+   MIL_DOUBLE Angle = 0.5 * atan2(2.0 * Cxy, Cxx - Cyy);
+   MIL_DOUBLE Ux = cos(Angle), Uy = sin(Angle);
+   MIL_DOUBLE CenterX = MeanX * PixelSizeX;
+   MIL_DOUBLE CenterY = MeanY * PixelSizeY;
+
+   // Extents of the corners of the run ends along the axes.
+   MIL_DOUBLE MinU = 0.0, MaxU = 0.0, MinV = 0.0, MaxV = 0.0;
+   for(size_t r = 0; r < Part.Runs.size(); r++)
+      {
+      const SPRun& Run = Part.Runs[r];
+      MIL_DOUBLE X[2] = {(Run.StartX - 0.5) * PixelSizeX - CenterX, (Run.EndX - 0.5) * PixelSizeX - CenterX};
+      MIL_DOUBLE Y0 = (Run.Row - Sums.OriginRow - 0.5) * PixelSizeY - CenterY;
+      MIL_DOUBLE Y[2] = {Y0, Y0 + PixelSizeY};
+      for(MIL_INT i = 0; i < 4; i++)
+         {
+         MIL_DOUBLE U = X[i & 1] * Ux + Y[i >> 1] * Uy;
+         MIL_DOUBLE V = Y[i >> 1] * Ux - X[i & 1] * Uy;
+         MinU = std::min(MinU, U);
+         MaxU = std::max(MaxU, U);
+         MinV = std::min(MinV, V);
+         MaxV = std::max(MaxV, V);
+         }
+      }
+
+   MIL_DOUBLE MidU = (MinU + MaxU) / 2.0;
+   MIL_DOUBLE MidV = (MinV + MaxV) / 2.0;
+   Measures.BoxCenterX = m_Grid.WorldPosX + CenterX + MidU * Ux - MidV * Uy;
+   Measures.BoxCenterY = m_Grid.WorldPosY + Sums.OriginRow * PixelSizeY + CenterY + MidU * Uy + MidV * Ux;
+   Measures.BoxLength = MaxU - MinU;
+   Measures.BoxWidth = MaxV - MinV;
+   Measures.BoxAngle = Angle * 180.0 / 3.14159265358979323846;
+   if(Measures.BoxWidth > Measures.BoxLength)
+      {
+      std::swap(Measures.BoxLength, Measures.BoxWidth);
+      Measures.BoxAngle += Measures.BoxAngle > 0 ? -90.0 : 90.0;
+      }
+   }
+
+//*****************************************************************************
+// AllocPartMap. Allocates a calibrated depth map of the bounding box of a
+//               part with its cells, the other cells being invalid. Returns
+//               M_NULL if the rows of the part are not in the ring anymore.
+//*****************************************************************************
+MIL_ID CPartSegmenter::AllocPartMap(MIL_ID MilSystem, const CDepthMapRing& Ring, const SPPart& Part) const
+   {
+   if(Part.FirstRow < Ring.GetFirstAvailableRow() || Part.EndRow > Ring.GetNbRowsWritten())
+      return M_NULL;
+
+   SPDepthMapGrid PartGrid = m_Grid;
+   PartGrid.SizeX = Part.EndX - Part.StartX;
+   PartGrid.SizeY = (MIL_INT)(Part.EndRow - Part.FirstRow);
+   PartGrid.WorldPosX = m_Grid.WorldPosX + Part.StartX * m_Grid.PixelSizeX;
+   PartGrid.WorldPosY = m_Grid.WorldPosY + Part.FirstRow * m_Grid.PixelSizeY;
+
+   MIL_ID MilPartMap = MbufAlloc2d(MilSystem, PartGrid.SizeX, PartGrid.SizeY, 16 + M_UNSIGNED,
+                                   M_IMAGE + M_PROC, M_NULL);
+   MbufClear(MilPartMap, INVALID_DEPTH);
+   MIL_UINT16* pData = (MIL_UINT16*)MbufInquire(MilPartMap, M_HOST_ADDRESS, M_NULL);
+   MIL_INT Pitch = MbufInquire(MilPartMap, M_PITCH, M_NULL);
+   for(size_t r = 0; r < Part.Runs.size(); r++)
+      {
+      const SPRun& Run = Part.Runs[r];
+      memcpy(pData + (Run.Row - Part.FirstRow) * Pitch + (Run.StartX - Part.StartX),
+             Ring.GetRow(Run.Row) + Run.StartX, (Run.EndX - Run.StartX) * sizeof(MIL_UINT16));
+      }
+   CalibrateDepthMap(MilPartMap, PartGrid);
+   return MilPartMap;
+   }
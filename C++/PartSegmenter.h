@@ -0,0 +1,157 @@
+﻿/************************************************************************************/
+/*
+* File name: PartSegmenter.h
+*
+* Synopsis:  This file contains the declaration of the CPartSegmenter class that
+*            segments the parts of the continuous depth map in connected components,
+*            row by row as the rows are completed, and emits each part as soon as
+*            its last row has passed.
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+
+#ifndef PART_SEGMENTER_H
+#define PART_SEGMENTER_H
+
+#include <vector>
+#include "DepthMapRing.h"
+
+//*****************************************************************************
+// Structure defining a run of consecutive part cells of a row, from StartX
+// to EndX (excluded).
+//*****************************************************************************
+struct SPRun
+   {
+   MIL_INT64 Row;
+   MIL_INT   StartX;
+   MIL_INT   EndX;
+   };
+
+//*****************************************************************************
+// Structure defining the measures of a part, in world units. The heights
+// are the world Z of the depth map, which are above the belt when its
+// reference is subtracted. The oriented bounding box is aligned on the
+// principal axes of the cells of the part; its angle is the angle of its
+// length from the X axis.
+//*****************************************************************************
+struct SPPartMeasures
+   {
+   SPPartMeasures()
+      : Area(0.0), Volume(0.0), MaxZ(0.0), MeanZ(0.0),
+        BoxCenterX(0.0), BoxCenterY(0.0), BoxLength(0.0), BoxWidth(0.0), BoxAngle(0.0) {};
+
+   MIL_DOUBLE Area;        // Projected area, in mm2.
+   MIL_DOUBLE Volume;      // in mm3
+   MIL_DOUBLE MaxZ;        // in mm
+   MIL_DOUBLE MeanZ;       // in mm
+   MIL_DOUBLE BoxCenterX;  // in mm
+   MIL_DOUBLE BoxCenterY;  // in mm
+   MIL_DOUBLE BoxLength;   // in mm
+   MIL_DOUBLE BoxWidth;    // in mm
+   MIL_DOUBLE BoxAngle;    // in degrees
+   };
+
+//*****************************************************************************
+// Structure defining a segmented part. The rows are indexed from the
+// beginning of the scan and the bounding box is in cells, with the ends
+// excluded.
+//*****************************************************************************
+struct SPPart
+   {
+   SPPart(): Id(0), FirstRow(0), EndRow(0), StartX(0), EndX(0), NbCells(0) {};
+
+   MIL_INT64          Id;
+   MIL_INT64          FirstRow;
+   MIL_INT64          EndRow;
+   MIL_INT            StartX;
+   MIL_INT            EndX;
+   MIL_INT64          NbCells;
+   std::vector<SPRun> Runs;       // Cells of the part.
+   SPPartMeasures     Measures;
+   };
+
+//*****************************************************************************
+// Class segmenting the parts of the depth map.
+//
+// The cells of the parts are the valid cells higher than MinZ. The parts
+// are the 8-connected components of these cells. The rows are labeled one
+// by one with the runs of the previous row, the frontier, which is all the
+// segmenter keeps besides the parts that touch it. When two parts meet,
+// the runs of the frontier are relabeled, which is cheap since the
+// frontier has at most a run every other cell. A part is complete, and
+// emitted, when a row has no run connected to it.
+//
+// The sums of the measures of the parts are accumulated while the runs are
+// found, so the cells are read once. When a part is emitted, its measures
+// are computed from its sums, and its box from the ends of its runs.
+//*****************************************************************************
+class CPartSegmenter
+   {
+   public:
+      CPartSegmenter(const SPDepthMapGrid& Grid, MIL_DOUBLE MinZ, MIL_INT64 MinCells);
+      virtual ~CPartSegmenter();
+
+      void Update(const CDepthMapRing& Ring, MIL_INT64 NbFinalRows);
+
+      // Parts completed by the last update.
+      MIL_INT GetNbNewParts() const { return (MIL_INT)m_NewParts.size(); }
+      const SPPart& GetNewPart(MIL_INT Index) const { return m_NewParts[Index]; }
+
+      MIL_INT64 GetNbParts() const { return m_NbParts; }
+      MIL_INT64 GetNbSegmentedRows() const { return m_NextRow; }
+      MIL_ID AllocPartMap(MIL_ID MilSystem, const CDepthMapRing& Ring, const SPPart& Part) const;
+
+   private:
+      // Run of the frontier and the part it belongs to.
+      struct SPFrontierRun
+         {
+         MIL_INT StartX;
+         MIL_INT EndX;
+         MIL_INT Slot;
+         };
+
+      // Sums of the measures of a part. The Y of the moments are relative to
+      // the origin row to keep their precision on long scans.
+      struct SPPartSums
+         {
+         MIL_INT64  OriginRow;
+         MIL_UINT64 SumDepth;
+         MIL_UINT16 MaxDepth;
+         MIL_DOUBLE SX;
+         MIL_DOUBLE SY;
+         MIL_DOUBLE SXX;
+         MIL_DOUBLE SYY;
+         MIL_DOUBLE SXY;
+         };
+
+      // Part being segmented.
+      struct SPSlot
+         {
+         SPPart     Part;
+         SPPartSums Sums;
+         };
+
+      void SegmentRow(const MIL_UINT16* pRow, MIL_INT64 Row);
+      MIL_INT NewSlot(MIL_INT64 Row);
+      void AddRun(MIL_INT Slot, MIL_INT64 Row, MIL_INT StartX, MIL_INT EndX,
+                  MIL_UINT64 SumDepth, MIL_UINT16 MaxDepth);
+      void Measure(const SPPartSums& Sums, SPPart& Part) const;
+      void MergeSlots(MIL_INT IntoSlot, MIL_INT FromSlot);
+      void FreeSlot(MIL_INT Slot);
+
+      SPDepthMapGrid m_Grid;
+      MIL_UINT16     m_MinDepth;
+      MIL_INT64      m_MinCells;
+      MIL_INT64      m_NextRow;
+      MIL_INT64      m_NbParts;
+
+      std::vector<SPSlot>        m_Slots;
+      std::vector<MIL_INT>       m_FreeSlots;
+      std::vector<MIL_INT>       m_ActiveSlots;
+      std::vector<SPFrontierRun> m_PrevRuns;
+      std::vector<SPFrontierRun> m_CurRuns;
+      std::vector<SPPart>        m_NewParts;
+   };
+
+#endif // PART_SEGMENTER_H
@@ -0,0 +1,385 @@
+﻿/************************************************************************************/
+/*
+* File name: PointIndex.cpp
+*
+* Synopsis:  This file contains the implementation of the CPointIndex class that
+*            indexes the converted points of a scan in a grid of XY cells.
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+#include <mil.h>
+#include <math.h>
+#include "PointIndex.h"
+
+//*****************************************************************************
+// Constructor.
+//*****************************************************************************
+CPointIndex::CPointIndex(MIL_ID MilSystem, MIL_DOUBLE CellSize, MIL_DOUBLE MinX, MIL_DOUBLE MaxX,
+                         MIL_DOUBLE WorldPosY, MIL_DOUBLE StepY, MIL_DOUBLE WindowLength)
+   : m_CellSize(CellSize),
+     m_InvCellSize(1.0 / CellSize),
+     m_MinX(MinX),
+     m_WorldPosY(WorldPosY),
+     m_StepY(StepY),
+     m_NbCellsX((MIL_INT)ceil((MaxX - MinX) / CellSize)),
+     m_NbCellsY(0),
+     m_FirstCellY(0),
+     m_MaxCellsY(WindowLength > 0.0 ? (MIL_INT)ceil(WindowLength / CellSize) : 0),
+     m_NbProfilesAdded(0),
+     m_NbPoints(0),
+     m_NbPointsDropped(0),
+     m_NbPointsOutOfRange(0)
+   {
+   if(m_NbCellsX < 1)
+      m_NbCellsX = 1;
+   MthrAlloc(MilSystem, M_MUTEX, M_DEFAULT, M_NULL, M_NULL, &m_MilMutex);
+   }
+
+//*****************************************************************************
+// Destructor.
+//*****************************************************************************
+CPointIndex::~CPointIndex()
+   {
+   MthrFree(m_MilMutex);
+   }
+
+//*****************************************************************************
+// AddBlock. Adds the valid points of a block to their cells. The rows of
+//           cells that leave the window are dropped.
+//*****************************************************************************
+void CPointIndex::AddBlock(const MIL_FLOAT* pX, const MIL_FLOAT* pZ, const MIL_UINT8* pMask,
+                           MIL_INT ProfileSize, MIL_INT NbProfiles)
+   {
+   if(!pX)
+      {
+      m_NbProfilesAdded += NbProfiles;
+      return;
+      }
+
+   Lock();
+   for(MIL_INT p = 0; p < NbProfiles; p++, m_NbProfilesAdded++)
+      {
+      SPIndexPoint Point;
+      Point.Y = (MIL_FLOAT)(m_WorldPosY + m_NbProfilesAdded * m_StepY);
+
+      // Append the rows of cells up to the one of the profile and drop the
+      // rows that leave the window.
+      MIL_INT CellY = (MIL_INT)floor((Point.Y - m_WorldPosY) * m_InvCellSize);
+      if(CellY < m_FirstCellY)
+         CellY = m_FirstCellY;
+      if(CellY >= m_NbCellsY)
+         {
+         m_Cells.resize((CellY + 1 - m_FirstCellY) * m_NbCellsX);
+         m_NbCellsY = CellY + 1;
+         while(m_MaxCellsY > 0 && m_NbCellsY - m_FirstCellY > m_MaxCellsY)
+            {
+            for(MIL_INT x = 0; x < m_NbCellsX; x++)
+               {
+               m_NbPoints -= (MIL_INT64)m_Cells.front().Points.size();
+               m_NbPointsDropped += (MIL_INT64)m_Cells.front().Points.size();
+               m_Cells.pop_front();
+               }
+            m_FirstCellY++;
+            }
+         }
+
+      MIL_INT Offset = p * ProfileSize;
+      for(MIL_INT i = Offset; i < Offset + ProfileSize; i++)
+         {
+         if(pMask && !pMask[i])
+            continue;
+
+         MIL_INT CellX = (MIL_INT)floor((pX[i] - m_MinX) * m_InvCellSize);
+         if(CellX < 0 || CellX >= m_NbCellsX)
+            {
+            m_NbPointsOutOfRange++;
+            continue;
+            }
+
+         Point.X = pX[i];
+         Point.Z = pZ[i];
+         SPIndexCell& Cell = m_Cells[(CellY - m_FirstCellY) * m_NbCellsX + CellX];
+         if(Cell.Points.empty() || Point.Z > Cell.Highest.Z)
+            Cell.Highest = Point;
+         Cell.Points.push_back(Point);
+         m_NbPoints++;
+         }
+      }
+   Unlock();
+   }
+
+//*****************************************************************************
+// FindPointsInBox. Appends the points inside a box. The cells whose highest
+//                  point is below the box are skipped.
+//*****************************************************************************
+MIL_INT CPointIndex::FindPointsInBox(MIL_DOUBLE MinX, MIL_DOUBLE MinY, MIL_DOUBLE MinZ,
+                                     MIL_DOUBLE MaxX, MIL_DOUBLE MaxY, MIL_DOUBLE MaxZ,
+                                     std::vector<SPIndexPoint>& Points) const
+   {
+   // Copy the points of the cells.
+   std::vector<SPIndexPoint> CellPoints;
+   Lock();
+   SPCellRange Range;
+   if(GetCellRange(MinX, MinY, MaxX, MaxY, Range))
+      {
+      for(MIL_INT y = Range.FirstY; y < Range.EndY; y++)
+         {
+         for(MIL_INT x = Range.FirstX; x < Range.EndX; x++)
+            {
+            const SPIndexCell& Cell = GetCell(x, y);
+            if(!Cell.Points.empty() && Cell.Highest.Z >= MinZ)
+               CopyCellPoints(Cell, CellPoints);
+            }
+         }
+      }
+   Unlock();
+
+   MIL_INT NbFound = 0;
+   for(size_t i = 0; i < CellPoints.size(); i++)
+      {
+      const SPIndexPoint& Point = CellPoints[i];
+      if(Point.X >= MinX && Point.X <= MaxX && Point.Y >= MinY && Point.Y <= MaxY &&
+         Point.Z >= MinZ && Point.Z <= MaxZ)
+         {
+         Points.push_back(Point);
+         NbFound++;
+         }
+      }
+   return NbFound;
+   }
+
+//*****************************************************************************
+// FindHighestPoint. Finds the highest point inside an XY rectangle. The
+//                   cells entirely inside the rectangle give their highest
+//                   point; only the points of the border cells that can be
+//                   higher are copied and visited.
+//*****************************************************************************
+bool CPointIndex::FindHighestPoint(MIL_DOUBLE MinX, MIL_DOUBLE MinY, MIL_DOUBLE MaxX, MIL_DOUBLE MaxY,
+                                   SPIndexPoint& Point) const
+   {
+   bool Found = false;
+   std::vector<SPIndexPoint> BorderPoints;
+   Lock();
+   SPCellRange Range;
+   if(GetCellRange(MinX, MinY, MaxX, MaxY, Range))
+      {
+      // Highest point of the inside cells.
+      for(MIL_INT y = Range.FirstY; y < Range.EndY; y++)
+         {
+         MIL_DOUBLE CellMinY = m_WorldPosY + y * m_CellSize;
+         if(CellMinY < MinY || CellMinY + m_CellSize > MaxY)
+            continue;
+         for(MIL_INT x = Range.FirstX; x < Range.EndX; x++)
+            {
+            const SPIndexCell& Cell = GetCell(x, y);
+            MIL_DOUBLE CellMinX = m_MinX + x * m_CellSize;
+            if(!Cell.Points.empty() && CellMinX >= MinX && CellMinX + m_CellSize <= MaxX &&
+               (!Found || Cell.Highest.Z > Point.Z))
+               {
+               Point = Cell.Highest;
+               Found = true;
+               }
+            }
+         }
+
+      // Points of the border cells.
+      for(MIL_INT y = Range.FirstY; y < Range.EndY; y++)
+         {
+         MIL_DOUBLE CellMinY = m_WorldPosY + y * m_CellSize;
+         bool InsideY = CellMinY >= MinY && CellMinY + m_CellSize <= MaxY;
+         for(MIL_INT x = Range.FirstX; x < Range.EndX; x++)
+            {
+            const SPIndexCell& Cell = GetCell(x, y);
+            MIL_DOUBLE CellMinX = m_MinX + x * m_CellSize;
+            if(Cell.Points.empty() || (Found && Cell.Highest.Z <= Point.Z) ||
+               (InsideY && CellMinX >= MinX && CellMinX + m_CellSize <= MaxX))
+               continue;
+            CopyCellPoints(Cell, BorderPoints);
+            }
+         }
+      }
+   Unlock();
+
+   for(size_t i = 0; i < BorderPoints.size(); i++)
+      {
+      const SPIndexPoint& CellPoint = BorderPoints[i];
+      if(CellPoint.X >= MinX && CellPoint.X <= MaxX && CellPoint.Y >= MinY && CellPoint.Y <= MaxY &&
+         (!Found || CellPoint.Z > Point.Z))
+         {
+         Point = CellPoint;
+         Found = true;
+         }
+      }
+   return Found;
+   }
+
+//*****************************************************************************
+// FindNearestPoint. Finds the point nearest to a position. The cells are
+//                   visited in rings around the cell of the position until
+//                   the next ring is farther than the nearest point found.
+//                   The rings start at the first one that overlaps the grid
+//                   and only their cells in the grid are visited. For a
+//                   position outside the grid, the distance of a ring also
+//                   counts the gap to the grid along the other axis, so a
+//                   far position visits few rings. The points of each ring
+//                   are copied under the lock.
+//*****************************************************************************
+bool CPointIndex::FindNearestPoint(MIL_DOUBLE X, MIL_DOUBLE Y, MIL_DOUBLE Z, SPIndexPoint& Point) const
+   {
+   bool Found = false;
+   MIL_DOUBLE BestDistance2 = 0.0;
+   MIL_INT CenterX = (MIL_INT)floor((X - m_MinX) * m_InvCellSize);
+   MIL_INT CenterY = (MIL_INT)floor((Y - m_WorldPosY) * m_InvCellSize);
+   std::vector<SPIndexPoint> RingPoints;
+   for(MIL_INT r = 0; ; r++)
+      {
+      RingPoints.clear();
+      Lock();
+
+      // Before the first ring, all the cells are outside the grid; past the
+      // last ring too. The grid can move between two rings.
+      MIL_INT MinRing = 0;
+      MIL_INT MaxRing = -1;
+      if(m_NbCellsY > m_FirstCellY)
+         {
+         MIL_INT Distances[4] = {CenterX, m_NbCellsX - 1 - CenterX,
+                                 CenterY - m_FirstCellY, m_NbCellsY - 1 - CenterY};
+         for(MIL_INT d = 0; d < 4; d++)
+            {
+            MIL_INT Distance = Distances[d] < 0 ? -Distances[d] : Distances[d];
+            if(Distance > MaxRing)
+               MaxRing = Distance;
+            if(-Distances[d] > MinRing)
+               MinRing = -Distances[d];
+            }
+         }
+      if(r < MinRing)
+         r = MinRing;
+
+      // The cells of ring r are at least r - 1 cells away from the position
+      // along one axis, and at least the gap to the grid along the other.
+      MIL_DOUBLE GapX = X < m_MinX ? m_MinX - X : X - (m_MinX + m_NbCellsX * m_CellSize);
+      MIL_DOUBLE GapY = Y < m_WorldPosY + m_FirstCellY * m_CellSize ?
+                        m_WorldPosY + m_FirstCellY * m_CellSize - Y : Y - (m_WorldPosY + m_NbCellsY * m_CellSize);
+      MIL_DOUBLE Gap = GapX < GapY ? GapX : GapY;
+      MIL_DOUBLE RingDistance = (r - 1) * m_CellSize;
+      MIL_DOUBLE RingDistance2 = RingDistance * RingDistance + (Gap > 0.0 ? Gap * Gap : 0.0);
+      if(r > MaxRing || (Found && r > 0 && RingDistance2 >= BestDistance2))
+         {
+         Unlock();
+         break;
+         }
+
+      MIL_INT FirstY = CenterY - r > m_FirstCellY ? CenterY - r : m_FirstCellY;
+      MIL_INT EndY = CenterY + r + 1 < m_NbCellsY ? CenterY + r + 1 : m_NbCellsY;
+      MIL_INT FirstX = CenterX - r > 0 ? CenterX - r : 0;
+      MIL_INT EndX = CenterX + r + 1 < m_NbCellsX ? CenterX + r + 1 : m_NbCellsX;
+      for(MIL_INT y = FirstY; y < EndY; y++)
+         {
+         // Inside the ring, only its first and last cells.
+         if(y == CenterY - r || y == CenterY + r || r == 0)
+            {
+            for(MIL_INT x = FirstX; x < EndX; x++)
+               CopyCellPoints(GetCell(x, y), RingPoints);
+            }
+         else
+            {
+            if(CenterX - r >= 0)
+               CopyCellPoints(GetCell(CenterX - r, y), RingPoints);
+            if(CenterX + r < m_NbCellsX)
+               CopyCellPoints(GetCell(CenterX + r, y), RingPoints);
+            }
+         }
+      Unlock();
+
+      for(size_t i = 0; i < RingPoints.size(); i++)
+         {
+         const SPIndexPoint& CellPoint = RingPoints[i];
+         MIL_DOUBLE DX = CellPoint.X - X;
+         MIL_DOUBLE DY = CellPoint.Y - Y;
+         MIL_DOUBLE DZ = CellPoint.Z - Z;
+         MIL_DOUBLE Distance2 = DX * DX + DY * DY + DZ * DZ;
+         if(!Found || Distance2 < BestDistance2)
+            {
+            Point = CellPoint;
+            BestDistance2 = Distance2;
+            Found = true;
+            }
+         }
+      }
+   return Found;
+   }
+
+//*****************************************************************************
+// GetHeightAt. Gets the Z of the point nearest in XY among the cells around
+//              the position, if it is at most a cell away.
+//*****************************************************************************
+bool CPointIndex::GetHeightAt(MIL_DOUBLE X, MIL_DOUBLE Y, MIL_DOUBLE& Z) const
+   {
+   std::vector<SPIndexPoint> CellPoints;
+   Lock();
+   SPCellRange Range;
+   if(GetCellRange(X - m_CellSize, Y - m_CellSize, X + m_CellSize, Y + m_CellSize, Range))
+      {
+      for(MIL_INT y = Range.FirstY; y < Range.EndY; y++)
+         {
+         for(MIL_INT x = Range.FirstX; x < Range.EndX; x++)
+            CopyCellPoints(GetCell(x, y), CellPoints);
+         }
+      }
+   Unlock();
+
+   bool Found = false;
+   MIL_DOUBLE BestDistance2 = m_CellSize * m_CellSize;
+   for(size_t i = 0; i < CellPoints.size(); i++)
+      {
+      MIL_DOUBLE DX = CellPoints[i].X - X;
+      MIL_DOUBLE DY = CellPoints[i].Y - Y;
+      MIL_DOUBLE Distance2 = DX * DX + DY * DY;
+      if(Distance2 <= BestDistance2)
+         {
+         Z = CellPoints[i].Z;
+         BestDistance2 = Distance2;
+         Found = true;
+         }
+      }
+   return Found;
+   }
+
+//*****************************************************************************
+// GetCellRange. Gets the cells overlapped by an XY rectangle. Returns false
+//               if it overlaps no cell.
+//*****************************************************************************
+bool CPointIndex::GetCellRange(MIL_DOUBLE MinX, MIL_DOUBLE MinY, MIL_DOUBLE MaxX, MIL_DOUBLE MaxY,
+                               SPCellRange& Range) const
+   {
+   if(MinX > MaxX || MinY > MaxY)
+      return false;
+
+   MIL_DOUBLE FirstX = floor((MinX - m_MinX) * m_InvCellSize);
+   MIL_DOUBLE LastX = floor((MaxX - m_MinX) * m_InvCellSize);
+   MIL_DOUBLE FirstY = floor((MinY - m_WorldPosY) * m_InvCellSize);
+   MIL_DOUBLE LastY = floor((MaxY - m_WorldPosY) * m_InvCellSize);
+   if(FirstX >= m_NbCellsX || LastX < 0.0 || FirstY >= m_NbCellsY || LastY < m_FirstCellY)
+      return false;
+
+   Range.FirstX = FirstX > 0.0 ? (MIL_INT)FirstX : 0;
+   Range.EndX = LastX < m_NbCellsX - 1 ? (MIL_INT)LastX + 1 : m_NbCellsX;
+   Range.FirstY = FirstY > m_FirstCellY ? (MIL_INT)FirstY : m_FirstCellY;
+   Range.EndY = LastY < m_NbCellsY - 1 ? (MIL_INT)LastY + 1 : m_NbCellsY;
+   return true;
+   }
+
+//*****************************************************************************
+// Lock/Unlock. Protect the cells.
+//*****************************************************************************
+void CPointIndex::Lock() const
+   {
+   MthrControl(m_MilMutex, M_LOCK, M_DEFAULT);
+   }
+
+void CPointIndex::Unlock() const
+   {
+   MthrControl(m_MilMutex, M_UNLOCK, M_DEFAULT);
+   }
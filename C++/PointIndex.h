@@ -0,0 +1,126 @@
+﻿/************************************************************************************/
+/*
+* File name: PointIndex.h
+*
+* Synopsis:  This file contains the declaration of the CPointIndex class that indexes
+*            the converted points of the last part of a scan in a grid of XY cells,
+*            built while the scan is acquired, to answer the range, nearest point and
+*            height queries without scanning all the points.
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+
+#ifndef POINT_INDEX_H
+#define POINT_INDEX_H
+
+#include <vector>
+#include <deque>
+
+//*****************************************************************************
+// Structure defining an indexed point, in world units.
+//*****************************************************************************
+struct SPIndexPoint
+   {
+   MIL_FLOAT X;
+   MIL_FLOAT Y;
+   MIL_FLOAT Z;
+   };
+
+//*****************************************************************************
+// Spatial index of the converted blocks.
+//
+// The cells are the squares of CellSize in XY, from MinX in X and from the Y
+// of the first profile in Y. The scan only grows in Y, so the rows of cells
+// are appended as the profiles arrive and a cell is addressed directly from
+// a position. Each cell keeps its points and its highest point: a query
+// only visits the cells it overlaps, and the cells entirely inside a box
+// answer its highest point without visiting their points.
+//
+// The index only keeps the rows of cells of the last WindowLength of the
+// scan, so its memory does not grow with the scan; the older rows are
+// dropped with their points. A length of 0 keeps the whole scan.
+//
+// The queries can be made from another thread while the blocks are added.
+// They only hold the lock to copy the points of the cells they need, and
+// search the copies after releasing it, so they do not stall the blocks.
+//*****************************************************************************
+class CPointIndex
+   {
+   public:
+      CPointIndex(MIL_ID MilSystem, MIL_DOUBLE CellSize, MIL_DOUBLE MinX, MIL_DOUBLE MaxX,
+                  MIL_DOUBLE WorldPosY, MIL_DOUBLE StepY, MIL_DOUBLE WindowLength);
+      ~CPointIndex();
+
+      // Adds a block of converted points. pMask can be M_NULL if all the
+      // points are valid; without points, the profiles are only skipped.
+      void AddBlock(const MIL_FLOAT* pX, const MIL_FLOAT* pZ, const MIL_UINT8* pMask,
+                    MIL_INT ProfileSize, MIL_INT NbProfiles);
+
+      // Appends the points inside a box to Points. Returns the number of
+      // points found.
+      MIL_INT FindPointsInBox(MIL_DOUBLE MinX, MIL_DOUBLE MinY, MIL_DOUBLE MinZ,
+                              MIL_DOUBLE MaxX, MIL_DOUBLE MaxY, MIL_DOUBLE MaxZ,
+                              std::vector<SPIndexPoint>& Points) const;
+
+      // Finds the highest point inside an XY rectangle. Returns false if
+      // the rectangle has no point.
+      bool FindHighestPoint(MIL_DOUBLE MinX, MIL_DOUBLE MinY, MIL_DOUBLE MaxX, MIL_DOUBLE MaxY,
+                            SPIndexPoint& Point) const;
+
+      // Finds the point nearest to a position in 3d. Returns false if no
+      // point is indexed.
+      bool FindNearestPoint(MIL_DOUBLE X, MIL_DOUBLE Y, MIL_DOUBLE Z, SPIndexPoint& Point) const;
+
+      // Gets the height at an XY position: the Z of the point nearest in XY,
+      // if it is at most a cell away. Returns false otherwise.
+      bool GetHeightAt(MIL_DOUBLE X, MIL_DOUBLE Y, MIL_DOUBLE& Z) const;
+
+      MIL_DOUBLE GetCellSize() const { return m_CellSize; }
+      MIL_INT64 GetNbPoints() const { return m_NbPoints; }
+      MIL_INT64 GetNbPointsDropped() const { return m_NbPointsDropped; }
+      MIL_INT64 GetNbPointsOutOfRange() const { return m_NbPointsOutOfRange; }
+
+   private:
+      struct SPIndexCell
+         {
+         std::vector<SPIndexPoint> Points;
+         SPIndexPoint              Highest;
+         };
+
+      struct SPCellRange
+         {
+         MIL_INT FirstX, EndX;
+         MIL_INT FirstY, EndY;
+         };
+
+      bool GetCellRange(MIL_DOUBLE MinX, MIL_DOUBLE MinY, MIL_DOUBLE MaxX, MIL_DOUBLE MaxY,
+                        SPCellRange& Range) const;
+      const SPIndexCell& GetCell(MIL_INT CellX, MIL_INT CellY) const
+         { return m_Cells[(CellY - m_FirstCellY) * m_NbCellsX + CellX]; }
+      void CopyCellPoints(const SPIndexCell& Cell, std::vector<SPIndexPoint>& Points) const
+         { Points.insert(Points.end(), Cell.Points.begin(), Cell.Points.end()); }
+      void Lock() const;
+      void Unlock() const;
+
+      MIL_DOUBLE m_CellSize;
+      MIL_DOUBLE m_InvCellSize;
+      MIL_DOUBLE m_MinX;
+      MIL_DOUBLE m_WorldPosY;
+      MIL_DOUBLE m_StepY;
+      MIL_INT    m_NbCellsX;
+      MIL_INT    m_NbCellsY;        // Rows of cells appended since the start of the scan.
+      MIL_INT    m_FirstCellY;      // First row of cells kept.
+      MIL_INT    m_MaxCellsY;       // Most rows of cells kept. 0 to keep them all.
+      MIL_INT64  m_NbProfilesAdded;
+      MIL_INT64  m_NbPoints;
+      MIL_INT64  m_NbPointsDropped;
+      MIL_INT64  m_NbPointsOutOfRange;
+      MIL_ID     m_MilMutex;
+
+      // Cells of the kept rows, row by row. Appending or dropping a row
+      // does not move the other cells.
+      std::deque<SPIndexCell> m_Cells;
+   };
+
+#endif // POINT_INDEX_H
@@ -0,0 +1,1235 @@
+﻿/************************************************************************************/
+/*
+* File name: ProfileKernels.cpp
+*
+* Synopsis:  This file contains the implementation of the host kernels applied on
+*            the rows of profile data. The kernels are specialized at compile
+*            time for the common scanCONTROL profile sizes and a generic version
+*            handles the other sizes. Each kernel is also compiled for the
+*            scalar, SSE4.1, AVX2 and AVX-512 instruction sets.
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+#include <mil.h>
+#include <math.h>
+#include <string.h>
+#include "ProfileKernels.h"
+
+#if KERNELS_USE_SSE41
+#include <immintrin.h>
+#endif
+
+//*****************************************************************************
+// Point operations shared by all the kernel versions. They are also used
+// for the remainder of the rows in the vectorized kernels.
+//*****************************************************************************
+static inline void ConvertToWorldPoint(MIL_UINT16 CodeX, MIL_UINT16 CodeZ, MIL_UINT8 Valid,
+                                       MIL_FLOAT* pDstX, MIL_FLOAT* pDstZ,
+                                       const SPConvertParams& Params,
+                                       MIL_UINT& NbValid, MIL_UINT64& SumCodeZ,
+                                       MIL_UINT16& MinCodeZ, MIL_UINT16& MaxCodeZ,
+                                       MIL_UINT* pHistogram)
+   {
+   *pDstX = CodeX * Params.ScaleX + Params.OffsetX;
+   *pDstZ = CodeZ * Params.ScaleZ + Params.OffsetZ;
+
+   // Accumulate the statistics without branches. Invalid points use
+   // neutral values.
+   MIL_UINT IsValid = Valid ? 1 : 0;
+   MIL_UINT16 MinCandidate = IsValid ? CodeZ : (MIL_UINT16)65535;
+   MIL_UINT16 MaxCandidate = IsValid ? CodeZ : (MIL_UINT16)0;
+   NbValid += IsValid;
+   SumCodeZ += CodeZ * IsValid;
+   MinCodeZ = MinCandidate < MinCodeZ ? MinCandidate : MinCodeZ;
+   MaxCodeZ = MaxCandidate > MaxCodeZ ? MaxCandidate : MaxCodeZ;
+   pHistogram[CodeZ >> STATS_HISTOGRAM_SHIFT] += IsValid;
+   }
+
+static inline MIL_UINT8 MaskPoint(MIL_UINT16 CodeZ, MIL_UINT16 InvalidCode)
+   {
+   return CodeZ != InvalidCode ? (MIL_UINT8)255 : (MIL_UINT8)0;
+   }
+
+//*****************************************************************************
+// Statistics accumulated in the local variables of a row kernel.
+//*****************************************************************************
+struct SPRowStats
+   {
+   SPRowStats(const SPStatsAccumulator& Stats)
+      : NbValid(0), SumCodeZ(0), MinCodeZ(Stats.MinCodeZ), MaxCodeZ(Stats.MaxCodeZ) {}
+   void AddTo(SPStatsAccumulator& Stats) const
+      {
+      Stats.NbValid += NbValid;
+      Stats.SumCodeZ += SumCodeZ;
+      Stats.MinCodeZ = MinCodeZ;
+      Stats.MaxCodeZ = MaxCodeZ;
+      }
+
+   MIL_UINT   NbValid;
+   MIL_UINT64 SumCodeZ;
+   MIL_UINT16 MinCodeZ;
+   MIL_UINT16 MaxCodeZ;
+   };
+
+//*****************************************************************************
+// Converts the points of a row from First to Size one by one.
+//*****************************************************************************
+static KERNEL_NOINLINE void ConvertToWorldRemainder(const MIL_UINT16* pSrcX, const MIL_UINT16* pSrcZ,
+                                           const MIL_UINT8* pMask, MIL_FLOAT* pDstX, MIL_FLOAT* pDstZ,
+                                           MIL_INT First, MIL_INT Size, const SPConvertParams& Params,
+                                           SPRowStats& Row, MIL_UINT* pHistogram)
+   {
+   for(MIL_INT x = First; x < Size; x++)
+      {
+      ConvertToWorldPoint(pSrcX[x], pSrcZ[x], pMask ? pMask[x] : (MIL_UINT8)1, &pDstX[x], &pDstZ[x],
+                          Params, Row.NbValid, Row.SumCodeZ, Row.MinCodeZ, Row.MaxCodeZ, pHistogram);
+      }
+   }
+
+//*****************************************************************************
+// Masks the points of a row from First to Size one by one.
+//*****************************************************************************
+static KERNEL_NOINLINE void MaskRowRemainder(const MIL_UINT16* pSrcZ, MIL_UINT8* pMask, MIL_INT First,
+                                             MIL_INT Size, MIL_UINT16 InvalidCode)
+   {
+   for(MIL_INT x = First; x < Size; x++)
+      pMask[x] = MaskPoint(pSrcZ[x], InvalidCode);
+   }
+
+//*****************************************************************************
+// Scalar kernels. The template parameter is the profile size when it is
+// known at compile time, or 0 for the generic kernel. Rows are processed in
+// blocks with a compile time trip count that are fully unrolled by the
+// compiler. With a known profile size, which is a multiple of the block
+// size, the remainder loop is removed.
+//*****************************************************************************
+template <MIL_INT FixedSize>
+static void ConvertToWorldRowScalar(const MIL_UINT16* pSrcX, const MIL_UINT16* pSrcZ,
+                                    const MIL_UINT8* pMask, MIL_FLOAT* pDstX, MIL_FLOAT* pDstZ,
+                                    MIL_INT Size, const SPConvertParams& Params,
+                                    SPStatsAccumulator& Stats)
+   {
+   const MIL_INT N = FixedSize ? FixedSize : Size;
+   SPRowStats Row(Stats);
+   MIL_INT x = 0;
+   for(; x + KERNEL_BLOCK_SIZE <= N; x += KERNEL_BLOCK_SIZE)
+      {
+      for(MIL_INT i = x; i < x + KERNEL_BLOCK_SIZE; i++)
+         {
+         ConvertToWorldPoint(pSrcX[i], pSrcZ[i], pMask ? pMask[i] : (MIL_UINT8)1, &pDstX[i], &pDstZ[i],
+                             Params, Row.NbValid, Row.SumCodeZ, Row.MinCodeZ, Row.MaxCodeZ, Stats.Histogram);
+         }
+      }
+   ConvertToWorldRemainder(pSrcX, pSrcZ, pMask, pDstX, pDstZ, x, N, Params, Row, Stats.Histogram);
+   Row.AddTo(Stats);
+   }
+
+template <MIL_INT FixedSize>
+static void MaskRowScalar(const MIL_UINT16* pSrcZ, MIL_UINT8* pMask, MIL_INT Size, MIL_UINT16 InvalidCode)
+   {
+   const MIL_INT N = FixedSize ? FixedSize : Size;
+   MIL_INT x = 0;
+   for(; x + KERNEL_BLOCK_SIZE <= N; x += KERNEL_BLOCK_SIZE)
+      {
+      for(MIL_INT i = x; i < x + KERNEL_BLOCK_SIZE; i++)
+         pMask[i] = MaskPoint(pSrcZ[i], InvalidCode);
+      }
+   if(N % KERNEL_BLOCK_SIZE)
+      MaskRowRemainder(pSrcZ, pMask, x, N, InvalidCode);
+   }
+
+#if KERNELS_USE_SSE41
+//*****************************************************************************
+// SSE4.1 kernels. 8 points are processed per iteration.
+//*****************************************************************************
+template <MIL_INT FixedSize>
+static KERNEL_TARGET_SSE41 void ConvertToWorldRowSse41(const MIL_UINT16* pSrcX, const MIL_UINT16* pSrcZ,
+                                                       const MIL_UINT8* pMask, MIL_FLOAT* pDstX, MIL_FLOAT* pDstZ,
+                                                       MIL_INT Size, const SPConvertParams& Params,
+                                                       SPStatsAccumulator& Stats)
+   {
+   const MIL_INT N = FixedSize ? FixedSize : Size;
+   const __m128 ScaleX = _mm_set1_ps(Params.ScaleX);
+   const __m128 OffsetX = _mm_set1_ps(Params.OffsetX);
+   const __m128 ScaleZ = _mm_set1_ps(Params.ScaleZ);
+   const __m128 OffsetZ = _mm_set1_ps(Params.OffsetZ);
+   const __m128i Zero = _mm_setzero_si128();
+   const __m128i AllOnes = _mm_set1_epi32(-1);
+   __m128i MinZ = AllOnes;
+   __m128i MaxZ = Zero;
+   __m128i SumZ = Zero;
+   __m128i Count = Zero;
+   MIL_UINT16 Codes[8];
+   MIL_UINT16 Valids[8];
+
+   MIL_INT x = 0;
+   for(; x + 8 <= N; x += 8)
+      {
+      __m128i CodeX = _mm_loadu_si128((const __m128i*)(pSrcX + x));
+      __m128i CodeZ = _mm_loadu_si128((const __m128i*)(pSrcZ + x));
+      __m128 XLo = _mm_cvtepi32_ps(_mm_cvtepu16_epi32(CodeX));
+      __m128 XHi = _mm_cvtepi32_ps(_mm_cvtepu16_epi32(_mm_srli_si128(CodeX, 8)));
+      __m128 ZLo = _mm_cvtepi32_ps(_mm_cvtepu16_epi32(CodeZ));
+      __m128 ZHi = _mm_cvtepi32_ps(_mm_cvtepu16_epi32(_mm_srli_si128(CodeZ, 8)));
+      _mm_storeu_ps(pDstX + x,     _mm_add_ps(_mm_mul_ps(XLo, ScaleX), OffsetX));
+      _mm_storeu_ps(pDstX + x + 4, _mm_add_ps(_mm_mul_ps(XHi, ScaleX), OffsetX));
+      _mm_storeu_ps(pDstZ + x,     _mm_add_ps(_mm_mul_ps(ZLo, ScaleZ), OffsetZ));
+      _mm_storeu_ps(pDstZ + x + 4, _mm_add_ps(_mm_mul_ps(ZHi, ScaleZ), OffsetZ));
+
+      // All ones in the 16 bits lanes of the valid points.
+      __m128i Valid = AllOnes;
+      if(pMask)
+         {
+         __m128i Mask = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i*)(pMask + x)));
+         Valid = _mm_xor_si128(_mm_cmpeq_epi16(Mask, Zero), AllOnes);
+         }
+      __m128i ValidZ = _mm_and_si128(CodeZ, Valid);
+      MinZ = _mm_min_epu16(MinZ, _mm_or_si128(CodeZ, _mm_xor_si128(Valid, AllOnes)));
+      MaxZ = _mm_max_epu16(MaxZ, ValidZ);
+      SumZ = _mm_add_epi32(SumZ, _mm_cvtepu16_epi32(ValidZ));
+      SumZ = _mm_add_epi32(SumZ, _mm_cvtepu16_epi32(_mm_srli_si128(ValidZ, 8)));
+      Count = _mm_sub_epi16(Count, Valid);
+
+      // The histogram is a scatter and stays scalar.
+      _mm_storeu_si128((__m128i*)Codes, CodeZ);
+      _mm_storeu_si128((__m128i*)Valids, Valid);
+      for(MIL_INT i = 0; i < 8; i++)
+         Stats.Histogram[Codes[i] >> STATS_HISTOGRAM_SHIFT] += Valids[i] & 1;
+      }
+
+   // Reduce the lanes.
+   SPRowStats Row(Stats);
+   MIL_UINT16 VecMin = (MIL_UINT16)_mm_cvtsi128_si32(_mm_minpos_epu16(MinZ));
+   MIL_UINT16 VecMax = (MIL_UINT16)~_mm_cvtsi128_si32(_mm_minpos_epu16(_mm_xor_si128(MaxZ, AllOnes)));
+   Row.MinCodeZ = VecMin < Row.MinCodeZ ? VecMin : Row.MinCodeZ;
+   Row.MaxCodeZ = VecMax > Row.MaxCodeZ ? VecMax : Row.MaxCodeZ;
+   MIL_UINT32 Sums[4];
+   MIL_UINT16 Counts[8];
+   _mm_storeu_si128((__m128i*)Sums, SumZ);
+   _mm_storeu_si128((__m128i*)Counts, Count);
+   for(MIL_INT i = 0; i < 4; i++)
+      Row.SumCodeZ += Sums[i];
+   for(MIL_INT i = 0; i < 8; i++)
+      Row.NbValid += Counts[i];
+
+   ConvertToWorldRemainder(pSrcX, pSrcZ, pMask, pDstX, pDstZ, x, N, Params, Row, Stats.Histogram);
+   Row.AddTo(Stats);
+   }
+
+template <MIL_INT FixedSize>
+static KERNEL_TARGET_SSE41 void MaskRowSse41(const MIL_UINT16* pSrcZ, MIL_UINT8* pMask,
+                                             MIL_INT Size, MIL_UINT16 InvalidCode)
+   {
+   const MIL_INT N = FixedSize ? FixedSize : Size;
+   const __m128i Invalid = _mm_set1_epi16((short)InvalidCode);
+   const __m128i AllOnes = _mm_set1_epi32(-1);
+   MIL_INT x = 0;
+   for(; x + 16 <= N; x += 16)
+      {
+      __m128i IsInvalidLo = _mm_cmpeq_epi16(_mm_loadu_si128((const __m128i*)(pSrcZ + x)), Invalid);
+      __m128i IsInvalidHi = _mm_cmpeq_epi16(_mm_loadu_si128((const __m128i*)(pSrcZ + x + 8)), Invalid);
+      __m128i IsInvalid = _mm_packs_epi16(IsInvalidLo, IsInvalidHi);
+      _mm_storeu_si128((__m128i*)(pMask + x), _mm_xor_si128(IsInvalid, AllOnes));
+      }
+   if(N % 16)
+      MaskRowRemainder(pSrcZ, pMask, x, N, InvalidCode);
+   }
+#endif
+
+#if KERNELS_USE_AVX2
+//*****************************************************************************
+// AVX2 kernels. 16 points are processed per iteration.
+//*****************************************************************************
+template <MIL_INT FixedSize>
+static KERNEL_TARGET_AVX2 void ConvertToWorldRowAvx2(const MIL_UINT16* pSrcX, const MIL_UINT16* pSrcZ,
+                                                     const MIL_UINT8* pMask, MIL_FLOAT* pDstX, MIL_FLOAT* pDstZ,
+                                                     MIL_INT Size, const SPConvertParams& Params,
+                                                     SPStatsAccumulator& Stats)
+   {
+   const MIL_INT N = FixedSize ? FixedSize : Size;
+   const __m256 ScaleX = _mm256_set1_ps(Params.ScaleX);
+   const __m256 OffsetX = _mm256_set1_ps(Params.OffsetX);
+   const __m256 ScaleZ = _mm256_set1_ps(Params.ScaleZ);
+   const __m256 OffsetZ = _mm256_set1_ps(Params.OffsetZ);
+   const __m256i Zero = _mm256_setzero_si256();
+   const __m256i AllOnes = _mm256_set1_epi32(-1);
+   __m256i MinZ = AllOnes;
+   __m256i MaxZ = Zero;
+   __m256i SumZ = Zero;
+   __m256i Count = Zero;
+   MIL_UINT16 Codes[16];
+   MIL_UINT16 Valids[16];
+
+   MIL_INT x = 0;
+   for(; x + 16 <= N; x += 16)
+      {
+      __m256i CodeX = _mm256_loadu_si256((const __m256i*)(pSrcX + x));
+      __m256i CodeZ = _mm256_loadu_si256((const __m256i*)(pSrcZ + x));
+      __m256 XLo = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(CodeX)));
+      __m256 XHi = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(CodeX, 1)));
+      __m256 ZLo = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(CodeZ)));
+      __m256 ZHi = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(CodeZ, 1)));
+      _mm256_storeu_ps(pDstX + x,     _mm256_add_ps(_mm256_mul_ps(XLo, ScaleX), OffsetX));
+      _mm256_storeu_ps(pDstX + x + 8, _mm256_add_ps(_mm256_mul_ps(XHi, ScaleX), OffsetX));
+      _mm256_storeu_ps(pDstZ + x,     _mm256_add_ps(_mm256_mul_ps(ZLo, ScaleZ), OffsetZ));
+      _mm256_storeu_ps(pDstZ + x + 8, _mm256_add_ps(_mm256_mul_ps(ZHi, ScaleZ), OffsetZ));
+
+      __m256i Valid = AllOnes;
+      if(pMask)
+         {
+         __m256i Mask = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(pMask + x)));
+         Valid = _mm256_xor_si256(_mm256_cmpeq_epi16(Mask, Zero), AllOnes);
+         }
+      __m256i ValidZ = _mm256_and_si256(CodeZ, Valid);
+      MinZ = _mm256_min_epu16(MinZ, _mm256_or_si256(CodeZ, _mm256_xor_si256(Valid, AllOnes)));
+      MaxZ = _mm256_max_epu16(MaxZ, ValidZ);
+      SumZ = _mm256_add_epi32(SumZ, _mm256_cvtepu16_epi32(_mm256_castsi256_si128(ValidZ)));
+      SumZ = _mm256_add_epi32(SumZ, _mm256_cvtepu16_epi32(_mm256_extracti128_si256(ValidZ, 1)));
+      Count = _mm256_sub_epi16(Count, Valid);
+
+      _mm256_storeu_si256((__m256i*)Codes, CodeZ);
+      _mm256_storeu_si256((__m256i*)Valids, Valid);
+      for(MIL_INT i = 0; i < 16; i++)
+         Stats.Histogram[Codes[i] >> STATS_HISTOGRAM_SHIFT] += Valids[i] & 1;
+      }
+
+   // Reduce the lanes.
+   SPRowStats Row(Stats);
+   __m128i AllOnes128 = _mm_set1_epi32(-1);
+   __m128i MinZ128 = _mm_min_epu16(_mm256_castsi256_si128(MinZ), _mm256_extracti128_si256(MinZ, 1));
+   __m128i MaxZ128 = _mm_max_epu16(_mm256_castsi256_si128(MaxZ), _mm256_extracti128_si256(MaxZ, 1));
+   MIL_UINT16 VecMin = (MIL_UINT16)_mm_cvtsi128_si32(_mm_minpos_epu16(MinZ128));
+   MIL_UINT16 VecMax = (MIL_UINT16)~_mm_cvtsi128_si32(_mm_minpos_epu16(_mm_xor_si128(MaxZ128, AllOnes128)));
+   Row.MinCodeZ = VecMin < Row.MinCodeZ ? VecMin : Row.MinCodeZ;
+   Row.MaxCodeZ = VecMax > Row.MaxCodeZ ? VecMax : Row.MaxCodeZ;
+   MIL_UINT32 Sums[8];
+   MIL_UINT16 Counts[16];
+   _mm256_storeu_si256((__m256i*)Sums, SumZ);
+   _mm256_storeu_si256((__m256i*)Counts, Count);
+   for(MIL_INT i = 0; i < 8; i++)
+      Row.SumCodeZ += Sums[i];
+   for(MIL_INT i = 0; i < 16; i++)
+      Row.NbValid += Counts[i];
+
+   ConvertToWorldRemainder(pSrcX, pSrcZ, pMask, pDstX, pDstZ, x, N, Params, Row, Stats.Histogram);
+   Row.AddTo(Stats);
+   }
+
+template <MIL_INT FixedSize>
+static KERNEL_TARGET_AVX2 void MaskRowAvx2(const MIL_UINT16* pSrcZ, MIL_UINT8* pMask,
+                                           MIL_INT Size, MIL_UINT16 InvalidCode)
+   {
+   const MIL_INT N = FixedSize ? FixedSize : Size;
+   const __m256i Invalid = _mm256_set1_epi16((short)InvalidCode);
+   const __m256i AllOnes = _mm256_set1_epi32(-1);
+   MIL_INT x = 0;
+   for(; x + 32 <= N; x += 32)
+      {
+      __m256i IsInvalidLo = _mm256_cmpeq_epi16(_mm256_loadu_si256((const __m256i*)(pSrcZ + x)), Invalid);
+      __m256i IsInvalidHi = _mm256_cmpeq_epi16(_mm256_loadu_si256((const __m256i*)(pSrcZ + x + 16)), Invalid);
+
+      // The pack works per 128 bits lane. Put the 64 bits quarters back in order.
+      __m256i IsInvalid = _mm256_permute4x64_epi64(_mm256_packs_epi16(IsInvalidLo, IsInvalidHi), 0xD8);
+      _mm256_storeu_si256((__m256i*)(pMask + x), _mm256_xor_si256(IsInvalid, AllOnes));
+      }
+   if(N % 32)
+      MaskRowRemainder(pSrcZ, pMask, x, N, InvalidCode);
+   }
+#endif
+
+#if KERNELS_USE_AVX512
+//*****************************************************************************
+// AVX-512 kernels. 32 points are processed per iteration. They require the
+// AVX512F and AVX512BW extensions.
+//
+// The unmasked forms of the arithmetic and conversion intrinsics pass an
+// undefined source to the masked builtins, which GCC 12 reports as
+// uninitialized. The kernels use the zero-masked forms with all the lanes
+// set, which give the same instructions.
+//*****************************************************************************
+static const __mmask16 ALL_32BIT_LANES = 0xFFFF;
+static const __mmask32 ALL_16BIT_LANES = 0xFFFFFFFF;
+
+// Separate multiply and add. The rounding intrinsics prevent the compiler
+// from contracting them in a fused multiply-add, so that the results are
+// identical to the ones of the other instruction sets.
+static inline KERNEL_TARGET_AVX512 __m512 MulAddAvx512(__m512 Value, __m512 Scale, __m512 Offset)
+   {
+   return _mm512_maskz_add_round_ps(ALL_32BIT_LANES,
+                                    _mm512_maskz_mul_round_ps(ALL_32BIT_LANES, Value, Scale, _MM_FROUND_CUR_DIRECTION),
+                                    Offset, _MM_FROUND_CUR_DIRECTION);
+   }
+
+// Widens 16 codes to 32-bit integers.
+static inline KERNEL_TARGET_AVX512 __m512i WidenCodesAvx512(__m256i Codes)
+   {
+   return _mm512_maskz_cvtepu16_epi32(ALL_32BIT_LANES, Codes);
+   }
+
+// Gets the low or the high half of 32 codes.
+static inline KERNEL_TARGET_AVX512 __m256i LowCodesAvx512(__m512i Codes)
+   {
+   return _mm512_maskz_extracti64x4_epi64(0xFF, Codes, 0);
+   }
+
+static inline KERNEL_TARGET_AVX512 __m256i HighCodesAvx512(__m512i Codes)
+   {
+   return _mm512_maskz_extracti64x4_epi64(0xFF, Codes, 1);
+   }
+
+template <MIL_INT FixedSize>
+static KERNEL_TARGET_AVX512 void ConvertToWorldRowAvx512(const MIL_UINT16* pSrcX, const MIL_UINT16* pSrcZ,
+                                                         const MIL_UINT8* pMask, MIL_FLOAT* pDstX, MIL_FLOAT* pDstZ,
+                                                         MIL_INT Size, const SPConvertParams& Params,
+                                                         SPStatsAccumulator& Stats)
+   {
+   const MIL_INT N = FixedSize ? FixedSize : Size;
+   const __m512 ScaleX = _mm512_set1_ps(Params.ScaleX);
+   const __m512 OffsetX = _mm512_set1_ps(Params.OffsetX);
+   const __m512 ScaleZ = _mm512_set1_ps(Params.ScaleZ);
+   const __m512 OffsetZ = _mm512_set1_ps(Params.OffsetZ);
+   const __m512i One = _mm512_set1_epi16(1);
+   __m512i MinZ = _mm512_set1_epi32(-1);
+   __m512i MaxZ = _mm512_setzero_si512();
+   __m512i SumZ = _mm512_setzero_si512();
+   __m512i Count = _mm512_setzero_si512();
+   MIL_UINT16 Codes[32];
+
+   MIL_INT x = 0;
+   for(; x + 32 <= N; x += 32)
+      {
+      __m512i CodeX = _mm512_loadu_si512((const void*)(pSrcX + x));
+      __m512i CodeZ = _mm512_loadu_si512((const void*)(pSrcZ + x));
+      __m512 XLo = _mm512_maskz_cvtepi32_ps(ALL_32BIT_LANES, WidenCodesAvx512(LowCodesAvx512(CodeX)));
+      __m512 XHi = _mm512_maskz_cvtepi32_ps(ALL_32BIT_LANES, WidenCodesAvx512(HighCodesAvx512(CodeX)));
+      __m512 ZLo = _mm512_maskz_cvtepi32_ps(ALL_32BIT_LANES, WidenCodesAvx512(LowCodesAvx512(CodeZ)));
+      __m512 ZHi = _mm512_maskz_cvtepi32_ps(ALL_32BIT_LANES, WidenCodesAvx512(HighCodesAvx512(CodeZ)));
+      _mm512_storeu_ps(pDstX + x,      MulAddAvx512(XLo, ScaleX, OffsetX));
+      _mm512_storeu_ps(pDstX + x + 16, MulAddAvx512(XHi, ScaleX, OffsetX));
+      _mm512_storeu_ps(pDstZ + x,      MulAddAvx512(ZLo, ScaleZ, OffsetZ));
+      _mm512_storeu_ps(pDstZ + x + 16, MulAddAvx512(ZHi, ScaleZ, OffsetZ));
+
+      // One bit per valid point.
+      __mmask32 Valid = 0xFFFFFFFF;
+      if(pMask)
+         {
+         __m512i Mask = _mm512_maskz_cvtepu8_epi16(ALL_16BIT_LANES, _mm256_loadu_si256((const __m256i*)(pMask + x)));
+         Valid = _mm512_test_epi16_mask(Mask, Mask);
+         }
+      __m512i ValidZ = _mm512_maskz_mov_epi16(Valid, CodeZ);
+      MinZ = _mm512_mask_min_epu16(MinZ, Valid, MinZ, CodeZ);
+      MaxZ = _mm512_max_epu16(MaxZ, ValidZ);
+      SumZ = _mm512_add_epi32(SumZ, WidenCodesAvx512(LowCodesAvx512(ValidZ)));
+      SumZ = _mm512_add_epi32(SumZ, WidenCodesAvx512(HighCodesAvx512(ValidZ)));
+      Count = _mm512_mask_add_epi16(Count, Valid, Count, One);
+
+      _mm512_storeu_si512((void*)Codes, CodeZ);
+      for(MIL_INT i = 0; i < 32; i++)
+         Stats.Histogram[Codes[i] >> STATS_HISTOGRAM_SHIFT] += (Valid >> i) & 1;
+      }
+
+   // Reduce the lanes.
+   SPRowStats Row(Stats);
+   MIL_UINT16 Mins[32];
+   MIL_UINT16 Maxs[32];
+   MIL_UINT16 Counts[32];
+   MIL_UINT32 Sums[16];
+   _mm512_storeu_si512((void*)Mins, MinZ);
+   _mm512_storeu_si512((void*)Maxs, MaxZ);
+   _mm512_storeu_si512((void*)Counts, Count);
+   _mm512_storeu_si512((void*)Sums, SumZ);
+   for(MIL_INT i = 0; i < 32; i++)
+      {
+      Row.MinCodeZ = Mins[i] < Row.MinCodeZ ? Mins[i] : Row.MinCodeZ;
+      Row.MaxCodeZ = Maxs[i] > Row.MaxCodeZ ? Maxs[i] : Row.MaxCodeZ;
+      Row.NbValid += Counts[i];
+      }
+   for(MIL_INT i = 0; i < 16; i++)
+      Row.SumCodeZ += Sums[i];
+
+   ConvertToWorldRemainder(pSrcX, pSrcZ, pMask, pDstX, pDstZ, x, N, Params, Row, Stats.Histogram);
+   Row.AddTo(Stats);
+   }
+
+template <MIL_INT FixedSize>
+static KERNEL_TARGET_AVX512 void MaskRowAvx512(const MIL_UINT16* pSrcZ, MIL_UINT8* pMask,
+                                               MIL_INT Size, MIL_UINT16 InvalidCode)
+   {
+   const MIL_INT N = FixedSize ? FixedSize : Size;
+   const __m512i Invalid = _mm512_set1_epi16((short)InvalidCode);
+   MIL_INT x = 0;
+   for(; x + 32 <= N; x += 32)
+      {
+      __mmask32 IsValid = _mm512_cmpneq_epu16_mask(_mm512_loadu_si512((const void*)(pSrcZ + x)), Invalid);
+      _mm256_storeu_si256((__m256i*)(pMask + x),
+                          _mm512_maskz_cvtepi16_epi8(ALL_16BIT_LANES, _mm512_movm_epi16(IsValid)));
+      }
+   if(N % 32)
+      MaskRowRemainder(pSrcZ, pMask, x, N, InvalidCode);
+   }
+#endif
+
+//*****************************************************************************
+// Depth map quantization. The points of a profile are quantized to the cell
+// and the gray level of a depth map row. The points outside the row or the
+// gray level range, and the invalid points, get the cell -1.
+//*****************************************************************************
+static inline void QuantizePoint(MIL_FLOAT X, MIL_FLOAT Z, MIL_UINT8 Valid, const SPRasterParams& Params,
+                                 MIL_INT32& Cell, MIL_INT32& Depth)
+   {
+   MIL_FLOAT CellX = floorf(X * Params.ScaleX + Params.OffsetX + 0.5f);
+   MIL_FLOAT CellZ = floorf(Z * Params.ScaleZ + Params.OffsetZ + 0.5f);
+   bool Inside = Valid && CellX >= 0.0f && CellX < (MIL_FLOAT)Params.SizeX &&
+                 CellZ >= 0.0f && CellZ <= (MIL_FLOAT)MAX_DEPTH;
+   Cell = Inside ? (MIL_INT32)CellX : -1;
+   Depth = Inside ? (MIL_INT32)CellZ : 0;
+   }
+
+static KERNEL_NOINLINE void QuantizeRemainder(const MIL_FLOAT* pSrcX, const MIL_FLOAT* pSrcZ,
+                                              const MIL_UINT8* pMask, MIL_INT Size,
+                                              const SPRasterParams& Params,
+                                              MIL_INT32* pCells, MIL_INT32* pDepths)
+   {
+   for(MIL_INT i = 0; i < Size; i++)
+      QuantizePoint(pSrcX[i], pSrcZ[i], pMask ? pMask[i] : (MIL_UINT8)1, Params, pCells[i], pDepths[i]);
+   }
+
+template <MIL_INT FixedSize>
+static void QuantizeRowScalar(const MIL_FLOAT* pSrcX, const MIL_FLOAT* pSrcZ, const MIL_UINT8* pMask,
+                              MIL_INT32* pCells, MIL_INT32* pDepths, MIL_INT Size, const SPRasterParams& Params)
+   {
+   const MIL_INT N = FixedSize ? FixedSize : Size;
+   QuantizeRemainder(pSrcX, pSrcZ, pMask, N, Params, pCells, pDepths);
+   }
+
+#if KERNELS_USE_SSE41
+static KERNEL_TARGET_SSE41 void QuantizeBlockSse41(const MIL_FLOAT* pSrcX, const MIL_FLOAT* pSrcZ,
+                                                   const MIL_UINT8* pMask, const SPRasterParams& Params,
+                                                   MIL_INT32* pCells, MIL_INT32* pDepths)
+   {
+   const __m128 ScaleX = _mm_set1_ps(Params.ScaleX);
+   const __m128 OffsetX = _mm_set1_ps(Params.OffsetX);
+   const __m128 ScaleZ = _mm_set1_ps(Params.ScaleZ);
+   const __m128 OffsetZ = _mm_set1_ps(Params.OffsetZ);
+   const __m128 Half = _mm_set1_ps(0.5f);
+   const __m128 Zero = _mm_setzero_ps();
+   const __m128 SizeX = _mm_set1_ps((MIL_FLOAT)Params.SizeX);
+   const __m128 MaxDepth = _mm_set1_ps((MIL_FLOAT)MAX_DEPTH);
+   const __m128i AllOnes = _mm_set1_epi32(-1);
+   for(MIL_INT i = 0; i < KERNEL_BLOCK_SIZE; i += 4)
+      {
+      __m128 CellX = _mm_floor_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(pSrcX + i), ScaleX), OffsetX), Half));
+      __m128 CellZ = _mm_floor_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(pSrcZ + i), ScaleZ), OffsetZ), Half));
+      __m128 InsideX = _mm_and_ps(_mm_cmpge_ps(CellX, Zero), _mm_cmplt_ps(CellX, SizeX));
+      __m128 InsideZ = _mm_and_ps(_mm_cmpge_ps(CellZ, Zero), _mm_cmple_ps(CellZ, MaxDepth));
+      __m128i Inside = _mm_castps_si128(_mm_and_ps(InsideX, InsideZ));
+      if(pMask)
+         {
+         MIL_INT32 Mask4;
+         memcpy(&Mask4, pMask + i, sizeof(Mask4));
+         __m128i Mask = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(Mask4));
+         Inside = _mm_andnot_si128(_mm_cmpeq_epi32(Mask, _mm_setzero_si128()), Inside);
+         }
+      __m128i Cells = _mm_or_si128(_mm_and_si128(Inside, _mm_cvttps_epi32(CellX)), _mm_andnot_si128(Inside, AllOnes));
+      __m128i Depths = _mm_and_si128(Inside, _mm_cvttps_epi32(CellZ));
+      _mm_storeu_si128((__m128i*)(pCells + i), Cells);
+      _mm_storeu_si128((__m128i*)(pDepths + i), Depths);
+      }
+   }
+
+template <MIL_INT FixedSize>
+static KERNEL_TARGET_SSE41 void QuantizeRowSse41(const MIL_FLOAT* pSrcX, const MIL_FLOAT* pSrcZ, const MIL_UINT8* pMask,
+                                                 MIL_INT32* pCells, MIL_INT32* pDepths, MIL_INT Size, const SPRasterParams& Params)
+   {
+   const MIL_INT N = FixedSize ? FixedSize : Size;
+   MIL_INT x = 0;
+   for(; x + KERNEL_BLOCK_SIZE <= N; x += KERNEL_BLOCK_SIZE)
+      QuantizeBlockSse41(pSrcX + x, pSrcZ + x, pMask ? pMask + x : M_NULL, Params, pCells + x, pDepths + x);
+   QuantizeRemainder(pSrcX + x, pSrcZ + x, pMask ? pMask + x : M_NULL, N - x, Params, pCells + x, pDepths + x);
+   }
+#endif
+
+#if KERNELS_USE_AVX2
+static KERNEL_TARGET_AVX2 void QuantizeBlockAvx2(const MIL_FLOAT* pSrcX, const MIL_FLOAT* pSrcZ,
+                                                 const MIL_UINT8* pMask, const SPRasterParams& Params,
+                                                 MIL_INT32* pCells, MIL_INT32* pDepths)
+   {
+   const __m256 ScaleX = _mm256_set1_ps(Params.ScaleX);
+   const __m256 OffsetX = _mm256_set1_ps(Params.OffsetX);
+   const __m256 ScaleZ = _mm256_set1_ps(Params.ScaleZ);
+   const __m256 OffsetZ = _mm256_set1_ps(Params.OffsetZ);
+   const __m256 Half = _mm256_set1_ps(0.5f);
+   const __m256 Zero = _mm256_setzero_ps();
+   const __m256 SizeX = _mm256_set1_ps((MIL_FLOAT)Params.SizeX);
+   const __m256 MaxDepth = _mm256_set1_ps((MIL_FLOAT)MAX_DEPTH);
+   const __m256i AllOnes = _mm256_set1_epi32(-1);
+   for(MIL_INT i = 0; i < KERNEL_BLOCK_SIZE; i += 8)
+      {
+      __m256 CellX = _mm256_floor_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(pSrcX + i), ScaleX), OffsetX), Half));
+      __m256 CellZ = _mm256_floor_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(pSrcZ + i), ScaleZ), OffsetZ), Half));
+      __m256 InsideX = _mm256_and_ps(_mm256_cmp_ps(CellX, Zero, _CMP_GE_OQ), _mm256_cmp_ps(CellX, SizeX, _CMP_LT_OQ));
+      __m256 InsideZ = _mm256_and_ps(_mm256_cmp_ps(CellZ, Zero, _CMP_GE_OQ), _mm256_cmp_ps(CellZ, MaxDepth, _CMP_LE_OQ));
+      __m256i Inside = _mm256_castps_si256(_mm256_and_ps(InsideX, InsideZ));
+      if(pMask)
+         {
+         __m256i Mask = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(pMask + i)));
+         Inside = _mm256_andnot_si256(_mm256_cmpeq_epi32(Mask, _mm256_setzero_si256()), Inside);
+         }
+      __m256i Cells = _mm256_blendv_epi8(AllOnes, _mm256_cvttps_epi32(CellX), Inside);
+      __m256i Depths = _mm256_and_si256(Inside, _mm256_cvttps_epi32(CellZ));
+      _mm256_storeu_si256((__m256i*)(pCells + i), Cells);
+      _mm256_storeu_si256((__m256i*)(pDepths + i), Depths);
+      }
+   }
+
+template <MIL_INT FixedSize>
+static KERNEL_TARGET_AVX2 void QuantizeRowAvx2(const MIL_FLOAT* pSrcX, const MIL_FLOAT* pSrcZ, const MIL_UINT8* pMask,
+                                               MIL_INT32* pCells, MIL_INT32* pDepths, MIL_INT Size, const SPRasterParams& Params)
+   {
+   const MIL_INT N = FixedSize ? FixedSize : Size;
+   MIL_INT x = 0;
+   for(; x + KERNEL_BLOCK_SIZE <= N; x += KERNEL_BLOCK_SIZE)
+      QuantizeBlockAvx2(pSrcX + x, pSrcZ + x, pMask ? pMask + x : M_NULL, Params, pCells + x, pDepths + x);
+   QuantizeRemainder(pSrcX + x, pSrcZ + x, pMask ? pMask + x : M_NULL, N - x, Params, pCells + x, pDepths + x);
+   }
+#endif
+
+//*****************************************************************************
+// Depth map row interpolation. The cells of a row are interpolated linearly
+// between two rows with a fixed point weight. A cell is invalid if one of
+// its two source cells is invalid.
+//*****************************************************************************
+static inline MIL_UINT16 InterpolateCell(MIL_UINT16 Depth0, MIL_UINT16 Depth1, MIL_UINT32 Weight)
+   {
+   MIL_UINT32 Depth = (Depth0 * (INTERPOLATION_WEIGHT_ONE - Weight) + Depth1 * Weight +
+                       INTERPOLATION_WEIGHT_ONE / 2) >> INTERPOLATION_WEIGHT_BITS;
+   return (Depth0 == INVALID_DEPTH || Depth1 == INVALID_DEPTH) ? INVALID_DEPTH : (MIL_UINT16)Depth;
+   }
+
+static void InterpolateRowScalar(const MIL_UINT16* pSrcRow0, const MIL_UINT16* pSrcRow1, MIL_UINT16* pDstRow,
+                                 MIL_INT SizeX, MIL_UINT32 Weight)
+   {
+   for(MIL_INT x = 0; x < SizeX; x++)
+      pDstRow[x] = InterpolateCell(pSrcRow0[x], pSrcRow1[x], Weight);
+   }
+
+#if KERNELS_USE_SSE41
+static KERNEL_TARGET_SSE41 void InterpolateRowSse41(const MIL_UINT16* pSrcRow0, const MIL_UINT16* pSrcRow1,
+                                                    MIL_UINT16* pDstRow, MIL_INT SizeX, MIL_UINT32 Weight)
+   {
+   const __m128i Weight0 = _mm_set1_epi32((int)(INTERPOLATION_WEIGHT_ONE - Weight));
+   const __m128i Weight1 = _mm_set1_epi32((int)Weight);
+   const __m128i Round = _mm_set1_epi32((int)(INTERPOLATION_WEIGHT_ONE / 2));
+   const __m128i Invalid = _mm_set1_epi16((short)INVALID_DEPTH);
+   MIL_INT x = 0;
+   for(; x + 8 <= SizeX; x += 8)
+      {
+      __m128i Depth0 = _mm_loadu_si128((const __m128i*)(pSrcRow0 + x));
+      __m128i Depth1 = _mm_loadu_si128((const __m128i*)(pSrcRow1 + x));
+      __m128i Lo = _mm_add_epi32(_mm_add_epi32(_mm_mullo_epi32(_mm_cvtepu16_epi32(Depth0), Weight0),
+                                               _mm_mullo_epi32(_mm_cvtepu16_epi32(Depth1), Weight1)), Round);
+      __m128i Hi = _mm_add_epi32(_mm_add_epi32(_mm_mullo_epi32(_mm_cvtepu16_epi32(_mm_srli_si128(Depth0, 8)), Weight0),
+                                               _mm_mullo_epi32(_mm_cvtepu16_epi32(_mm_srli_si128(Depth1, 8)), Weight1)), Round);
+      __m128i Depth = _mm_packus_epi32(_mm_srli_epi32(Lo, INTERPOLATION_WEIGHT_BITS),
+                                       _mm_srli_epi32(Hi, INTERPOLATION_WEIGHT_BITS));
+      __m128i IsInvalid = _mm_or_si128(_mm_cmpeq_epi16(Depth0, Invalid), _mm_cmpeq_epi16(Depth1, Invalid));
+      _mm_storeu_si128((__m128i*)(pDstRow + x), _mm_or_si128(Depth, IsInvalid));
+      }
+   for(; x < SizeX; x++)
+      pDstRow[x] = InterpolateCell(pSrcRow0[x], pSrcRow1[x], Weight);
+   }
+#endif
+
+#if KERNELS_USE_AVX2
+static KERNEL_TARGET_AVX2 void InterpolateRowAvx2(const MIL_UINT16* pSrcRow0, const MIL_UINT16* pSrcRow1,
+                                                  MIL_UINT16* pDstRow, MIL_INT SizeX, MIL_UINT32 Weight)
+   {
+   const __m256i Weight0 = _mm256_set1_epi32((int)(INTERPOLATION_WEIGHT_ONE - Weight));
+   const __m256i Weight1 = _mm256_set1_epi32((int)Weight);
+   const __m256i Round = _mm256_set1_epi32((int)(INTERPOLATION_WEIGHT_ONE / 2));
+   const __m256i Invalid = _mm256_set1_epi16((short)INVALID_DEPTH);
+   MIL_INT x = 0;
+   for(; x + 16 <= SizeX; x += 16)
+      {
+      __m256i Depth0 = _mm256_loadu_si256((const __m256i*)(pSrcRow0 + x));
+      __m256i Depth1 = _mm256_loadu_si256((const __m256i*)(pSrcRow1 + x));
+      __m256i Lo = _mm256_add_epi32(_mm256_add_epi32(
+                      _mm256_mullo_epi32(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(Depth0)), Weight0),
+                      _mm256_mullo_epi32(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(Depth1)), Weight1)), Round);
+      __m256i Hi = _mm256_add_epi32(_mm256_add_epi32(
+                      _mm256_mullo_epi32(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(Depth0, 1)), Weight0),
+                      _mm256_mullo_epi32(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(Depth1, 1)), Weight1)), Round);
+
+      // The pack works on each 128 bits lane; put the quarters back in order.
+      __m256i Depth = _mm256_packus_epi32(_mm256_srli_epi32(Lo, INTERPOLATION_WEIGHT_BITS),
+                                          _mm256_srli_epi32(Hi, INTERPOLATION_WEIGHT_BITS));
+      Depth = _mm256_permute4x64_epi64(Depth, 0xD8);
+      __m256i IsInvalid = _mm256_or_si256(_mm256_cmpeq_epi16(Depth0, Invalid), _mm256_cmpeq_epi16(Depth1, Invalid));
+      _mm256_storeu_si256((__m256i*)(pDstRow + x), _mm256_or_si256(Depth, IsInvalid));
+      }
+   for(; x < SizeX; x++)
+      pDstRow[x] = InterpolateCell(pSrcRow0[x], pSrcRow1[x], Weight);
+   }
+#endif
+
+//*****************************************************************************
+// Depth map row deviation. The deviation is saturated to MAX_DEVIATION so
+// that DEVIATION_INVALID stays distinct.
+//*****************************************************************************
+static inline MIL_UINT8 DeviationCell(MIL_UINT16 Depth, MIL_UINT16 Ref, MIL_UINT16 Tolerance,
+                                      MIL_INT16& Deviation, MIL_UINT16& MaxDeviation)
+   {
+   bool IsValid = Depth != INVALID_DEPTH;
+   bool IsRefValid = Ref != INVALID_DEPTH;
+   MIL_INT Diff = (MIL_INT)Depth - (MIL_INT)Ref;
+   Diff = Diff > MAX_DEVIATION ? MAX_DEVIATION : (Diff < -MAX_DEVIATION ? -MAX_DEVIATION : Diff);
+   MIL_UINT16 AbsDiff = (MIL_UINT16)(Diff < 0 ? -Diff : Diff);
+   if(IsValid && IsRefValid)
+      {
+      Deviation = (MIL_INT16)Diff;
+      MaxDeviation = AbsDiff > MaxDeviation ? AbsDiff : MaxDeviation;
+      return AbsDiff > Tolerance ? 255 : 0;
+      }
+   Deviation = DEVIATION_INVALID;
+   return IsValid != IsRefValid ? 255 : 0;
+   }
+
+static MIL_INT DeviationRowScalar(const MIL_UINT16* pSrcRow, const MIL_UINT16* pRefRow, MIL_INT16* pDeviation,
+                                  MIL_UINT8* pFlags, MIL_INT SizeX, MIL_UINT16 Tolerance,
+                                  MIL_UINT16& MaxDeviation)
+   {
+   MIL_INT NbFlagged = 0;
+   for(MIL_INT x = 0; x < SizeX; x++)
+      {
+      pFlags[x] = DeviationCell(pSrcRow[x], pRefRow[x], Tolerance, pDeviation[x], MaxDeviation);
+      NbFlagged += pFlags[x] & 1;
+      }
+   return NbFlagged;
+   }
+
+#if KERNELS_USE_SSE41
+// The unsigned depths are biased to signed values so that the saturated
+// subtraction gives the saturated deviation. The flags are summed with
+// _mm_sad_epu8, which does not need the POPCNT instruction.
+static KERNEL_TARGET_SSE41 MIL_INT DeviationRowSse41(const MIL_UINT16* pSrcRow, const MIL_UINT16* pRefRow,
+                                                     MIL_INT16* pDeviation, MIL_UINT8* pFlags, MIL_INT SizeX,
+                                                     MIL_UINT16 Tolerance, MIL_UINT16& MaxDeviation)
+   {
+   const __m128i Bias = _mm_set1_epi16((short)0x8000);
+   const __m128i Invalid = _mm_set1_epi16((short)INVALID_DEPTH);
+   const __m128i MinDiff = _mm_set1_epi16((short)-MAX_DEVIATION);
+   const __m128i InvalidDeviation = _mm_set1_epi16(DEVIATION_INVALID);
+   const __m128i Tol = _mm_set1_epi16((short)Tolerance);
+   const __m128i One = _mm_set1_epi8(1);
+   __m128i Max = _mm_setzero_si128();
+   __m128i NbFlagged = _mm_setzero_si128();
+   MIL_INT x = 0;
+   for(; x + 8 <= SizeX; x += 8)
+      {
+      __m128i Depth = _mm_loadu_si128((const __m128i*)(pSrcRow + x));
+      __m128i Ref = _mm_loadu_si128((const __m128i*)(pRefRow + x));
+      __m128i Diff = _mm_max_epi16(_mm_subs_epi16(_mm_xor_si128(Depth, Bias), _mm_xor_si128(Ref, Bias)), MinDiff);
+      __m128i AbsDiff = _mm_abs_epi16(Diff);
+      __m128i IsInvalid = _mm_cmpeq_epi16(Depth, Invalid);
+      __m128i IsRefInvalid = _mm_cmpeq_epi16(Ref, Invalid);
+      __m128i NotBoth = _mm_or_si128(IsInvalid, IsRefInvalid);
+      __m128i Flag = _mm_or_si128(_mm_andnot_si128(NotBoth, _mm_cmpgt_epi16(AbsDiff, Tol)),
+                                  _mm_xor_si128(IsInvalid, IsRefInvalid));
+      _mm_storeu_si128((__m128i*)(pDeviation + x), _mm_blendv_epi8(Diff, InvalidDeviation, NotBoth));
+      Max = _mm_max_epi16(Max, _mm_andnot_si128(NotBoth, AbsDiff));
+
+      __m128i Flags = _mm_packs_epi16(Flag, _mm_setzero_si128());
+      _mm_storel_epi64((__m128i*)(pFlags + x), Flags);
+      NbFlagged = _mm_add_epi64(NbFlagged, _mm_sad_epu8(_mm_and_si128(Flags, One), _mm_setzero_si128()));
+      }
+
+   MIL_INT16 Maxs[8];
+   _mm_storeu_si128((__m128i*)Maxs, Max);
+   for(MIL_INT i = 0; i < 8; i++)
+      MaxDeviation = (MIL_UINT16)Maxs[i] > MaxDeviation ? (MIL_UINT16)Maxs[i] : MaxDeviation;
+   MIL_INT Count = (MIL_INT)_mm_cvtsi128_si32(NbFlagged);
+   for(; x < SizeX; x++)
+      {
+      pFlags[x] = DeviationCell(pSrcRow[x], pRefRow[x], Tolerance, pDeviation[x], MaxDeviation);
+      Count += pFlags[x] & 1;
+      }
+   return Count;
+   }
+#endif
+
+#if KERNELS_USE_AVX2
+static KERNEL_TARGET_AVX2 MIL_INT DeviationRowAvx2(const MIL_UINT16* pSrcRow, const MIL_UINT16* pRefRow,
+                                                   MIL_INT16* pDeviation, MIL_UINT8* pFlags, MIL_INT SizeX,
+                                                   MIL_UINT16 Tolerance, MIL_UINT16& MaxDeviation)
+   {
+   const __m256i Bias = _mm256_set1_epi16((short)0x8000);
+   const __m256i Invalid = _mm256_set1_epi16((short)INVALID_DEPTH);
+   const __m256i MinDiff = _mm256_set1_epi16((short)-MAX_DEVIATION);
+   const __m256i InvalidDeviation = _mm256_set1_epi16(DEVIATION_INVALID);
+   const __m256i Tol = _mm256_set1_epi16((short)Tolerance);
+   const __m128i One = _mm_set1_epi8(1);
+   __m256i Max = _mm256_setzero_si256();
+   __m128i NbFlagged = _mm_setzero_si128();
+   MIL_INT x = 0;
+   for(; x + 16 <= SizeX; x += 16)
+      {
+      __m256i Depth = _mm256_loadu_si256((const __m256i*)(pSrcRow + x));
+      __m256i Ref = _mm256_loadu_si256((const __m256i*)(pRefRow + x));
+      __m256i Diff = _mm256_max_epi16(_mm256_subs_epi16(_mm256_xor_si256(Depth, Bias),
+                                                        _mm256_xor_si256(Ref, Bias)), MinDiff);
+      __m256i AbsDiff = _mm256_abs_epi16(Diff);
+      __m256i IsInvalid = _mm256_cmpeq_epi16(Depth, Invalid);
+      __m256i IsRefInvalid = _mm256_cmpeq_epi16(Ref, Invalid);
+      __m256i NotBoth = _mm256_or_si256(IsInvalid, IsRefInvalid);
+      __m256i Flag = _mm256_or_si256(_mm256_andnot_si256(NotBoth, _mm256_cmpgt_epi16(AbsDiff, Tol)),
+                                     _mm256_xor_si256(IsInvalid, IsRefInvalid));
+      _mm256_storeu_si256((__m256i*)(pDeviation + x), _mm256_blendv_epi8(Diff, InvalidDeviation, NotBoth));
+      Max = _mm256_max_epi16(Max, _mm256_andnot_si256(NotBoth, AbsDiff));
+
+      // The pack works on each 128 bits lane; gather the low halves.
+      __m256i Packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(Flag, Flag), 0x08);
+      __m128i Flags = _mm256_castsi256_si128(Packed);
+      _mm_storeu_si128((__m128i*)(pFlags + x), Flags);
+      NbFlagged = _mm_add_epi64(NbFlagged, _mm_sad_epu8(_mm_and_si128(Flags, One), _mm_setzero_si128()));
+      }
+
+   MIL_INT16 Maxs[16];
+   _mm256_storeu_si256((__m256i*)Maxs, Max);
+   for(MIL_INT i = 0; i < 16; i++)
+      MaxDeviation = (MIL_UINT16)Maxs[i] > MaxDeviation ? (MIL_UINT16)Maxs[i] : MaxDeviation;
+   MIL_INT Count = (MIL_INT)(_mm_cvtsi128_si32(NbFlagged) + _mm_extract_epi32(NbFlagged, 2));
+   for(; x < SizeX; x++)
+      {
+      pFlags[x] = DeviationCell(pSrcRow[x], pRefRow[x], Tolerance, pDeviation[x], MaxDeviation);
+      Count += pFlags[x] & 1;
+      }
+   return Count;
+   }
+#endif
+
+//*****************************************************************************
+// Organized point cloud normals. The derivatives of the height field are:
+//    Zx  = (Z[x+1] - Z[x-1]) / (X[x+1] - X[x-1])
+//    Zxx = 2 * (slope after - slope before) / (X[x+1] - X[x-1])
+//    Zy, Zyy and Zxy with the rows before and after, StepY apart.
+// The normal is (-Zx, -Zy, 1) / sqrt(G), with G = 1 + Zx2 + Zy2, and the mean
+// curvature is ((1 + Zy2) Zxx - 2 Zx Zy Zxy + (1 + Zx2) Zyy) / (2 G^1.5).
+//*****************************************************************************
+static inline void NormalPoint(const MIL_FLOAT* pX, const MIL_FLOAT* const pZ[3], const MIL_UINT8* const pMask[3],
+                               MIL_FLOAT* pNormalX, MIL_FLOAT* pNormalY, MIL_FLOAT* pNormalZ,
+                               MIL_FLOAT* pCurvature, MIL_UINT8* pNormalMask, MIL_INT x,
+                               MIL_FLOAT InvStep2, MIL_FLOAT InvStepSq)
+   {
+   MIL_FLOAT Dx0 = pX[x] - pX[x - 1];
+   MIL_FLOAT Dx1 = pX[x + 1] - pX[x];
+   bool IsValid = Dx0 != 0 && Dx1 != 0;
+   for(MIL_INT r = 0; r < 3; r++)
+      IsValid = IsValid && pMask[r][x - 1] && pMask[r][x] && pMask[r][x + 1];
+   if(!IsValid)
+      {
+      pNormalX[x] = pNormalY[x] = pNormalZ[x] = pCurvature[x] = 0;
+      pNormalMask[x] = 0;
+      return;
+      }
+
+   const MIL_FLOAT* pZ0 = pZ[0];
+   const MIL_FLOAT* pZ1 = pZ[1];
+   const MIL_FLOAT* pZ2 = pZ[2];
+   MIL_FLOAT InvDx2 = 1.0f / (Dx0 + Dx1);
+   MIL_FLOAT Zx = (pZ1[x + 1] - pZ1[x - 1]) * InvDx2;
+   MIL_FLOAT Zxx = 2.0f * ((pZ1[x + 1] - pZ1[x]) / Dx1 - (pZ1[x] - pZ1[x - 1]) / Dx0) * InvDx2;
+   MIL_FLOAT Zy = (pZ2[x] - pZ0[x]) * InvStep2;
+   MIL_FLOAT Zyy = ((pZ2[x] + pZ0[x]) - 2.0f * pZ1[x]) * InvStepSq;
+   MIL_FLOAT Zxy = ((pZ2[x + 1] - pZ2[x - 1]) - (pZ0[x + 1] - pZ0[x - 1])) * InvStep2 * InvDx2;
+   MIL_FLOAT Zx2 = Zx * Zx;
+   MIL_FLOAT Zy2 = Zy * Zy;
+   MIL_FLOAT InvNorm = 1.0f / sqrtf(1.0f + Zx2 + Zy2);
+   pNormalX[x] = -Zx * InvNorm;
+   pNormalY[x] = -Zy * InvNorm;
+   pNormalZ[x] = InvNorm;
+   pCurvature[x] = ((1.0f + Zy2) * Zxx - 2.0f * Zx * Zy * Zxy + (1.0f + Zx2) * Zyy) *
+                   (0.5f * InvNorm * InvNorm * InvNorm);
+   pNormalMask[x] = 255;
+   }
+
+// Sets the normals of the first and the last point of a row, which do not
+// have their neighbors.
+static inline void ClearNormalEnds(MIL_FLOAT* pNormalX, MIL_FLOAT* pNormalY, MIL_FLOAT* pNormalZ,
+                                   MIL_FLOAT* pCurvature, MIL_UINT8* pNormalMask, MIL_INT Size)
+   {
+   MIL_INT Ends[2] = {0, Size - 1};
+   for(MIL_INT e = 0; e < 2 && Size > 0; e++)
+      {
+      MIL_INT x = Ends[e];
+      pNormalX[x] = pNormalY[x] = pNormalZ[x] = pCurvature[x] = 0;
+      pNormalMask[x] = 0;
+      }
+   }
+
+static void NormalRowScalar(const MIL_FLOAT* pX, const MIL_FLOAT* const pZ[3], const MIL_UINT8* const pMask[3],
+                            MIL_FLOAT* pNormalX, MIL_FLOAT* pNormalY, MIL_FLOAT* pNormalZ,
+                            MIL_FLOAT* pCurvature, MIL_UINT8* pNormalMask, MIL_INT Size, MIL_FLOAT StepY)
+   {
+   MIL_FLOAT InvStep2 = 0.5f / StepY;
+   MIL_FLOAT InvStepSq = 1.0f / (StepY * StepY);
+   ClearNormalEnds(pNormalX, pNormalY, pNormalZ, pCurvature, pNormalMask, Size);
+   for(MIL_INT x = 1; x < Size - 1; x++)
+      NormalPoint(pX, pZ, pMask, pNormalX, pNormalY, pNormalZ, pCurvature, pNormalMask, x, InvStep2, InvStepSq);
+   }
+
+#if KERNELS_USE_SSE41
+// Loads the valid flags of 4 points of a mask as 32 bits masks.
+static inline KERNEL_TARGET_SSE41 __m128i LoadMask4Sse41(const MIL_UINT8* pMask)
+   {
+   MIL_INT32 Bytes;
+   memcpy(&Bytes, pMask, sizeof(Bytes));
+   __m128i Mask = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(Bytes));
+   return _mm_xor_si128(_mm_cmpeq_epi32(Mask, _mm_setzero_si128()), _mm_set1_epi32(-1));
+   }
+
+static KERNEL_TARGET_SSE41 void NormalRowSse41(const MIL_FLOAT* pX, const MIL_FLOAT* const pZ[3],
+                                               const MIL_UINT8* const pMask[3],
+                                               MIL_FLOAT* pNormalX, MIL_FLOAT* pNormalY, MIL_FLOAT* pNormalZ,
+                                               MIL_FLOAT* pCurvature, MIL_UINT8* pNormalMask,
+                                               MIL_INT Size, MIL_FLOAT StepY)
+   {
+   MIL_FLOAT InvStep2 = 0.5f / StepY;
+   MIL_FLOAT InvStepSq = 1.0f / (StepY * StepY);
+   const __m128 One = _mm_set1_ps(1.0f);
+   const __m128 Two = _mm_set1_ps(2.0f);
+   const __m128 Half = _mm_set1_ps(0.5f);
+   const __m128 Zero = _mm_setzero_ps();
+   const __m128 InvStep2s = _mm_set1_ps(InvStep2);
+   const __m128 InvStepSqs = _mm_set1_ps(InvStepSq);
+   const MIL_FLOAT* pZ0 = pZ[0];
+   const MIL_FLOAT* pZ1 = pZ[1];
+   const MIL_FLOAT* pZ2 = pZ[2];
+   ClearNormalEnds(pNormalX, pNormalY, pNormalZ, pCurvature, pNormalMask, Size);
+   MIL_INT x = 1;
+   for(; x + 4 <= Size - 1; x += 4)
+      {
+      __m128i Valid = _mm_set1_epi32(-1);
+      for(MIL_INT r = 0; r < 3; r++)
+         {
+         Valid = _mm_and_si128(Valid, LoadMask4Sse41(pMask[r] + x - 1));
+         Valid = _mm_and_si128(Valid, LoadMask4Sse41(pMask[r] + x));
+         Valid = _mm_and_si128(Valid, LoadMask4Sse41(pMask[r] + x + 1));
+         }
+      __m128 X = _mm_loadu_ps(pX + x);
+      __m128 Dx0 = _mm_sub_ps(X, _mm_loadu_ps(pX + x - 1));
+      __m128 Dx1 = _mm_sub_ps(_mm_loadu_ps(pX + x + 1), X);
+      __m128 IsValid = _mm_and_ps(_mm_castsi128_ps(Valid),
+                                  _mm_and_ps(_mm_cmpneq_ps(Dx0, Zero), _mm_cmpneq_ps(Dx1, Zero)));
+
+      __m128 Z1Prev = _mm_loadu_ps(pZ1 + x - 1);
+      __m128 Z1 = _mm_loadu_ps(pZ1 + x);
+      __m128 Z1Next = _mm_loadu_ps(pZ1 + x + 1);
+      __m128 Z0 = _mm_loadu_ps(pZ0 + x);
+      __m128 Z2 = _mm_loadu_ps(pZ2 + x);
+      __m128 InvDx2 = _mm_div_ps(One, _mm_add_ps(Dx0, Dx1));
+      __m128 Zx = _mm_mul_ps(_mm_sub_ps(Z1Next, Z1Prev), InvDx2);
+      __m128 Zxx = _mm_mul_ps(_mm_mul_ps(Two, _mm_sub_ps(_mm_div_ps(_mm_sub_ps(Z1Next, Z1), Dx1),
+                                                         _mm_div_ps(_mm_sub_ps(Z1, Z1Prev), Dx0))), InvDx2);
+      __m128 Zy = _mm_mul_ps(_mm_sub_ps(Z2, Z0), InvStep2s);
+      __m128 Zyy = _mm_mul_ps(_mm_sub_ps(_mm_add_ps(Z2, Z0), _mm_mul_ps(Two, Z1)), InvStepSqs);
+      __m128 Zxy = _mm_mul_ps(_mm_mul_ps(_mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(pZ2 + x + 1), _mm_loadu_ps(pZ2 + x - 1)),
+                                                    _mm_sub_ps(_mm_loadu_ps(pZ0 + x + 1), _mm_loadu_ps(pZ0 + x - 1))),
+                                         InvStep2s), InvDx2);
+      __m128 Zx2 = _mm_mul_ps(Zx, Zx);
+      __m128 Zy2 = _mm_mul_ps(Zy, Zy);
+      __m128 InvNorm = _mm_div_ps(One, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(One, Zx2), Zy2)));
+      __m128 Curvature = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(_mm_add_ps(One, Zy2), Zxx),
+                                               _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(Two, Zx), Zy), Zxy)),
+                                    _mm_mul_ps(_mm_add_ps(One, Zx2), Zyy));
+      Curvature = _mm_mul_ps(Curvature, _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(Half, InvNorm), InvNorm), InvNorm));
+
+      _mm_storeu_ps(pNormalX + x, _mm_and_ps(_mm_sub_ps(Zero, _mm_mul_ps(Zx, InvNorm)), IsValid));
+      _mm_storeu_ps(pNormalY + x, _mm_and_ps(_mm_sub_ps(Zero, _mm_mul_ps(Zy, InvNorm)), IsValid));
+      _mm_storeu_ps(pNormalZ + x, _mm_and_ps(InvNorm, IsValid));
+      _mm_storeu_ps(pCurvature + x, _mm_and_ps(Curvature, IsValid));
+      __m128i Mask16 = _mm_packs_epi32(_mm_castps_si128(IsValid), _mm_setzero_si128());
+      MIL_INT32 MaskBytes = _mm_cvtsi128_si32(_mm_packs_epi16(Mask16, _mm_setzero_si128()));
+      memcpy(pNormalMask + x, &MaskBytes, sizeof(MaskBytes));
+      }
+   for(; x < Size - 1; x++)
+      NormalPoint(pX, pZ, pMask, pNormalX, pNormalY, pNormalZ, pCurvature, pNormalMask, x, InvStep2, InvStepSq);
+   }
+#endif
+
+#if KERNELS_USE_AVX2
+// Loads the valid flags of 8 points of a mask as 32 bits masks.
+static inline KERNEL_TARGET_AVX2 __m256i LoadMask8Avx2(const MIL_UINT8* pMask)
+   {
+   __m256i Mask = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)pMask));
+   return _mm256_xor_si256(_mm256_cmpeq_epi32(Mask, _mm256_setzero_si256()), _mm256_set1_epi32(-1));
+   }
+
+static KERNEL_TARGET_AVX2 void NormalRowAvx2(const MIL_FLOAT* pX, const MIL_FLOAT* const pZ[3],
+                                             const MIL_UINT8* const pMask[3],
+                                             MIL_FLOAT* pNormalX, MIL_FLOAT* pNormalY, MIL_FLOAT* pNormalZ,
+                                             MIL_FLOAT* pCurvature, MIL_UINT8* pNormalMask,
+                                             MIL_INT Size, MIL_FLOAT StepY)
+   {
+   MIL_FLOAT InvStep2 = 0.5f / StepY;
+   MIL_FLOAT InvStepSq = 1.0f / (StepY * StepY);
+   const __m256 One = _mm256_set1_ps(1.0f);
+   const __m256 Two = _mm256_set1_ps(2.0f);
+   const __m256 Half = _mm256_set1_ps(0.5f);
+   const __m256 Zero = _mm256_setzero_ps();
+   const __m256 InvStep2s = _mm256_set1_ps(InvStep2);
+   const __m256 InvStepSqs = _mm256_set1_ps(InvStepSq);
+   const MIL_FLOAT* pZ0 = pZ[0];
+   const MIL_FLOAT* pZ1 = pZ[1];
+   const MIL_FLOAT* pZ2 = pZ[2];
+   ClearNormalEnds(pNormalX, pNormalY, pNormalZ, pCurvature, pNormalMask, Size);
+   MIL_INT x = 1;
+   for(; x + 8 <= Size - 1; x += 8)
+      {
+      __m256i Valid = _mm256_set1_epi32(-1);
+      for(MIL_INT r = 0; r < 3; r++)
+         {
+         Valid = _mm256_and_si256(Valid, LoadMask8Avx2(pMask[r] + x - 1));
+         Valid = _mm256_and_si256(Valid, LoadMask8Avx2(pMask[r] + x));
+         Valid = _mm256_and_si256(Valid, LoadMask8Avx2(pMask[r] + x + 1));
+         }
+      __m256 X = _mm256_loadu_ps(pX + x);
+      __m256 Dx0 = _mm256_sub_ps(X, _mm256_loadu_ps(pX + x - 1));
+      __m256 Dx1 = _mm256_sub_ps(_mm256_loadu_ps(pX + x + 1), X);
+      __m256 IsValid = _mm256_and_ps(_mm256_castsi256_ps(Valid),
+                                     _mm256_and_ps(_mm256_cmp_ps(Dx0, Zero, _CMP_NEQ_UQ),
+                                                   _mm256_cmp_ps(Dx1, Zero, _CMP_NEQ_UQ)));
+
+      __m256 Z1Prev = _mm256_loadu_ps(pZ1 + x - 1);
+      __m256 Z1 = _mm256_loadu_ps(pZ1 + x);
+      __m256 Z1Next = _mm256_loadu_ps(pZ1 + x + 1);
+      __m256 Z0 = _mm256_loadu_ps(pZ0 + x);
+      __m256 Z2 = _mm256_loadu_ps(pZ2 + x);
+      __m256 InvDx2 = _mm256_div_ps(One, _mm256_add_ps(Dx0, Dx1));
+      __m256 Zx = _mm256_mul_ps(_mm256_sub_ps(Z1Next, Z1Prev), InvDx2);
+      __m256 Zxx = _mm256_mul_ps(_mm256_mul_ps(Two, _mm256_sub_ps(_mm256_div_ps(_mm256_sub_ps(Z1Next, Z1), Dx1),
+                                                                  _mm256_div_ps(_mm256_sub_ps(Z1, Z1Prev), Dx0))),
+                                 InvDx2);
+      __m256 Zy = _mm256_mul_ps(_mm256_sub_ps(Z2, Z0), InvStep2s);
+      __m256 Zyy = _mm256_mul_ps(_mm256_sub_ps(_mm256_add_ps(Z2, Z0), _mm256_mul_ps(Two, Z1)), InvStepSqs);
+      __m256 Zxy = _mm256_mul_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_sub_ps(_mm256_loadu_ps(pZ2 + x + 1),
+                                                                           _mm256_loadu_ps(pZ2 + x - 1)),
+                                                             _mm256_sub_ps(_mm256_loadu_ps(pZ0 + x + 1),
+                                                                           _mm256_loadu_ps(pZ0 + x - 1))),
+                                               InvStep2s), InvDx2);
+      __m256 Zx2 = _mm256_mul_ps(Zx, Zx);
+      __m256 Zy2 = _mm256_mul_ps(Zy, Zy);
+      __m256 InvNorm = _mm256_div_ps(One, _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(One, Zx2), Zy2)));
+      __m256 Curvature = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(_mm256_add_ps(One, Zy2), Zxx),
+                                                     _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(Two, Zx), Zy), Zxy)),
+                                       _mm256_mul_ps(_mm256_add_ps(One, Zx2), Zyy));
+      Curvature = _mm256_mul_ps(Curvature, _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(Half, InvNorm), InvNorm),
+                                                         InvNorm));
+
+      _mm256_storeu_ps(pNormalX + x, _mm256_and_ps(_mm256_sub_ps(Zero, _mm256_mul_ps(Zx, InvNorm)), IsValid));
+      _mm256_storeu_ps(pNormalY + x, _mm256_and_ps(_mm256_sub_ps(Zero, _mm256_mul_ps(Zy, InvNorm)), IsValid));
+      _mm256_storeu_ps(pNormalZ + x, _mm256_and_ps(InvNorm, IsValid));
+      _mm256_storeu_ps(pCurvature + x, _mm256_and_ps(Curvature, IsValid));
+      __m256i ValidMask = _mm256_castps_si256(IsValid);
+      __m128i Mask16 = _mm_packs_epi32(_mm256_castsi256_si128(ValidMask), _mm256_extracti128_si256(ValidMask, 1));
+      _mm_storel_epi64((__m128i*)(pNormalMask + x), _mm_packs_epi16(Mask16, _mm_setzero_si128()));
+      }
+   for(; x < Size - 1; x++)
+      NormalPoint(pX, pZ, pMask, pNormalX, pNormalY, pNormalZ, pCurvature, pNormalMask, x, InvStep2, InvStepSq);
+   }
+#endif
+
+//*****************************************************************************
+// Depth map row colorization. The stretched entry of a cell is at most
+// RangeDepth * Scale >> COLORIZE_SCALE_BITS, which is MAX_DEPTH, and the
+// product fits in 32 bits.
+//*****************************************************************************
+static inline MIL_UINT32 ColorizeIndex(MIL_UINT16 Depth, const SPColorizeParams& Params)
+   {
+   if(Depth == INVALID_DEPTH)
+      return INVALID_DEPTH;
+   MIL_UINT32 Delta = Depth > Params.MinDepth ? (MIL_UINT32)(Depth - Params.MinDepth) : 0;
+   Delta = Delta < Params.RangeDepth ? Delta : Params.RangeDepth;
+   return (Delta * Params.Scale) >> COLORIZE_SCALE_BITS;
+   }
+
+static void ColorizeRowScalar(const MIL_UINT16* pSrcRow, MIL_UINT32* pDstRow, MIL_INT SizeX,
+                              const MIL_UINT32* pLut, const SPColorizeParams& Params)
+   {
+   for(MIL_INT x = 0; x < SizeX; x++)
+      pDstRow[x] = pLut[ColorizeIndex(pSrcRow[x], Params)];
+   }
+
+#if KERNELS_USE_SSE41
+// SSE4.1 has no gather: the entries are computed in vectors and the colors
+// are read one by one.
+static KERNEL_TARGET_SSE41 void ColorizeRowSse41(const MIL_UINT16* pSrcRow, MIL_UINT32* pDstRow, MIL_INT SizeX,
+                                                 const MIL_UINT32* pLut, const SPColorizeParams& Params)
+   {
+   const __m128i Invalid = _mm_set1_epi16((short)INVALID_DEPTH);
+   const __m128i MinDepth = _mm_set1_epi16((short)Params.MinDepth);
+   const __m128i RangeDepth = _mm_set1_epi16((short)Params.RangeDepth);
+   const __m128i Scale = _mm_set1_epi32((int)Params.Scale);
+   const __m128i InvalidIndex = _mm_set1_epi32(INVALID_DEPTH);
+   MIL_UINT32 Indices[8];
+   MIL_INT x = 0;
+   for(; x + 8 <= SizeX; x += 8)
+      {
+      __m128i Depth = _mm_loadu_si128((const __m128i*)(pSrcRow + x));
+      __m128i IsInvalid = _mm_cmpeq_epi16(Depth, Invalid);
+      __m128i Delta = _mm_min_epu16(_mm_subs_epu16(Depth, MinDepth), RangeDepth);
+      __m128i Lo = _mm_srli_epi32(_mm_mullo_epi32(_mm_cvtepu16_epi32(Delta), Scale), COLORIZE_SCALE_BITS);
+      __m128i Hi = _mm_srli_epi32(_mm_mullo_epi32(_mm_cvtepu16_epi32(_mm_srli_si128(Delta, 8)), Scale),
+                                  COLORIZE_SCALE_BITS);
+      Lo = _mm_blendv_epi8(Lo, InvalidIndex, _mm_cvtepi16_epi32(IsInvalid));
+      Hi = _mm_blendv_epi8(Hi, InvalidIndex, _mm_cvtepi16_epi32(_mm_srli_si128(IsInvalid, 8)));
+      _mm_storeu_si128((__m128i*)Indices, Lo);
+      _mm_storeu_si128((__m128i*)(Indices + 4), Hi);
+      for(MIL_INT i = 0; i < 8; i++)
+         pDstRow[x + i] = pLut[Indices[i]];
+      }
+   for(; x < SizeX; x++)
+      pDstRow[x] = pLut[ColorizeIndex(pSrcRow[x], Params)];
+   }
+#endif
+
+#if KERNELS_USE_AVX2
+static KERNEL_TARGET_AVX2 void ColorizeRowAvx2(const MIL_UINT16* pSrcRow, MIL_UINT32* pDstRow, MIL_INT SizeX,
+                                               const MIL_UINT32* pLut, const SPColorizeParams& Params)
+   {
+   const __m256i Invalid = _mm256_set1_epi16((short)INVALID_DEPTH);
+   const __m256i MinDepth = _mm256_set1_epi16((short)Params.MinDepth);
+   const __m256i RangeDepth = _mm256_set1_epi16((short)Params.RangeDepth);
+   const __m256i Scale = _mm256_set1_epi32((int)Params.Scale);
+   const __m256i InvalidIndex = _mm256_set1_epi32(INVALID_DEPTH);
+   MIL_INT x = 0;
+   for(; x + 16 <= SizeX; x += 16)
+      {
+      __m256i Depth = _mm256_loadu_si256((const __m256i*)(pSrcRow + x));
+      __m256i IsInvalid = _mm256_cmpeq_epi16(Depth, Invalid);
+      __m256i Delta = _mm256_min_epu16(_mm256_subs_epu16(Depth, MinDepth), RangeDepth);
+      __m256i Lo = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(Delta)),
+                                                        Scale), COLORIZE_SCALE_BITS);
+      __m256i Hi = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(Delta, 1)),
+                                                        Scale), COLORIZE_SCALE_BITS);
+      Lo = _mm256_blendv_epi8(Lo, InvalidIndex, _mm256_cvtepi16_epi32(_mm256_castsi256_si128(IsInvalid)));
+      Hi = _mm256_blendv_epi8(Hi, InvalidIndex, _mm256_cvtepi16_epi32(_mm256_extracti128_si256(IsInvalid, 1)));
+      _mm256_storeu_si256((__m256i*)(pDstRow + x), _mm256_i32gather_epi32((const int*)pLut, Lo, 4));
+      _mm256_storeu_si256((__m256i*)(pDstRow + x + 8), _mm256_i32gather_epi32((const int*)pLut, Hi, 4));
+      }
+   for(; x < SizeX; x++)
+      pDstRow[x] = pLut[ColorizeIndex(pSrcRow[x], Params)];
+   }
+#endif
+
+//*****************************************************************************
+// Kernel tables. The specialized profile sizes are the container
+// resolutions of the scanCONTROL 26xx and 29xx. The tables of the
+// instruction sets that are not compiled fall back to the scalar kernels.
+// The kernels of the depth map rows and of the normals take the RowSuffix
+// instruction set.
+//*****************************************************************************
+#define PROFILE_KERNELS(Isa, Suffix, RowSuffix, ProfileSize) \
+   { ProfileSize, Isa, ConvertToWorldRow##Suffix<ProfileSize>, MaskRow##Suffix<ProfileSize>, \
+     QuantizeRow##RowSuffix<ProfileSize>, InterpolateRow##RowSuffix, \
+     DeviationRow##RowSuffix, NormalRow##RowSuffix, ColorizeRow##RowSuffix }
+
+#define PROFILE_KERNELS_TABLE(Isa, Suffix, RowSuffix)   \
+   {                                                    \
+   PROFILE_KERNELS(Isa, Suffix, RowSuffix, 0),          \
+   PROFILE_KERNELS(Isa, Suffix, RowSuffix, 160),        \
+   PROFILE_KERNELS(Isa, Suffix, RowSuffix, 320),        \
+   PROFILE_KERNELS(Isa, Suffix, RowSuffix, 640),        \
+   PROFILE_KERNELS(Isa, Suffix, RowSuffix, 1280)        \
+   }
+
+static const MIL_INT NB_KERNELS_PER_ISA = 5;
+static const SPProfileKernels PROFILE_KERNELS_TABLES[NB_KERNEL_ISA][NB_KERNELS_PER_ISA] =
+   {
+   PROFILE_KERNELS_TABLE(KERNEL_ISA_SCALAR, Scalar, Scalar),
+#if KERNELS_USE_SSE41
+   PROFILE_KERNELS_TABLE(KERNEL_ISA_SSE41, Sse41, Sse41),
+#else
+   PROFILE_KERNELS_TABLE(KERNEL_ISA_SCALAR, Scalar, Scalar),
+#endif
+#if KERNELS_USE_AVX2
+   PROFILE_KERNELS_TABLE(KERNEL_ISA_AVX2, Avx2, Avx2),
+#else
+   PROFILE_KERNELS_TABLE(KERNEL_ISA_SCALAR, Scalar, Scalar),
+#endif
+#if KERNELS_USE_AVX512
+   // The depth map rows are bound by the memory accesses and the LUT reads,
+   // and the normals by the divisions and the square roots, which the wider
+   // vectors do not speed up: the AVX-512 table uses their AVX2 kernels.
+   PROFILE_KERNELS_TABLE(KERNEL_ISA_AVX512, Avx512, Avx2)
+#else
+   PROFILE_KERNELS_TABLE(KERNEL_ISA_SCALAR, Scalar, Scalar)
+#endif
+   };
+
+//*****************************************************************************
+// SelectProfileKernels. Gets the kernels specialized for the profile size,
+//                       or the generic kernels if the size is not
+//                       specialized, of the instruction set to use on this
+//                       CPU.
+//*****************************************************************************
+const SPProfileKernels& SelectProfileKernels(MIL_INT ProfileSize)
+   {
+   return SelectProfileKernels(ProfileSize, GetKernelIsa());
+   }
+
+const SPProfileKernels& SelectProfileKernels(MIL_INT ProfileSize, EKernelIsa Isa)
+   {
+   const SPProfileKernels* pTable = PROFILE_KERNELS_TABLES[Isa];
+   for(MIL_INT k = 1; k < NB_KERNELS_PER_ISA; k++)
+      {
+      if(pTable[k].ProfileSize == ProfileSize)
+         return pTable[k];
+      }
+   return pTable[0];
+   }
+
+//*****************************************************************************
+// PrintProfileKernels. Prints the kernels that are used.
+//*****************************************************************************
+void PrintProfileKernels(const SPProfileKernels& Kernels)
+   {
+   MosPrintf(MIL_TEXT("Profile kernels: %s instruction set (best supported: %s), "),
+             GetKernelIsaName(Kernels.Isa), GetKernelIsaName(GetSupportedKernelIsa()));
+   if(Kernels.ProfileSize)
+      MosPrintf(MIL_TEXT("specialized for %d points per profile.\n"), (int)Kernels.ProfileSize);
+   else
+      MosPrintf(MIL_TEXT("generic profile size.\n"));
+   }
+
+//*****************************************************************************
+// ClearDepthRow. Sets all the cells of a depth map row to invalid.
+//*****************************************************************************
+void ClearDepthRow(MIL_UINT16* pDstRow, MIL_INT SizeX)
+   {
+   for(MIL_INT x = 0; x < SizeX; x++)
+      pDstRow[x] = INVALID_DEPTH;
+   }
+
+//*****************************************************************************
+// FillDepthRowGaps. Interpolates linearly the runs of at most MaxFillGap
+//                   missing cells between two valid cells of a depth map row.
+//*****************************************************************************
+void FillDepthRowGaps(MIL_UINT16* pDstRow, MIL_INT SizeX, MIL_INT MaxFillGap)
+   {
+   MIL_INT LastValid = -1;
+   for(MIL_INT x = 0; x < SizeX; x++)
+      {
+      if(pDstRow[x] == INVALID_DEPTH)
+         continue;
+      MIL_INT Gap = x - LastValid - 1;
+      if(LastValid >= 0 && Gap > 0 && Gap <= MaxFillGap)
+         {
+         MIL_FLOAT Start = pDstRow[LastValid];
+         MIL_FLOAT Step = ((MIL_FLOAT)pDstRow[x] - Start) / (Gap + 1);
+         for(MIL_INT g = 1; g <= Gap; g++)
+            pDstRow[LastValid + g] = (MIL_UINT16)(Start + Step * g + 0.5f);
+         }
+      LastValid = x;
+      }
+   }
@@ -0,0 +1,190 @@
+﻿/************************************************************************************/
+/*
+* File name: ProfileKernels.h
+*
+* Synopsis:  This file contains the declaration of the host kernels applied on
+*            the rows of profile data. The kernels are specialized at compile
+*            time for the common scanCONTROL profile sizes and a generic version
+*            handles the other sizes. Each kernel is also compiled for several
+*            instruction sets. The kernels to use are selected once for the
+*            profile size of the interface and the instruction set of the CPU.
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+
+#ifndef PROFILE_KERNELS_H
+#define PROFILE_KERNELS_H
+
+#include "CpuFeatures.h"
+
+//*****************************************************************************
+// Constants.
+//*****************************************************************************
+static const MIL_INT STATS_HISTOGRAM_SHIFT = 11;
+static const MIL_INT NB_STATS_HISTOGRAM_BINS = 65536 >> STATS_HISTOGRAM_SHIFT;
+
+// Number of points processed by one unrolled block of a kernel. The kernels
+// use unaligned loads and stores, so a block of float results only fills a
+// 64 bytes cache line when the rows are aligned by the allocation policy.
+static const MIL_INT KERNEL_BLOCK_SIZE = 16;
+
+// Gray levels of the depth maps. The highest gray level marks missing data.
+static const MIL_UINT16 INVALID_DEPTH = 65535;
+static const MIL_INT    MAX_DEPTH = 65534;
+
+// Deviation of a cell that is not valid in both depth maps, and largest
+// deviation, in gray levels.
+static const MIL_INT16 DEVIATION_INVALID = -32767 - 1;
+static const MIL_INT   MAX_DEVIATION = 32767;
+
+// Fixed point weights of the depth map row interpolation.
+static const MIL_UINT32 INTERPOLATION_WEIGHT_BITS = 8;
+static const MIL_UINT32 INTERPOLATION_WEIGHT_ONE = 1 << INTERPOLATION_WEIGHT_BITS;
+
+// Fixed point bits of the scale of the depth map colorization.
+static const MIL_UINT32 COLORIZE_SCALE_BITS = 8;
+
+//*****************************************************************************
+// Structure defining the linear conversion from the 16 bits codes to world
+// coordinates.
+//*****************************************************************************
+struct SPConvertParams
+   {
+   MIL_FLOAT ScaleX;
+   MIL_FLOAT OffsetX;
+   MIL_FLOAT ScaleZ;
+   MIL_FLOAT OffsetZ;
+   };
+
+//*****************************************************************************
+// Structure defining the mapping of world coordinates to the cells and the
+// gray levels of a depth map row. It is the inverse of the McalUniform
+// calibration and M_GRAY_LEVEL_SIZE_Z of the depth map.
+//*****************************************************************************
+struct SPRasterParams
+   {
+   MIL_FLOAT ScaleX;       // 1 / PixelSizeX
+   MIL_FLOAT OffsetX;      // -WorldPosX / PixelSizeX
+   MIL_FLOAT ScaleZ;       // 1 / GrayLevelSizeZ
+   MIL_FLOAT OffsetZ;      // -WorldPosZ / GrayLevelSizeZ
+   MIL_INT   SizeX;        // Number of cells of the row.
+   };
+
+//*****************************************************************************
+// Structure defining the stretch of the gray levels of a depth map to the
+// entries of a colorization LUT.
+//*****************************************************************************
+struct SPColorizeParams
+   {
+   MIL_UINT16 MinDepth;    // Gray level of the first entry.
+   MIL_UINT16 RangeDepth;  // Gray levels stretched to the entries, at least 1.
+   MIL_UINT32 Scale;       // (MAX_DEPTH << COLORIZE_SCALE_BITS) / RangeDepth
+   };
+
+//*****************************************************************************
+// Structure accumulating the statistics of the valid Z codes.
+//*****************************************************************************
+struct SPStatsAccumulator
+   {
+   SPStatsAccumulator() { Reset(); }
+   void Reset()
+      {
+      NbValid = 0;
+      SumCodeZ = 0;
+      MinCodeZ = 65535;
+      MaxCodeZ = 0;
+      for(MIL_INT i = 0; i < NB_STATS_HISTOGRAM_BINS; i++)
+         Histogram[i] = 0;
+      }
+
+   MIL_UINT   NbValid;
+   MIL_UINT64 SumCodeZ;
+   MIL_UINT16 MinCodeZ;
+   MIL_UINT16 MaxCodeZ;
+   MIL_UINT   Histogram[NB_STATS_HISTOGRAM_BINS];
+   };
+
+//*****************************************************************************
+// Kernel function types.
+//*****************************************************************************
+
+// Converts a row of X and Z codes to world coordinates and accumulates the
+// statistics of the valid points. pMask can be M_NULL if all points are valid.
+typedef void (*PConvertToWorldRow)(const MIL_UINT16* pSrcX, const MIL_UINT16* pSrcZ,
+                                   const MIL_UINT8* pMask, MIL_FLOAT* pDstX, MIL_FLOAT* pDstZ,
+                                   MIL_INT Size, const SPConvertParams& Params,
+                                   SPStatsAccumulator& Stats);
+
+// Creates the valid mask of a row of Z codes.
+typedef void (*PMaskRow)(const MIL_UINT16* pSrcZ, MIL_UINT8* pMask, MIL_INT Size, MIL_UINT16 InvalidCode);
+
+// Quantizes a profile of flat X and Z world coordinates to the cells and the
+// gray levels of a depth map row. The points that do not fall in a cell get
+// the cell -1.
+typedef void (*PQuantizeRow)(const MIL_FLOAT* pSrcX, const MIL_FLOAT* pSrcZ, const MIL_UINT8* pMask,
+                             MIL_INT32* pCells, MIL_INT32* pDepths, MIL_INT Size, const SPRasterParams& Params);
+
+// Interpolates a depth map row between two rows. Weight is the fixed point
+// weight of the second row, from 0 to INTERPOLATION_WEIGHT_ONE. The cells
+// that are invalid in one of the rows are invalid.
+typedef void (*PInterpolateRow)(const MIL_UINT16* pSrcRow0, const MIL_UINT16* pSrcRow1, MIL_UINT16* pDstRow,
+                                MIL_INT SizeX, MIL_UINT32 Weight);
+
+// Computes the signed deviation of a depth map row from a reference row and
+// flags the cells out of tolerance: the cells valid in both rows whose
+// absolute deviation is above Tolerance, and the cells valid in only one of
+// them. Tolerance is at most MAX_DEVIATION. The cells that are not valid in
+// both rows get DEVIATION_INVALID. MaxDeviation is raised to the largest
+// absolute deviation of the row. Returns the number of flagged cells.
+typedef MIL_INT (*PDeviationRow)(const MIL_UINT16* pSrcRow, const MIL_UINT16* pRefRow, MIL_INT16* pDeviation,
+                                 MIL_UINT8* pFlags, MIL_INT SizeX, MIL_UINT16 Tolerance,
+                                 MIL_UINT16& MaxDeviation);
+
+// Computes the normals and the mean curvatures of a row of an organized
+// point cloud from the rows before and after it, as a height field Z(X, Y)
+// derived with central differences; the curvature is negative on the convex
+// tops. pX is the row; pZ and pMask are the
+// rows before, at and after it, StepY apart. A point without its 8
+// neighbors, or with the X of a neighbor in the row, gets a null normal and
+// the mask 0.
+typedef void (*PNormalRow)(const MIL_FLOAT* pX, const MIL_FLOAT* const pZ[3], const MIL_UINT8* const pMask[3],
+                           MIL_FLOAT* pNormalX, MIL_FLOAT* pNormalY, MIL_FLOAT* pNormalZ,
+                           MIL_FLOAT* pCurvature, MIL_UINT8* pNormalMask, MIL_INT Size, MIL_FLOAT StepY);
+
+// Colorizes a depth map row with a LUT of 65536 packed colors. The valid
+// cells from MinDepth to MinDepth + RangeDepth are stretched to the entries
+// 0 to MAX_DEPTH, and the invalid cells get the entry INVALID_DEPTH.
+typedef void (*PColorizeRow)(const MIL_UINT16* pSrcRow, MIL_UINT32* pDstRow, MIL_INT SizeX,
+                             const MIL_UINT32* pLut, const SPColorizeParams& Params);
+
+//*****************************************************************************
+// Structure defining the set of kernels used for a given profile size.
+//*****************************************************************************
+struct SPProfileKernels
+   {
+   MIL_INT            ProfileSize;   // 0 for the generic kernels.
+   EKernelIsa         Isa;
+   PConvertToWorldRow ConvertToWorldRow;
+   PMaskRow           MaskRow;
+   PQuantizeRow       QuantizeRow;
+   PInterpolateRow    InterpolateRow;
+   PDeviationRow      DeviationRow;
+   PNormalRow         NormalRow;
+   PColorizeRow       ColorizeRow;
+   };
+
+//*****************************************************************************
+// Kernel selection.
+//*****************************************************************************
+const SPProfileKernels& SelectProfileKernels(MIL_INT ProfileSize);
+const SPProfileKernels& SelectProfileKernels(MIL_INT ProfileSize, EKernelIsa Isa);
+void PrintProfileKernels(const SPProfileKernels& Kernels);
+
+//*****************************************************************************
+// Depth map row functions.
+//*****************************************************************************
+void ClearDepthRow(MIL_UINT16* pDstRow, MIL_INT SizeX);
+void FillDepthRowGaps(MIL_UINT16* pDstRow, MIL_INT SizeX, MIL_INT MaxFillGap);
+
+#endif // PROFILE_KERNELS_H
@@ -0,0 +1,198 @@
+﻿/************************************************************************************/
+/*
+* File name: ProfileMesher.cpp
+*
+* Synopsis:  This file contains the implementation of the CProfileMesher class that
+*            triangulates the organized point cloud of the profiles.
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+#include <mil.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include "ProfileMesher.h"
+
+//*****************************************************************************
+// Constants.
+//*****************************************************************************
+
+// Arrays of the copy of the last profile.
+enum ELastRowArray
+   {
+   LAST_X = 0,
+   LAST_Z,
+   LAST_NORMAL_X,
+   LAST_NORMAL_Y,
+   LAST_NORMAL_Z,
+   NB_LAST_ARRAYS
+   };
+
+//*****************************************************************************
+// Constructor.
+//*****************************************************************************
+CProfileMesher::CProfileMesher(MIL_INT ProfileSize, MIL_DOUBLE MaxZGap)
+   : m_ProfileSize(ProfileSize),
+     m_MaxZGap((MIL_FLOAT)MaxZGap),
+     m_NbVertices(0),
+     m_NbTriangles(0),
+     m_HasLastRow(false),
+     m_LastY(0)
+   {
+   m_LastRow.resize(NB_LAST_ARRAYS * ProfileSize);
+   m_LastMask.resize(ProfileSize);
+   m_PrevIndices.resize(ProfileSize, -1);
+   m_CurIndices.resize(ProfileSize, -1);
+   }
+
+//*****************************************************************************
+// Destructor.
+//*****************************************************************************
+CProfileMesher::~CProfileMesher()
+   {
+   }
+
+//*****************************************************************************
+// Process. Triangulates the last profile of the previous block with the
+//          first row of the block, then the rows of the block two by two,
+//          and keeps the last row.
+//*****************************************************************************
+void CProfileMesher::Process(const COrganizedPointCloud& Cloud)
+   {
+   m_NewVertices.clear();
+   m_NewTriangles.clear();
+
+   SPMeshRow Prev;
+   if(m_HasLastRow)
+      {
+      Prev.Y = m_LastY;
+      Prev.pX = &m_LastRow[LAST_X * m_ProfileSize];
+      Prev.pZ = &m_LastRow[LAST_Z * m_ProfileSize];
+      Prev.pMask = &m_LastMask[0];
+      Prev.pNormalX = &m_LastRow[LAST_NORMAL_X * m_ProfileSize];
+      Prev.pNormalY = &m_LastRow[LAST_NORMAL_Y * m_ProfileSize];
+      Prev.pNormalZ = &m_LastRow[LAST_NORMAL_Z * m_ProfileSize];
+      Prev.pIndices = &m_PrevIndices[0];
+      }
+
+   for(MIL_INT Row = 0; Row < Cloud.GetNbProfiles(); Row++)
+      {
+      // A new profile has no vertex yet.
+      std::fill(m_CurIndices.begin(), m_CurIndices.end(), -1);
+      SPMeshRow Cur;
+      Cur.Y = (MIL_FLOAT)Cloud.GetY(Row);
+      Cur.pX = Cloud.GetX(Row);
+      Cur.pZ = Cloud.GetZ(Row);
+      Cur.pMask = Cloud.GetMask(Row);
+      Cur.pNormalX = Cloud.GetNormalX(Row);
+      Cur.pNormalY = Cloud.GetNormalY(Row);
+      Cur.pNormalZ = Cloud.GetNormalZ(Row);
+      Cur.pIndices = &m_CurIndices[0];
+
+      if(m_HasLastRow || Row > 0)
+         TriangulateRows(Prev, Cur);
+
+      m_PrevIndices.swap(m_CurIndices);
+      Prev = Cur;
+      Prev.pIndices = &m_PrevIndices[0];
+      }
+
+   if(Cloud.GetNbProfiles() > 0)
+      KeepLastRow(Prev);
+   }
+
+//*****************************************************************************
+// TriangulateRows. Triangulates the cells between two profiles.
+//*****************************************************************************
+void CProfileMesher::TriangulateRows(SPMeshRow& Prev, SPMeshRow& Cur)
+   {
+   // The points of a cell are A and B on the previous profile, C and D on
+   // the current one.
+   const MIL_UINT8* pPrevMask = Prev.pMask;
+   const MIL_UINT8* pCurMask = Cur.pMask;
+   for(MIL_INT i = 0; i + 1 < m_ProfileSize; i++)
+      {
+      MIL_INT NbValid = (pPrevMask[i] != 0) + (pPrevMask[i + 1] != 0) + (pCurMask[i] != 0) + (pCurMask[i + 1] != 0);
+      if(NbValid < 3)
+         continue;
+
+      if(NbValid == 3)
+         {
+         if(!pPrevMask[i])
+            AddTriangle(Prev, i + 1, Cur, i + 1, Cur, i);
+         else if(!pPrevMask[i + 1])
+            AddTriangle(Prev, i, Cur, i + 1, Cur, i);
+         else if(!pCurMask[i])
+            AddTriangle(Prev, i, Prev, i + 1, Cur, i + 1);
+         else
+            AddTriangle(Prev, i, Prev, i + 1, Cur, i);
+         }
+      else if(fabs(Prev.pZ[i] - Cur.pZ[i + 1]) <= fabs(Prev.pZ[i + 1] - Cur.pZ[i]))
+         {
+         AddTriangle(Prev, i, Prev, i + 1, Cur, i + 1);
+         AddTriangle(Prev, i, Cur, i + 1, Cur, i);
+         }
+      else
+         {
+         AddTriangle(Prev, i, Prev, i + 1, Cur, i);
+         AddTriangle(Prev, i + 1, Cur, i + 1, Cur, i);
+         }
+      }
+   }
+
+//*****************************************************************************
+// AddTriangle. Adds a triangle of valid points, unless it spans a Z gap.
+//*****************************************************************************
+void CProfileMesher::AddTriangle(SPMeshRow& Row0, MIL_INT Point0, SPMeshRow& Row1, MIL_INT Point1,
+                                 SPMeshRow& Row2, MIL_INT Point2)
+   {
+   MIL_FLOAT Z0 = Row0.pZ[Point0];
+   MIL_FLOAT Z1 = Row1.pZ[Point1];
+   MIL_FLOAT Z2 = Row2.pZ[Point2];
+   MIL_FLOAT MinZ = std::min(Z0, std::min(Z1, Z2));
+   MIL_FLOAT MaxZ = std::max(Z0, std::max(Z1, Z2));
+   if(MaxZ - MinZ > m_MaxZGap)
+      return;
+
+   SPMeshTriangle Triangle;
+   Triangle.Vertices[0] = GetVertex(Row0, Point0);
+   Triangle.Vertices[1] = GetVertex(Row1, Point1);
+   Triangle.Vertices[2] = GetVertex(Row2, Point2);
+   m_NewTriangles.push_back(Triangle);
+   m_NbTriangles++;
+   }
+
+//*****************************************************************************
+// GetVertex. Gets the index of the vertex of a point, emitting the vertex
+//            the first time.
+//*****************************************************************************
+MIL_INT64 CProfileMesher::GetVertex(SPMeshRow& Row, MIL_INT Point)
+   {
+   if(Row.pIndices[Point] < 0)
+      {
+      SPMeshVertex Vertex = {Row.pX[Point], Row.Y, Row.pZ[Point],
+                             Row.pNormalX[Point], Row.pNormalY[Point], Row.pNormalZ[Point]};
+      m_NewVertices.push_back(Vertex);
+      Row.pIndices[Point] = m_NbVertices++;
+      }
+   return Row.pIndices[Point];
+   }
+
+//*****************************************************************************
+// KeepLastRow. Copies the last profile of the block, whose points are
+//              overwritten by the next block. Its indices are already in
+//              the previous indices.
+//*****************************************************************************
+void CProfileMesher::KeepLastRow(const SPMeshRow& Row)
+   {
+   MIL_INT Bytes = m_ProfileSize * sizeof(MIL_FLOAT);
+   memcpy(&m_LastRow[LAST_X * m_ProfileSize], Row.pX, Bytes);
+   memcpy(&m_LastRow[LAST_Z * m_ProfileSize], Row.pZ, Bytes);
+   memcpy(&m_LastRow[LAST_NORMAL_X * m_ProfileSize], Row.pNormalX, Bytes);
+   memcpy(&m_LastRow[LAST_NORMAL_Y * m_ProfileSize], Row.pNormalY, Bytes);
+   memcpy(&m_LastRow[LAST_NORMAL_Z * m_ProfileSize], Row.pNormalZ, Bytes);
+   memcpy(&m_LastMask[0], Row.pMask, m_ProfileSize);
+   m_LastY = Row.Y;
+   m_HasLastRow = true;
+   }
@@ -0,0 +1,118 @@
+﻿/************************************************************************************/
+/*
+* File name: ProfileMesher.h
+*
+* Synopsis:  This file contains the declaration of the CProfileMesher class that
+*            triangulates the organized point cloud of the profiles, profile after
+*            profile, and emits the vertices and the triangles incrementally.
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+
+#ifndef PROFILE_MESHER_H
+#define PROFILE_MESHER_H
+
+#include <vector>
+#include "OrganizedPointCloud.h"
+
+//*****************************************************************************
+// Structure defining a vertex of the mesh, with the normal of its point.
+// The normal is null if it could not be computed.
+//*****************************************************************************
+struct SPMeshVertex
+   {
+   MIL_FLOAT X;
+   MIL_FLOAT Y;
+   MIL_FLOAT Z;
+   MIL_FLOAT NormalX;
+   MIL_FLOAT NormalY;
+   MIL_FLOAT NormalZ;
+   };
+
+//*****************************************************************************
+// Structure defining a triangle of the mesh by the indices of its vertices,
+// counter-clockwise seen from above when X increases along the profiles.
+// The indices are 64 bits since a continuous scan exceeds 2^32 vertices.
+//*****************************************************************************
+struct SPMeshTriangle
+   {
+   MIL_INT64 Vertices[3];
+   };
+
+//*****************************************************************************
+// Streaming triangulation of the organized point cloud.
+//
+// Each cell of the grid between two consecutive profiles and two consecutive
+// points is split in two triangles along the diagonal with the smaller Z
+// difference. A triangle is skipped if one of its points is invalid or if
+// the Z of two of its points differ by more than MaxZGap, which would
+// connect a part to the belt. A cell with three valid points gets one
+// triangle.
+//
+// A point becomes a vertex the first time a triangle uses it, so the points
+// without triangles are not emitted. The vertices and the triangles of each
+// block are kept until the next block; only the last profile is kept between
+// the blocks, so the memory does not grow with the scan.
+//*****************************************************************************
+class CProfileMesher
+   {
+   public:
+      CProfileMesher(MIL_INT ProfileSize, MIL_DOUBLE MaxZGap);
+      ~CProfileMesher();
+
+      // Triangulates the rows of the last block of the organized point cloud.
+      void Process(const COrganizedPointCloud& Cloud);
+
+      // Vertices and triangles added by the last block. The indices of the
+      // vertices count from the first vertex of the mesh.
+      MIL_INT GetNbNewVertices() const { return (MIL_INT)m_NewVertices.size(); }
+      const SPMeshVertex* GetNewVertices() const { return m_NewVertices.empty() ? M_NULL : &m_NewVertices[0]; }
+      MIL_INT GetNbNewTriangles() const { return (MIL_INT)m_NewTriangles.size(); }
+      const SPMeshTriangle* GetNewTriangles() const { return m_NewTriangles.empty() ? M_NULL : &m_NewTriangles[0]; }
+
+      // Size of the whole mesh.
+      MIL_INT64 GetNbVertices() const { return m_NbVertices; }
+      MIL_INT64 GetNbTriangles() const { return m_NbTriangles; }
+
+   private:
+      // Points of a profile and the indices of their vertices, -1 until
+      // they are emitted.
+      struct SPMeshRow
+         {
+         MIL_FLOAT        Y;
+         const MIL_FLOAT* pX;
+         const MIL_FLOAT* pZ;
+         const MIL_UINT8* pMask;
+         const MIL_FLOAT* pNormalX;
+         const MIL_FLOAT* pNormalY;
+         const MIL_FLOAT* pNormalZ;
+         MIL_INT64*       pIndices;
+         };
+
+      void TriangulateRows(SPMeshRow& Prev, SPMeshRow& Cur);
+      void AddTriangle(SPMeshRow& Row0, MIL_INT Point0, SPMeshRow& Row1, MIL_INT Point1,
+                       SPMeshRow& Row2, MIL_INT Point2);
+      MIL_INT64 GetVertex(SPMeshRow& Row, MIL_INT Point);
+      void KeepLastRow(const SPMeshRow& Row);
+
+      MIL_INT    m_ProfileSize;
+      MIL_FLOAT  m_MaxZGap;
+      MIL_INT64  m_NbVertices;
+      MIL_INT64  m_NbTriangles;
+
+      // Copy of the last profile of the previous block.
+      bool                   m_HasLastRow;
+      MIL_FLOAT              m_LastY;
+      std::vector<MIL_FLOAT> m_LastRow;
+      std::vector<MIL_UINT8> m_LastMask;
+
+      // Indices of the vertices of the previous and of the current profiles.
+      std::vector<MIL_INT64> m_PrevIndices;
+      std::vector<MIL_INT64> m_CurIndices;
+
+      std::vector<SPMeshVertex>   m_NewVertices;
+      std::vector<SPMeshTriangle> m_NewTriangles;
+   };
+
+#endif // PROFILE_MESHER_H
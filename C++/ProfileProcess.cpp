@@ -1,292 +1,726 @@
-﻿/************************************************************************************/
-/*
-* File name: ProfileProcess.cpp
-*
-* Synopsis:  This file contains the implementation of the CProfileProcess classes that
-*            are processing some profile data (SPdata).
-*
-* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
-* All Rights Reserved
-*/
-#include <mil.h>
-#include <vector>
-#include "DataConversion.h"
-#include "ProfileProcess.h"
-
-//*****************************************************************************
-// Constants.
-//*****************************************************************************
-static const MIL_INT WINDOWS_OFFSET_X = 15;
-
-//*****************************************************************************
-// DirectX display.
-//*****************************************************************************
-#if USE_D3D_DISPLAY
-// D3D display parameters.
-const MIL_INT    D3D_DISPLAY_SIZE_X = 640;
-const MIL_INT    D3D_DISPLAY_SIZE_Y = 480;
-const MIL_DOUBLE MAX_Z_GAP_DISTANCE = 2.0; // in mm
-#endif
-
-//*****************************************************************************
-// CProfileProcess. Interface to a profile process.
-//*****************************************************************************
-
-//*****************************************************************************
-// Constructor.
-//*****************************************************************************
-CProfileProcess::CProfileProcess(const SPCal& PCal, MIL_INT NbPoints) :
-   m_PCal(PCal),
-   m_NbPoints(NbPoints),
-   m_pProcessProfileDataConversion(NULL)
-   {
-   }
-
-//*****************************************************************************
-// Destructor. Deletes the profile process data conversion if required.
-//*****************************************************************************
-CProfileProcess::~CProfileProcess() 
-   {
-   if(m_pProcessProfileDataConversion)
-      {
-      delete m_pProcessProfileDataConversion;
-      m_pProcessProfileDataConversion = NULL;
-      }
-   };
-
-
-//*****************************************************************************
-// CProfile3dPointsProcess. Base class for any profile process that needs to
-//                          work on 3d points. The data from the 3d camera
-//                          will be converted accordingly.
-//*****************************************************************************
-
-//*****************************************************************************
-// Constructor.
-//*****************************************************************************
-CProfile3dPointsProcess::CProfile3dPointsProcess(MIL_ID MilSystem, const SPCal& PCal,
-                                                 MIL_INT ProfileSize, MIL_INT NbProfiles) :
-   CProfileProcess(PCal, ProfileSize * NbProfiles)
-   {
-   // Build the data conversion from fixed point Z and X coordinates to float flat array of X-Y coordinates. 
-   m_pProcessProfileDataConversion = new CDataConversionToWorld(m_pProcessProfileDataConversion, MilSystem,
-                                                                ProfileSize, NbProfiles, PCal);
-   m_pProcessProfileDataConversion = new CDataConversionToFlat(m_pProcessProfileDataConversion, MilSystem,
-                                                               ProfileSize, NbProfiles, 32 + M_FLOAT);
-   m_pProcessProfileDataConversion = new CDataConversionApplyInvalid(m_pProcessProfileDataConversion);
-   }
-
-
-//*****************************************************************************
-// CProfileSingleProcess. Process on 3dpoints coming from a single profile.
-//                        This process display the 3d points.
-//*****************************************************************************
-
-//*****************************************************************************
-// Constructor. Allocates objects for displaying the 3d profile.
-//*****************************************************************************
-CProfileSingleProcess::CProfileSingleProcess(MIL_ID MilSystem, const SPCal& ConvertPCal,
-                                             const SPRange& DataRange, MIL_INT ProfileSize)
-   :CProfile3dPointsProcess(MilSystem, ConvertPCal, ProfileSize, 1)
-   {
-   // Allocate the displayed image.
-   MIL_DOUBLE WorldSizeX = DataRange.MaxX - DataRange.MinX;
-   MIL_DOUBLE WorldSizeZ = DataRange.MaxZ - DataRange.MinZ;
-   MIL_DOUBLE DisplayPixelSize = WorldSizeX / ProfileSize;
-   MIL_INT DisplaySizeX = (MIL_INT)(WorldSizeX / DisplayPixelSize);
-   MIL_INT DisplaySizeY = (MIL_INT)(WorldSizeZ / DisplayPixelSize);
-   MbufAlloc2d(MilSystem, DisplaySizeX, DisplaySizeY,
-               8 + M_UNSIGNED, M_IMAGE + M_DISP, &m_MilDisplayedImage);
-   MbufClear(m_MilDisplayedImage, 192);
-   McalUniform(m_MilDisplayedImage, DataRange.MinX, DataRange.MinZ,
-               DisplayPixelSize, DisplayPixelSize, 0.0, M_DEFAULT);
-
-   // Allocate the display.
-   MdispAlloc(MilSystem, M_DEFAULT, MIL_TEXT("M_DEFAULT"), M_DEFAULT, &m_MilDisplay);
-   MdispSelect(m_MilDisplay, m_MilDisplayedImage);
-
-   // Allocate the graphic list and associate to the display.
-   MgraAllocList(MilSystem, M_DEFAULT, &m_MilGraList);
-   MdispControl(m_MilDisplay, M_ASSOCIATED_GRAPHIC_LIST_ID, m_MilGraList);
-   }
-
-//*****************************************************************************
-// Destructor. Frees display resources.
-//*****************************************************************************
-CProfileSingleProcess::~CProfileSingleProcess()
-   {
-   MbufFree(m_MilDisplayedImage);
-   MgraFree(m_MilGraList);
-   MdispFree(m_MilDisplay);
-   }
-
-//*****************************************************************************
-// Function that processes the profile data. Converts the profile data
-// to be in 3d points format. Draws the points as dots in the calibrated
-// display.
-//*****************************************************************************
-void CProfileSingleProcess::Process(const SPData& Data)
-   {
-   // Convert the data.
-   SPData ConvertedData = m_pProcessProfileDataConversion->Convert(Data);
-
-   // Draw the points in the displayed graphic list.
-   MIL_FLOAT* pConvertedX = (MIL_FLOAT*)MbufInquire(ConvertedData.MilX, M_HOST_ADDRESS, M_NULL);
-   MIL_FLOAT* pConvertedZ = (MIL_FLOAT*)MbufInquire(ConvertedData.MilZ, M_HOST_ADDRESS, M_NULL);
-   std::vector<MIL_DOUBLE> ConvertedXDouble(m_NbPoints);
-   std::vector<MIL_DOUBLE> ConvertedZDouble(m_NbPoints);
-   for(MIL_UINT i = 0; i < m_NbPoints; i++)
-      {
-      ConvertedXDouble[i] = pConvertedX[i];
-      ConvertedZDouble[i] = pConvertedZ[i];
-      }
-
-   // Disable the updates of the graphic list.
-   MdispControl(m_MilDisplay, M_UPDATE, M_DISABLE);
-
-   // Clear the graphic list.
-   MgraClear(M_DEFAULT, m_MilGraList);
-
-   // Draw the calibration.
-   MgraControl(M_DEFAULT, M_BACKGROUND_MODE, M_TRANSPARENT);
-   MgraColor(M_DEFAULT, M_COLOR_BLUE);
-   McalDraw(M_DEFAULT, this->m_MilDisplayedImage, m_MilGraList,
-            M_DRAW_ABSOLUTE_COORDINATE_SYSTEM, M_DEFAULT, M_DEFAULT);
-   MgraColor(M_DEFAULT, M_COLOR_RED);
-   MgraControl(M_DEFAULT, M_INPUT_UNITS, M_WORLD);
-   MgraDots(M_DEFAULT, m_MilGraList, m_NbPoints,
-            &ConvertedXDouble[0], &ConvertedZDouble[0], M_DEFAULT);
-   MdispControl(m_MilDisplay, M_UPDATE, M_ENABLE);
-   }
-
-//*****************************************************************************
-// CProfileDepthMapProcess. Process on 3dpoints coming from multiple profiles.
-//                          This process extracts and displays a depth map extracted
-//                          from the 3d points.
-//*****************************************************************************
-
-//*****************************************************************************
-// Constructor. Allocates point cloud container, depth map.
-//*****************************************************************************
-CProfileDepthMapProcess::CProfileDepthMapProcess(MIL_ID MilSystem, const SPCal& ConvPCal,
-                                                 const SPRange& DataRange, MIL_DOUBLE WorldPosY,
-                                                 MIL_DOUBLE ConveyorSpeed, MIL_INT ProfileSize, MIL_INT NbProfiles)
-   :CProfile3dPointsProcess(MilSystem, ConvPCal, ProfileSize, NbProfiles),
-    m_ConvertedY(m_NbPoints),
-    m_NbFramesProcessed(0)
-   {
-#if USE_D3D_DISPLAY
-   m_3DDispHandle = M_NULL;
-#endif
-   // Create the Y coordinate data.
-   for(MIL_INT y = 0; y < NbProfiles; y++)
-      {
-      MIL_DOUBLE CurY = WorldPosY + y * ConveyorSpeed;
-      for(MIL_INT x = 0; x < ProfileSize; x++)
-         m_ConvertedY[x + y*ProfileSize] = (MIL_FLOAT)CurY;
-      }
-   
-   // Allocate the point cloud container.
-   M3dmapAllocResult(MilSystem, M_POINT_CLOUD_CONTAINER, M_DEFAULT, &m_MilPointCloudContainer);
-
-   // Allocate the depth map.
-   MbufAlloc2d(MilSystem, ProfileSize, NbProfiles, 16 + M_UNSIGNED, M_IMAGE + M_PROC + M_DISP, &m_MilDepthMap);
-   MbufClear(m_MilDepthMap, 65535);
-
-   // Calibrate the depth map.
-   MIL_DOUBLE WorldSizeX = DataRange.MaxX - DataRange.MinX;
-   MIL_DOUBLE WorldSizeZ = DataRange.MaxZ - DataRange.MinZ;
-   MIL_DOUBLE PixelSizeX = WorldSizeX / ProfileSize;
-   MIL_DOUBLE GrayLevelSizeZ = WorldSizeZ / 65535;
-   McalUniform(m_MilDepthMap, DataRange.MinX, WorldPosY, PixelSizeX, ConveyorSpeed, 0.0, M_DEFAULT);
-   McalControl(m_MilDepthMap, M_WORLD_POS_Z, DataRange.MinZ);
-   McalControl(m_MilDepthMap, M_GRAY_LEVEL_SIZE_Z, GrayLevelSizeZ);
-
-   // Set the extraction box of the point cloud to the depth map.
-   M3dmapSetBox(m_MilPointCloudContainer, M_EXTRACTION_BOX, M_DEPTH_MAP, (MIL_DOUBLE)m_MilDepthMap,
-                M_DEFAULT, M_DEFAULT, M_DEFAULT, M_DEFAULT, M_DEFAULT);
-
-   // Set the extraction parameters.
-   M3dmapControl(m_MilPointCloudContainer, M_GENERAL, M_AUTO_SCALE_ASPECT_RATIO, M_UNCONSTRAINED);
-
-   // Allocate the display.
-   MdispAlloc(MilSystem, M_DEFAULT, MIL_TEXT("M_DEFAULT"), M_DEFAULT, &m_MilDisplay);
-   
-   // Create the LUT for the display.
-   MbufAllocColor(MilSystem, 3, 65536, 1, 8 + M_UNSIGNED, M_LUT, &m_MilDisplayLut);
-   MgenLutFunction(m_MilDisplayLut, M_COLORMAP_JET, M_DEFAULT,
-                   M_DEFAULT, M_DEFAULT, M_DEFAULT, M_DEFAULT, M_DEFAULT);
-   MIL_UINT8 ColorForInvalidDepth[3] = {128, 128, 128};
-   MbufPutColor2d(m_MilDisplayLut, M_PLANAR, M_ALL_BANDS, 65535, 0, 1, 1, ColorForInvalidDepth);
-   MdispLut(m_MilDisplay, m_MilDisplayLut);
-
-#if USE_D3D_DISPLAY
-   // Try to allocate D3D display.
-   m_3DDispHandle = MdepthD3DAlloc(m_MilDepthMap,
-                                   M_NULL,
-                                   D3D_DISPLAY_SIZE_X,
-                                   D3D_DISPLAY_SIZE_Y,
-                                   M_DEFAULT,
-                                   M_DEFAULT,
-                                   M_DEFAULT,
-                                   0,
-                                   65534,
-                                   MAX_Z_GAP_DISTANCE,
-                                   0);
-   if(m_3DDispHandle)
-      {
-      MdispD3DControl(m_3DDispHandle, MD3D_POINT, MD3D_ENABLE);
-      MdispD3DControl(m_3DDispHandle, MD3D_ROTATE, MD3D_FALSE);
-      MdispD3DShow(m_3DDispHandle);
-      MdispControl(m_MilDisplay, M_WINDOW_INITIAL_POSITION_X, D3D_DISPLAY_SIZE_X + WINDOWS_OFFSET_X);
-      }   
-#endif
-
-   // Select the image on the display.
-   MdispSelect(m_MilDisplay, m_MilDepthMap);
-   }
-
-//*****************************************************************************
-// Destructor. Frees resources.
-//*****************************************************************************
-CProfileDepthMapProcess::~CProfileDepthMapProcess()
-   {
-   MbufFree(m_MilDisplayLut);
-   MdispFree(m_MilDisplay);
-   MbufFree(m_MilDepthMap);
-   M3dmapFree(m_MilPointCloudContainer);
-#if USE_D3D_DISPLAY
-   if(m_3DDispHandle)MdispD3DFree(m_3DDispHandle);
-#endif
-   }
-
-//*****************************************************************************
-// Function that processes the profile data. Converts the profile data
-// to be in 3d points format. Extracts the points into a displayed
-// depth map.
-//*****************************************************************************
-void CProfileDepthMapProcess::Process(const SPData& Data)
-   {
-   // Convert the data.
-   SPData ConvertedData = m_pProcessProfileDataConversion->Convert(Data);
-
-   // Put the data in a point cloud container.
-   MIL_FLOAT* pConvertedX = (MIL_FLOAT*)MbufInquire(ConvertedData.MilX, M_HOST_ADDRESS, M_NULL);
-   MIL_FLOAT* pConvertedZ = (MIL_FLOAT*)MbufInquire(ConvertedData.MilZ, M_HOST_ADDRESS, M_NULL);
-   M3dmapPut(m_MilPointCloudContainer, M_POINT_CLOUD_LABEL(1), M_POSITION, M_FLOAT + 32,
-             m_NbPoints, pConvertedX, &m_ConvertedY[0], pConvertedZ, M_NULL, M_DEFAULT);
-
-   // Extract the data in the depth map.
-   M3dmapExtract(m_MilPointCloudContainer, m_MilDepthMap, M_NULL, M_CORRECTED_DEPTH_MAP, M_ALL, M_DEFAULT);
-
-#if USE_D3D_DISPLAY
-   if(m_3DDispHandle)
-      {
-      MdepthD3DSetImages(m_3DDispHandle, m_MilDepthMap, M_NULL);
-      if(m_NbFramesProcessed == 0)
-         MdispD3DPrintHelp(m_3DDispHandle);
-      }
-#endif
-
-   m_NbFramesProcessed++;
-   }
+﻿/************************************************************************************/
+/*
+* File name: ProfileProcess.cpp
+*
+* Synopsis:  This file contains the implementation of the CProfileProcess classes that
+*            are processing some profile data (SPdata).
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+#include <mil.h>
+#include <math.h>
+#include <vector>
+#include "DataConversion.h"
+#include "ProfileProcess.h"
+
+//*****************************************************************************
+// Constants.
+//*****************************************************************************
+static const MIL_INT WINDOWS_OFFSET_X = 15;
+
+// Maximum number of missing depth map cells interpolated between two cells
+// of a profile.
+static const MIL_INT DEPTH_MAP_MAX_FILL_GAP = 2;
+
+// Largest Z difference between neighbor points connected by the D3D display
+// and by the mesh.
+static const MIL_DOUBLE MAX_Z_GAP_DISTANCE = 2.0; // in mm
+
+//*****************************************************************************
+// DirectX display.
+//*****************************************************************************
+#if USE_D3D_DISPLAY
+// D3D display parameters.
+const MIL_INT    D3D_DISPLAY_SIZE_X = 640;
+const MIL_INT    D3D_DISPLAY_SIZE_Y = 480;
+#endif
+
+//*****************************************************************************
+// CProfileProcess. Interface to a profile process.
+//*****************************************************************************
+
+//*****************************************************************************
+// Constructor.
+//*****************************************************************************
+CProfileProcess::CProfileProcess(const SPCal& PCal, MIL_INT NbPoints) :
+   m_PCal(PCal),
+   m_NbPoints(NbPoints),
+   m_pProcessProfileDataConversion(NULL)
+   {
+   }
+
+//*****************************************************************************
+// Destructor. Deletes the profile process data conversion if required.
+//*****************************************************************************
+CProfileProcess::~CProfileProcess() 
+   {
+   if(m_pProcessProfileDataConversion)
+      {
+      delete m_pProcessProfileDataConversion;
+      m_pProcessProfileDataConversion = NULL;
+      }
+   };
+
+//*****************************************************************************
+// Plan. Declares the buffers of the profile process data conversion to the
+//       planner. The converted data is used until the end of the process.
+//*****************************************************************************
+SPPlanData CProfileProcess::Plan(CBufferPlanner& Planner, const SPPlanData& Data)
+   {
+   SPPlanData PlannedData = m_pProcessProfileDataConversion ?
+      m_pProcessProfileDataConversion->Plan(Planner, Data) : Data;
+   Planner.BeginStage();
+   Planner.Use(PlannedData);
+   return PlannedData;
+   }
+
+//*****************************************************************************
+// Bind. Gets the buffers allocated by the planner and the kernels selected
+//       for the profile size.
+//*****************************************************************************
+void CProfileProcess::Bind(const CBufferPlanner& Planner, const SPProfileKernels& Kernels)
+   {
+   if(m_pProcessProfileDataConversion)
+      m_pProcessProfileDataConversion->Bind(Planner, Kernels);
+   }
+
+//*****************************************************************************
+// ProcessEmptyBlock. Processes a block that only contains the empty belt,
+//                    without its data. Its points are not converted, so
+//                    its statistics only count them.
+//*****************************************************************************
+void CProfileProcess::ProcessEmptyBlock()
+   {
+   m_LastStats.Reset();
+   m_LastStats.NbPoints = (MIL_INT)m_NbPoints;
+   }
+
+
+//*****************************************************************************
+// CProfile3dPointsProcess. Base class for any profile process that needs to
+//                          work on 3d points. The data from the 3d camera
+//                          will be converted accordingly.
+//*****************************************************************************
+
+//*****************************************************************************
+// Constructor.
+//*****************************************************************************
+CProfile3dPointsProcess::CProfile3dPointsProcess(const SPCal& PCal, MIL_INT ProfileSize, MIL_INT NbProfiles,
+                                                 const SPBeltSettings& BeltSettings) :
+   CProfileProcess(PCal, ProfileSize * NbProfiles)
+   {
+   // Allocate the reference profile of the belt, if the heights above the
+   // belt are requested.
+   m_pBeltReference = BeltSettings.NbReferenceBlocks > 0 ?
+      new CBeltReference(ProfileSize, BeltSettings) : M_NULL;
+
+   // Build the data conversion from fixed point Z and X coordinates to float flat array of X-Y coordinates. 
+   m_pProcessProfileDataConversion = new CDataConversionToWorld(m_pProcessProfileDataConversion,
+                                                                ProfileSize, NbProfiles, PCal,
+                                                                m_pBeltReference);
+   m_pProcessProfileDataConversion = new CDataConversionToFlat(m_pProcessProfileDataConversion,
+                                                               ProfileSize, NbProfiles, 32 + M_FLOAT);
+   m_pProcessProfileDataConversion = new CDataConversionApplyInvalid(m_pProcessProfileDataConversion);
+   }
+
+//*****************************************************************************
+// Destructor.
+//*****************************************************************************
+CProfile3dPointsProcess::~CProfile3dPointsProcess()
+   {
+   delete m_pBeltReference;
+   }
+
+//*****************************************************************************
+// ConvertData. Converts the profile data to 3d points and keeps the statistics
+//              accumulated by the conversion.
+//*****************************************************************************
+SPData CProfile3dPointsProcess::ConvertData(const SPData& Data)
+   {
+   SPData ConvertedData = m_pProcessProfileDataConversion->Convert(Data);
+   if(ConvertedData.pStats)
+      m_LastStats = *ConvertedData.pStats;
+   return ConvertedData;
+   }
+
+
+//*****************************************************************************
+// CProfileSingleProcess. Process on 3dpoints coming from a single profile.
+//                        This process display the 3d points.
+//*****************************************************************************
+
+//*****************************************************************************
+// Constructor. Allocates objects for displaying the 3d profile.
+//*****************************************************************************
+CProfileSingleProcess::CProfileSingleProcess(MIL_ID MilSystem, const SPCal& ConvertPCal,
+                                             const SPRange& DataRange, MIL_INT ProfileSize,
+                                             const SPBeltSettings& BeltSettings)
+   :CProfile3dPointsProcess(ConvertPCal, ProfileSize, 1, BeltSettings)
+   {
+   // Allocate the displayed image.
+   MIL_DOUBLE WorldSizeX = DataRange.MaxX - DataRange.MinX;
+   MIL_DOUBLE WorldSizeZ = DataRange.MaxZ - DataRange.MinZ;
+   MIL_DOUBLE DisplayPixelSize = WorldSizeX / ProfileSize;
+   MIL_INT DisplaySizeX = (MIL_INT)(WorldSizeX / DisplayPixelSize);
+   MIL_INT DisplaySizeY = (MIL_INT)(WorldSizeZ / DisplayPixelSize);
+   MbufAlloc2d(MilSystem, DisplaySizeX, DisplaySizeY,
+               8 + M_UNSIGNED, M_IMAGE + M_DISP, &m_MilDisplayedImage);
+   MbufClear(m_MilDisplayedImage, 192);
+   McalUniform(m_MilDisplayedImage, DataRange.MinX, DataRange.MinZ,
+               DisplayPixelSize, DisplayPixelSize, 0.0, M_DEFAULT);
+
+   // Allocate the display.
+   MdispAlloc(MilSystem, M_DEFAULT, MIL_TEXT("M_DEFAULT"), M_DEFAULT, &m_MilDisplay);
+   MdispSelect(m_MilDisplay, m_MilDisplayedImage);
+
+   // Allocate the graphic list and associate to the display.
+   MgraAllocList(MilSystem, M_DEFAULT, &m_MilGraList);
+   MdispControl(m_MilDisplay, M_ASSOCIATED_GRAPHIC_LIST_ID, m_MilGraList);
+   }
+
+//*****************************************************************************
+// Destructor. Frees display resources.
+//*****************************************************************************
+CProfileSingleProcess::~CProfileSingleProcess()
+   {
+   MbufFree(m_MilDisplayedImage);
+   MgraFree(m_MilGraList);
+   MdispFree(m_MilDisplay);
+   }
+
+//*****************************************************************************
+// Function that processes the profile data. Converts the profile data
+// to be in 3d points format. Draws the points as dots in the calibrated
+// display.
+//*****************************************************************************
+void CProfileSingleProcess::Process(const SPData& Data)
+   {
+   // Convert the data.
+   SPData ConvertedData = ConvertData(Data);
+
+   // Draw the points in the displayed graphic list.
+   MIL_FLOAT* pConvertedX = (MIL_FLOAT*)MbufInquire(ConvertedData.MilX, M_HOST_ADDRESS, M_NULL);
+   MIL_FLOAT* pConvertedZ = (MIL_FLOAT*)MbufInquire(ConvertedData.MilZ, M_HOST_ADDRESS, M_NULL);
+   DrawPoints(pConvertedX, pConvertedZ, (MIL_INT)m_NbPoints);
+   }
+
+//*****************************************************************************
+// ProcessEmptyBlock. Draws an empty profile.
+//*****************************************************************************
+void CProfileSingleProcess::ProcessEmptyBlock()
+   {
+   CProfile3dPointsProcess::ProcessEmptyBlock();
+   DrawPoints(M_NULL, M_NULL, 0);
+   }
+
+//*****************************************************************************
+// DrawPoints. Draws the calibration and the points in the displayed
+//             graphic list.
+//*****************************************************************************
+void CProfileSingleProcess::DrawPoints(const MIL_FLOAT* pX, const MIL_FLOAT* pZ, MIL_INT NbPoints)
+   {
+   std::vector<MIL_DOUBLE> ConvertedXDouble(NbPoints + 1);
+   std::vector<MIL_DOUBLE> ConvertedZDouble(NbPoints + 1);
+   for(MIL_INT i = 0; i < NbPoints; i++)
+      {
+      ConvertedXDouble[i] = pX[i];
+      ConvertedZDouble[i] = pZ[i];
+      }
+
+   // Disable the updates of the graphic list.
+   MdispControl(m_MilDisplay, M_UPDATE, M_DISABLE);
+
+   // Clear the graphic list.
+   MgraClear(M_DEFAULT, m_MilGraList);
+
+   // Draw the calibration.
+   MgraControl(M_DEFAULT, M_BACKGROUND_MODE, M_TRANSPARENT);
+   MgraColor(M_DEFAULT, M_COLOR_BLUE);
+   McalDraw(M_DEFAULT, this->m_MilDisplayedImage, m_MilGraList,
+            M_DRAW_ABSOLUTE_COORDINATE_SYSTEM, M_DEFAULT, M_DEFAULT);
+   MgraColor(M_DEFAULT, M_COLOR_RED);
+   MgraControl(M_DEFAULT, M_INPUT_UNITS, M_WORLD);
+   if(NbPoints)
+      MgraDots(M_DEFAULT, m_MilGraList, NbPoints,
+               &ConvertedXDouble[0], &ConvertedZDouble[0], M_DEFAULT);
+   MdispControl(m_MilDisplay, M_UPDATE, M_ENABLE);
+   }
+
+//*****************************************************************************
+// GetMaxFillGap. Gets the largest gap filled between two points of a profile
+//                rasterized in a grid. On a grid finer than the profiles in
+//                X, the cells between two points are gaps to fill.
+//*****************************************************************************
+static MIL_INT GetMaxFillGap(const SPDepthMapGrid& Grid, MIL_DOUBLE ProfilePixelSizeX)
+   {
+   if(Grid.PixelSizeX < ProfilePixelSizeX)
+      return (MIL_INT)ceil((DEPTH_MAP_MAX_FILL_GAP + 1) * ProfilePixelSizeX / Grid.PixelSizeX) - 1;
+   return DEPTH_MAP_MAX_FILL_GAP;
+   }
+
+//*****************************************************************************
+// CProfileDepthMapProcess. Process on 3dpoints coming from multiple profiles.
+//                          This process rasterizes and displays a depth map
+//                          built from the 3d points.
+//*****************************************************************************
+
+//*****************************************************************************
+// Constructor. Allocates the depth map and its rasterizer.
+//*****************************************************************************
+CProfileDepthMapProcess::CProfileDepthMapProcess(MIL_ID MilSystem, const SPCal& ConvPCal,
+                                                 const SPRange& DataRange, MIL_DOUBLE WorldPosY,
+                                                 MIL_DOUBLE ConveyorSpeed, MIL_INT ProfileSize, MIL_INT NbProfiles,
+                                                 const SPBeltSettings& BeltSettings,
+                                                 const SPDepthMapSettings& Settings)
+   :CProfile3dPointsProcess(ConvPCal, ProfileSize, NbProfiles, BeltSettings),
+    m_ProfileSize(ProfileSize),
+    m_NbProfiles(NbProfiles),
+    m_DisplayLength(Settings.DisplayLength < Settings.MapLength ? Settings.DisplayLength : Settings.MapLength),
+    m_NbFramesProcessed(0)
+   {
+#if USE_D3D_DISPLAY
+   m_3DDispHandle = M_NULL;
+#endif
+   // Define the depth map grid. By default, the grid has the resolution of
+   // the profiles: a cell per point in X and a row per profile in Y.
+   MIL_DOUBLE WorldSizeX = DataRange.MaxX - DataRange.MinX;
+   MIL_DOUBLE WorldSizeZ = DataRange.MaxZ - DataRange.MinZ;
+   MIL_DOUBLE ProfilePixelSizeX = WorldSizeX / ProfileSize;
+   SPDepthMapGrid Grid;
+   Grid.PixelSizeX = Settings.PixelSizeX > 0 ? Settings.PixelSizeX : ProfilePixelSizeX;
+   Grid.PixelSizeY = Settings.PixelSizeY > 0 ? Settings.PixelSizeY : ConveyorSpeed;
+   Grid.SizeX = (MIL_INT)ceil(WorldSizeX / Grid.PixelSizeX);
+   Grid.SizeY = Settings.MapLength;
+   Grid.WorldPosX = DataRange.MinX;
+   Grid.WorldPosY = WorldPosY;
+   Grid.WorldPosZ = DataRange.MinZ;
+   Grid.GrayLevelSizeZ = WorldSizeZ / 65535;
+
+   // Allocate the rasterizer of the profiles in the depth map and its
+   // worker threads.
+   m_pWorkerPool = new CWorkerPool(MilSystem, Settings.NbWorkers);
+   m_pRasterizer = new CDepthMapRasterizer(Grid, ConveyorSpeed, Settings.CellPolicy,
+                                           GetMaxFillGap(Grid, ProfilePixelSizeX), m_pWorkerPool);
+
+   // Allocate the hole filler, which runs on the same workers.
+   m_pHoleFiller = Settings.MaxHoleSize > 0 ?
+      new CDepthMapHoleFiller(Grid.SizeX, Settings.MaxHoleSize, m_pWorkerPool) : M_NULL;
+
+   // Allocate the continuous depth map. The windows must hold the rows
+   // updated by a whole block and the displayed rows, which are at most the
+   // rows of the depth map.
+   MIL_INT MaxBlockRows = m_pRasterizer->GetMaxRowsPerBlock(NbProfiles);
+   MIL_INT MaxWindowLength = MaxBlockRows > m_DisplayLength ? MaxBlockRows : m_DisplayLength;
+   m_pDepthMapRing = new CDepthMapRing(MilSystem, Grid, Settings.MapLength, MaxWindowLength);
+
+   // The displayed depth map is a window on the last rows.
+   m_MilDepthMap = m_pDepthMapRing->AllocWindow(m_DisplayLength);
+
+   // Allocate the pyramid of the depth map, if requested. Each level keeps
+   // as many rows as the depth map, so it covers a longer part of the scan.
+   m_pPyramid = Settings.NbPyramidLevels > 0 ?
+      new CDepthMapPyramid(MilSystem, *m_pDepthMapRing, Settings.NbPyramidLevels,
+                           Settings.MapLength, MaxWindowLength) : M_NULL;
+
+   // Allocate the segmentation of the parts, if requested.
+   m_pPartSegmenter = Settings.SegmentParts ?
+      new CPartSegmenter(Grid, Settings.PartMinZ, Settings.PartMinCells) : M_NULL;
+
+   // Allocate the organized point cloud, if requested or meshed. Its normals
+   // are computed on the same workers. The mesh skips the Z gaps like the
+   // D3D display.
+   m_pOrganizedPointCloud = (Settings.ComputeNormals || Settings.GenerateMesh) ?
+      new COrganizedPointCloud(ProfileSize, NbProfiles, WorldPosY, ConveyorSpeed, m_pWorkerPool) : M_NULL;
+   m_pMesher = Settings.GenerateMesh ? new CProfileMesher(ProfileSize, MAX_Z_GAP_DISTANCE) : M_NULL;
+
+   // Allocate the voxel accumulator of the whole scan, if requested.
+   m_pVoxelAccumulator = Settings.VoxelSize > 0.0 ?
+      new CVoxelAccumulator(MilSystem, Settings.VoxelSize, Settings.VoxelPolicy, WorldPosY, ConveyorSpeed) : M_NULL;
+
+   // Allocate the spatial index of the last part of the scan, if requested.
+   m_pPointIndex = Settings.IndexCellSize > 0.0 ?
+      new CPointIndex(MilSystem, Settings.IndexCellSize, DataRange.MinX, DataRange.MaxX,
+                      WorldPosY, ConveyorSpeed, Settings.IndexLength) : M_NULL;
+
+   // Allocate the colorizer of the previews of the displayed rows, if
+   // requested.
+   m_pColorizer = Settings.PreviewRate > 0.0 ?
+      new CDepthMapColorizer(MilSystem, *m_pDepthMapRing, m_DisplayLength, Settings.PreviewRate) : M_NULL;
+
+   // Allocate the inspection of the parts, if requested. The golden depth
+   // map must have been saved with the same grid.
+   m_pPartInspector = M_NULL;
+   if(Settings.InspectParts)
+      {
+      MIL_ID MilGoldenDepthMap = M_NULL;
+      if(Settings.GoldenFileName)
+         {
+         MbufRestore(Settings.GoldenFileName, MilSystem, &MilGoldenDepthMap);
+         if(MilGoldenDepthMap &&
+            (MbufInquire(MilGoldenDepthMap, M_SIZE_X, M_NULL) != Grid.SizeX ||
+             MbufInquire(MilGoldenDepthMap, M_TYPE, M_NULL) != 16 + M_UNSIGNED))
+            {
+            MosPrintf(MIL_TEXT("The golden part does not match the depth map. The first part is learned.\n"));
+            MbufFree(MilGoldenDepthMap);
+            MilGoldenDepthMap = M_NULL;
+            }
+         }
+      m_pPartInspector = new CPartInspector(Grid, MilGoldenDepthMap, Settings.PartMinZ, Settings.PartMinCells,
+                                            Settings.InspectionTolerance, Settings.MaxOutOfTolerance);
+      if(MilGoldenDepthMap)
+         MbufFree(MilGoldenDepthMap);
+      }
+
+   // Allocate the out-of-core store of the whole scan, if requested.
+   m_pTileStore = M_NULL;
+   if(Settings.SpillFileName && (Settings.TileRows < 1 || Settings.TileRows > Settings.MapLength))
+      MosPrintf(MIL_TEXT("The depth map tiles must have from 1 to %d rows. They are not stored.\n"),
+                (int)Settings.MapLength);
+   else if(Settings.SpillFileName)
+      {
+      m_pTileStore = new CDepthMapTileStore(MilSystem, Grid, Settings.TileRows, Settings.SpillFileName);
+      if(!m_pTileStore->IsOpen())
+         {
+         MosPrintf(MIL_TEXT("Unable to create the spill file of the depth map tiles.\n"));
+         delete m_pTileStore;
+         m_pTileStore = M_NULL;
+         }
+      }
+
+   // Allocate the display.
+   MdispAlloc(MilSystem, M_DEFAULT, MIL_TEXT("M_DEFAULT"), M_DEFAULT, &m_MilDisplay);
+   
+   // Create the LUT for the display.
+   MbufAllocColor(MilSystem, 3, 65536, 1, 8 + M_UNSIGNED, M_LUT, &m_MilDisplayLut);
+   MgenLutFunction(m_MilDisplayLut, M_COLORMAP_JET, M_DEFAULT,
+                   M_DEFAULT, M_DEFAULT, M_DEFAULT, M_DEFAULT, M_DEFAULT);
+   MIL_UINT8 ColorForInvalidDepth[3] = {128, 128, 128};
+   MbufPutColor2d(m_MilDisplayLut, M_PLANAR, M_ALL_BANDS, 65535, 0, 1, 1, ColorForInvalidDepth);
+   MdispLut(m_MilDisplay, m_MilDisplayLut);
+
+#if USE_D3D_DISPLAY
+   // Try to allocate D3D display.
+   m_3DDispHandle = MdepthD3DAlloc(m_MilDepthMap,
+                                   M_NULL,
+                                   D3D_DISPLAY_SIZE_X,
+                                   D3D_DISPLAY_SIZE_Y,
+                                   M_DEFAULT,
+                                   M_DEFAULT,
+                                   M_DEFAULT,
+                                   0,
+                                   65534,
+                                   MAX_Z_GAP_DISTANCE,
+                                   0);
+   if(m_3DDispHandle)
+      {
+      MdispD3DControl(m_3DDispHandle, MD3D_POINT, MD3D_ENABLE);
+      MdispD3DControl(m_3DDispHandle, MD3D_ROTATE, MD3D_FALSE);
+      MdispD3DShow(m_3DDispHandle);
+      MdispControl(m_MilDisplay, M_WINDOW_INITIAL_POSITION_X, D3D_DISPLAY_SIZE_X + WINDOWS_OFFSET_X);
+      }   
+#endif
+
+   // Select the image on the display.
+   MdispSelect(m_MilDisplay, m_MilDepthMap);
+   }
+
+//*****************************************************************************
+// Destructor. Frees resources.
+//*****************************************************************************
+CProfileDepthMapProcess::~CProfileDepthMapProcess()
+   {
+   MbufFree(m_MilDisplayLut);
+   MdispFree(m_MilDisplay);
+   MbufFree(m_MilDepthMap);
+   delete m_pColorizer;
+   delete m_pPointIndex;
+   delete m_pVoxelAccumulator;
+   delete m_pPartInspector;
+   delete m_pMesher;
+   delete m_pOrganizedPointCloud;
+   delete m_pPartSegmenter;
+   delete m_pPyramid;
+   delete m_pDepthMapRing;
+   delete m_pTileStore;
+   delete m_pHoleFiller;
+   delete m_pRasterizer;
+   delete m_pWorkerPool;
+#if USE_D3D_DISPLAY
+   if(m_3DDispHandle)MdispD3DFree(m_3DDispHandle);
+#endif
+   }
+
+//*****************************************************************************
+// Bind. Also gets the kernels of the rasterizer.
+//*****************************************************************************
+void CProfileDepthMapProcess::Bind(const CBufferPlanner& Planner, const SPProfileKernels& Kernels)
+   {
+   CProfile3dPointsProcess::Bind(Planner, Kernels);
+   m_pRasterizer->SetKernels(Kernels.QuantizeRow, Kernels.InterpolateRow);
+   if(m_pPartInspector)
+      m_pPartInspector->SetKernel(Kernels.DeviationRow);
+   if(m_pOrganizedPointCloud)
+      m_pOrganizedPointCloud->SetKernel(Kernels.NormalRow);
+   if(m_pColorizer)
+      m_pColorizer->SetKernel(Kernels.ColorizeRow);
+   }
+
+//*****************************************************************************
+// Function that processes the profile data. Converts the profile data
+// to be in 3d points format. Rasterizes the points into a displayed
+// depth map.
+//*****************************************************************************
+void CProfileDepthMapProcess::Process(const SPData& Data)
+   {
+   // Convert the data.
+   SPData ConvertedData = ConvertData(Data);
+
+   // Rasterize the profiles in the continuous depth map. Only the rows
+   // touched by the block, including the seam row with the previous block,
+   // are updated.
+   const MIL_FLOAT* pConvertedX = (const MIL_FLOAT*)MbufInquire(ConvertedData.MilX, M_HOST_ADDRESS, M_NULL);
+   const MIL_FLOAT* pConvertedZ = (const MIL_FLOAT*)MbufInquire(ConvertedData.MilZ, M_HOST_ADDRESS, M_NULL);
+   const MIL_UINT8* pValidMask = ConvertedData.MilValidMask ?
+      (const MIL_UINT8*)MbufInquire(ConvertedData.MilValidMask, M_HOST_ADDRESS, M_NULL) : M_NULL;
+   m_LastUpdatedRows = m_pRasterizer->Rasterize(pConvertedX, pConvertedZ, pValidMask,
+                                                m_ProfileSize, m_NbProfiles, *m_pDepthMapRing);
+
+   // Keep the points organized, compute their normals and mesh them.
+   if(m_pOrganizedPointCloud)
+      m_pOrganizedPointCloud->Process(pConvertedX, pConvertedZ, pValidMask);
+   if(m_pMesher)
+      m_pMesher->Process(*m_pOrganizedPointCloud);
+
+   // Accumulate the points in their voxels and index them.
+   if(m_pVoxelAccumulator)
+      m_pVoxelAccumulator->AddBlock(pConvertedX, pConvertedZ, pValidMask, m_ProfileSize, m_NbProfiles);
+   if(m_pPointIndex)
+      m_pPointIndex->AddBlock(pConvertedX, pConvertedZ, pValidMask, m_ProfileSize, m_NbProfiles);
+   UpdateDepthMap();
+   }
+
+//*****************************************************************************
+// ProcessEmptyBlock. Advances the depth map over the block without
+//                    converting it. The rows of the block are cleared, as
+//                    the points of a converted block of belt are within the
+//                    tolerance of the belt.
+//*****************************************************************************
+void CProfileDepthMapProcess::ProcessEmptyBlock()
+   {
+   CProfile3dPointsProcess::ProcessEmptyBlock();
+   m_LastUpdatedRows = m_pRasterizer->Rasterize(M_NULL, M_NULL, M_NULL,
+                                                m_ProfileSize, m_NbProfiles, *m_pDepthMapRing);
+   if(m_pOrganizedPointCloud)
+      m_pOrganizedPointCloud->Process(M_NULL, M_NULL, M_NULL);
+   if(m_pMesher)
+      m_pMesher->Process(*m_pOrganizedPointCloud);
+   if(m_pVoxelAccumulator)
+      m_pVoxelAccumulator->AddBlock(M_NULL, M_NULL, M_NULL, m_ProfileSize, m_NbProfiles);
+   if(m_pPointIndex)
+      m_pPointIndex->AddBlock(M_NULL, M_NULL, M_NULL, m_ProfileSize, m_NbProfiles);
+   UpdateDepthMap();
+   }
+
+//*****************************************************************************
+// UpdateDepthMap. Commits the rasterized rows of a block and updates what
+//                 depends on them: the filled holes, the pyramid, the
+//                 out-of-core tiles, the parts and the display.
+//*****************************************************************************
+void CProfileDepthMapProcess::UpdateDepthMap()
+   {
+   m_pDepthMapRing->CommitRows(m_LastUpdatedRows);
+
+   // Fill the holes of the rows that are far enough from the last completed
+   // row. They are also updated rows.
+   if(m_pHoleFiller)
+      {
+      SPRowRange FilledRows = m_pHoleFiller->Fill(*m_pDepthMapRing, m_pRasterizer->GetNbCompletedRows());
+      m_pDepthMapRing->CommitRows(FilledRows);
+      if(!FilledRows.IsEmpty() && FilledRows.First < m_LastUpdatedRows.First)
+         m_LastUpdatedRows.First = FilledRows.First;
+      }
+
+   // Update the cells of the pyramid above the updated rows.
+   if(m_pPyramid)
+      m_pPyramid->Update(m_LastUpdatedRows);
+
+   // Spill the tiles whose rows are final.
+   if(m_pTileStore)
+      m_pTileStore->Append(*m_pDepthMapRing, GetNbFinalRows());
+
+   // Segment and measure the final rows and report the parts they completed.
+   if(m_pPartSegmenter)
+      {
+      m_pPartSegmenter->Update(*m_pDepthMapRing, GetNbFinalRows());
+      for(MIL_INT p = 0; p < m_pPartSegmenter->GetNbNewParts(); p++)
+         {
+         const SPPart& Part = m_pPartSegmenter->GetNewPart(p);
+         const SPPartMeasures& Measures = Part.Measures;
+         MosPrintf(MIL_TEXT("Part %d: rows %d to %d, %.1f mm2, %.1f mm3, max Z %.2f mm, mean Z %.2f mm,\n")
+                   MIL_TEXT("        box %.1f x %.1f mm at (%.1f, %.1f) mm, %.1f deg.\n"),
+                   (int)Part.Id, (int)Part.FirstRow, (int)Part.EndRow - 1,
+                   Measures.Area, Measures.Volume, Measures.MaxZ, Measures.MeanZ,
+                   Measures.BoxLength, Measures.BoxWidth, Measures.BoxCenterX, Measures.BoxCenterY,
+                   Measures.BoxAngle);
+         }
+      }
+
+   // Inspect the final rows and report the parts they completed.
+   if(m_pPartInspector)
+      {
+      m_pPartInspector->Update(*m_pDepthMapRing, GetNbFinalRows());
+      for(MIL_INT i = 0; i < m_pPartInspector->GetNbNewInspections(); i++)
+         {
+         const SPInspection& Inspection = m_pPartInspector->GetNewInspection(i);
+         if(Inspection.IsGolden)
+            MosPrintf(MIL_TEXT("Inspection %d: rows %d to %d learned as the golden part.\n"),
+                      (int)Inspection.Id, (int)Inspection.FirstRow, (int)Inspection.EndRow - 1);
+         else
+            MosPrintf(MIL_TEXT("Inspection %d: rows %d to %d %s, %d cells out of tolerance, max deviation %.2f mm.\n"),
+                      (int)Inspection.Id, (int)Inspection.FirstRow, (int)Inspection.EndRow - 1,
+                      Inspection.Pass ? MIL_TEXT("pass") : MIL_TEXT("FAIL"),
+                      (int)Inspection.NbOutOfTolerance, Inspection.MaxDeviation);
+         }
+      }
+
+   // Start a preview of the last rows, if one is due.
+   if(m_pColorizer)
+      m_pColorizer->Update();
+
+   // Scroll the displayed window to the last rows.
+   m_pDepthMapRing->MoveWindowToLast(m_MilDepthMap, m_DisplayLength);
+   MbufControl(m_MilDepthMap, M_MODIFIED, M_DEFAULT);
+
+#if USE_D3D_DISPLAY
+   if(m_3DDispHandle)
+      {
+      MdepthD3DSetImages(m_3DDispHandle, m_MilDepthMap, M_NULL);
+      if(m_NbFramesProcessed == 0)
+         MdispD3DPrintHelp(m_3DDispHandle);
+      }
+#endif
+
+   m_NbFramesProcessed++;
+   }
+
+//*****************************************************************************
+// EndScan. Completes the depth map once the grab is stopped: fills the holes
+//          of the last rows and stores the last, partial tile. The row still
+//          open in the rasterizer is not stored.
+//*****************************************************************************
+void CProfileDepthMapProcess::EndScan()
+   {
+   if(m_pHoleFiller)
+      m_pDepthMapRing->CommitRows(m_pHoleFiller->Finish(*m_pDepthMapRing, m_pRasterizer->GetNbCompletedRows()));
+   if(m_pTileStore)
+      m_pTileStore->Flush(*m_pDepthMapRing, GetNbFinalRows());
+   }
+
+//*****************************************************************************
+// GetNbFinalRows. Gets the number of rows that will not change anymore:
+//                 the rows completed by the rasterizer, and filled if the
+//                 holes are filled.
+//*****************************************************************************
+MIL_INT64 CProfileDepthMapProcess::GetNbFinalRows() const
+   {
+   return m_pHoleFiller ? m_pHoleFiller->GetNbFilledRows() : m_pRasterizer->GetNbCompletedRows();
+   }
+
+//*****************************************************************************
+// CProfileFusionProcess. Process on 3dpoints coming from multiple profiles
+//                        of one of several sensors. This process rasterizes
+//                        the points of the sensor for their fusion.
+//*****************************************************************************
+
+//*****************************************************************************
+// Constructor. Allocates the depth map of the sensor and its rasterizer, and
+//              declares it to the fusion.
+//*****************************************************************************
+CProfileFusionProcess::CProfileFusionProcess(MIL_ID MilSystem, const SPCal& PCal, const SPRange& DataRange,
+                                             const SPSensorPose& Pose, MIL_DOUBLE ConveyorSpeed,
+                                             MIL_INT ProfileSize, MIL_INT NbProfiles,
+                                             const SPBeltSettings& BeltSettings, ECellPolicy CellPolicy,
+                                             MIL_INT NbWorkers, CDepthMapFusion& Fusion, MIL_INT Sensor)
+   :CProfile3dPointsProcess(PCal, ProfileSize, NbProfiles, BeltSettings),
+    m_ProfileSize(ProfileSize),
+    m_NbProfiles(NbProfiles),
+    m_Sensor(Sensor),
+    m_Fusion(Fusion)
+   {
+   // Move the converted points to the pose of the sensor.
+   m_pProcessProfileDataConversion = new CDataConversionApplyPose(m_pProcessProfileDataConversion, Pose);
+
+   // Allocate the rasterizer of the profiles on the grid of the fusion and
+   // its worker threads.
+   const SPDepthMapGrid& Grid = Fusion.GetGrid();
+   MIL_DOUBLE ProfilePixelSizeX = (DataRange.MaxX - DataRange.MinX) / ProfileSize;
+   m_pWorkerPool = new CWorkerPool(MilSystem, NbWorkers);
+   m_pRasterizer = new CDepthMapRasterizer(Grid, ConveyorSpeed, CellPolicy,
+                                           GetMaxFillGap(Grid, ProfilePixelSizeX), m_pWorkerPool);
+
+   // Allocate the depth map of the sensor, as long as the fused one. The
+   // offset of the sensor along the conveyor is rounded to a row.
+   MIL_INT MaxBlockRows = m_pRasterizer->GetMaxRowsPerBlock(NbProfiles);
+   m_pDepthMapRing = new CDepthMapRing(MilSystem, Grid, Fusion.GetRing().GetLength(), MaxBlockRows);
+   MIL_INT64 RowOffset = (MIL_INT64)floor(Pose.OffsetY / Grid.PixelSizeY + 0.5);
+   m_Fusion.SetSensor(m_Sensor, m_pDepthMapRing, RowOffset, MaxBlockRows);
+   }
+
+//*****************************************************************************
+// Destructor. Removes the sensor from the fusion and frees resources.
+//*****************************************************************************
+CProfileFusionProcess::~CProfileFusionProcess()
+   {
+   m_Fusion.SetSensor(m_Sensor, M_NULL, 0, 0);
+   delete m_pDepthMapRing;
+   delete m_pRasterizer;
+   delete m_pWorkerPool;
+   }
+
+//*****************************************************************************
+// Bind. Also gets the kernels of the rasterizer.
+//*****************************************************************************
+void CProfileFusionProcess::Bind(const CBufferPlanner& Planner, const SPProfileKernels& Kernels)
+   {
+   CProfile3dPointsProcess::Bind(Planner, Kernels);
+   m_pRasterizer->SetKernels(Kernels.QuantizeRow, Kernels.InterpolateRow);
+   }
+
+//*****************************************************************************
+// Function that processes the profile data. Converts the profile data
+// to be in 3d points format at the pose of the sensor. Rasterizes the
+// points in the depth map of the sensor and fuses the completed rows.
+//*****************************************************************************
+void CProfileFusionProcess::Process(const SPData& Data)
+   {
+   SPData ConvertedData = ConvertData(Data);
+   const MIL_FLOAT* pConvertedX = (const MIL_FLOAT*)MbufInquire(ConvertedData.MilX, M_HOST_ADDRESS, M_NULL);
+   const MIL_FLOAT* pConvertedZ = (const MIL_FLOAT*)MbufInquire(ConvertedData.MilZ, M_HOST_ADDRESS, M_NULL);
+   const MIL_UINT8* pValidMask = ConvertedData.MilValidMask ?
+      (const MIL_UINT8*)MbufInquire(ConvertedData.MilValidMask, M_HOST_ADDRESS, M_NULL) : M_NULL;
+   UpdateFusion(m_pRasterizer->Rasterize(pConvertedX, pConvertedZ, pValidMask,
+                                         m_ProfileSize, m_NbProfiles, *m_pDepthMapRing));
+   }
+
+//*****************************************************************************
+// ProcessEmptyBlock. Advances the depth map of the sensor over the block
+//                    without converting it. The rows of the block are
+//                    cleared, so the pose of the sensor does not matter.
+//*****************************************************************************
+void CProfileFusionProcess::ProcessEmptyBlock()
+   {
+   CProfile3dPointsProcess::ProcessEmptyBlock();
+   UpdateFusion(m_pRasterizer->Rasterize(M_NULL, M_NULL, M_NULL,
+                                         m_ProfileSize, m_NbProfiles, *m_pDepthMapRing));
+   }
+
+//*****************************************************************************
+// UpdateFusion. Commits the rasterized rows of a block and reports the
+//               completed rows to the fusion.
+//*****************************************************************************
+void CProfileFusionProcess::UpdateFusion(const SPRowRange& UpdatedRows)
+   {
+   m_pDepthMapRing->CommitRows(UpdatedRows);
+   m_Fusion.Update(m_Sensor, m_pRasterizer->GetNbCompletedRows());
+   }
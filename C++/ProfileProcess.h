@@ -1,102 +1,258 @@
-﻿/************************************************************************************/
-/*
-* File name: ProfileProcess.h
-*
-* Synopsis:  This file contains the declaration of the CProfileProcess classes that
-*            are processing some profile data(SPdata). 
-*
-* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
-* All Rights Reserved
-*/
-#include <vector>
-#include "DataConversion.h"
-
-#ifndef PROFILE_PROCESS_H
-#define PROFILE_PROCESS_H
-
-// DirectX display is only available under Windows.
-#if M_MIL_USE_WINDOWS && !M_MIL_USE_RT
-#define USE_D3D_DISPLAY  1
-#include "MdispD3D.h"
-#endif
-
-//*****************************************************************************
-// Structure defining the range of the sensor profile.
-//*****************************************************************************
-struct SPRange
-   {
-   MIL_DOUBLE MinX;
-   MIL_DOUBLE MinZ;
-   MIL_DOUBLE MaxX;
-   MIL_DOUBLE MaxZ;
-   };
-
-//*****************************************************************************
-// Base class of a processing to apply to some profile data.
-//*****************************************************************************
-class CProfileProcess
-   {
-   public:
-      CProfileProcess(const SPCal& PCal, MIL_INT NbPoints);
-      virtual ~CProfileProcess();
-      virtual void Process(const SPData& Data) = 0;
-
-   protected:
-      MIL_UINT m_NbPoints;
-      SPCal m_PCal;
-      CDataConversion* m_pProcessProfileDataConversion;
-   };
-
-//*****************************************************************************
-// Base class of a processing to apply to some profile data
-// that requires to convert the profiles to 3d points.
-//*****************************************************************************
-class CProfile3dPointsProcess: public CProfileProcess
-   {
-   public:
-      CProfile3dPointsProcess(MIL_ID MilSystem, const SPCal& PCal,
-                              MIL_INT ProfileSize, MIL_INT NbProfiles);
-   };
-
-//*****************************************************************************
-// Processing to be applied to the 3d points of a single profile.
-//*****************************************************************************
-class CProfileSingleProcess: public CProfile3dPointsProcess
-   {
-   public:
-      CProfileSingleProcess(MIL_ID MilSystem, const SPCal& ConvertPCal,
-                            const SPRange& DataRange, MIL_INT ProfileSize);
-      virtual ~CProfileSingleProcess();
-      virtual void Process(const SPData& Data);
-   private:
-      MIL_ID m_MilDisplay;
-      MIL_ID m_MilGraList;
-      MIL_ID m_MilDisplayedImage;
-   };
-
-//*****************************************************************************
-// Processing to be applied to the 3d points of a multiple 
-// profile in order to create and display a depth map.
-//*****************************************************************************
-class CProfileDepthMapProcess : public CProfile3dPointsProcess
-   {
-   public:
-      CProfileDepthMapProcess(MIL_ID MilSystem, const SPCal& PCal, const SPRange& DataRange,
-                              MIL_DOUBLE WorldPosY, MIL_DOUBLE ConveyorSpeed,
-                              MIL_INT ProfileSize, MIL_INT NbProfiles);
-      virtual ~CProfileDepthMapProcess();
-      virtual void Process(const SPData& Data);
-
-   private:
-      MIL_ID  m_MilDisplay;
-      MIL_ID  m_MilPointCloudContainer;
-      MIL_ID  m_MilDepthMap;
-      MIL_ID  m_MilDisplayLut;
-      std::vector<MIL_FLOAT> m_ConvertedY;
-#if USE_D3D_DISPLAY
-      MIL_DISP_D3D_HANDLE m_3DDispHandle;
-#endif
-      MIL_INT m_NbFramesProcessed;
-   };
-
-#endif // PROFILE_PROCESS_H
+﻿/************************************************************************************/
+/*
+* File name: ProfileProcess.h
+*
+* Synopsis:  This file contains the declaration of the CProfileProcess classes that
+*            are processing some profile data(SPdata). 
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+#include <vector>
+#include "DataConversion.h"
+#include "DepthMapHoleFiller.h"
+#include "DepthMapTileStore.h"
+#include "DepthMapPyramid.h"
+#include "PartSegmenter.h"
+#include "PartInspector.h"
+#include "OrganizedPointCloud.h"
+#include "ProfileMesher.h"
+#include "VoxelAccumulator.h"
+#include "PointIndex.h"
+#include "DepthMapFusion.h"
+#include "DepthMapColorizer.h"
+
+#ifndef PROFILE_PROCESS_H
+#define PROFILE_PROCESS_H
+
+// DirectX display is only available under Windows.
+#if M_MIL_USE_WINDOWS && !M_MIL_USE_RT
+#define USE_D3D_DISPLAY  1
+#include "MdispD3D.h"
+#endif
+
+//*****************************************************************************
+// Structure defining the range of the sensor profile.
+//*****************************************************************************
+struct SPRange
+   {
+   MIL_DOUBLE MinX;
+   MIL_DOUBLE MinZ;
+   MIL_DOUBLE MaxX;
+   MIL_DOUBLE MaxZ;
+   };
+
+//*****************************************************************************
+// Structure defining the continuous depth map built from the profiles.
+//*****************************************************************************
+struct SPDepthMapSettings
+   {
+   MIL_INT     MapLength;       // Number of rows kept in the continuous depth map.
+   MIL_INT     DisplayLength;   // Number of last rows displayed.
+   ECellPolicy CellPolicy;      // Combination of the points of a cell.
+   MIL_INT     NbWorkers;       // Number of rasterization threads. 0 for one per core.
+   MIL_DOUBLE  PixelSizeX;      // Cell size in X, in mm. 0 for the profile resolution.
+   MIL_DOUBLE  PixelSizeY;      // Row spacing in Y, in mm. 0 for the conveyor step.
+   MIL_INT     MaxHoleSize;     // Largest hole filled, in cells. 0 to not fill the holes.
+   MIL_CONST_TEXT_PTR SpillFileName; // File of the out-of-core tiles. M_NULL to not keep them.
+   MIL_INT     TileRows;        // Number of rows of the out-of-core tiles.
+   MIL_INT     NbPyramidLevels; // Number of reduced levels of the pyramid. 0 for no pyramid.
+   bool        SegmentParts;    // Segment the parts of the depth map.
+   MIL_DOUBLE  PartMinZ;        // Cells higher than this are parts, in mm.
+   MIL_INT     PartMinCells;    // Smaller parts are noise, in cells.
+   bool        InspectParts;    // Compare the parts with a golden part.
+   MIL_CONST_TEXT_PTR GoldenFileName; // Depth map of the golden part. M_NULL to learn the first part.
+   MIL_DOUBLE  InspectionTolerance;   // Largest deviation from the golden part, in mm.
+   MIL_INT     MaxOutOfTolerance;     // Most cells out of tolerance of a passing part.
+   bool        ComputeNormals;  // Keep the organized point cloud and its normals.
+   bool        GenerateMesh;    // Triangulate the organized point cloud.
+   MIL_DOUBLE  VoxelSize;       // Size of the voxels of the decimated points, in mm. 0 to not accumulate.
+   EVoxelPolicy VoxelPolicy;    // Point kept for a voxel.
+   MIL_DOUBLE  IndexCellSize;   // Size of the cells of the point index, in mm. 0 to not index.
+   MIL_DOUBLE  IndexLength;     // Length of the last part of the scan indexed, in mm. 0 for the whole scan.
+   MIL_DOUBLE  PreviewRate;     // Highest rate of the colorized previews, in Hz. 0 for no preview.
+   };
+
+//*****************************************************************************
+// Base class of a processing to apply to some profile data.
+//*****************************************************************************
+class CProfileProcess
+   {
+   public:
+      CProfileProcess(const SPCal& PCal, MIL_INT NbPoints);
+      virtual ~CProfileProcess();
+      virtual void Process(const SPData& Data) = 0;
+      virtual void ProcessEmptyBlock();
+
+      // Planning of the data conversion buffers.
+      virtual SPPlanData Plan(CBufferPlanner& Planner, const SPPlanData& Data);
+      virtual void Bind(const CBufferPlanner& Planner, const SPProfileKernels& Kernels);
+
+      // Statistics of the last processed block.
+      const SPStats& GetLastStats() const { return m_LastStats; }
+
+      // Reference profile of the belt. M_NULL if the Z are absolute.
+      virtual CBeltReference* GetBeltReference() const { return M_NULL; }
+
+   protected:
+      MIL_UINT m_NbPoints;
+      SPCal m_PCal;
+      SPStats m_LastStats;
+      CDataConversion* m_pProcessProfileDataConversion;
+   };
+
+//*****************************************************************************
+// Base class of a processing to apply to some profile data
+// that requires to convert the profiles to 3d points.
+//*****************************************************************************
+class CProfile3dPointsProcess: public CProfileProcess
+   {
+   public:
+      CProfile3dPointsProcess(const SPCal& PCal, MIL_INT ProfileSize, MIL_INT NbProfiles,
+                              const SPBeltSettings& BeltSettings);
+      virtual ~CProfile3dPointsProcess();
+
+      virtual CBeltReference* GetBeltReference() const { return m_pBeltReference; }
+
+   protected:
+      SPData ConvertData(const SPData& Data);
+
+      CBeltReference* m_pBeltReference;
+   };
+
+//*****************************************************************************
+// Processing to be applied to the 3d points of a single profile.
+//*****************************************************************************
+class CProfileSingleProcess: public CProfile3dPointsProcess
+   {
+   public:
+      CProfileSingleProcess(MIL_ID MilSystem, const SPCal& ConvertPCal,
+                            const SPRange& DataRange, MIL_INT ProfileSize,
+                            const SPBeltSettings& BeltSettings);
+      virtual ~CProfileSingleProcess();
+      virtual void Process(const SPData& Data);
+      virtual void ProcessEmptyBlock();
+   private:
+      void DrawPoints(const MIL_FLOAT* pX, const MIL_FLOAT* pZ, MIL_INT NbPoints);
+
+      MIL_ID m_MilDisplay;
+      MIL_ID m_MilGraList;
+      MIL_ID m_MilDisplayedImage;
+   };
+
+//*****************************************************************************
+// Processing to be applied to the 3d points of a multiple 
+// profile in order to create and display a depth map. The blocks
+// of profiles are stitched in a continuous depth map.
+//*****************************************************************************
+class CProfileDepthMapProcess : public CProfile3dPointsProcess
+   {
+   public:
+      CProfileDepthMapProcess(MIL_ID MilSystem, const SPCal& PCal, const SPRange& DataRange,
+                              MIL_DOUBLE WorldPosY, MIL_DOUBLE ConveyorSpeed,
+                              MIL_INT ProfileSize, MIL_INT NbProfiles,
+                              const SPBeltSettings& BeltSettings,
+                              const SPDepthMapSettings& Settings);
+      virtual ~CProfileDepthMapProcess();
+      virtual void Bind(const CBufferPlanner& Planner, const SPProfileKernels& Kernels);
+      virtual void Process(const SPData& Data);
+      virtual void ProcessEmptyBlock();
+      void EndScan();
+
+      // Continuous depth map.
+      const CDepthMapRing& GetDepthMapRing() const { return *m_pDepthMapRing; }
+      const SPRowRange& GetLastUpdatedRows() const { return m_LastUpdatedRows; }
+      MIL_INT64 GetNbFinalRows() const;
+
+      // Out-of-core tiles of the whole scan. M_NULL if they are not kept.
+      const CDepthMapTileStore* GetTileStore() const { return m_pTileStore; }
+
+      // Min, max and mean pyramid of the depth map. M_NULL if not maintained.
+      const CDepthMapPyramid* GetPyramid() const { return m_pPyramid; }
+
+      // Segmentation of the parts. M_NULL if the parts are not segmented.
+      const CPartSegmenter* GetPartSegmenter() const { return m_pPartSegmenter; }
+
+      // Inspection of the parts. M_NULL if the parts are not inspected.
+      const CPartInspector* GetPartInspector() const { return m_pPartInspector; }
+
+      // Organized point cloud and normals. M_NULL if not computed.
+      const COrganizedPointCloud* GetOrganizedPointCloud() const { return m_pOrganizedPointCloud; }
+
+      // Streaming mesh of the profiles. M_NULL if not generated.
+      const CProfileMesher* GetMesher() const { return m_pMesher; }
+
+      // Voxel accumulator of the whole scan. M_NULL if not accumulated.
+      const CVoxelAccumulator* GetVoxelAccumulator() const { return m_pVoxelAccumulator; }
+
+      // Spatial index of the points of the whole scan. M_NULL if not indexed.
+      const CPointIndex* GetPointIndex() const { return m_pPointIndex; }
+
+      // Colorized previews of the displayed rows. M_NULL if not colorized.
+      const CDepthMapColorizer* GetColorizer() const { return m_pColorizer; }
+
+   private:
+      void UpdateDepthMap();
+
+      MIL_ID  m_MilDisplay;
+      MIL_ID  m_MilDepthMap;
+      MIL_ID  m_MilDisplayLut;
+      MIL_INT m_ProfileSize;
+      MIL_INT m_NbProfiles;
+      MIL_INT m_DisplayLength;
+      CWorkerPool* m_pWorkerPool;
+      CDepthMapRasterizer* m_pRasterizer;
+      CDepthMapHoleFiller* m_pHoleFiller;
+      CDepthMapTileStore* m_pTileStore;
+      CDepthMapRing* m_pDepthMapRing;
+      CDepthMapPyramid* m_pPyramid;
+      CPartSegmenter* m_pPartSegmenter;
+      CPartInspector* m_pPartInspector;
+      COrganizedPointCloud* m_pOrganizedPointCloud;
+      CProfileMesher* m_pMesher;
+      CVoxelAccumulator* m_pVoxelAccumulator;
+      CPointIndex* m_pPointIndex;
+      CDepthMapColorizer* m_pColorizer;
+      SPRowRange m_LastUpdatedRows;
+#if USE_D3D_DISPLAY
+      MIL_DISP_D3D_HANDLE m_3DDispHandle;
+#endif
+      MIL_INT m_NbFramesProcessed;
+   };
+
+//*****************************************************************************
+// Processing of the profiles of one of several sensors whose depth maps are
+// fused. The points are converted with the calibration of the sensor, moved
+// to its pose and rasterized in its own depth map on the grid of the fusion.
+// Each sensor is processed by the thread of its interface, with its own
+// workers, so the sensors run in parallel.
+//*****************************************************************************
+class CProfileFusionProcess : public CProfile3dPointsProcess
+   {
+   public:
+      CProfileFusionProcess(MIL_ID MilSystem, const SPCal& PCal, const SPRange& DataRange,
+                            const SPSensorPose& Pose, MIL_DOUBLE ConveyorSpeed,
+                            MIL_INT ProfileSize, MIL_INT NbProfiles,
+                            const SPBeltSettings& BeltSettings, ECellPolicy CellPolicy,
+                            MIL_INT NbWorkers, CDepthMapFusion& Fusion, MIL_INT Sensor);
+      virtual ~CProfileFusionProcess();
+      virtual void Bind(const CBufferPlanner& Planner, const SPProfileKernels& Kernels);
+      virtual void Process(const SPData& Data);
+      virtual void ProcessEmptyBlock();
+
+      // Depth map of the sensor.
+      const CDepthMapRing& GetDepthMapRing() const { return *m_pDepthMapRing; }
+
+   private:
+      void UpdateFusion(const SPRowRange& UpdatedRows);
+
+      MIL_INT m_ProfileSize;
+      MIL_INT m_NbProfiles;
+      MIL_INT m_Sensor;
+      CDepthMapFusion& m_Fusion;
+      CWorkerPool* m_pWorkerPool;
+      CDepthMapRasterizer* m_pRasterizer;
+      CDepthMapRing* m_pDepthMapRing;
+   };
+
+#endif // PROFILE_PROCESS_H
@@ -0,0 +1,241 @@
+﻿/************************************************************************************/
+/*
+* File name: VoxelAccumulator.cpp
+*
+* Synopsis:  This file contains the implementation of the CVoxelAccumulator class that
+*            accumulates the converted points of a scan in a voxel hash.
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+#include <mil.h>
+#include <math.h>
+#include "VoxelAccumulator.h"
+
+//*****************************************************************************
+// Constants.
+//*****************************************************************************
+
+// Bits of the voxel coordinates in the keys. The coordinates are biased to
+// be positive. The key with all the bits set marks the empty slots.
+static const MIL_INT    KEY_BITS_X = 21;
+static const MIL_INT    KEY_BITS_Y = 22;
+static const MIL_INT    KEY_BITS_Z = 21;
+static const MIL_UINT64 EMPTY_KEY = ~(MIL_UINT64)0;
+
+// Initial number of slots of the hash table. Power of 2.
+static const MIL_INT INITIAL_NB_SLOTS = 1 << 16;
+
+static MIL_CONST_TEXT_PTR VOXEL_POLICY_NAMES[NB_VOXEL_POLICIES] =
+   {
+   MIL_TEXT("centroid"),
+   MIL_TEXT("max Z")
+   };
+
+//*****************************************************************************
+// GetVoxelPolicyName. Gets the display name of a voxel policy.
+//*****************************************************************************
+MIL_CONST_TEXT_PTR GetVoxelPolicyName(EVoxelPolicy Policy)
+   {
+   return (Policy >= 0 && Policy < NB_VOXEL_POLICIES) ? VOXEL_POLICY_NAMES[Policy] : MIL_TEXT("unknown");
+   }
+
+//*****************************************************************************
+// HashKey. Mixes the bits of a key (finalizer of splitmix64).
+//*****************************************************************************
+static inline MIL_UINT64 HashKey(MIL_UINT64 Key)
+   {
+   Key = (Key ^ (Key >> 30)) * 0xBF58476D1CE4E5B9ULL;
+   Key = (Key ^ (Key >> 27)) * 0x94D049BB133111EBULL;
+   return Key ^ (Key >> 31);
+   }
+
+//*****************************************************************************
+// Constructor.
+//*****************************************************************************
+CVoxelAccumulator::CVoxelAccumulator(MIL_ID MilSystem, MIL_DOUBLE VoxelSize, EVoxelPolicy Policy,
+                                     MIL_DOUBLE WorldPosY, MIL_DOUBLE StepY)
+   : m_InvVoxelSize(1.0 / VoxelSize),
+     m_Policy(Policy),
+     m_WorldPosY(WorldPosY),
+     m_StepY(StepY),
+     m_NbProfilesAdded(0),
+     m_NbPointsAdded(0),
+     m_NbPointsOutOfRange(0),
+     m_SlotMask(INITIAL_NB_SLOTS - 1),
+     m_NbVoxels(0)
+   {
+   SPVoxelSlot EmptySlot = {EMPTY_KEY, 0, 0.0, 0.0, 0.0};
+   m_Slots.resize(INITIAL_NB_SLOTS, EmptySlot);
+   MthrAlloc(MilSystem, M_MUTEX, M_DEFAULT, M_NULL, M_NULL, &m_MilMutex);
+   }
+
+//*****************************************************************************
+// Destructor.
+//*****************************************************************************
+CVoxelAccumulator::~CVoxelAccumulator()
+   {
+   MthrFree(m_MilMutex);
+   }
+
+//*****************************************************************************
+// AddBlock. Adds the valid points of a block to their voxels.
+//*****************************************************************************
+void CVoxelAccumulator::AddBlock(const MIL_FLOAT* pX, const MIL_FLOAT* pZ, const MIL_UINT8* pMask,
+                                 MIL_INT ProfileSize, MIL_INT NbProfiles)
+   {
+   if(!pX)
+      {
+      m_NbProfilesAdded += NbProfiles;
+      return;
+      }
+
+   Lock();
+   MIL_UINT64 LastKey = EMPTY_KEY;
+   SPVoxelSlot* pLastSlot = M_NULL;
+   for(MIL_INT p = 0; p < NbProfiles; p++, m_NbProfilesAdded++)
+      {
+      MIL_DOUBLE Y = m_WorldPosY + m_NbProfilesAdded * m_StepY;
+      MIL_INT Offset = p * ProfileSize;
+      for(MIL_INT i = Offset; i < Offset + ProfileSize; i++)
+         {
+         if(pMask && !pMask[i])
+            continue;
+
+         MIL_UINT64 Key;
+         if(!GetKey(pX[i], Y, pZ[i], Key))
+            {
+            m_NbPointsOutOfRange++;
+            continue;
+            }
+         if(Key != LastKey)
+            {
+            // The slot stays valid until the next FindSlot(), which can
+            // grow the table.
+            pLastSlot = &FindSlot(Key);
+            LastKey = Key;
+            }
+
+         SPVoxelSlot& Slot = *pLastSlot;
+         if(m_Policy == VOXEL_CENTROID)
+            {
+            Slot.X += pX[i];
+            Slot.Y += Y;
+            Slot.Z += pZ[i];
+            }
+         else if(Slot.NbPoints == 0 || pZ[i] > Slot.Z)
+            {
+            Slot.X = pX[i];
+            Slot.Y = Y;
+            Slot.Z = pZ[i];
+            }
+         Slot.NbPoints++;
+         m_NbPointsAdded++;
+         }
+      }
+   Unlock();
+   }
+
+//*****************************************************************************
+// Snapshot. Copies the points of the occupied voxels.
+//*****************************************************************************
+MIL_INT CVoxelAccumulator::Snapshot(std::vector<SPVoxelPoint>& Points) const
+   {
+   Lock();
+   Points.resize((size_t)m_NbVoxels);
+   MIL_INT NbPoints = 0;
+   for(size_t s = 0; s < m_Slots.size(); s++)
+      {
+      const SPVoxelSlot& Slot = m_Slots[s];
+      if(Slot.Key == EMPTY_KEY)
+         continue;
+      SPVoxelPoint& Point = Points[NbPoints++];
+      MIL_DOUBLE Scale = m_Policy == VOXEL_CENTROID ? 1.0 / Slot.NbPoints : 1.0;
+      Point.X = Slot.X * Scale;
+      Point.Y = Slot.Y * Scale;
+      Point.Z = Slot.Z * Scale;
+      Point.NbPoints = Slot.NbPoints;
+      }
+   Unlock();
+   return NbPoints;
+   }
+
+//*****************************************************************************
+// GetMemorySize. Gets the size of the hash table, in bytes.
+//*****************************************************************************
+MIL_INT64 CVoxelAccumulator::GetMemorySize() const
+   {
+   return (MIL_INT64)m_Slots.size() * sizeof(SPVoxelSlot);
+   }
+
+//*****************************************************************************
+// GetKey. Gets the key of the voxel of a point. Returns false if the voxel
+//         is out of the range of the keys.
+//*****************************************************************************
+bool CVoxelAccumulator::GetKey(MIL_DOUBLE X, MIL_DOUBLE Y, MIL_DOUBLE Z, MIL_UINT64& Key) const
+   {
+   MIL_INT64 VoxelX = (MIL_INT64)floor(X * m_InvVoxelSize) + ((MIL_INT64)1 << (KEY_BITS_X - 1));
+   MIL_INT64 VoxelY = (MIL_INT64)floor(Y * m_InvVoxelSize) + ((MIL_INT64)1 << (KEY_BITS_Y - 1));
+   MIL_INT64 VoxelZ = (MIL_INT64)floor(Z * m_InvVoxelSize) + ((MIL_INT64)1 << (KEY_BITS_Z - 1));
+   if(VoxelX < 0 || VoxelX >= ((MIL_INT64)1 << KEY_BITS_X) - 1 ||
+      VoxelY < 0 || VoxelY >= ((MIL_INT64)1 << KEY_BITS_Y) - 1 ||
+      VoxelZ < 0 || VoxelZ >= ((MIL_INT64)1 << KEY_BITS_Z) - 1)
+      return false;
+   Key = ((MIL_UINT64)VoxelY << (KEY_BITS_X + KEY_BITS_Z)) | ((MIL_UINT64)VoxelZ << KEY_BITS_X) | (MIL_UINT64)VoxelX;
+   return true;
+   }
+
+//*****************************************************************************
+// FindSlot. Finds the slot of a voxel, occupying an empty slot for a new
+//           voxel.
+//*****************************************************************************
+CVoxelAccumulator::SPVoxelSlot& CVoxelAccumulator::FindSlot(MIL_UINT64 Key)
+   {
+   if(2 * (m_NbVoxels + 1) > (MIL_INT64)m_Slots.size())
+      Grow();
+
+   MIL_UINT64 s = HashKey(Key) & m_SlotMask;
+   while(m_Slots[s].Key != Key && m_Slots[s].Key != EMPTY_KEY)
+      s = (s + 1) & m_SlotMask;
+   if(m_Slots[s].Key == EMPTY_KEY)
+      {
+      m_Slots[s].Key = Key;
+      m_NbVoxels++;
+      }
+   return m_Slots[s];
+   }
+
+//*****************************************************************************
+// Grow. Doubles the number of slots and reinserts the voxels.
+//*****************************************************************************
+void CVoxelAccumulator::Grow()
+   {
+   std::vector<SPVoxelSlot> OldSlots;
+   OldSlots.swap(m_Slots);
+   SPVoxelSlot EmptySlot = {EMPTY_KEY, 0, 0.0, 0.0, 0.0};
+   m_Slots.resize(2 * OldSlots.size(), EmptySlot);
+   m_SlotMask = m_Slots.size() - 1;
+
+   for(size_t o = 0; o < OldSlots.size(); o++)
+      {
+      if(OldSlots[o].Key == EMPTY_KEY)
+         continue;
+      MIL_UINT64 s = HashKey(OldSlots[o].Key) & m_SlotMask;
+      while(m_Slots[s].Key != EMPTY_KEY)
+         s = (s + 1) & m_SlotMask;
+      m_Slots[s] = OldSlots[o];
+      }
+   }
+
+//*****************************************************************************
+// Lock/Unlock. Protect the hash table.
+//*****************************************************************************
+void CVoxelAccumulator::Lock() const
+   {
+   MthrControl(m_MilMutex, M_LOCK, M_DEFAULT);
+   }
+
+void CVoxelAccumulator::Unlock() const
+   {
+   MthrControl(m_MilMutex, M_UNLOCK, M_DEFAULT);
+   }
@@ -0,0 +1,107 @@
+﻿/************************************************************************************/
+/*
+* File name: VoxelAccumulator.h
+*
+* Synopsis:  This file contains the declaration of the CVoxelAccumulator class that
+*            accumulates the converted points of a scan in a voxel hash and keeps one
+*            point per occupied voxel, to get a decimated point set of long scans.
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+
+#ifndef VOXEL_ACCUMULATOR_H
+#define VOXEL_ACCUMULATOR_H
+
+#include <vector>
+
+//*****************************************************************************
+// Policies selecting the point kept for a voxel.
+//*****************************************************************************
+enum EVoxelPolicy
+   {
+   VOXEL_CENTROID = 0,  // Centroid of the points. Reduces the noise.
+   VOXEL_MAX_Z,         // Highest point. For the tops of the parts.
+   NB_VOXEL_POLICIES
+   };
+
+MIL_CONST_TEXT_PTR GetVoxelPolicyName(EVoxelPolicy Policy);
+
+//*****************************************************************************
+// Structure defining the point kept for a voxel.
+//*****************************************************************************
+struct SPVoxelPoint
+   {
+   MIL_DOUBLE X;
+   MIL_DOUBLE Y;
+   MIL_DOUBLE Z;
+   MIL_UINT32 NbPoints;    // Number of points that fell in the voxel.
+   };
+
+//*****************************************************************************
+// Voxel hash accumulator of the converted blocks.
+//
+// The voxels are the cubes of VoxelSize aligned on the world origin. The
+// occupied voxels are kept in a hash table with open addressing and linear
+// probing, whose capacity doubles when it is half full, so the memory grows
+// with the number of occupied voxels and not with the number of points.
+// Consecutive points of a profile often fall in the same voxel, so the
+// last voxel found is checked first.
+//
+// The Y of a profile is its position on the conveyor. Snapshot() can be
+// called from another thread while the blocks are added.
+//*****************************************************************************
+class CVoxelAccumulator
+   {
+   public:
+      CVoxelAccumulator(MIL_ID MilSystem, MIL_DOUBLE VoxelSize, EVoxelPolicy Policy,
+                        MIL_DOUBLE WorldPosY, MIL_DOUBLE StepY);
+      ~CVoxelAccumulator();
+
+      // Adds a block of converted points. pMask can be M_NULL if all the
+      // points are valid; without points, the profiles are only skipped.
+      void AddBlock(const MIL_FLOAT* pX, const MIL_FLOAT* pZ, const MIL_UINT8* pMask,
+                    MIL_INT ProfileSize, MIL_INT NbProfiles);
+
+      // Copies the points of the occupied voxels, in no particular order.
+      // Returns the number of points.
+      MIL_INT Snapshot(std::vector<SPVoxelPoint>& Points) const;
+
+      MIL_INT64 GetNbVoxels() const { return m_NbVoxels; }
+      MIL_INT64 GetNbPointsAdded() const { return m_NbPointsAdded; }
+      MIL_INT64 GetNbPointsOutOfRange() const { return m_NbPointsOutOfRange; }
+      MIL_INT64 GetMemorySize() const;
+
+   private:
+      // Slot of the hash table. For the centroid policy, X, Y and Z are the
+      // sums of the points; for the max Z policy, they are the highest point.
+      struct SPVoxelSlot
+         {
+         MIL_UINT64 Key;
+         MIL_UINT32 NbPoints;
+         MIL_DOUBLE X;
+         MIL_DOUBLE Y;
+         MIL_DOUBLE Z;
+         };
+
+      bool GetKey(MIL_DOUBLE X, MIL_DOUBLE Y, MIL_DOUBLE Z, MIL_UINT64& Key) const;
+      SPVoxelSlot& FindSlot(MIL_UINT64 Key);
+      void Grow();
+      void Lock() const;
+      void Unlock() const;
+
+      MIL_DOUBLE   m_InvVoxelSize;
+      EVoxelPolicy m_Policy;
+      MIL_DOUBLE   m_WorldPosY;
+      MIL_DOUBLE   m_StepY;
+      MIL_INT64    m_NbProfilesAdded;
+      MIL_INT64    m_NbPointsAdded;
+      MIL_INT64    m_NbPointsOutOfRange;
+      MIL_ID       m_MilMutex;
+
+      std::vector<SPVoxelSlot> m_Slots;
+      MIL_UINT64               m_SlotMask;
+      MIL_INT64                m_NbVoxels;
+   };
+
+#endif // VOXEL_ACCUMULATOR_H
@@ -0,0 +1,106 @@
+﻿/************************************************************************************/
+/*
+* File name: WorkerPool.cpp
+*
+* Synopsis:  This file contains the implementation of the CWorkerPool class that
+*            runs the items of a parallel task on a set of MIL threads.
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+#include <mil.h>
+#include "CpuFeatures.h"
+#include "WorkerPool.h"
+
+//*****************************************************************************
+// Constructor. Allocates the worker threads and their events. A number of
+//              workers of 0 uses one worker per logical core.
+//*****************************************************************************
+CWorkerPool::CWorkerPool(MIL_ID MilSystem, MIL_INT NbWorkers)
+   : m_pTask(M_NULL),
+     m_NbItems(0),
+     m_Exit(false)
+   {
+   if(NbWorkers <= 0)
+      NbWorkers = GetNbLogicalCores();
+
+   // The addresses of the workers are given to the threads, so the vector
+   // is sized before the threads are started.
+   m_Workers.resize(NbWorkers - 1);
+   for(size_t w = 0; w < m_Workers.size(); w++)
+      {
+      SPWorker& Worker = m_Workers[w];
+      Worker.pPool = this;
+      Worker.Index = (MIL_INT)w + 1;
+      MthrAlloc(MilSystem, M_EVENT, M_NOT_SIGNALED + M_AUTO_RESET, M_NULL, M_NULL, &Worker.MilStartEvent);
+      MthrAlloc(MilSystem, M_EVENT, M_NOT_SIGNALED + M_AUTO_RESET, M_NULL, M_NULL, &Worker.MilDoneEvent);
+      }
+   for(size_t w = 0; w < m_Workers.size(); w++)
+      MthrAlloc(MilSystem, M_THREAD, M_DEFAULT, &WorkerThread, &m_Workers[w], &m_Workers[w].MilThread);
+   }
+
+//*****************************************************************************
+// Destructor. Stops the worker threads and frees them.
+//*****************************************************************************
+CWorkerPool::~CWorkerPool()
+   {
+   m_Exit = true;
+   for(size_t w = 0; w < m_Workers.size(); w++)
+      MthrControl(m_Workers[w].MilStartEvent, M_EVENT_SET, M_SIGNALED);
+   for(size_t w = 0; w < m_Workers.size(); w++)
+      {
+      MthrWait(m_Workers[w].MilThread, M_THREAD_END_WAIT, M_NULL);
+      MthrFree(m_Workers[w].MilThread);
+      MthrFree(m_Workers[w].MilStartEvent);
+      MthrFree(m_Workers[w].MilDoneEvent);
+      }
+   }
+
+//*****************************************************************************
+// Run. Runs the NbItems items of a task and returns when they are all done.
+//      Only the workers that have items are started.
+//*****************************************************************************
+void CWorkerPool::Run(CParallelTask& Task, MIL_INT NbItems)
+   {
+   m_pTask = &Task;
+   m_NbItems = NbItems;
+
+   MIL_INT NbStarted = NbItems - 1 < (MIL_INT)m_Workers.size() ? NbItems - 1 : (MIL_INT)m_Workers.size();
+   for(MIL_INT w = 0; w < NbStarted; w++)
+      MthrControl(m_Workers[w].MilStartEvent, M_EVENT_SET, M_SIGNALED);
+
+   RunItems(0);
+
+   for(MIL_INT w = 0; w < NbStarted; w++)
+      MthrWait(m_Workers[w].MilDoneEvent, M_EVENT_WAIT, M_NULL);
+   m_pTask = M_NULL;
+   }
+
+//*****************************************************************************
+// RunItems. Runs the items of a worker.
+//*****************************************************************************
+void CWorkerPool::RunItems(MIL_INT Worker)
+   {
+   MIL_INT NbWorkers = GetNbWorkers();
+   for(MIL_INT Item = Worker; Item < m_NbItems; Item += NbWorkers)
+      m_pTask->RunItem(Item, Worker);
+   }
+
+//*****************************************************************************
+// WorkerThread. Function of the worker threads. Waits for a task, runs its
+//               items and signals the end.
+//*****************************************************************************
+MIL_UINT32 MFTYPE CWorkerPool::WorkerThread(void* pUserData)
+   {
+   SPWorker& Worker = *(SPWorker*)pUserData;
+   CWorkerPool& Pool = *Worker.pPool;
+   while(true)
+      {
+      MthrWait(Worker.MilStartEvent, M_EVENT_WAIT, M_NULL);
+      if(Pool.m_Exit)
+         break;
+      Pool.RunItems(Worker.Index);
+      MthrControl(Worker.MilDoneEvent, M_EVENT_SET, M_SIGNALED);
+      }
+   return 0;
+   }
@@ -0,0 +1,66 @@
+﻿/************************************************************************************/
+/*
+* File name: WorkerPool.h
+*
+* Synopsis:  This file contains the declaration of the CWorkerPool class that runs
+*            the items of a parallel task on a set of MIL threads. The items are
+*            distributed statically among the workers so that they do not share
+*            any lock or counter.
+*
+* Copyright © 1992-2024 Zebra Technologies Corp. and/or its affiliates
+* All Rights Reserved
+*/
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <vector>
+
+//*****************************************************************************
+// Base class of a task whose items can run in parallel. The items must not
+// write the same data. Worker is the index of the worker that runs the item,
+// used to select its scratch memory.
+//*****************************************************************************
+class CParallelTask
+   {
+   public:
+      virtual ~CParallelTask() {}
+      virtual void RunItem(MIL_INT Item, MIL_INT Worker) = 0;
+   };
+
+//*****************************************************************************
+// Class running the parallel tasks on a pool of worker threads.
+//
+// The calling thread is worker 0 and the pool allocates NbWorkers - 1 MIL
+// threads. Worker w runs the items w, w + NbWorkers, w + 2 * NbWorkers...
+// The only synchronization is the start and done events of each thread.
+//*****************************************************************************
+class CWorkerPool
+   {
+   public:
+      CWorkerPool(MIL_ID MilSystem, MIL_INT NbWorkers);
+      virtual ~CWorkerPool();
+
+      void Run(CParallelTask& Task, MIL_INT NbItems);
+      MIL_INT GetNbWorkers() const { return (MIL_INT)m_Workers.size() + 1; }
+
+   private:
+      struct SPWorker
+         {
+         CWorkerPool* pPool;
+         MIL_INT      Index;
+         MIL_ID       MilThread;
+         MIL_ID       MilStartEvent;
+         MIL_ID       MilDoneEvent;
+         };
+
+      static MIL_UINT32 MFTYPE WorkerThread(void* pUserData);
+      void RunItems(MIL_INT Worker);
+
+      std::vector<SPWorker> m_Workers;
+      CParallelTask*        m_pTask;
+      MIL_INT               m_NbItems;
+      bool                  m_Exit;
+   };
+
+#endif // WORKER_POOL_H